@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include "system.h"
 
 // GhostC Language Types
@@ -18,6 +19,21 @@ typedef enum {
 } GhostCType;
 
 // GhostC Value Structure
+//
+// Built with GHOSTC_NAN_BOXING, a value is one 64-bit word instead of a
+// 24-byte tagged union (on ARM), which shrinks the value stack, globals
+// and arrays to a third.
+// Every double stands for itself except the quiet NaNs whose top 16 bits
+// are 0xFFF9 or above; those carry a type there and a 48-bit payload
+// below, ints sign-extended and pointers as they are. Ints then wrap at
+// 48 bits rather than 64, and a script has no way to hold a struct or a
+// function. Code outside this header reads and builds values only through
+// the accessors that follow, so it works with either representation.
+#ifdef GHOSTC_NAN_BOXING
+typedef struct GhostCValue {
+    uint64_t bits;
+} GhostCValue;
+#else
 typedef struct GhostCValue {
     GhostCType type;
     union {
@@ -40,6 +56,188 @@ typedef struct GhostCValue {
         } function;
     } value;
 } GhostCValue;
+#endif
+
+#ifdef GHOSTC_NAN_BOXING
+#define GHOSTC_BOX_TAGGED 0xFFF9000000000000ULL
+#define GHOSTC_BOX_PAYLOAD 0x0000FFFFFFFFFFFFULL
+#define GHOSTC_BOX(type, payload) \
+    ((GhostCValue){GHOSTC_BOX_TAGGED + ((uint64_t)(type) << 48) + ((uint64_t)(payload) & GHOSTC_BOX_PAYLOAD)})
+
+static inline GhostCType ghostc_type_of(GhostCValue value) {
+    return value.bits < GHOSTC_BOX_TAGGED ? GHOSTC_TYPE_FLOAT
+                                          : (GhostCType)((value.bits - GHOSTC_BOX_TAGGED) >> 48);
+}
+
+static inline int64_t ghostc_int(GhostCValue value) {
+    return (int64_t)(value.bits << 16) >> 16;
+}
+
+static inline double ghostc_float(GhostCValue value) {
+    double number;
+    memcpy(&number, &value.bits, sizeof(number));
+    return number;
+}
+
+static inline int ghostc_bool(GhostCValue value) {
+    return (int)(value.bits & 1);
+}
+
+static inline char* ghostc_string(GhostCValue value) {
+    return (char*)(uintptr_t)(value.bits & GHOSTC_BOX_PAYLOAD);
+}
+
+static inline GhostCValue* ghostc_array(GhostCValue value) {
+    return (GhostCValue*)(uintptr_t)(value.bits & GHOSTC_BOX_PAYLOAD);
+}
+
+static inline GhostCValue ghostc_make_void(void) {
+    return GHOSTC_BOX(GHOSTC_TYPE_VOID, 0);
+}
+
+static inline GhostCValue ghostc_make_int(int64_t number) {
+    return GHOSTC_BOX(GHOSTC_TYPE_INT, number);
+}
+
+// Every NaN becomes the positive quiet one, so none can pass for a tag
+static inline GhostCValue ghostc_make_float(double number) {
+    GhostCValue value;
+    if (number != number) {
+        value.bits = 0x7FF8000000000000ULL;
+    } else {
+        memcpy(&value.bits, &number, sizeof(number));
+    }
+    return value;
+}
+
+static inline GhostCValue ghostc_make_bool(int truth) {
+    return GHOSTC_BOX(GHOSTC_TYPE_BOOL, truth != 0);
+}
+
+static inline GhostCValue ghostc_make_string(char* string) {
+    return GHOSTC_BOX(GHOSTC_TYPE_STRING, (uintptr_t)string);
+}
+
+// The length is not stored in the value; the runtime keeps it with the
+// elements
+static inline GhostCValue ghostc_make_array(GhostCValue* elements, size_t length) {
+    (void)length;
+    return GHOSTC_BOX(GHOSTC_TYPE_ARRAY, (uintptr_t)elements);
+}
+#else
+static inline GhostCType ghostc_type_of(GhostCValue value) {
+    return value.type;
+}
+
+static inline int64_t ghostc_int(GhostCValue value) {
+    return value.value.int_val;
+}
+
+static inline double ghostc_float(GhostCValue value) {
+    return value.value.float_val;
+}
+
+static inline int ghostc_bool(GhostCValue value) {
+    return value.value.bool_val;
+}
+
+static inline char* ghostc_string(GhostCValue value) {
+    return value.value.string_val;
+}
+
+static inline GhostCValue* ghostc_array(GhostCValue value) {
+    return (GhostCValue*)value.value.array.data;
+}
+
+static inline GhostCValue ghostc_make_void(void) {
+    GhostCValue value;
+    value.type = GHOSTC_TYPE_VOID;
+    return value;
+}
+
+static inline GhostCValue ghostc_make_int(int64_t number) {
+    GhostCValue value;
+    value.type = GHOSTC_TYPE_INT;
+    value.value.int_val = number;
+    return value;
+}
+
+static inline GhostCValue ghostc_make_float(double number) {
+    GhostCValue value;
+    value.type = GHOSTC_TYPE_FLOAT;
+    value.value.float_val = number;
+    return value;
+}
+
+static inline GhostCValue ghostc_make_bool(int truth) {
+    GhostCValue value;
+    value.type = GHOSTC_TYPE_BOOL;
+    value.value.bool_val = (uint8_t)(truth != 0);
+    return value;
+}
+
+static inline GhostCValue ghostc_make_string(char* string) {
+    GhostCValue value;
+    value.type = GHOSTC_TYPE_STRING;
+    value.value.string_val = string;
+    return value;
+}
+
+static inline GhostCValue ghostc_make_array(GhostCValue* elements, size_t length) {
+    GhostCValue value;
+    value.type = GHOSTC_TYPE_ARRAY;
+    value.value.array.data = elements;
+    value.value.array.length = length;
+    value.value.array.elem_type = GHOSTC_TYPE_VOID;
+    return value;
+}
+#endif
+
+// A global variable. Names are interned in the runtime heap and found
+// through symbol_index, an open-addressed table of symbol numbers + 1
+// (0 marks a free slot) that is never more than half full.
+typedef struct {
+    char* name;
+    uint32_t hash;
+    GhostCValue value;
+} GhostCSymbol;
+
+// GhostC Heap
+//
+// Everything a script allocates comes out of runtime->heap. Interned
+// names and long-lived blocks are carved upwards from the bottom; blocks
+// are rounded up to a power-of-two size class and go back on that class's
+// free list when freed. Temporaries come from a scratch arena that grows
+// down from the top and is emptied whenever the value stack is, at the
+// end of every statement and condition.
+//
+// Strings and arrays that outlive their statement are heap blocks owned
+// by an incremental mark-sweep collector. Storing a temporary or an
+// image's string in a variable or an array copies it into one. Once
+// GHOSTC_GC_TRIGGER of the heap has been allocated, a cycle starts, and
+// every statement boundary does at most GHOSTC_GC_STEP units of it:
+// globals or stack slots scanned, array elements traced or heap blocks
+// swept or rescanned. The stack is empty between statements, so the
+// globals are the only roots there, and a write barrier on every store
+// keeps marking correct while the script runs. An allocation that finds
+// the heap full finishes the work at once, with the live stack as extra
+// roots.
+//
+// The collector never calls kmalloc, so it works when kmalloc is
+// exhausted. Arrays waiting to be traced go on a stack of GHOSTC_GC_GRAY
+// entries carved from the heap by ghostc_init; any that do not fit stay
+// gray and are traced where they lie by a rescan of the heap, which
+// steps resume block by block like the sweep.
+#define GHOSTC_HEAP_CLASSES 12   // 16 bytes to 32 KB
+#define GHOSTC_GC_TRIGGER 8      // 1/8 of heap_size
+#define GHOSTC_GC_STEP 64
+#define GHOSTC_GC_GRAY 128
+
+typedef enum {
+    GHOSTC_GC_IDLE,
+    GHOSTC_GC_MARK,
+    GHOSTC_GC_SWEEP
+} GhostCCollectorPhase;
 
 // GhostC Runtime Environment
 typedef struct {
@@ -48,13 +246,81 @@ typedef struct {
     size_t stack_ptr;
     void* heap;
     size_t heap_size;
-    struct {
-        char* name;
-        GhostCValue value;
-    }* symbols;
+    size_t heap_used;           // Bytes carved from the bottom
+    size_t scratch_used;        // Bytes taken from the top
+    void* free_lists[GHOSTC_HEAP_CLASSES];
+    GhostCCollectorPhase gc_phase;
+    size_t gc_cursor;           // Next global to mark from, or heap offset to sweep
+    size_t gc_stack_cursor;     // Next stack slot to mark from
+    void** gc_gray;             // Arrays marked but not yet traced; in the heap
+    size_t gc_gray_count;
+    size_t gc_gray_capacity;
+    int gc_gray_overflow;       // A gray array did not fit in gc_gray
+    int gc_rescanning;          // The heap is being rescanned for such arrays
+    size_t gc_rescan;           // Heap offset the rescan has reached
+    size_t gc_allocated;        // Bytes allocated since the last cycle began
+    GhostCSymbol* symbols;
     size_t symbol_count;
+    size_t symbol_capacity;
+    uint32_t* symbol_index;
+    size_t symbol_index_size;   // Power of two
+    const char* error;          // Why the last ghostc_execute failed
 } GhostCRuntime;
 
+// GhostC Bytecode
+//
+// ghostc_compile produces one self-contained image: a header, the constant
+// pool, the globals table, the text of the string constants, then the
+// code. Variables are numbered per image; the globals table gives the
+// constant holding each one's name, and ghostc_execute binds them all to
+// runtime symbols once before the first instruction runs. Each opcode is
+// one byte followed by its operands; 16-bit operands are little-endian.
+// ghostc_execute verifies an image once and then runs it without further
+// checks, so the image must be 8-byte aligned and must not change while
+// it runs.
+#define GHOSTC_MAGIC 0x31434847  // "GHC1"
+
+typedef enum {
+    GHOSTC_OP_HALT,
+    GHOSTC_OP_CONST,          // u16 constant
+    GHOSTC_OP_LOAD,           // u16 global
+    GHOSTC_OP_STORE,          // u16 global; pops
+    GHOSTC_OP_POP,
+    GHOSTC_OP_ADD,
+    GHOSTC_OP_SUB,
+    GHOSTC_OP_MUL,
+    GHOSTC_OP_DIV,
+    GHOSTC_OP_MOD,
+    GHOSTC_OP_NEG,
+    GHOSTC_OP_EQ,
+    GHOSTC_OP_NE,
+    GHOSTC_OP_LT,
+    GHOSTC_OP_LE,
+    GHOSTC_OP_GT,
+    GHOSTC_OP_GE,
+    GHOSTC_OP_JUMP,           // u16 code offset
+    GHOSTC_OP_JUMP_IF_FALSE,  // u16 code offset; pops the condition
+    GHOSTC_OP_CALL,           // u8 builtin, u8 argument count
+    GHOSTC_OP_COUNT
+} GhostCOpcode;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t constant_count;
+    uint16_t global_count;    // u16 constant indices after the pool
+    uint32_t strings_size;
+    uint32_t code_size;
+} GhostCImageHeader;
+
+typedef struct {
+    uint32_t type;            // GHOSTC_TYPE_INT, _FLOAT or _STRING
+    uint32_t string_offset;   // Strings: start of the text after the pool
+    union {
+        int64_t int_val;
+        double float_val;
+    } value;
+} GhostCConstant;
+
 // GhostC Compiler Structure
 typedef struct {
     char* source;
@@ -72,12 +338,22 @@ int ghostc_compile(const char* source, GhostCCompiler* compiler);
 int ghostc_execute(GhostCRuntime* runtime, uint8_t* bytecode, size_t size);
 GhostCValue ghostc_eval(GhostCRuntime* runtime, const char* expression);
 
+// Heap Allocation; all return NULL once the heap is full. Blocks from
+// ghostc_alloc are never collected and must be freed explicitly.
+void* ghostc_alloc(GhostCRuntime* runtime, size_t size);
+void ghostc_free(GhostCRuntime* runtime, void* block);
+void* ghostc_scratch(GhostCRuntime* runtime, size_t size);
+
+// Finish any collection in progress and run a full one
+void ghostc_collect(GhostCRuntime* runtime);
+
 // Built-in Functions
-GhostCValue ghostc_print(GhostCValue* args, size_t count);
-GhostCValue ghostc_input(GhostCValue* args, size_t count);
-GhostCValue ghostc_array_new(GhostCValue* args, size_t count);
-GhostCValue ghostc_array_get(GhostCValue* args, size_t count);
-GhostCValue ghostc_array_set(GhostCValue* args, size_t count);
+// A builtin that fails sets runtime->error, which stops the script.
+GhostCValue ghostc_print(GhostCRuntime* runtime, GhostCValue* args, size_t count);
+GhostCValue ghostc_input(GhostCRuntime* runtime, GhostCValue* args, size_t count);
+GhostCValue ghostc_array_new(GhostCRuntime* runtime, GhostCValue* args, size_t count);
+GhostCValue ghostc_array_get(GhostCRuntime* runtime, GhostCValue* args, size_t count);
+GhostCValue ghostc_array_set(GhostCRuntime* runtime, GhostCValue* args, size_t count);
 
 // Error Handling
 const char* ghostc_get_error(GhostCCompiler* compiler);
@@ -2,6 +2,8 @@
 #include "../include/ghost_terminal.h"
 #include <string.h>
 
+static void gc_init(GhostCRuntime* runtime);
+
 // Initialize GhostC Runtime
 GhostCRuntime* ghostc_init(size_t stack_size, size_t heap_size) {
     GhostCRuntime* runtime = (GhostCRuntime*)kmalloc(sizeof(GhostCRuntime));
@@ -12,8 +14,23 @@ GhostCRuntime* ghostc_init(size_t stack_size, size_t heap_size) {
     runtime->symbols = NULL;
     runtime->stack_size = stack_size;
     runtime->heap_size = heap_size;
+    runtime->heap_used = 0;
+    runtime->scratch_used = 0;
+    for (size_t i = 0; i < GHOSTC_HEAP_CLASSES; i++) {
+        runtime->free_lists[i] = NULL;
+    }
     runtime->stack_ptr = 0;
     runtime->symbol_count = 0;
+    runtime->symbol_capacity = 0;
+    runtime->symbol_index = NULL;
+    runtime->symbol_index_size = 0;
+    runtime->error = NULL;
+
+    if (!runtime->stack || !runtime->heap) {
+        ghostc_cleanup(runtime);
+        return NULL;
+    }
+    gc_init(runtime);
 
     return runtime;
 }
@@ -22,33 +39,902 @@ GhostCRuntime* ghostc_init(size_t stack_size, size_t heap_size) {
 void ghostc_cleanup(GhostCRuntime* runtime) {
     if (!runtime) return;
 
-    // Free stack
+    // Free stack; the strings it held live in the heap or an image
     if (runtime->stack) {
-        for (size_t i = 0; i < runtime->stack_ptr; i++) {
-            if (runtime->stack[i].type == GHOSTC_TYPE_STRING) {
-                kfree(runtime->stack[i].value.string_val);
-            }
-        }
         kfree(runtime->stack);
     }
 
-    // Free heap
+    // Free heap, and every block, name and temporary with it
     if (runtime->heap) {
         kfree(runtime->heap);
     }
 
-    // Free symbols
+    // Free symbols; their names live in the heap
     if (runtime->symbols) {
-        for (size_t i = 0; i < runtime->symbol_count; i++) {
-            kfree(runtime->symbols[i].name);
-        }
         kfree(runtime->symbols);
     }
+    if (runtime->symbol_index) {
+        kfree(runtime->symbol_index);
+    }
 
     kfree(runtime);
 }
 
-// Simple Compiler Implementation
+// Precedes every block in the heap, so the sweep can walk them in order
+typedef struct {
+    uint8_t size_class;
+    uint8_t kind;
+    uint8_t color;
+    uint8_t reserved;
+    uint32_t length;            // Elements of an array
+} GhostCBlock;
+
+enum {
+    BLOCK_FREE,
+    BLOCK_RAW,                  // From ghostc_alloc; never collected
+    BLOCK_STRING,
+    BLOCK_ARRAY
+};
+
+enum {
+    WHITE,                      // Not reached yet this cycle
+    GRAY,                       // Reached, elements not traced yet
+    BLACK
+};
+
+static size_t block_size(const GhostCBlock* header) {
+    return sizeof(GhostCBlock) + ((size_t)16 << header->size_class);
+}
+
+static void* carve(GhostCRuntime* runtime, size_t size, uint8_t kind) {
+    size_t size_class = 0;
+    while (size_class < GHOSTC_HEAP_CLASSES && ((size_t)16 << size_class) < size) size_class++;
+    if (size_class == GHOSTC_HEAP_CLASSES) return NULL;
+
+    GhostCBlock* header;
+    void* block = runtime->free_lists[size_class];
+    if (block) {
+        runtime->free_lists[size_class] = *(void**)block;
+        header = (GhostCBlock*)block - 1;
+    } else {
+        size_t total = sizeof(GhostCBlock) + ((size_t)16 << size_class);
+        if (runtime->heap_used + total + runtime->scratch_used > (runtime->heap_size & ~(size_t)7)) return NULL;
+        header = (GhostCBlock*)((uint8_t*)runtime->heap + runtime->heap_used);
+        header->size_class = (uint8_t)size_class;
+        runtime->heap_used += total;
+    }
+
+    // A block allocated mid-cycle survives it: marking treats it as
+    // reached, and the sweep only whitens it if it has not passed it yet
+    size_t offset = (size_t)((uint8_t*)header - (uint8_t*)runtime->heap);
+    header->kind = kind;
+    header->color = runtime->gc_phase == GHOSTC_GC_MARK ||
+                    (runtime->gc_phase == GHOSTC_GC_SWEEP && offset >= runtime->gc_cursor) ? BLACK : WHITE;
+    header->length = 0;
+    runtime->gc_allocated += block_size(header);
+    return header + 1;
+}
+
+// Falls back to a full collection when the heap is full
+static void* allocate(GhostCRuntime* runtime, size_t size, uint8_t kind) {
+    void* block = carve(runtime, size, kind);
+    if (!block) {
+        ghostc_collect(runtime);
+        block = carve(runtime, size, kind);
+    }
+    return block;
+}
+
+void* ghostc_alloc(GhostCRuntime* runtime, size_t size) {
+    return allocate(runtime, size, BLOCK_RAW);
+}
+
+void ghostc_free(GhostCRuntime* runtime, void* block) {
+    if (!block) return;
+    GhostCBlock* header = (GhostCBlock*)block - 1;
+    header->kind = BLOCK_FREE;
+    *(void**)block = runtime->free_lists[header->size_class];
+    runtime->free_lists[header->size_class] = block;
+}
+
+void* ghostc_scratch(GhostCRuntime* runtime, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    size_t top = runtime->heap_size & ~(size_t)7;
+    if (runtime->heap_used + runtime->scratch_used + size > top) return NULL;
+    runtime->scratch_used += size;
+    return (uint8_t*)runtime->heap + top - runtime->scratch_used;
+}
+
+// The collected block a value refers to; NULL for numbers, temporaries
+// and strings that belong to an image
+static GhostCBlock* object_of(const GhostCRuntime* runtime, const GhostCValue* value) {
+    const uint8_t* data;
+    GhostCType type = ghostc_type_of(*value);
+    if (type == GHOSTC_TYPE_STRING) {
+        data = (const uint8_t*)ghostc_string(*value);
+    } else if (type == GHOSTC_TYPE_ARRAY) {
+        data = (const uint8_t*)ghostc_array(*value);
+    } else {
+        return NULL;
+    }
+
+    const uint8_t* heap = (const uint8_t*)runtime->heap;
+    if (data < heap + sizeof(GhostCBlock) || data >= heap + runtime->heap_used) return NULL;
+    return (GhostCBlock*)data - 1;
+}
+
+static void gc_push(GhostCRuntime* runtime, GhostCBlock* header) {
+    if (runtime->gc_gray_count == runtime->gc_gray_capacity) {
+        // Left gray; the mark phase rescans the heap for it once gc_gray
+        // is empty
+        runtime->gc_gray_overflow = 1;
+        return;
+    }
+    runtime->gc_gray[runtime->gc_gray_count++] = header;
+}
+
+static void gc_shade(GhostCRuntime* runtime, const GhostCValue* value) {
+    GhostCBlock* header = object_of(runtime, value);
+    if (!header || header->color != WHITE) return;
+    if (header->kind == BLOCK_STRING) {
+        header->color = BLACK;
+    } else {
+        header->color = GRAY;
+        gc_push(runtime, header);
+    }
+}
+
+// Makes a value fit to be stored in a variable or an array: a string that
+// is a temporary or belongs to an image is copied into a collected block.
+// While marking, the value is shaded, so that storing it where marking
+// has already been cannot hide it from the collector.
+static int gc_keep(GhostCRuntime* runtime, GhostCValue* value) {
+    if (ghostc_type_of(*value) == GHOSTC_TYPE_STRING && !object_of(runtime, value)) {
+        size_t length = strlen(ghostc_string(*value)) + 1;
+        char* copy = (char*)allocate(runtime, length, BLOCK_STRING);
+        if (!copy) return 0;
+        memcpy(copy, ghostc_string(*value), length);
+        *value = ghostc_make_string(copy);
+    }
+    if (runtime->gc_phase == GHOSTC_GC_MARK) gc_shade(runtime, value);
+    return 1;
+}
+
+static size_t gc_trace(GhostCRuntime* runtime, GhostCBlock* header) {
+    GhostCValue* elements = (GhostCValue*)(header + 1);
+    header->color = BLACK;
+    for (uint32_t i = 0; i < header->length; i++) {
+        gc_shade(runtime, &elements[i]);
+    }
+    return 1 + header->length;
+}
+
+// Does up to budget units of the cycle in progress
+static void gc_run(GhostCRuntime* runtime, size_t budget) {
+    uint8_t* heap = (uint8_t*)runtime->heap;
+
+    while (budget > 0 && runtime->gc_phase != GHOSTC_GC_IDLE) {
+        if (runtime->gc_phase == GHOSTC_GC_SWEEP) {
+            if (runtime->gc_cursor >= runtime->heap_used) {
+                runtime->gc_phase = GHOSTC_GC_IDLE;
+                break;
+            }
+            GhostCBlock* header = (GhostCBlock*)(heap + runtime->gc_cursor);
+            runtime->gc_cursor += block_size(header);
+            budget--;
+            if (header->kind != BLOCK_STRING && header->kind != BLOCK_ARRAY) continue;
+            if (header->color == WHITE) {
+                ghostc_free(runtime, header + 1);
+            } else {
+                header->color = WHITE;
+            }
+            continue;
+        }
+
+        size_t cost = 1;
+        if (runtime->gc_gray_count > 0) {
+            cost = gc_trace(runtime, (GhostCBlock*)runtime->gc_gray[--runtime->gc_gray_count]);
+        } else if (runtime->gc_cursor < runtime->symbol_count) {
+            gc_shade(runtime, &runtime->symbols[runtime->gc_cursor++].value);
+        } else if (runtime->gc_rescanning || runtime->gc_gray_overflow) {
+            // One block per unit. Arrays that overflow again while the
+            // rescan runs leave the flag set for another pass; each array
+            // turns gray once a cycle, so the passes come to an end.
+            if (!runtime->gc_rescanning) {
+                runtime->gc_rescanning = 1;
+                runtime->gc_gray_overflow = 0;
+                runtime->gc_rescan = 0;
+            }
+            if (runtime->gc_rescan >= runtime->heap_used) {
+                runtime->gc_rescanning = 0;
+                continue;
+            }
+            GhostCBlock* header = (GhostCBlock*)(heap + runtime->gc_rescan);
+            runtime->gc_rescan += block_size(header);
+            if (header->kind == BLOCK_ARRAY && header->color == GRAY) cost = gc_trace(runtime, header);
+        } else if (runtime->gc_stack_cursor < runtime->stack_ptr) {
+            // Everything reachable from the globals is marked. The stack is
+            // the one place stores do not shade, so it is scanned last. A
+            // bounded step only runs between statements, when the slots
+            // below stack_ptr belong to no running statement and stay as
+            // they are, so the scan resumes where the last step left it.
+            gc_shade(runtime, &runtime->stack[runtime->gc_stack_cursor++]);
+        } else {
+            runtime->gc_phase = GHOSTC_GC_SWEEP;
+            runtime->gc_cursor = 0;
+        }
+        budget -= budget < cost ? budget : cost;
+    }
+}
+
+static void gc_start(GhostCRuntime* runtime) {
+    runtime->gc_phase = GHOSTC_GC_MARK;
+    runtime->gc_cursor = 0;
+    runtime->gc_stack_cursor = 0;
+    runtime->gc_rescanning = 0;
+    runtime->gc_gray_overflow = 0;
+    runtime->gc_allocated = 0;
+}
+
+// The gray stack comes out of the heap, so that marking never needs
+// kmalloc. A heap too small to hold it leaves every gray array to the
+// rescan.
+static void gc_init(GhostCRuntime* runtime) {
+    runtime->gc_phase = GHOSTC_GC_IDLE;
+    runtime->gc_cursor = 0;
+    runtime->gc_stack_cursor = 0;
+    runtime->gc_gray_count = 0;
+    runtime->gc_gray_overflow = 0;
+    runtime->gc_rescanning = 0;
+    runtime->gc_rescan = 0;
+    runtime->gc_gray = (void**)carve(runtime, GHOSTC_GC_GRAY * sizeof(void*), BLOCK_RAW);
+    runtime->gc_gray_capacity = runtime->gc_gray ? GHOSTC_GC_GRAY : 0;
+    runtime->gc_allocated = 0;
+}
+
+// One bounded step, starting a cycle if none is running
+static void gc_step(GhostCRuntime* runtime) {
+    if (runtime->gc_phase == GHOSTC_GC_IDLE) gc_start(runtime);
+    gc_run(runtime, GHOSTC_GC_STEP);
+}
+
+void ghostc_collect(GhostCRuntime* runtime) {
+    // The cycle in progress may have marked what is garbage by now, so a
+    // whole new one follows it
+    gc_run(runtime, (size_t)-1);
+    gc_start(runtime);
+    gc_run(runtime, (size_t)-1);
+}
+
+// FNV-1a
+static uint32_t ghostc_hash(const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Functions scripts can call, indexed by GHOSTC_OP_CALL
+static const struct {
+    const char* name;
+    GhostCValue (*func)(GhostCRuntime* runtime, GhostCValue* args, size_t count);
+} builtins[] = {
+    {"print", ghostc_print},
+    {"input", ghostc_input},
+    {"array", ghostc_array_new},
+    {"get", ghostc_array_get},
+    {"set", ghostc_array_set},
+};
+
+#define BUILTIN_COUNT (sizeof(builtins) / sizeof(builtins[0]))
+
+// Operand bytes that follow each opcode
+static const uint8_t operand_size[GHOSTC_OP_COUNT] = {
+    [GHOSTC_OP_CONST] = 2,
+    [GHOSTC_OP_LOAD] = 2,
+    [GHOSTC_OP_STORE] = 2,
+    [GHOSTC_OP_JUMP] = 2,
+    [GHOSTC_OP_JUMP_IF_FALSE] = 2,
+    [GHOSTC_OP_CALL] = 2,
+};
+
+// Tokens other than single punctuation characters
+enum {
+    TOKEN_EOF = 256,
+    TOKEN_INT,
+    TOKEN_FLOAT,
+    TOKEN_STRING,
+    TOKEN_NAME,
+    TOKEN_IF,
+    TOKEN_ELSE,
+    TOKEN_WHILE,
+    TOKEN_EQ,
+    TOKEN_NE,
+    TOKEN_LE,
+    TOKEN_GE
+};
+
+// State of one ghostc_compile call
+typedef struct {
+    GhostCCompiler* compiler;
+    size_t line;
+    int failed;
+
+    // Current token
+    int token;
+    const char* text;
+    size_t text_length;
+    int64_t int_value;
+    double float_value;
+
+    uint8_t* code;
+    size_t code_size;
+    size_t code_capacity;
+    // While compiling, value.int_val of a string constant that names a
+    // variable holds its global number + 1
+    GhostCConstant* constants;
+    size_t constant_count;
+    size_t constant_capacity;
+    uint32_t* constant_index;   // Open-addressed like GhostCRuntime.symbol_index
+    size_t constant_index_size;
+    uint16_t* globals;
+    size_t global_count;
+    size_t global_capacity;
+    char* strings;
+    size_t strings_size;
+    size_t strings_capacity;
+} GhostCParser;
+
+static void compile_error(GhostCParser* parser, const char* message) {
+    if (parser->failed) return;
+    parser->failed = 1;
+    parser->token = TOKEN_EOF;
+
+    // "line <n>: <message>"
+    char digits[24];
+    size_t count = 0;
+    size_t line = parser->line;
+    do {
+        digits[count++] = (char)('0' + line % 10);
+        line /= 10;
+    } while (line);
+
+    size_t length = strlen(message);
+    char* error = (char*)kmalloc(length + count + 8);
+    if (!error) return;
+    memcpy(error, "line ", 5);
+    for (size_t i = 0; i < count; i++) {
+        error[5 + i] = digits[count - 1 - i];
+    }
+    memcpy(error + 5 + count, ": ", 2);
+    memcpy(error + 7 + count, message, length + 1);
+    parser->compiler->error = error;
+}
+
+// Grows *buffer to hold needed elements, doubling to keep appends cheap
+static int reserve(GhostCParser* parser, void** buffer, size_t* capacity, size_t needed, size_t element_size) {
+    if (needed <= *capacity) return 1;
+
+    size_t grown_capacity = *capacity ? *capacity * 2 : 64;
+    while (grown_capacity < needed) grown_capacity *= 2;
+
+    void* grown = kmalloc(grown_capacity * element_size);
+    if (!grown) {
+        compile_error(parser, "out of memory");
+        return 0;
+    }
+    if (*buffer) {
+        memcpy(grown, *buffer, *capacity * element_size);
+        kfree(*buffer);
+    }
+    *buffer = grown;
+    *capacity = grown_capacity;
+    return 1;
+}
+
+static int is_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static int keyword(const char* text, size_t length) {
+    if (length == 2 && memcmp(text, "if", 2) == 0) return TOKEN_IF;
+    if (length == 4 && memcmp(text, "else", 4) == 0) return TOKEN_ELSE;
+    if (length == 5 && memcmp(text, "while", 5) == 0) return TOKEN_WHILE;
+    return TOKEN_NAME;
+}
+
+static void next_token(GhostCParser* parser) {
+    if (parser->failed) return;
+
+    GhostCCompiler* compiler = parser->compiler;
+    const char* source = compiler->source;
+    size_t pos = compiler->position;
+    size_t length = compiler->length;
+
+    // Whitespace and // comments
+    while (pos < length) {
+        char c = source[pos];
+        if (c == '\n') {
+            parser->line++;
+            pos++;
+        } else if (c == ' ' || c == '\t' || c == '\r') {
+            pos++;
+        } else if (c == '/' && pos + 1 < length && source[pos + 1] == '/') {
+            while (pos < length && source[pos] != '\n') pos++;
+        } else {
+            break;
+        }
+    }
+
+    parser->text = source + pos;
+    if (pos >= length) {
+        parser->token = TOKEN_EOF;
+        compiler->position = pos;
+        return;
+    }
+
+    char c = source[pos];
+    if (c >= '0' && c <= '9') {
+        int64_t value = 0;
+        while (pos < length && source[pos] >= '0' && source[pos] <= '9') {
+            value = value * 10 + (source[pos++] - '0');
+        }
+        parser->token = TOKEN_INT;
+        parser->int_value = value;
+
+        if (pos + 1 < length && source[pos] == '.' && source[pos + 1] >= '0' && source[pos + 1] <= '9') {
+            double fraction = 0.0;
+            double scale = 1.0;
+            for (pos++; pos < length && source[pos] >= '0' && source[pos] <= '9'; pos++) {
+                fraction = fraction * 10.0 + (source[pos] - '0');
+                scale *= 10.0;
+            }
+            parser->token = TOKEN_FLOAT;
+            parser->float_value = (double)value + fraction / scale;
+        }
+    } else if (is_name_char(c)) {
+        while (pos < length && is_name_char(source[pos])) pos++;
+        parser->token = keyword(parser->text, (size_t)(source + pos - parser->text));
+    } else if (c == '"') {
+        // The text keeps its escapes; add_string resolves them
+        for (pos++; pos < length && source[pos] != '"'; pos++) {
+            if (source[pos] == '\\' && pos + 1 < length) pos++;
+            if (source[pos] == '\n') parser->line++;
+        }
+        if (pos >= length) {
+            compile_error(parser, "unterminated string");
+            return;
+        }
+        pos++;
+        parser->token = TOKEN_STRING;
+    } else {
+        char next = pos + 1 < length ? source[pos + 1] : '\0';
+        pos++;
+        parser->token = c;
+        if (next == '=') {
+            switch (c) {
+                case '=': parser->token = TOKEN_EQ; pos++; break;
+                case '!': parser->token = TOKEN_NE; pos++; break;
+                case '<': parser->token = TOKEN_LE; pos++; break;
+                case '>': parser->token = TOKEN_GE; pos++; break;
+                default: break;
+            }
+        }
+        if (!strchr("+-*/%()<>={},;", c) && parser->token == c) {
+            compile_error(parser, "unexpected character");
+            return;
+        }
+    }
+
+    parser->text_length = (size_t)(source + pos - parser->text);
+    compiler->position = pos;
+}
+
+static void expect(GhostCParser* parser, int token, const char* message) {
+    if (parser->token != token) {
+        compile_error(parser, message);
+        return;
+    }
+    next_token(parser);
+}
+
+static void emit_byte(GhostCParser* parser, uint8_t byte) {
+    if (!reserve(parser, (void**)&parser->code, &parser->code_capacity, parser->code_size + 1, 1)) return;
+    parser->code[parser->code_size++] = byte;
+}
+
+static void emit_op(GhostCParser* parser, GhostCOpcode op, size_t operand) {
+    emit_byte(parser, (uint8_t)op);
+    if (operand_size[op] == 2) {
+        emit_byte(parser, (uint8_t)(operand & 0xFF));
+        emit_byte(parser, (uint8_t)(operand >> 8));
+    }
+}
+
+// Emits a jump to be patched once its target is known
+static size_t emit_jump(GhostCParser* parser, GhostCOpcode op) {
+    emit_op(parser, op, 0);
+    return parser->code_size - 2;
+}
+
+static void patch_jump(GhostCParser* parser, size_t operand, size_t target) {
+    if (parser->failed) return;
+    if (target > 0xFFFF) {
+        compile_error(parser, "program too large");
+        return;
+    }
+    parser->code[operand] = (uint8_t)(target & 0xFF);
+    parser->code[operand + 1] = (uint8_t)(target >> 8);
+}
+
+// Bytes that make a constant what it is, for hashing and comparison
+static const void* constant_key(const GhostCParser* parser, const GhostCConstant* constant, size_t* length) {
+    if (constant->type == GHOSTC_TYPE_STRING) {
+        const char* text = parser->strings + constant->string_offset;
+        *length = strlen(text);
+        return text;
+    }
+    *length = sizeof(constant->value);
+    return &constant->value;
+}
+
+static uint32_t constant_hash(const void* key, size_t length, uint32_t type) {
+    return ghostc_hash(key, length) ^ type;
+}
+
+// Finds a constant of type whose key matches, or adds the one given
+static size_t intern_constant(GhostCParser* parser, const GhostCConstant* constant) {
+    size_t length;
+    const void* key = constant_key(parser, constant, &length);
+    uint32_t hash = constant_hash(key, length, constant->type);
+
+    size_t mask = parser->constant_index_size - 1;
+    size_t slot = parser->constant_index_size ? hash & mask : 0;
+    while (parser->constant_index_size && parser->constant_index[slot]) {
+        const GhostCConstant* existing = &parser->constants[parser->constant_index[slot] - 1];
+        size_t existing_length;
+        const void* existing_key = constant_key(parser, existing, &existing_length);
+        if (existing->type == constant->type && existing_length == length &&
+            memcmp(existing_key, key, length) == 0) {
+            return parser->constant_index[slot] - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (parser->constant_count > 0xFFFF) {
+        compile_error(parser, "too many constants");
+        return 0;
+    }
+    if (!reserve(parser, (void**)&parser->constants, &parser->constant_capacity,
+                 parser->constant_count + 1, sizeof(GhostCConstant))) {
+        return 0;
+    }
+    size_t index = parser->constant_count++;
+    parser->constants[index] = *constant;
+
+    // Keep the index at most half full
+    if (parser->constant_count * 2 > parser->constant_index_size) {
+        size_t size = parser->constant_index_size ? parser->constant_index_size * 2 : 64;
+        uint32_t* grown = (uint32_t*)kmalloc(size * sizeof(uint32_t));
+        if (!grown) {
+            compile_error(parser, "out of memory");
+            return 0;
+        }
+        memset(grown, 0, size * sizeof(uint32_t));
+        for (size_t i = 0; i < parser->constant_count; i++) {
+            size_t key_length;
+            const void* existing_key = constant_key(parser, &parser->constants[i], &key_length);
+            size_t at = constant_hash(existing_key, key_length, parser->constants[i].type) & (size - 1);
+            while (grown[at]) at = (at + 1) & (size - 1);
+            grown[at] = (uint32_t)(i + 1);
+        }
+        if (parser->constant_index) kfree(parser->constant_index);
+        parser->constant_index = grown;
+        parser->constant_index_size = size;
+    } else {
+        parser->constant_index[slot] = (uint32_t)(index + 1);
+    }
+    return index;
+}
+
+static size_t add_number(GhostCParser* parser, GhostCType type, int64_t int_val, double float_val) {
+    GhostCConstant constant = {.type = type, .string_offset = 0};
+    if (type == GHOSTC_TYPE_INT) {
+        constant.value.int_val = int_val;
+    } else {
+        constant.value.float_val = float_val;
+    }
+    return intern_constant(parser, &constant);
+}
+
+// Adds text, resolving escapes if it is a quoted literal. The text is
+// written after the strings so far and kept only if it is new.
+static size_t add_string(GhostCParser* parser, const char* text, size_t length, int quoted) {
+    if (!reserve(parser, (void**)&parser->strings, &parser->strings_capacity,
+                 parser->strings_size + length + 1, 1)) {
+        return 0;
+    }
+
+    char* out = parser->strings + parser->strings_size;
+    size_t count = 0;
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        if (quoted && c == '\\' && i + 1 < length) {
+            switch (text[++i]) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case '0': c = '\0'; break;
+                default: c = text[i]; break;
+            }
+        }
+        out[count++] = c;
+    }
+    out[count] = '\0';
+
+    GhostCConstant constant = {.type = GHOSTC_TYPE_STRING, .string_offset = (uint32_t)parser->strings_size};
+    constant.value.int_val = 0;
+    size_t index = intern_constant(parser, &constant);
+    if (index == parser->constant_count - 1 && parser->constants[index].string_offset == parser->strings_size) {
+        parser->strings_size += count + 1;
+    }
+    return index;
+}
+
+// Number of the variable called name in this image
+static size_t add_global(GhostCParser* parser, const char* name, size_t length) {
+    size_t constant = add_string(parser, name, length, 0);
+    if (parser->failed) return 0;
+    if (parser->constants[constant].value.int_val) {
+        return (size_t)parser->constants[constant].value.int_val - 1;
+    }
+
+    if (parser->global_count > 0xFFFF) {
+        compile_error(parser, "too many variables");
+        return 0;
+    }
+    if (!reserve(parser, (void**)&parser->globals, &parser->global_capacity,
+                 parser->global_count + 1, sizeof(uint16_t))) {
+        return 0;
+    }
+    parser->globals[parser->global_count] = (uint16_t)constant;
+    parser->constants[constant].value.int_val = (int64_t)++parser->global_count;
+    return parser->global_count - 1;
+}
+
+static void expression(GhostCParser* parser);
+static void statement(GhostCParser* parser);
+
+static void call(GhostCParser* parser, const char* name, size_t length) {
+    size_t builtin = 0;
+    while (builtin < BUILTIN_COUNT &&
+           !(strlen(builtins[builtin].name) == length && memcmp(builtins[builtin].name, name, length) == 0)) {
+        builtin++;
+    }
+    if (builtin == BUILTIN_COUNT) {
+        compile_error(parser, "unknown function");
+        return;
+    }
+
+    size_t count = 0;
+    next_token(parser);
+    if (parser->token != ')') {
+        do {
+            if (count > 0) next_token(parser);
+            expression(parser);
+            count++;
+        } while (parser->token == ',');
+    }
+    expect(parser, ')', "expected ')' after arguments");
+    if (count > 0xFF) {
+        compile_error(parser, "too many arguments");
+        return;
+    }
+
+    emit_byte(parser, GHOSTC_OP_CALL);
+    emit_byte(parser, (uint8_t)builtin);
+    emit_byte(parser, (uint8_t)count);
+}
+
+static void primary(GhostCParser* parser) {
+    switch (parser->token) {
+        case TOKEN_INT:
+            emit_op(parser, GHOSTC_OP_CONST, add_number(parser, GHOSTC_TYPE_INT, parser->int_value, 0.0));
+            next_token(parser);
+            break;
+        case TOKEN_FLOAT:
+            emit_op(parser, GHOSTC_OP_CONST, add_number(parser, GHOSTC_TYPE_FLOAT, 0, parser->float_value));
+            next_token(parser);
+            break;
+        case TOKEN_STRING:
+            emit_op(parser, GHOSTC_OP_CONST, add_string(parser, parser->text + 1, parser->text_length - 2, 1));
+            next_token(parser);
+            break;
+        case TOKEN_NAME: {
+            const char* name = parser->text;
+            size_t length = parser->text_length;
+            next_token(parser);
+            if (parser->token == '(') {
+                call(parser, name, length);
+            } else {
+                emit_op(parser, GHOSTC_OP_LOAD, add_global(parser, name, length));
+            }
+            break;
+        }
+        case '(':
+            next_token(parser);
+            expression(parser);
+            expect(parser, ')', "expected ')'");
+            break;
+        default:
+            compile_error(parser, "expected an expression");
+            break;
+    }
+}
+
+static void unary(GhostCParser* parser) {
+    if (parser->token == '-') {
+        next_token(parser);
+        unary(parser);
+        emit_op(parser, GHOSTC_OP_NEG, 0);
+    } else {
+        primary(parser);
+    }
+}
+
+static void term(GhostCParser* parser) {
+    unary(parser);
+    while (parser->token == '*' || parser->token == '/' || parser->token == '%') {
+        GhostCOpcode op = parser->token == '*' ? GHOSTC_OP_MUL : parser->token == '/' ? GHOSTC_OP_DIV : GHOSTC_OP_MOD;
+        next_token(parser);
+        unary(parser);
+        emit_op(parser, op, 0);
+    }
+}
+
+static void additive(GhostCParser* parser) {
+    term(parser);
+    while (parser->token == '+' || parser->token == '-') {
+        GhostCOpcode op = parser->token == '+' ? GHOSTC_OP_ADD : GHOSTC_OP_SUB;
+        next_token(parser);
+        term(parser);
+        emit_op(parser, op, 0);
+    }
+}
+
+static void expression(GhostCParser* parser) {
+    additive(parser);
+
+    GhostCOpcode op;
+    switch (parser->token) {
+        case TOKEN_EQ: op = GHOSTC_OP_EQ; break;
+        case TOKEN_NE: op = GHOSTC_OP_NE; break;
+        case '<': op = GHOSTC_OP_LT; break;
+        case TOKEN_LE: op = GHOSTC_OP_LE; break;
+        case '>': op = GHOSTC_OP_GT; break;
+        case TOKEN_GE: op = GHOSTC_OP_GE; break;
+        default: return;
+    }
+    next_token(parser);
+    additive(parser);
+    emit_op(parser, op, 0);
+}
+
+static void block(GhostCParser* parser) {
+    expect(parser, '{', "expected '{'");
+    while (parser->token != '}' && parser->token != TOKEN_EOF) {
+        statement(parser);
+    }
+    expect(parser, '}', "expected '}'");
+}
+
+static void condition(GhostCParser* parser) {
+    next_token(parser);
+    expect(parser, '(', "expected '('");
+    expression(parser);
+    expect(parser, ')', "expected ')'");
+}
+
+// True if the name just read is followed by '=' rather than '=='
+static int assignment_follows(GhostCParser* parser) {
+    const char* source = parser->compiler->source;
+    size_t pos = parser->compiler->position;
+    while (pos < parser->compiler->length && (source[pos] == ' ' || source[pos] == '\t')) pos++;
+    return pos < parser->compiler->length && source[pos] == '=' &&
+           (pos + 1 >= parser->compiler->length || source[pos + 1] != '=');
+}
+
+static void statement(GhostCParser* parser) {
+    if (parser->token == TOKEN_IF) {
+        condition(parser);
+        size_t skip_then = emit_jump(parser, GHOSTC_OP_JUMP_IF_FALSE);
+        block(parser);
+        if (parser->token == TOKEN_ELSE) {
+            size_t skip_else = emit_jump(parser, GHOSTC_OP_JUMP);
+            patch_jump(parser, skip_then, parser->code_size);
+            next_token(parser);
+            if (parser->token == TOKEN_IF) {
+                statement(parser);
+            } else {
+                block(parser);
+            }
+            patch_jump(parser, skip_else, parser->code_size);
+        } else {
+            patch_jump(parser, skip_then, parser->code_size);
+        }
+    } else if (parser->token == TOKEN_WHILE) {
+        size_t loop = parser->code_size;
+        condition(parser);
+        size_t exit = emit_jump(parser, GHOSTC_OP_JUMP_IF_FALSE);
+        block(parser);
+        emit_op(parser, GHOSTC_OP_JUMP, loop);
+        patch_jump(parser, exit, parser->code_size);
+    } else if (parser->token == TOKEN_NAME && assignment_follows(parser)) {
+        size_t global = add_global(parser, parser->text, parser->text_length);
+        next_token(parser);
+        next_token(parser);
+        expression(parser);
+        emit_op(parser, GHOSTC_OP_STORE, global);
+        expect(parser, ';', "expected ';'");
+    } else {
+        expression(parser);
+        emit_op(parser, GHOSTC_OP_POP, 0);
+        expect(parser, ';', "expected ';'");
+    }
+}
+
+// Header, constant pool, globals, string text and code, in one allocation
+static int assemble(GhostCParser* parser) {
+    GhostCCompiler* compiler = parser->compiler;
+    size_t constants_size = parser->constant_count * sizeof(GhostCConstant);
+    size_t globals_size = parser->global_count * sizeof(uint16_t);
+    size_t size = sizeof(GhostCImageHeader) + constants_size + globals_size + parser->strings_size +
+                  parser->code_size;
+
+    uint8_t* image = (uint8_t*)kmalloc(size);
+    if (!image) {
+        compile_error(parser, "out of memory");
+        return -1;
+    }
+
+    GhostCImageHeader header = {
+        .magic = GHOSTC_MAGIC,
+        .constant_count = (uint16_t)parser->constant_count,
+        .global_count = (uint16_t)parser->global_count,
+        .strings_size = (uint32_t)parser->strings_size,
+        .code_size = (uint32_t)parser->code_size,
+    };
+    uint8_t* out = image;
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    if (constants_size) memcpy(out, parser->constants, constants_size);
+    for (size_t i = 0; i < parser->constant_count; i++) {
+        GhostCConstant* constant = (GhostCConstant*)out + i;
+        if (constant->type == GHOSTC_TYPE_STRING) constant->value.int_val = 0;
+    }
+    out += constants_size;
+    if (globals_size) memcpy(out, parser->globals, globals_size);
+    out += globals_size;
+    if (parser->strings_size) memcpy(out, parser->strings, parser->strings_size);
+    out += parser->strings_size;
+    memcpy(out, parser->code, parser->code_size);
+
+    compiler->bytecode = image;
+    compiler->bytecode_size = size;
+    return 0;
+}
+
+// Recursive descent straight to bytecode:
+//
+//   statement := 'if' '(' expr ')' block ['else' (block | if-statement)]
+//              | 'while' '(' expr ')' block
+//              | name '=' expr ';'
+//              | expr ';'
+//   expr      := sum [('==' | '!=' | '<' | '<=' | '>' | '>=') sum]
+//   sum       := product (('+' | '-') product)*
+//   product   := unary (('*' | '/' | '%') unary)*
+//   unary     := '-' unary | number | string | name | name '(' args ')' | '(' expr ')'
 int ghostc_compile(const char* source, GhostCCompiler* compiler) {
     if (!source || !compiler) return -1;
 
@@ -56,82 +942,658 @@ int ghostc_compile(const char* source, GhostCCompiler* compiler) {
     compiler->length = strlen(source);
     compiler->position = 0;
     compiler->error = NULL;
-
-    // Allocate bytecode buffer (simple 1:1 mapping for now)
-    compiler->bytecode = (uint8_t*)kmalloc(compiler->length);
+    compiler->bytecode = NULL;
     compiler->bytecode_size = 0;
 
-    // Simple tokenization and bytecode generation
-    while (compiler->position < compiler->length) {
-        char c = source[compiler->position++];
-        
-        // Skip whitespace
-        if (c == ' ' || c == '\t' || c == '\n') continue;
+    GhostCParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.compiler = compiler;
+    parser.line = 1;
 
-        // Basic instruction encoding
-        compiler->bytecode[compiler->bytecode_size++] = (uint8_t)c;
+    next_token(&parser);
+    while (parser.token != TOKEN_EOF) {
+        statement(&parser);
+    }
+    emit_op(&parser, GHOSTC_OP_HALT, 0);
+    if (parser.code_size > 0xFFFF) {
+        compile_error(&parser, "program too large");
     }
 
-    return 0;
+    int result = parser.failed ? -1 : assemble(&parser);
+    if (parser.code) kfree(parser.code);
+    if (parser.constants) kfree(parser.constants);
+    if (parser.constant_index) kfree(parser.constant_index);
+    if (parser.globals) kfree(parser.globals);
+    if (parser.strings) kfree(parser.strings);
+    return result;
 }
 
-// Simple Executor
-int ghostc_execute(GhostCRuntime* runtime, uint8_t* bytecode, size_t size) {
-    if (!runtime || !bytecode) return -1;
+static int runtime_error(GhostCRuntime* runtime, const char* message) {
+    runtime->error = message;
+    return -1;
+}
+
+// Symbol number of name, or -1
+static long ghostc_find_symbol(const GhostCRuntime* runtime, const char* name, uint32_t hash) {
+    if (!runtime->symbol_index_size) return -1;
+
+    size_t mask = runtime->symbol_index_size - 1;
+    for (size_t slot = hash & mask; runtime->symbol_index[slot]; slot = (slot + 1) & mask) {
+        const GhostCSymbol* symbol = &runtime->symbols[runtime->symbol_index[slot] - 1];
+        if (symbol->hash == hash && strcmp(symbol->name, name) == 0) {
+            return (long)runtime->symbol_index[slot] - 1;
+        }
+    }
+    return -1;
+}
+
+// Makes room for count symbols without moving them again
+static int ghostc_reserve_symbols(GhostCRuntime* runtime, size_t count) {
+    if (count > runtime->symbol_capacity) {
+        size_t capacity = runtime->symbol_capacity ? runtime->symbol_capacity : 16;
+        while (capacity < count) capacity *= 2;
+
+        GhostCSymbol* grown = (GhostCSymbol*)kmalloc(capacity * sizeof(GhostCSymbol));
+        if (!grown) return 0;
+        if (runtime->symbols) {
+            memcpy(grown, runtime->symbols, runtime->symbol_count * sizeof(GhostCSymbol));
+            kfree(runtime->symbols);
+        }
+        runtime->symbols = grown;
+        runtime->symbol_capacity = capacity;
+    }
+
+    if (count * 2 > runtime->symbol_index_size) {
+        size_t size = runtime->symbol_index_size ? runtime->symbol_index_size : 32;
+        while (size < count * 2) size *= 2;
+
+        uint32_t* index = (uint32_t*)kmalloc(size * sizeof(uint32_t));
+        if (!index) return 0;
+        memset(index, 0, size * sizeof(uint32_t));
+        for (size_t i = 0; i < runtime->symbol_count; i++) {
+            size_t slot = runtime->symbols[i].hash & (size - 1);
+            while (index[slot]) slot = (slot + 1) & (size - 1);
+            index[slot] = (uint32_t)(i + 1);
+        }
+        if (runtime->symbol_index) kfree(runtime->symbol_index);
+        runtime->symbol_index = index;
+        runtime->symbol_index_size = size;
+    }
+    return 1;
+}
+
+// Symbol number of name, defining it as void if it is new. Names are
+// copied into the heap, where they stay for the life of the runtime.
+static long ghostc_define_symbol(GhostCRuntime* runtime, const char* name, uint32_t hash) {
+    long found = ghostc_find_symbol(runtime, name, hash);
+    if (found >= 0) return found;
+
+    size_t length = strlen(name) + 1;
+    if (!ghostc_reserve_symbols(runtime, runtime->symbol_count + 1)) return -1;
+    char* copy = (char*)ghostc_alloc(runtime, length);
+    if (!copy) return -1;
+    memcpy(copy, name, length);
+
+    size_t number = runtime->symbol_count++;
+    GhostCSymbol* symbol = &runtime->symbols[number];
+    symbol->name = copy;
+    symbol->hash = hash;
+    symbol->value = ghostc_make_void();
+
+    size_t mask = runtime->symbol_index_size - 1;
+    size_t slot = hash & mask;
+    while (runtime->symbol_index[slot]) slot = (slot + 1) & mask;
+    runtime->symbol_index[slot] = (uint32_t)(number + 1);
+    return (long)number;
+}
 
-    for (size_t i = 0; i < size; i++) {
-        uint8_t instruction = bytecode[i];
-        
-        // Execute instruction (placeholder)
-        switch (instruction) {
-            case 'p': // print
-                ghostc_print(NULL, 0);
+// Checks everything the interpreter loop takes for granted: known
+// opcodes, operands in range, jumps landing on an instruction with an
+// empty stack, no stack underflow and a HALT at the end. Sets a bit in
+// stored for each global the code assigns. Returns the deepest the stack
+// gets, or -1.
+static long ghostc_verify(GhostCRuntime* runtime, const GhostCImageHeader* header, const uint8_t* code,
+                          uint8_t* stored) {
+    size_t size = header->code_size;
+    uint8_t* targets = (uint8_t*)kmalloc(size / 8 + 1);
+    if (!targets) return runtime_error(runtime, "out of memory");
+    memset(targets, 0, size / 8 + 1);
+
+    const char* error = NULL;
+    long depth = 0;
+    long max_depth = 0;
+    uint8_t last = GHOSTC_OP_COUNT;
+    size_t pc = 0;
+
+    while (pc < size && !error) {
+        uint8_t op = code[pc];
+        if (op >= GHOSTC_OP_COUNT || pc + 1 + operand_size[op] > size) {
+            error = "corrupt bytecode";
+            break;
+        }
+        if (depth == 0) targets[pc / 8] |= (uint8_t)(1 << (pc % 8));
+
+        size_t operand = operand_size[op] == 2 ? (size_t)(code[pc + 1] | (code[pc + 2] << 8)) : 0;
+        long pops = 0;
+        long pushes = 0;
+        switch (op) {
+            case GHOSTC_OP_CONST:
+                if (operand >= header->constant_count) error = "constant out of range";
+                pushes = 1;
+                break;
+            case GHOSTC_OP_LOAD:
+                if (operand >= header->global_count) error = "global out of range";
+                pushes = 1;
                 break;
-            case 'i': // input
-                ghostc_input(NULL, 0);
+            case GHOSTC_OP_STORE:
+                if (operand >= header->global_count) {
+                    error = "global out of range";
+                    break;
+                }
+                stored[operand / 8] |= (uint8_t)(1 << (operand % 8));
+                pops = 1;
+                break;
+            case GHOSTC_OP_POP:
+            case GHOSTC_OP_JUMP_IF_FALSE:
+                pops = 1;
+                break;
+            case GHOSTC_OP_NEG:
+                pops = 1;
+                pushes = 1;
+                break;
+            case GHOSTC_OP_CALL:
+                if (code[pc + 1] >= BUILTIN_COUNT) error = "unknown builtin";
+                pops = code[pc + 2];
+                pushes = 1;
+                break;
+            case GHOSTC_OP_HALT:
+            case GHOSTC_OP_JUMP:
                 break;
             default:
-                // Unknown instruction
+                // Binary operators
+                pops = 2;
+                pushes = 1;
                 break;
         }
+
+        if (depth < pops) error = "stack underflow";
+        depth += pushes - pops;
+        if (depth > max_depth) max_depth = depth;
+        if ((op == GHOSTC_OP_JUMP || op == GHOSTC_OP_JUMP_IF_FALSE) && (depth != 0 || operand >= size)) {
+            error = "bad jump";
+        }
+        last = op;
+        pc += 1 + operand_size[op];
     }
 
-    return 0;
+    if (!error && last != GHOSTC_OP_HALT) error = "missing halt";
+
+    // Jump targets, now that every instruction start is known
+    for (pc = 0; pc < size && !error; pc += 1 + operand_size[code[pc]]) {
+        if (code[pc] == GHOSTC_OP_JUMP || code[pc] == GHOSTC_OP_JUMP_IF_FALSE) {
+            size_t target = (size_t)(code[pc + 1] | (code[pc + 2] << 8));
+            if (!(targets[target / 8] & (1 << (target % 8)))) error = "bad jump";
+        }
+    }
+
+    kfree(targets);
+    if (error) return runtime_error(runtime, error);
+    return max_depth;
+}
+
+static int truthy(const GhostCValue* value) {
+    switch (ghostc_type_of(*value)) {
+        case GHOSTC_TYPE_BOOL: return ghostc_bool(*value);
+        case GHOSTC_TYPE_INT: return ghostc_int(*value) != 0;
+        case GHOSTC_TYPE_FLOAT: return ghostc_float(*value) != 0.0;
+        case GHOSTC_TYPE_STRING: return ghostc_string(*value) != NULL;
+        default: return 0;
+    }
+}
+
+static int as_float(const GhostCValue* value, double* out) {
+    switch (ghostc_type_of(*value)) {
+        case GHOSTC_TYPE_INT:
+            *out = (double)ghostc_int(*value);
+            return 1;
+        case GHOSTC_TYPE_FLOAT:
+            *out = ghostc_float(*value);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// -1, 0 or 1 for numbers or strings; 2 if the two cannot be ordered
+static int compare(const GhostCValue* a, const GhostCValue* b) {
+    double x, y;
+    GhostCType type = ghostc_type_of(*a);
+    if (type == GHOSTC_TYPE_INT && ghostc_type_of(*b) == GHOSTC_TYPE_INT) {
+        return (ghostc_int(*a) > ghostc_int(*b)) - (ghostc_int(*a) < ghostc_int(*b));
+    }
+    if (as_float(a, &x) && as_float(b, &y)) return (x > y) - (x < y);
+    if (type != ghostc_type_of(*b)) return 2;
+    if (type == GHOSTC_TYPE_STRING) {
+        int order = strcmp(ghostc_string(*a), ghostc_string(*b));
+        return (order > 0) - (order < 0);
+    }
+    if (type == GHOSTC_TYPE_BOOL) return ghostc_bool(*a) != ghostc_bool(*b);
+    return 2;
+}
+
+// Verifies the image, then runs it. The loop threads through a table of
+// label addresses (GCC computed goto), so each instruction ends in its
+// own indirect branch and nothing is checked that verification already
+// ruled out.
+int ghostc_execute(GhostCRuntime* runtime, uint8_t* bytecode, size_t size) {
+    if (!runtime || !bytecode) return -1;
+    runtime->error = NULL;
+
+    const GhostCImageHeader* header = (const GhostCImageHeader*)bytecode;
+    if (size < sizeof(GhostCImageHeader) || header->magic != GHOSTC_MAGIC) {
+        return runtime_error(runtime, "not a GhostC image");
+    }
+    size_t constants_size = header->constant_count * sizeof(GhostCConstant);
+    size_t globals_size = header->global_count * sizeof(uint16_t);
+    if (size != sizeof(GhostCImageHeader) + constants_size + globals_size + header->strings_size +
+                    header->code_size) {
+        return runtime_error(runtime, "truncated image");
+    }
+
+    const GhostCConstant* constants = (const GhostCConstant*)(bytecode + sizeof(GhostCImageHeader));
+    const uint16_t* globals = (const uint16_t*)(constants + header->constant_count);
+    const char* strings = (const char*)(globals + header->global_count);
+    const uint8_t* code = (const uint8_t*)strings + header->strings_size;
+
+    // Every string ends inside the string area
+    if (header->strings_size > 0 && strings[header->strings_size - 1] != '\0') {
+        return runtime_error(runtime, "corrupt string constants");
+    }
+    for (size_t i = 0; i < header->constant_count; i++) {
+        if (constants[i].type == GHOSTC_TYPE_STRING && constants[i].string_offset >= header->strings_size) {
+            return runtime_error(runtime, "corrupt string constants");
+        }
+    }
+
+    for (size_t i = 0; i < header->global_count; i++) {
+        if (globals[i] >= header->constant_count || constants[globals[i]].type != GHOSTC_TYPE_STRING) {
+            return runtime_error(runtime, "corrupt globals");
+        }
+    }
+
+    // One allocation for the globals' symbols and the bits saying which
+    // of them this image assigns
+    size_t slots_size = header->global_count * sizeof(GhostCValue*);
+    GhostCValue** slots = (GhostCValue**)kmalloc(slots_size + header->global_count / 8 + 1);
+    if (!slots) return runtime_error(runtime, "out of memory");
+    uint8_t* stored = (uint8_t*)slots + slots_size;
+    memset(stored, 0, header->global_count / 8 + 1);
+
+    long max_depth = ghostc_verify(runtime, header, code, stored);
+    const char* error = max_depth < 0 ? runtime->error : NULL;
+    if (!error && runtime->stack_ptr + (size_t)max_depth > runtime->stack_size) {
+        error = "stack overflow";
+    }
+
+    // Bind every global to a runtime symbol up front, so loads and stores
+    // are a single indirection. Room is made first so that defining
+    // symbols cannot move the ones already bound. A variable the image
+    // reads but never assigns must already exist.
+    if (!error && !ghostc_reserve_symbols(runtime, runtime->symbol_count + header->global_count)) {
+        error = "out of memory";
+    }
+    for (size_t i = 0; i < header->global_count && !error; i++) {
+        const char* name = strings + constants[globals[i]].string_offset;
+        uint32_t hash = ghostc_hash(name, strlen(name));
+        long symbol = stored[i / 8] & (1 << (i % 8)) ? ghostc_define_symbol(runtime, name, hash)
+                                                     : ghostc_find_symbol(runtime, name, hash);
+        if (symbol < 0) {
+            error = stored[i / 8] & (1 << (i % 8)) ? "out of memory" : "undefined variable";
+            break;
+        }
+        slots[i] = &runtime->symbols[symbol].value;
+    }
+    if (error) {
+        kfree(slots);
+        return runtime_error(runtime, error);
+    }
+
+    static void* const dispatch[GHOSTC_OP_COUNT] = {
+        [GHOSTC_OP_HALT] = &&op_halt,
+        [GHOSTC_OP_CONST] = &&op_const,
+        [GHOSTC_OP_LOAD] = &&op_load,
+        [GHOSTC_OP_STORE] = &&op_store,
+        [GHOSTC_OP_POP] = &&op_pop,
+        [GHOSTC_OP_ADD] = &&op_add,
+        [GHOSTC_OP_SUB] = &&op_sub,
+        [GHOSTC_OP_MUL] = &&op_mul,
+        [GHOSTC_OP_DIV] = &&op_div,
+        [GHOSTC_OP_MOD] = &&op_mod,
+        [GHOSTC_OP_NEG] = &&op_neg,
+        [GHOSTC_OP_EQ] = &&op_eq,
+        [GHOSTC_OP_NE] = &&op_ne,
+        [GHOSTC_OP_LT] = &&op_lt,
+        [GHOSTC_OP_LE] = &&op_le,
+        [GHOSTC_OP_GT] = &&op_gt,
+        [GHOSTC_OP_GE] = &&op_ge,
+        [GHOSTC_OP_JUMP] = &&op_jump,
+        [GHOSTC_OP_JUMP_IF_FALSE] = &&op_jump_if_false,
+        [GHOSTC_OP_CALL] = &&op_call,
+    };
+
+    // Temporaries never outlive the statement that made them
+    runtime->scratch_used = 0;
+
+    GhostCValue* base = runtime->stack + runtime->stack_ptr;
+    GhostCValue* sp = base;
+    const uint8_t* ip = code;
+    size_t gc_trigger = runtime->heap_size / GHOSTC_GC_TRIGGER;
+    double x, y;
+    int order;
+
+#define NEXT() goto *dispatch[*ip++]
+#define OPERAND() (ip += 2, (size_t)(ip[-2] | (ip[-1] << 8)))
+
+// Between statements temporaries are dropped and the collector gets its turn
+#define STATEMENT_END()                                                             \
+    runtime->scratch_used = 0;                                                      \
+    if (runtime->gc_phase != GHOSTC_GC_IDLE || runtime->gc_allocated > gc_trigger) { \
+        runtime->stack_ptr = (size_t)(base - runtime->stack);                       \
+        gc_step(runtime);                                                           \
+    }
+
+// Ints stay ints and wrap around; anything mixed with a float is computed
+// as a float
+#define ARITHMETIC(op)                                                              \
+    if (ghostc_type_of(sp[-2]) == GHOSTC_TYPE_INT &&                                \
+        ghostc_type_of(sp[-1]) == GHOSTC_TYPE_INT) {                                \
+        sp[-2] = ghostc_make_int((int64_t)((uint64_t)ghostc_int(sp[-2]) op          \
+                                           (uint64_t)ghostc_int(sp[-1])));          \
+    } else if (as_float(&sp[-2], &x) && as_float(&sp[-1], &y)) {                    \
+        sp[-2] = ghostc_make_float(x op y);                                         \
+    } else {                                                                        \
+        error = "arithmetic on a non-number";                                       \
+        goto fail;                                                                  \
+    }                                                                               \
+    sp--;                                                                           \
+    NEXT()
+
+#define COMPARISON(test)                                                            \
+    order = compare(&sp[-2], &sp[-1]);                                              \
+    sp--;                                                                           \
+    sp[-1] = ghostc_make_bool(test);                                                \
+    NEXT()
+
+    NEXT();
+
+op_const: {
+    const GhostCConstant* constant = &constants[OPERAND()];
+    if (constant->type == GHOSTC_TYPE_STRING) {
+        *sp = ghostc_make_string((char*)strings + constant->string_offset);
+    } else if (constant->type == GHOSTC_TYPE_INT) {
+        *sp = ghostc_make_int(constant->value.int_val);
+    } else {
+        *sp = ghostc_make_float(constant->value.float_val);
+    }
+    sp++;
+    NEXT();
+}
+op_load:
+    *sp++ = *slots[OPERAND()];
+    NEXT();
+op_store: {
+    GhostCValue* slot = slots[OPERAND()];
+    if (ghostc_type_of(sp[-1]) == GHOSTC_TYPE_STRING || ghostc_type_of(sp[-1]) == GHOSTC_TYPE_ARRAY) {
+        runtime->stack_ptr = (size_t)(sp - runtime->stack);
+        if (!gc_keep(runtime, &sp[-1])) {
+            error = "out of memory";
+            goto fail;
+        }
+    }
+    *slot = *--sp;
+    if (sp == base) {
+        STATEMENT_END();
+    }
+    NEXT();
+}
+op_pop:
+    if (--sp == base) {
+        STATEMENT_END();
+    }
+    NEXT();
+op_add:
+    if (ghostc_type_of(sp[-2]) == GHOSTC_TYPE_STRING && ghostc_type_of(sp[-1]) == GHOSTC_TYPE_STRING) {
+        size_t left = strlen(ghostc_string(sp[-2]));
+        size_t right = strlen(ghostc_string(sp[-1]));
+        char* joined = (char*)ghostc_scratch(runtime, left + right + 1);
+        if (!joined) {
+            error = "out of memory";
+            goto fail;
+        }
+        memcpy(joined, ghostc_string(sp[-2]), left);
+        memcpy(joined + left, ghostc_string(sp[-1]), right + 1);
+        sp[-2] = ghostc_make_string(joined);
+        sp--;
+        NEXT();
+    }
+    ARITHMETIC(+);
+op_sub:
+    ARITHMETIC(-);
+op_mul:
+    ARITHMETIC(*);
+op_div:
+    if (ghostc_type_of(sp[-2]) == GHOSTC_TYPE_INT && ghostc_type_of(sp[-1]) == GHOSTC_TYPE_INT) {
+        int64_t divisor = ghostc_int(sp[-1]);
+        if (divisor == 0) {
+            error = "division by zero";
+            goto fail;
+        }
+        // The one quotient that does not fit wraps like the other operators
+        sp[-2] = ghostc_make_int(divisor == -1 ? (int64_t)(0 - (uint64_t)ghostc_int(sp[-2]))
+                                               : ghostc_int(sp[-2]) / divisor);
+    } else if (as_float(&sp[-2], &x) && as_float(&sp[-1], &y)) {
+        sp[-2] = ghostc_make_float(x / y);
+    } else {
+        error = "arithmetic on a non-number";
+        goto fail;
+    }
+    sp--;
+    NEXT();
+op_mod:
+    if (ghostc_type_of(sp[-2]) != GHOSTC_TYPE_INT || ghostc_type_of(sp[-1]) != GHOSTC_TYPE_INT) {
+        error = "modulo of a non-integer";
+        goto fail;
+    }
+    if (ghostc_int(sp[-1]) == 0) {
+        error = "division by zero";
+        goto fail;
+    }
+    sp[-2] = ghostc_make_int(ghostc_int(sp[-1]) == -1 ? 0 : ghostc_int(sp[-2]) % ghostc_int(sp[-1]));
+    sp--;
+    NEXT();
+op_neg:
+    if (ghostc_type_of(sp[-1]) == GHOSTC_TYPE_INT) {
+        sp[-1] = ghostc_make_int((int64_t)(0 - (uint64_t)ghostc_int(sp[-1])));
+    } else if (ghostc_type_of(sp[-1]) == GHOSTC_TYPE_FLOAT) {
+        sp[-1] = ghostc_make_float(-ghostc_float(sp[-1]));
+    } else {
+        error = "negation of a non-number";
+        goto fail;
+    }
+    NEXT();
+op_eq:
+    COMPARISON(order == 0);
+op_ne:
+    COMPARISON(order != 0);
+op_lt:
+    COMPARISON(order == -1);
+op_le:
+    COMPARISON(order == -1 || order == 0);
+op_gt:
+    COMPARISON(order == 1);
+op_ge:
+    COMPARISON(order == 1 || order == 0);
+op_jump:
+    ip = code + OPERAND();
+    NEXT();
+op_jump_if_false: {
+    size_t target = OPERAND();
+    if (!truthy(--sp)) ip = code + target;
+    if (sp == base) {
+        STATEMENT_END();
+    }
+    NEXT();
+}
+op_call: {
+    uint8_t builtin = ip[0];
+    uint8_t count = ip[1];
+    ip += 2;
+    sp -= count;
+    // The arguments stay roots for any collection the call runs
+    runtime->stack_ptr = (size_t)(sp + count - runtime->stack);
+    *sp = builtins[builtin].func(runtime, sp, count);
+    if (runtime->error) {
+        error = runtime->error;
+        goto fail;
+    }
+    sp++;
+    NEXT();
+}
+
+#undef COMPARISON
+#undef ARITHMETIC
+#undef STATEMENT_END
+#undef OPERAND
+#undef NEXT
+
+fail:
+    runtime->error = error;
+op_halt:
+    runtime->stack_ptr = (size_t)(base - runtime->stack);
+    kfree(slots);
+    return error ? -1 : 0;
 }
 
 // Built-in Functions
-GhostCValue ghostc_print(GhostCValue* args, size_t count) {
-    GhostCValue result = {.type = GHOSTC_TYPE_VOID};
-    
-    if (count > 0 && args) {
-        for (size_t i = 0; i < count; i++) {
-            switch (args[i].type) {
-                case GHOSTC_TYPE_STRING:
-                    terminal_writestring(args[i].value.string_val);
-                    break;
-                case GHOSTC_TYPE_INT:
-                    // Convert int to string and print
-                    char buf[32];
-                    itoa(args[i].value.int_val, buf, 10);
-                    terminal_writestring(buf);
-                    break;
-                default:
-                    terminal_writestring("(unprintable value)");
-                    break;
+static void write_unsigned(uint64_t number) {
+    char buffer[21];
+    char* digit = buffer + sizeof(buffer) - 1;
+    *digit = '\0';
+    do {
+        *--digit = (char)('0' + number % 10);
+        number /= 10;
+    } while (number);
+    term_write_string(digit);
+}
+
+static void write_int(int64_t number) {
+    if (number < 0) term_write_string("-");
+    write_unsigned(number < 0 ? 0 - (uint64_t)number : (uint64_t)number);
+}
+
+// Six decimals at most, trailing zeros dropped; one digit and an
+// exponent from 1e18 up, where the integer part could overflow
+static void write_float(double number) {
+    if (number != number) {
+        term_write_string("nan");
+        return;
+    }
+    if (number < 0 || (number == 0 && 1 / number < 0)) {
+        term_write_string("-");
+        number = -number;
+    }
+    if (number > 1.7976931348623157e308) {
+        term_write_string("inf");
+        return;
+    }
+
+    int exponent = 0;
+    if (number >= 1e18) {
+        while (number >= 10) {
+            number /= 10;
+            exponent++;
+        }
+    }
+    uint64_t whole = (uint64_t)number;
+    uint64_t fraction = (uint64_t)((number - (double)whole) * 1e6 + 0.5);
+    if (fraction >= 1000000) {
+        whole++;
+        fraction -= 1000000;
+    }
+
+    char decimals[8] = ".000000";
+    for (int i = 6; i > 0; i--) {
+        decimals[i] = (char)('0' + fraction % 10);
+        fraction /= 10;
+    }
+    int last = 6;
+    while (last > 1 && decimals[last] == '0') decimals[last--] = '\0';
+
+    write_unsigned(whole);
+    term_write_string(decimals);
+    if (exponent) {
+        term_write_string("e+");
+        write_unsigned((uint64_t)exponent);
+    }
+}
+
+static size_t array_length(GhostCValue value) {
+    return ((GhostCBlock*)ghostc_array(value) - 1)->length;
+}
+
+// Arrays inside arrays are not expanded, so a cycle cannot loop forever
+static void write_value(GhostCValue value, int nested) {
+    switch (ghostc_type_of(value)) {
+        case GHOSTC_TYPE_VOID:
+            term_write_string("void");
+            break;
+        case GHOSTC_TYPE_INT:
+            write_int(ghostc_int(value));
+            break;
+        case GHOSTC_TYPE_FLOAT:
+            write_float(ghostc_float(value));
+            break;
+        case GHOSTC_TYPE_STRING:
+            term_write_string(ghostc_string(value));
+            break;
+        case GHOSTC_TYPE_BOOL:
+            term_write_string(ghostc_bool(value) ? "true" : "false");
+            break;
+        case GHOSTC_TYPE_ARRAY: {
+            if (nested) {
+                term_write_string("[...]");
+                break;
+            }
+            GhostCValue* elements = ghostc_array(value);
+            size_t length = array_length(value);
+            term_write_string("[");
+            for (size_t i = 0; i < length; i++) {
+                if (i) term_write_string(", ");
+                write_value(elements[i], 1);
             }
+            term_write_string("]");
+            break;
         }
+        default:
+            term_write_string("(unprintable value)");
+            break;
     }
-    
-    terminal_writestring("\n");
-    return result;
 }
 
-GhostCValue ghostc_input(GhostCValue* args, size_t count) {
-    GhostCValue result = {.type = GHOSTC_TYPE_STRING};
-    
+GhostCValue ghostc_print(GhostCRuntime* runtime, GhostCValue* args, size_t count) {
+    (void)runtime;
+    for (size_t i = 0; i < count; i++) {
+        write_value(args[i], 0);
+    }
+    term_write_string("\n");
+    return ghostc_make_void();
+}
+
+// The line read is a temporary; storing it in a variable copies it
+GhostCValue ghostc_input(GhostCRuntime* runtime, GhostCValue* args, size_t count) {
     // Print prompt if provided
-    if (count > 0 && args && args[0].type == GHOSTC_TYPE_STRING) {
-        terminal_writestring(args[0].value.string_val);
+    if (count > 0 && args && ghostc_type_of(args[0]) == GHOSTC_TYPE_STRING) {
+        term_write_string(ghostc_string(args[0]));
     }
 
     // Simple input buffer
@@ -145,8 +1607,68 @@ GhostCValue ghostc_input(GhostCValue* args, size_t count) {
     }
     
     buffer[pos] = '\0';
-    result.value.string_val = strdup(buffer);
-    return result;
+    char* line = (char*)ghostc_scratch(runtime, pos + 1);
+    if (!line) {
+        runtime->error = "out of memory";
+        return ghostc_make_void();
+    }
+    memcpy(line, buffer, pos + 1);
+    return ghostc_make_string(line);
+}
+
+// array(n): n elements, all void
+GhostCValue ghostc_array_new(GhostCRuntime* runtime, GhostCValue* args, size_t count) {
+    if (count != 1 || ghostc_type_of(args[0]) != GHOSTC_TYPE_INT || ghostc_int(args[0]) < 0) {
+        runtime->error = "array() takes a length";
+        return ghostc_make_void();
+    }
+
+    size_t length = (size_t)ghostc_int(args[0]);
+    if (length > ((size_t)16 << (GHOSTC_HEAP_CLASSES - 1)) / sizeof(GhostCValue)) {
+        runtime->error = "array too long";
+        return ghostc_make_void();
+    }
+    GhostCValue* elements = (GhostCValue*)allocate(runtime, length * sizeof(GhostCValue), BLOCK_ARRAY);
+    if (!elements) {
+        runtime->error = "out of memory";
+        return ghostc_make_void();
+    }
+    ((GhostCBlock*)elements - 1)->length = (uint32_t)length;
+    for (size_t i = 0; i < length; i++) {
+        elements[i] = ghostc_make_void();
+    }
+    return ghostc_make_array(elements, length);
+}
+
+// The element args[0][args[1]] of get() and set(), or NULL
+static GhostCValue* array_element(GhostCRuntime* runtime, GhostCValue* args, size_t count, size_t expected) {
+    if (count != expected || ghostc_type_of(args[0]) != GHOSTC_TYPE_ARRAY ||
+        ghostc_type_of(args[1]) != GHOSTC_TYPE_INT) {
+        runtime->error = expected == 2 ? "get() takes an array and an index" : "set() takes an array, an index and a value";
+        return NULL;
+    }
+    int64_t index = ghostc_int(args[1]);
+    if (index < 0 || (uint64_t)index >= array_length(args[0])) {
+        runtime->error = "array index out of range";
+        return NULL;
+    }
+    return ghostc_array(args[0]) + index;
+}
+
+GhostCValue ghostc_array_get(GhostCRuntime* runtime, GhostCValue* args, size_t count) {
+    GhostCValue* element = array_element(runtime, args, count, 2);
+    return element ? *element : ghostc_make_void();
+}
+
+GhostCValue ghostc_array_set(GhostCRuntime* runtime, GhostCValue* args, size_t count) {
+    GhostCValue* element = array_element(runtime, args, count, 3);
+    if (!element) return ghostc_make_void();
+    if (!gc_keep(runtime, &args[2])) {
+        runtime->error = "out of memory";
+        return ghostc_make_void();
+    }
+    *element = args[2];
+    return ghostc_make_void();
 }
 
 // Error Handling
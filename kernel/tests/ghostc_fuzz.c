@@ -0,0 +1,149 @@
+// Mutation fuzzer for the GhostC compiler, verifier and VM.
+//
+//   ghostc_fuzz [iterations] [seed]
+//
+// Each case mutates either the source of a seed program or the image it
+// compiles to, then compiles and runs the result in a child process. A
+// child killed by anything but the alarm (a sanitizer report, a signal)
+// is a failure: the case is written to fuzz-crash-<n> and the driver
+// exits non-zero. A mutated image may loop forever, so a child that runs
+// out its alarm only counts as a hang.
+#include "host.h"
+#include "../include/ghostc.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const char* kSeeds[] = {
+    "x = 1 + 2 * 3; print(x, \" \", x / 2, \" \", -x % 4);",
+    "s = \"ab\" + \"cd\"; if (s == \"abcd\") { print(s); } else { print(\"no\"); }",
+    "t = \"\"; i = 0; while (i < 20) { t = t + \"x\"; i = i + 1; } print(t);",
+    "i = 0; n = 0; while (i < 50) { n = n + i * 2; i = i + 1; } print(n);",
+    "f = 1.5; g = f * 2.0 - 0.25; if (f < g) { print(\"less\"); } x = g >= 2.75;",
+    "i = 0; while (i < 50) { a = array(3); set(a, 0, a); set(a, 1, \"x\" + \"y\"); i = i + 1; } print(get(a, 1));",
+    "a = array(4); b = array(4); set(a, 0, b); set(b, 0, a); a = 0; b = 0; print(a == b);",
+    "line = input(\"? \"); if (line != \"\") { print(line, \" \", 42); }",
+};
+#define SEED_COUNT (sizeof(kSeeds) / sizeof(kSeeds[0]))
+
+static uint64_t state;
+
+static uint64_t next_random(void) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static void mutate(uint8_t* data, size_t size) {
+    size_t count = 1 + next_random() % 4;
+    for (size_t i = 0; i < count && size > 0; i++) {
+        size_t at = next_random() % size;
+        switch (next_random() % 3) {
+            case 0: data[at] ^= (uint8_t)(1 << (next_random() % 8)); break;
+            case 1: data[at] = (uint8_t)next_random(); break;
+            default: data[at] = (uint8_t)(data[at] + 1); break;
+        }
+    }
+}
+
+// Runs in the child
+static void run_case(const uint8_t* data, size_t size, int is_source) {
+    host_set_input("fuzz");
+    GhostCRuntime* runtime = ghostc_init(256, 16 * 1024);
+    if (!runtime) _exit(0);
+
+    if (is_source) {
+        char* source = malloc(size + 1);
+        memcpy(source, data, size);
+        source[size] = '\0';
+        GhostCCompiler compiler;
+        if (ghostc_compile(source, &compiler) == 0) {
+            ghostc_execute(runtime, compiler.bytecode, compiler.bytecode_size);
+            kfree(compiler.bytecode);
+        }
+        ghostc_clear_error(&compiler);
+        free(source);
+    } else {
+        // Images must be 8-byte aligned; malloc's are
+        uint8_t* image = malloc(size ? size : 1);
+        memcpy(image, data, size);
+        ghostc_execute(runtime, image, size);
+        free(image);
+    }
+    ghostc_collect(runtime);
+    ghostc_cleanup(runtime);
+    host_output();
+    _exit(0);
+}
+
+static void save_case(const uint8_t* data, size_t size, long iteration) {
+    char name[64];
+    snprintf(name, sizeof(name), "fuzz-crash-%ld", iteration);
+    FILE* file = fopen(name, "wb");
+    if (file) {
+        fwrite(data, 1, size, file);
+        fclose(file);
+    }
+    fprintf(stderr, "ghostc_fuzz: case %ld failed; saved to %s\n", iteration, name);
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 2000;
+    state = argc > 2 ? strtoull(argv[2], NULL, 0) : 0x9E3779B97F4A7C15ULL;
+    if (state == 0) state = 1;
+
+    uint8_t* images[SEED_COUNT];
+    size_t image_sizes[SEED_COUNT];
+    for (size_t i = 0; i < SEED_COUNT; i++) {
+        GhostCCompiler compiler;
+        if (ghostc_compile(kSeeds[i], &compiler) != 0) {
+            fprintf(stderr, "ghostc_fuzz: seed %zu does not compile: %s\n", i, ghostc_get_error(&compiler));
+            return 1;
+        }
+        images[i] = compiler.bytecode;
+        image_sizes[i] = compiler.bytecode_size;
+    }
+
+    long hangs = 0;
+    uint8_t buffer[4096];
+    for (long iteration = 0; iteration < iterations; iteration++) {
+        size_t seed = next_random() % SEED_COUNT;
+        int is_source = next_random() % 4 == 0;
+        size_t size = is_source ? strlen(kSeeds[seed]) : image_sizes[seed];
+        memcpy(buffer, is_source ? (const uint8_t*)kSeeds[seed] : images[seed], size);
+        mutate(buffer, size);
+
+        fflush(NULL);
+        pid_t child = fork();
+        if (child < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (child == 0) {
+            alarm(2);
+            run_case(buffer, size, is_source);
+        }
+
+        int status;
+        if (waitpid(child, &status, 0) < 0) {
+            perror("waitpid");
+            return 1;
+        }
+        if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM) {
+            hangs++;
+        } else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            save_case(buffer, size, iteration);
+            return 1;
+        }
+    }
+
+    for (size_t i = 0; i < SEED_COUNT; i++) {
+        kfree(images[i]);
+    }
+    printf("ghostc_fuzz: %ld cases, no failures, %ld hangs\n", iterations, hangs);
+    return 0;
+}
@@ -0,0 +1,354 @@
+// Host tests for the GhostC runtime. ghostc.c is included rather than
+// linked so the tests can reach its internals, down to driving the
+// collector step by step.
+#include "../src/ghostc.c"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static int run(GhostCRuntime* runtime, const char* source) {
+    GhostCCompiler compiler;
+    if (ghostc_compile(source, &compiler) != 0) {
+        fprintf(stderr, "compile failed: %s\n%s\n", ghostc_get_error(&compiler), source);
+        assert(0);
+    }
+    int result = ghostc_execute(runtime, compiler.bytecode, compiler.bytecode_size);
+    kfree(compiler.bytecode);
+    ghostc_clear_error(&compiler);
+    return result;
+}
+
+static void expect_output(const char* expected) {
+    const char* output = host_output();
+    if (strcmp(output, expected) != 0) {
+        fprintf(stderr, "expected \"%s\", got \"%s\"\n", expected, output);
+        assert(0);
+    }
+}
+
+// Heap blocks from offset from up to offset to
+static size_t blocks_between(GhostCRuntime* runtime, size_t from, size_t to) {
+    size_t count = 0;
+    for (size_t offset = from; offset < to; offset += block_size((GhostCBlock*)((uint8_t*)runtime->heap + offset))) {
+        count++;
+    }
+    return count;
+}
+
+// A global array of 1000 one-element arrays: more gray arrays at once
+// than gc_gray holds
+static const char* kTree =
+    "big = array(1000);\n"
+    "i = 0;\n"
+    "while (i < 1000) { inner = array(1); set(inner, 0, i); set(big, i, inner); i = i + 1; }\n";
+
+static const char* kTreeSum =
+    "sum = 0;\n"
+    "i = 0;\n"
+    "while (i < 1000) { sum = sum + get(get(big, i), 0); i = i + 1; }\n"
+    "print(sum);\n";
+
+static void test_execute(void) {
+    GhostCRuntime* runtime = ghostc_init(256, 64 * 1024);
+    assert(runtime);
+
+    assert(run(runtime, "x = 2 + 3 * 4; print(x, \" \", 7 / 2, \" \", -x % 5);") == 0);
+    expect_output("14 3 -4\n");
+
+    assert(run(runtime, "if (x == 14) { print(\"yes\"); } else { print(\"no\"); }") == 0);
+    expect_output("yes\n");
+
+    assert(run(runtime, "i = 0; n = 0; while (i < 10) { n = n + i; i = i + 1; } print(n);") == 0);
+    expect_output("45\n");
+
+    assert(run(runtime, "print(x / 0);") != 0);
+    assert(strcmp(runtime->error, "division by zero") == 0);
+
+#ifdef GHOSTC_NAN_BOXING
+    assert(run(runtime, "print(140737488355327 + 1);") == 0);
+    expect_output("-140737488355328\n");
+#else
+    assert(run(runtime, "print(140737488355327 + 1);") == 0);
+    expect_output("140737488355328\n");
+#endif
+
+    GhostCCompiler compiler;
+    assert(ghostc_compile("x = ;", &compiler) != 0);
+    ghostc_clear_error(&compiler);
+
+    ghostc_cleanup(runtime);
+}
+
+// Globals are bound once per image and live on in the runtime
+static void test_globals(void) {
+    GhostCRuntime* runtime = ghostc_init(256, 64 * 1024);
+    assert(runtime);
+
+    assert(run(runtime, "print(missing);") != 0);
+    assert(strcmp(runtime->error, "undefined variable") == 0);
+
+    // Enough names to grow symbol_index several times
+    static char source[16 * 1024];
+    size_t length = 0;
+    for (int i = 0; i < 300; i++) {
+        length += (size_t)snprintf(source + length, sizeof(source) - length, "v%d = %d;\n", i, i * 3);
+    }
+    assert(run(runtime, source) == 0);
+    assert(runtime->symbol_count == 300);
+    assert(runtime->symbol_index_size >= 2 * runtime->symbol_count);
+
+    assert(run(runtime, "total = v0 + v17 + v299; v17 = 0; print(total);") == 0);
+    expect_output("948\n");
+    assert(run(runtime, "print(v17, \" \", v298);") == 0);
+    expect_output("0 894\n");
+    assert(runtime->symbol_count == 301);
+
+    ghostc_cleanup(runtime);
+}
+
+// Script strings live in the runtime heap: temporaries in the scratch
+// arena, stored strings in blocks that are reused once unreachable
+static void test_heap(void) {
+    GhostCRuntime* runtime = ghostc_init(256, 64 * 1024);
+    assert(runtime);
+
+    host_set_input("hello\n");
+    assert(run(runtime, "line = input(\"> \"); print(line + \"!\");") == 0);
+    expect_output("> hello!\n");
+    assert(runtime->scratch_used == 0);
+
+    // The string outlives the image it was built by
+    assert(run(runtime, "name = \"ghost\" + \"c\";") == 0);
+    assert(run(runtime, "print(name);") == 0);
+    expect_output("ghostc\n");
+
+    assert(run(runtime, "s = \"\"; i = 0; while (i < 100) { s = \"ab\" + \"cd\"; i = i + 1; }") == 0);
+    size_t used = runtime->heap_used;
+    assert(run(runtime, "i = 0; while (i < 100000) { s = s + \"x\"; s = \"ab\" + \"cd\"; i = i + 1; } print(s);") == 0);
+    expect_output("abcd\n");
+    // Replaced strings wait for the collector, which starts a cycle once
+    // a trigger's worth has been allocated
+    assert(runtime->heap_used <= used + runtime->heap_size / GHOSTC_GC_TRIGGER);
+
+    void* block = ghostc_alloc(runtime, 100);
+    assert(block);
+    ghostc_free(runtime, block);
+    assert(ghostc_alloc(runtime, 120) == block);
+    assert(ghostc_alloc(runtime, 64 * 1024) == NULL);
+
+    ghostc_cleanup(runtime);
+}
+
+// print formats every kind of value; nested arrays are not expanded
+static void test_print(void) {
+    GhostCRuntime* runtime = ghostc_init(256, 64 * 1024);
+    assert(runtime);
+
+    assert(run(runtime, "print(1.5, \" \", -0.25, \" \", 2.0, \" \", 1 < 2, \" \", 2 < 1);") == 0);
+    expect_output("1.5 -0.25 2.0 true false\n");
+
+    assert(run(runtime, "a = array(3); set(a, 0, 7); set(a, 1, \"x\"); set(a, 2, a); print(a, \" \", array(1));") == 0);
+    expect_output("[7, x, [...]] [void]\n");
+
+    ghostc_cleanup(runtime);
+}
+
+// Strings and arrays in globals outlive the image that made them
+static void test_survives_execute(void) {
+    GhostCRuntime* runtime = ghostc_init(256, 64 * 1024);
+    assert(runtime);
+
+    assert(run(runtime, "name = \"ghost\" + \"c\"; list = array(2); set(list, 0, name); set(list, 1, list);") == 0);
+    ghostc_collect(runtime);
+    assert(run(runtime, "print(name, \" \", get(get(list, 1), 0));") == 0);
+    expect_output("ghostc ghostc\n");
+
+    ghostc_cleanup(runtime);
+}
+
+// Cyclic garbage is collected; without the collector the loop runs out
+// of heap after a few hundred iterations
+static void test_collects_garbage(void) {
+    GhostCRuntime* runtime = ghostc_init(256, 64 * 1024);
+    assert(runtime);
+
+    assert(run(runtime,
+               "i = 0;\n"
+               "while (i < 20000) { a = array(4); set(a, 0, a); s = \"ab\" + \"cd\"; set(a, 1, s); i = i + 1; }\n"
+               "print(i);\n") == 0);
+    expect_output("20000\n");
+
+    ghostc_cleanup(runtime);
+}
+
+// Live arrays survive collections that run while the script builds them
+// and a full one afterwards, which overflows gc_gray and finds the rest
+// with the rescan
+static void test_live_arrays(void) {
+    GhostCRuntime* runtime = ghostc_init(256, 256 * 1024);
+    assert(runtime);
+    assert(runtime->gc_gray_capacity == GHOSTC_GC_GRAY);
+
+    assert(run(runtime, kTree) == 0);
+    ghostc_collect(runtime);
+    assert(run(runtime, kTreeSum) == 0);
+    expect_output("499500\n");
+
+    assert(run(runtime, "get(big, 1000);") != 0);
+    assert(strcmp(runtime->error, "array index out of range") == 0);
+
+    ghostc_cleanup(runtime);
+}
+
+// A heap too small for gc_gray leaves every gray array to the rescan
+static void test_no_gray_stack(void) {
+    GhostCRuntime* runtime = ghostc_init(256, 1024);
+    assert(runtime);
+    assert(runtime->gc_gray == NULL && runtime->gc_gray_capacity == 0);
+
+    assert(run(runtime,
+               "i = 0;\n"
+               "while (i < 200) { a = array(1); b = array(1); set(a, 0, b); set(b, 0, a); i = i + 1; }\n"
+               "set(b, 0, 42);\n") == 0);
+    ghostc_collect(runtime);
+    assert(run(runtime, "print(get(get(a, 0), 0));") == 0);
+    expect_output("42\n");
+
+    ghostc_cleanup(runtime);
+}
+
+// The collector never calls kmalloc: with kmalloc exhausted, explicit
+// collections and the ones a full heap forces both finish
+static void test_kmalloc_exhausted(void) {
+    host_fail_kmalloc_after(2);
+    assert(ghostc_init(256, 64 * 1024) == NULL);
+    host_fail_kmalloc_after(-1);
+
+    GhostCRuntime* runtime = ghostc_init(256, 256 * 1024);
+    assert(runtime);
+    assert(run(runtime, kTree) == 0);
+
+    host_fail_kmalloc_after(0);
+    ghostc_collect(runtime);
+    host_fail_kmalloc_after(-1);
+
+    // The globals already exist, so execute needs two kmallocs, for its
+    // slots and the verifier's jump targets; every collection the loop
+    // forces runs without any
+    const char* garbage =
+        "i = 0;\n"
+        "while (i < 5000) { inner = array(64); i = i + 1; }\n";
+    GhostCCompiler compiler;
+    assert(ghostc_compile(garbage, &compiler) == 0);
+    assert(ghostc_execute(runtime, compiler.bytecode, compiler.bytecode_size) == 0);
+    host_fail_kmalloc_after(2);
+    assert(ghostc_execute(runtime, compiler.bytecode, compiler.bytecode_size) == 0);
+    host_fail_kmalloc_after(-1);
+    kfree(compiler.bytecode);
+
+    assert(run(runtime, kTreeSum) == 0);
+    expect_output("499500\n");
+
+    ghostc_cleanup(runtime);
+}
+
+// No step does more than GHOSTC_GC_STEP units of the rescan or of the
+// stack scan, however large the heap and the stack are
+static void test_bounded_steps(void) {
+    GhostCRuntime* runtime = ghostc_init(512, 256 * 1024);
+    assert(runtime);
+    assert(run(runtime, kTree) == 0);
+    ghostc_collect(runtime);
+    assert(runtime->gc_phase == GHOSTC_GC_IDLE);
+
+    for (size_t i = 0; i < 400; i++) {
+        runtime->stack[i] = ghostc_make_int((int64_t)i);
+    }
+    runtime->stack_ptr = 400;
+
+    size_t steps = 0;
+    size_t rescan_steps = 0;
+    size_t stack_steps = 0;
+    gc_start(runtime);
+    while (runtime->gc_phase == GHOSTC_GC_MARK) {
+        size_t rescan = runtime->gc_rescan;
+        int rescanning = runtime->gc_rescanning;
+        size_t stack_cursor = runtime->gc_stack_cursor;
+
+        gc_run(runtime, GHOSTC_GC_STEP);
+        steps++;
+        assert(steps < 100000);
+
+        if (rescanning && runtime->gc_rescanning && runtime->gc_rescan > rescan) {
+            assert(blocks_between(runtime, rescan, runtime->gc_rescan) <= GHOSTC_GC_STEP);
+            rescan_steps++;
+        }
+        assert(runtime->gc_stack_cursor - stack_cursor <= GHOSTC_GC_STEP);
+        if (runtime->gc_stack_cursor > stack_cursor) stack_steps++;
+    }
+    assert(rescan_steps > 1);
+    assert(stack_steps >= 400 / GHOSTC_GC_STEP);
+
+    runtime->stack_ptr = 0;
+    gc_run(runtime, (size_t)-1);
+    assert(run(runtime, kTreeSum) == 0);
+    expect_output("499500\n");
+
+    ghostc_cleanup(runtime);
+}
+
+// The verifier refuses images that would leave the code or the pools
+static void test_verifier(void) {
+    GhostCRuntime* runtime = ghostc_init(256, 64 * 1024);
+    assert(runtime);
+
+    GhostCCompiler compiler;
+    assert(ghostc_compile("x = 1; while (x < 3) { x = x + 1; } print(x);", &compiler) == 0);
+    GhostCImageHeader* header = (GhostCImageHeader*)compiler.bytecode;
+    uint8_t* code = compiler.bytecode + compiler.bytecode_size - header->code_size;
+
+    assert(ghostc_execute(runtime, compiler.bytecode, compiler.bytecode_size) == 0);
+    expect_output("3\n");
+
+    assert(ghostc_execute(runtime, compiler.bytecode, compiler.bytecode_size - 1) != 0);
+
+    code[0] = GHOSTC_OP_COUNT;
+    assert(ghostc_execute(runtime, compiler.bytecode, compiler.bytecode_size) != 0);
+    code[0] = GHOSTC_OP_CONST;
+    code[1] = 0xFF;
+    code[2] = 0xFF;
+    assert(ghostc_execute(runtime, compiler.bytecode, compiler.bytecode_size) != 0);
+    code[0] = GHOSTC_OP_JUMP;
+    code[1] = 1;
+    code[2] = 0;
+    assert(ghostc_execute(runtime, compiler.bytecode, compiler.bytecode_size) != 0);
+    code[header->code_size - 1] = GHOSTC_OP_POP;
+    assert(ghostc_execute(runtime, compiler.bytecode, compiler.bytecode_size) != 0);
+
+    header->magic = 0;
+    assert(ghostc_execute(runtime, compiler.bytecode, compiler.bytecode_size) != 0);
+
+    kfree(compiler.bytecode);
+    host_output();
+    ghostc_cleanup(runtime);
+}
+
+int main(void) {
+    test_execute();
+    test_globals();
+    test_heap();
+    test_print();
+    test_survives_execute();
+    test_collects_garbage();
+    test_live_arrays();
+    test_no_gray_stack();
+    test_kmalloc_exhausted();
+    test_bounded_steps();
+    test_verifier();
+#ifdef GHOSTC_NAN_BOXING
+    printf("ghostc_test (NaN-boxed): all tests passed\n");
+#else
+    printf("ghostc_test: all tests passed\n");
+#endif
+    return 0;
+}
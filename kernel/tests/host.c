@@ -0,0 +1,49 @@
+#include "host.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static long kmalloc_budget = -1;
+static char output[64 * 1024];
+static size_t output_length;
+static const char* input = "";
+
+void* kmalloc(size_t size) {
+    if (kmalloc_budget == 0) return NULL;
+    if (kmalloc_budget > 0) kmalloc_budget--;
+    return malloc(size);
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+void host_fail_kmalloc_after(long calls) {
+    kmalloc_budget = calls;
+}
+
+char keyboard_getchar(void) {
+    return *input ? *input++ : '\n';
+}
+
+void host_set_input(const char* text) {
+    input = text;
+}
+
+void term_write_string(const char* str) {
+    size_t length = strlen(str);
+    if (output_length + length >= sizeof(output)) {
+        fprintf(stderr, "host: terminal output overflowed\n");
+        abort();
+    }
+    memcpy(output + output_length, str, length + 1);
+    output_length += length;
+}
+
+const char* host_output(void) {
+    static char copy[sizeof(output)];
+    memcpy(copy, output, output_length + 1);
+    output_length = 0;
+    output[0] = '\0';
+    return copy;
+}
@@ -0,0 +1,29 @@
+#ifndef __GHOSTC_TEST_HOST_H
+#define __GHOSTC_TEST_HOST_H
+
+// Stands in for the kernel headers when ghostc.c is built for the host.
+// The test target force-includes this file, so system.h and
+// ghost_terminal.h, whose typedefs and prototypes clash with the host's
+// libc, are skipped and ghostc.c gets only what it uses from them.
+#define __SYSTEM_H
+#define __GHOST_TERMINAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+void* kmalloc(size_t size);
+void kfree(void* ptr);
+char keyboard_getchar(void);
+void term_write_string(const char* str);
+
+// kmalloc fails once this many more calls have succeeded; -1 never
+void host_fail_kmalloc_after(long calls);
+
+// Everything written to the terminal since the last call, which empties
+// it
+const char* host_output(void);
+
+// Characters keyboard_getchar returns, then newlines
+void host_set_input(const char* text);
+
+#endif
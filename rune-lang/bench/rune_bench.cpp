@@ -0,0 +1,443 @@
+// Throughput of the Rune front end on a synthetic corpus built from the
+// constructs in examples/*.rune. Each phase is timed separately and reports
+// source MB/s, heap allocations per KB of source and bytes allocated per KB.
+// Results are written as JSON.
+//
+// Usage: rune_bench [--size MB] [--seed N] [--repeats N]
+//                   [--mix name=weight,...] [--corpus FILE] [--output FILE]
+//
+// Numbers are only comparable between builds of the same type; configure
+// with -DCMAKE_BUILD_TYPE=Release to measure what ships.
+
+#include "RuneBytecode.hpp"
+#include "RuneCodeGen.hpp"
+#include "RuneLexer.hpp"
+#include "RuneOptimizer.hpp"
+#include "RuneParser.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace RuneLang;
+
+// ---------------------------------------------------------------------------
+// Allocation counting. Replacing the global operators here also covers
+// allocations made inside librunelang.
+
+namespace {
+std::atomic<size_t> gAllocations{0};
+std::atomic<size_t> gAllocatedBytes{0};
+}
+
+void* operator new(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    gAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* block = std::malloc(size ? size : 1)) return block;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete[](void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    std::free(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+    std::free(block);
+}
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Corpus
+
+enum Construct {
+    Print,
+    Declaration,
+    Branch,
+    Loop,
+    While,
+    Function,
+    Memory,
+    File,
+    System,
+    Comment,
+    ConstructCount
+};
+
+const char* const kConstructNames[ConstructCount] = {
+    "print", "declaration", "branch", "loop", "while",
+    "function", "memory", "file", "system", "comment",
+};
+
+// Pools stay small so the corpus fits the bytecode limits at any size
+constexpr int kGlobals = 256;
+constexpr int kFunctions = 64;
+
+class CorpusGenerator {
+public:
+    CorpusGenerator(uint64_t seed, const std::vector<double>& weights)
+        : random_(seed), pick_(weights.begin(), weights.end()) {}
+
+    std::string generate(size_t targetBytes) {
+        std::string out;
+        out.reserve(targetBytes + 512);
+        out += "ᛞ Synthetic Rune corpus\n";
+        out += "ᛠ v0 ᛃ 1\n";
+        declared_ = 1;
+
+        while (out.size() < targetBytes) {
+            construct(static_cast<Construct>(pick_(random_)), out);
+        }
+        return out;
+    }
+
+private:
+    int number(int low, int high) {
+        return std::uniform_int_distribution<int>(low, high)(random_);
+    }
+
+    std::string global() {
+        return "v" + std::to_string(number(0, declared_ - 1));
+    }
+
+    void construct(Construct kind, std::string& out) {
+        switch (kind) {
+            case Print:
+                out += "ᚠ\"Value: \" " + global() + " \" units\\n\"\n";
+                break;
+
+            case Declaration: {
+                // The initializer may only read names declared before it
+                const std::string lhs = global();
+                const std::string rhs = global();
+                const int slot = declared_ < kGlobals ? declared_++ : number(0, kGlobals - 1);
+                if (number(0, 1)) {
+                    out += "ᛠ v" + std::to_string(slot) + " ᛃ " + lhs + " ᚢ " +
+                           std::to_string(number(1, 9)) + " ᚹ (" + rhs + " ᚦ 1)\n";
+                } else {
+                    out += "ᛚ v" + std::to_string(slot) + " ᛃ 1024 ᚹ " + std::to_string(number(1, 64)) +
+                           "  ᛞ block size\n";
+                }
+                break;
+            }
+
+            case Branch:
+                out += "ᚷ(" + global() + " > " + std::to_string(number(0, 100)) + ") {\n"
+                       "    ᚠ\"Above threshold\\n\"\n"
+                       "} ᚨ {\n"
+                       "    ᚠ\"Below threshold: \" " + global() + " \"\\n\"\n"
+                       "}\n";
+                break;
+
+            case Loop:
+                out += "ᚱ(ᛚ i ᛃ 0; i < " + std::to_string(number(2, 10)) + "; i ᚢ 1) {\n"
+                       "    ᚠ\"Iteration: \" i \"\\n\"\n"
+                       "}\n";
+                break;
+
+            case While: {
+                const std::string counter = global();
+                out += "ᛉ " + counter + " < 0 {\n"
+                       "    " + counter + " ᛃ " + counter + " ᚢ 1\n"
+                       "}\n";
+                break;
+            }
+
+            case Function:
+                if (functions_ < kFunctions) {
+                    out += "ᛠ f" + std::to_string(functions_++) + "(ᛠ a, ᛠ b) {\n"
+                           "    ᚷ a > b {\n"
+                           "        ᛏ a ᚦ b\n"
+                           "    }\n"
+                           "    ᛏ a ᚹ b ᚢ 1\n"
+                           "}\n";
+                } else {
+                    out += "ᚠ\"Result: \" f" + std::to_string(number(0, kFunctions - 1)) + "(" + global() +
+                           ", " + std::to_string(number(1, 9)) + ") \"\\n\"\n";
+                }
+                break;
+
+            case Memory:
+                out += "ᛝ memBlock ᛃ ᛬" + std::to_string(1024 * number(1, 16)) + "\n"
+                       "ᚷ(memBlock) {\n"
+                       "    memBlock[0] ᛃ " + std::to_string(number(0, 255)) + "\n"
+                       "    ᛮmemBlock\n"
+                       "}\n";
+                break;
+
+            case File:
+                out += "ᚷ(ᛵ\"bench.txt\" \"Hello from GhostC OS!\\n\") {\n"
+                       "    ᚠ\"File size: \" ᛫getFileSize(\"bench.txt\") \" bytes\\n\"\n"
+                       "    ᛳ\"bench.txt\"\n"
+                       "}\n";
+                break;
+
+            case System: {
+                static const char* const queries[] = {
+                    "getOSVersion", "getHostname", "getCPUCount", "getTotalMemory",
+                    "getAvailableMemory", "getUptime",
+                };
+                const char* query = queries[number(0, 5)];
+                out += std::string("ᚠ\"") + query + ": \" ᛨ" + query + "() \"\\n\"\n";
+                break;
+            }
+
+            case Comment:
+                out += "ᛞ Display memory state after allocation\n";
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    std::mt19937_64 random_;
+    std::discrete_distribution<int> pick_;
+    int declared_ = 0;
+    int functions_ = 0;
+};
+
+// "print=3,branch=1" over the default weights
+bool parseMix(const std::string& text, std::vector<double>& weights) {
+    std::stringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        const size_t equals = item.find('=');
+        if (equals == std::string::npos) return false;
+        const std::string name = item.substr(0, equals);
+        bool found = false;
+        for (int i = 0; i < ConstructCount; i++) {
+            if (name == kConstructNames[i]) {
+                weights[i] = std::strtod(item.c_str() + equals + 1, nullptr);
+                found = weights[i] >= 0.0;
+            }
+        }
+        if (!found) return false;
+    }
+    for (double weight : weights) {
+        if (weight > 0.0) return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Measurement
+
+struct Phase {
+    std::string name;
+    double seconds = 0.0;
+    size_t allocations = 0;
+    size_t allocatedBytes = 0;
+    std::string error;
+};
+
+// Best time over repeats; allocations are counted for the final run.
+// setup runs untimed before each repetition.
+Phase measure(const std::string& name, int repeats, const std::function<void()>& setup,
+              const std::function<void()>& run) {
+    Phase phase;
+    phase.name = name;
+    try {
+        for (int i = 0; i < repeats; i++) {
+            setup();
+            const size_t allocations = gAllocations.load(std::memory_order_relaxed);
+            const size_t bytes = gAllocatedBytes.load(std::memory_order_relaxed);
+            const auto start = std::chrono::steady_clock::now();
+            run();
+            const auto end = std::chrono::steady_clock::now();
+            phase.allocations = gAllocations.load(std::memory_order_relaxed) - allocations;
+            phase.allocatedBytes = gAllocatedBytes.load(std::memory_order_relaxed) - bytes;
+
+            const double seconds = std::chrono::duration<double>(end - start).count();
+            if (i == 0 || seconds < phase.seconds) phase.seconds = seconds;
+        }
+    } catch (const std::exception& e) {
+        phase.error = e.what();
+    }
+    return phase;
+}
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+void printUsage() {
+    std::cout << "Usage: rune_bench [options]\n\n"
+              << "Options:\n"
+              << "  --size <MB>          Size of the generated corpus (default: 4)\n"
+              << "  --seed <n>           Seed for the corpus generator (default: 1)\n"
+              << "  --repeats <n>        Runs per phase; the fastest is reported (default: 3)\n"
+              << "  --mix <name=w,...>   Relative weight of each construct\n"
+              << "  --corpus <file>      Also write the generated corpus to <file>\n"
+              << "  --output <file>      Write results to <file> instead of stdout\n"
+              << "\nConstructs:";
+    for (const char* name : kConstructNames) std::cout << ' ' << name;
+    std::cout << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    double sizeMB = 4.0;
+    uint64_t seed = 1;
+    int repeats = 3;
+    std::string corpusPath;
+    std::string outputPath;
+    std::vector<double> weights = {4, 4, 2, 1, 1, 1, 1, 1, 1, 2};
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        } else if (arg == "--size" && hasValue) {
+            sizeMB = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--seed" && hasValue) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--repeats" && hasValue) {
+            repeats = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--mix" && hasValue) {
+            if (!parseMix(argv[++i], weights)) {
+                std::cerr << "rune_bench: invalid mix " << argv[i] << std::endl;
+                return 2;
+            }
+        } else if (arg == "--corpus" && hasValue) {
+            corpusPath = argv[++i];
+        } else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        } else {
+            std::cerr << "rune_bench: unknown option " << arg << std::endl;
+            printUsage();
+            return 2;
+        }
+    }
+
+    const std::string source = CorpusGenerator(seed, weights).generate(static_cast<size_t>(sizeMB * 1024 * 1024));
+    if (!corpusPath.empty()) {
+        std::ofstream(corpusPath, std::ios::binary) << source;
+    }
+
+    // compileFile streams from and to disk, so it gets files of its own
+    const fs::path scratch = fs::temp_directory_path() / ("rune_bench_" + std::to_string(getpid()));
+    fs::create_directories(scratch);
+    const std::string inputPath = (scratch / "corpus.rune").string();
+    const std::string generatedPath = (scratch / "corpus.cpp").string();
+    std::ofstream(inputPath, std::ios::binary) << source;
+
+    RuneParser parser;
+    RuneArena arena;
+    Ast::Program program;
+    std::vector<Phase> phases;
+    auto parse = [&] {
+        arena.reset();
+        program = parser.parseProgram(source, arena);
+    };
+    auto nothing = [] {};
+
+    RuneSymbolTable symbols;
+    phases.push_back(measure("lex", repeats, nothing, [&] {
+        symbols.clear();
+        RuneLexer::tokenize(source, symbols);
+    }));
+    phases.push_back(measure("lex_parallel", repeats, nothing, [&] {
+        symbols.clear();
+        RuneLexer::tokenizeParallel(source, symbols, std::thread::hardware_concurrency());
+    }));
+    phases.push_back(measure("parse", repeats, nothing, parse));
+    phases.push_back(measure("optimize", repeats, parse, [&] { RuneOptimizer().optimize(program, arena); }));
+    phases.push_back(measure("codegen", repeats, parse, [&] { generateCpp(program); }));
+    phases.push_back(measure("codegen_mapped", repeats, parse, [&] {
+        CppSourceLines lines(source);
+        generateCpp(program, lines);
+    }));
+    phases.push_back(measure("bytecode", repeats, parse, [&] { compileBytecode(program); }));
+    phases.push_back(measure("compile_file", repeats, nothing, [&] { parser.compileFile(inputPath, generatedPath); }));
+
+    std::error_code ignored;
+    fs::remove_all(scratch, ignored);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::ostringstream json;
+    const double kilobytes = static_cast<double>(source.size()) / 1024.0;
+    json << "{\n"
+         << "  \"corpus\": {\n"
+         << "    \"bytes\": " << source.size() << ",\n"
+         << "    \"seed\": " << seed << ",\n"
+         << "    \"mix\": {";
+    for (int i = 0; i < ConstructCount; i++) {
+        json << (i ? ", " : "") << "\"" << kConstructNames[i] << "\": " << weights[i];
+    }
+    json << "}\n"
+         << "  },\n"
+         << "  \"repeats\": " << repeats << ",\n"
+         << "  \"phases\": [\n";
+    for (size_t i = 0; i < phases.size(); i++) {
+        const Phase& phase = phases[i];
+        json << "    {\"name\": " << jsonString(phase.name);
+        if (phase.error.empty()) {
+            json << ", \"seconds\": " << phase.seconds
+                 << ", \"mb_per_s\": " << static_cast<double>(source.size()) / (1024.0 * 1024.0) / phase.seconds
+                 << ", \"allocations\": " << phase.allocations
+                 << ", \"allocations_per_kb\": " << static_cast<double>(phase.allocations) / kilobytes
+                 << ", \"allocated_bytes_per_kb\": " << static_cast<double>(phase.allocatedBytes) / kilobytes;
+        } else {
+            json << ", \"error\": " << jsonString(phase.error);
+        }
+        json << "}" << (i + 1 < phases.size() ? "," : "") << "\n";
+    }
+    json << "  ],\n"
+         << "  \"peak_rss_kb\": " << usage.ru_maxrss << "\n"
+         << "}\n";
+
+    if (outputPath.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream(outputPath) << json.str();
+    }
+
+    for (const Phase& phase : phases) {
+        if (!phase.error.empty()) return 1;
+    }
+    return 0;
+}
@@ -14,6 +14,7 @@
 #include "RuneSystem.hpp"
 #include "RuneParser.hpp"
 #include "RuneMonitor.hpp"
+#include "RuneNative.hpp"
 
 namespace RuneLang {
 
@@ -90,12 +91,16 @@ private:
     std::string getRuneSymbol(const std::string& command);
     bool validateRitual(const std::vector<std::string>& runes);
     void openRuneEditor(const std::string& filename);
+    void runRuneScript(const std::string& path);
+    void runNativeScript(const std::string& path);
     
     std::unordered_map<std::string, RuneCommand> commands;
     std::unordered_map<std::string, std::string> runeAliases;
     std::unordered_map<std::string, RuneEffect> runeEffects;
     std::vector<std::string> activeRunes;
     std::unique_ptr<RuneMonitor> monitor;
+    std::unique_ptr<RuneJit> jit;  // Created by the first native invoke
+    std::unordered_map<std::string, std::unique_ptr<RuneNativeScript>> nativeScripts;
     bool isBinding;
     std::string currentDirectory;
 };
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace RuneLang {
+
+// Bump allocator for short-lived trees. Objects are never destroyed
+// individually; everything is released at once by reset() or the destructor,
+// so only trivially destructible types may be placed in the arena.
+class RuneArena {
+public:
+    explicit RuneArena(size_t blockSize = 64 * 1024) : blockSize_(blockSize) {}
+
+    RuneArena(const RuneArena&) = delete;
+    RuneArena& operator=(const RuneArena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        uintptr_t current = reinterpret_cast<uintptr_t>(cursor_);
+        uintptr_t aligned = (current + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+        if (cursor_ == nullptr || aligned + size > reinterpret_cast<uintptr_t>(limit_)) {
+            grow(size + align);
+            current = reinterpret_cast<uintptr_t>(cursor_);
+            aligned = (current + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+        }
+        cursor_ = reinterpret_cast<char*>(aligned + size);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "Arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T* copyArray(const T* items, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "Arena arrays are copied bytewise");
+        if (count == 0) return nullptr;
+        T* data = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        std::memcpy(data, items, sizeof(T) * count);
+        return data;
+    }
+
+    // Release every allocation but keep the first block for reuse
+    void reset() {
+        if (blocks_.empty()) return;
+        blocks_.resize(1);
+        cursor_ = blocks_.front().data.get();
+        limit_ = cursor_ + blocks_.front().size;
+    }
+
+    size_t bytesReserved() const {
+        size_t total = 0;
+        for (const Block& block : blocks_) total += block.size;
+        return total;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void grow(size_t minimum) {
+        const size_t size = minimum > blockSize_ ? minimum : blockSize_;
+        blocks_.push_back(Block{std::unique_ptr<char[]>(new char[size]), size});
+        cursor_ = blocks_.back().data.get();
+        limit_ = cursor_ + size;
+    }
+
+    size_t blockSize_;
+    std::vector<Block> blocks_;
+    char* cursor_ = nullptr;
+    char* limit_ = nullptr;
+};
+
+} // namespace RuneLang
@@ -0,0 +1,404 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "RuneSymbols.hpp"
+
+namespace RuneLang {
+namespace Ast {
+
+// Every node lives in a RuneArena and refers to names and literals through
+// string_views into the source buffer, so the tree stays trivially
+// destructible and is released in one go after code generation. Names and
+// string literals also carry their Symbol in Program::symbols.
+
+enum class NodeKind : uint8_t {
+    // Expressions
+    IntLiteral,
+    FloatLiteral,
+    StringLiteral,
+    BoolLiteral,
+    Identifier,
+    Unary,
+    Binary,
+    Assign,
+    Call,
+    Index,
+    Member,
+    Scoped,
+    Builtin,
+
+    // Statements
+    Comment,
+    Print,
+    Input,
+    VarDecl,
+    ExprStmt,
+    Block,
+    If,
+    While,
+    For,
+    Return,
+    Function,
+    Class
+};
+
+struct Node {
+    explicit Node(NodeKind k) : kind(k) {}
+
+    NodeKind kind;
+    uint32_t offset = 0;   // Byte offset into the source; see RuneLineIndex
+};
+
+// Arena-allocated array of child pointers
+template <typename T>
+struct NodeList {
+    T* const* items = nullptr;
+    uint32_t count = 0;
+
+    T* const* begin() const { return items; }
+    T* const* end() const { return items + count; }
+    T* operator[](size_t index) const { return items[index]; }
+    bool empty() const { return count == 0; }
+};
+
+struct Expr : Node {
+    using Node::Node;
+};
+
+struct Stmt : Node {
+    using Node::Node;
+};
+
+// ---------------------------------------------------------------------------
+// Expressions
+
+struct IntLiteral : Expr {
+    static constexpr NodeKind Kind = NodeKind::IntLiteral;
+    IntLiteral() : Expr(Kind) {}
+
+    int64_t value = 0;
+    std::string_view text;
+};
+
+struct FloatLiteral : Expr {
+    static constexpr NodeKind Kind = NodeKind::FloatLiteral;
+    FloatLiteral() : Expr(Kind) {}
+
+    double value = 0.0;
+    std::string_view text;
+};
+
+struct StringLiteral : Expr {
+    static constexpr NodeKind Kind = NodeKind::StringLiteral;
+    StringLiteral() : Expr(Kind) {}
+
+    std::string_view text;   // Raw contents between the delimiters
+    Symbol symbol = kNoSymbol;  // Of text
+    bool runeQuoted = false; // Delimited by ᛟ rather than '"'
+};
+
+struct BoolLiteral : Expr {
+    static constexpr NodeKind Kind = NodeKind::BoolLiteral;
+    BoolLiteral() : Expr(Kind) {}
+
+    bool value = false;
+};
+
+struct Identifier : Expr {
+    static constexpr NodeKind Kind = NodeKind::Identifier;
+    Identifier() : Expr(Kind) {}
+
+    std::string_view name;
+    Symbol symbol = kNoSymbol;
+};
+
+enum class UnaryOp : uint8_t {
+    Negate,  // -
+    Not,     // !
+    BitNot   // ᛁ ~
+};
+
+struct UnaryExpr : Expr {
+    static constexpr NodeKind Kind = NodeKind::Unary;
+    UnaryExpr() : Expr(Kind) {}
+
+    UnaryOp op = UnaryOp::Negate;
+    Expr* operand = nullptr;
+};
+
+enum class BinaryOp : uint8_t {
+    Add,        // ᚢ +
+    Sub,        // ᚦ -
+    Mul,        // ᚹ *
+    Div,        // ᚺ /
+    Mod,        // ᚻ %
+    Shl,        // ᚼ <<
+    Shr,        // ᚽ >>
+    BitAnd,     // ᚾ &
+    BitOr,      // ᚿ |
+    BitXor,     // ᛀ ^
+    Less,       // <
+    Greater,    // >
+    LessEq,     // <=
+    GreaterEq,  // >=
+    Equal,      // ==
+    NotEqual,   // ᛇ !=
+    LogicalAnd, // &&
+    LogicalOr   // ᛋ ||
+};
+
+// Binding strength shared by the parser and the code generator; higher
+// binds tighter, mirroring C++
+inline int precedence(BinaryOp op) {
+    switch (op) {
+        case BinaryOp::LogicalOr: return 1;
+        case BinaryOp::LogicalAnd: return 2;
+        case BinaryOp::BitOr: return 3;
+        case BinaryOp::BitXor: return 4;
+        case BinaryOp::BitAnd: return 5;
+        case BinaryOp::Equal:
+        case BinaryOp::NotEqual: return 6;
+        case BinaryOp::Less:
+        case BinaryOp::Greater:
+        case BinaryOp::LessEq:
+        case BinaryOp::GreaterEq: return 7;
+        case BinaryOp::Shl:
+        case BinaryOp::Shr: return 8;
+        case BinaryOp::Add:
+        case BinaryOp::Sub: return 9;
+        case BinaryOp::Mul:
+        case BinaryOp::Div:
+        case BinaryOp::Mod: return 10;
+    }
+    return 0;
+}
+
+inline std::string_view spelling(BinaryOp op) {
+    switch (op) {
+        case BinaryOp::Add: return "+";
+        case BinaryOp::Sub: return "-";
+        case BinaryOp::Mul: return "*";
+        case BinaryOp::Div: return "/";
+        case BinaryOp::Mod: return "%";
+        case BinaryOp::Shl: return "<<";
+        case BinaryOp::Shr: return ">>";
+        case BinaryOp::BitAnd: return "&";
+        case BinaryOp::BitOr: return "|";
+        case BinaryOp::BitXor: return "^";
+        case BinaryOp::Less: return "<";
+        case BinaryOp::Greater: return ">";
+        case BinaryOp::LessEq: return "<=";
+        case BinaryOp::GreaterEq: return ">=";
+        case BinaryOp::Equal: return "==";
+        case BinaryOp::NotEqual: return "!=";
+        case BinaryOp::LogicalAnd: return "&&";
+        case BinaryOp::LogicalOr: return "||";
+    }
+    return "";
+}
+
+struct BinaryExpr : Expr {
+    static constexpr NodeKind Kind = NodeKind::Binary;
+    BinaryExpr() : Expr(Kind) {}
+
+    BinaryOp op = BinaryOp::Add;
+    Expr* lhs = nullptr;
+    Expr* rhs = nullptr;
+};
+
+// target ᛃ value
+struct AssignExpr : Expr {
+    static constexpr NodeKind Kind = NodeKind::Assign;
+    AssignExpr() : Expr(Kind) {}
+
+    Expr* target = nullptr;
+    Expr* value = nullptr;
+};
+
+struct CallExpr : Expr {
+    static constexpr NodeKind Kind = NodeKind::Call;
+    CallExpr() : Expr(Kind) {}
+
+    Expr* callee = nullptr;
+    NodeList<Expr> args;
+};
+
+struct IndexExpr : Expr {
+    static constexpr NodeKind Kind = NodeKind::Index;
+    IndexExpr() : Expr(Kind) {}
+
+    Expr* base = nullptr;
+    Expr* index = nullptr;
+};
+
+struct MemberExpr : Expr {
+    static constexpr NodeKind Kind = NodeKind::Member;
+    MemberExpr() : Expr(Kind) {}
+
+    Expr* base = nullptr;
+    std::string_view member;
+    bool arrow = false;      // ᛗ or '->'
+};
+
+// Name behind an operations prefix rune, e.g. ᛨgetHostname
+struct ScopedExpr : Expr {
+    static constexpr NodeKind Kind = NodeKind::Scoped;
+    ScopedExpr() : Expr(Kind) {}
+
+    char32_t prefix = 0;
+    std::string_view scope;  // Keyword of the prefix rune, e.g. "RuneSystem::"
+    std::string_view name;
+    Symbol symbol = kNoSymbol;  // Of name
+};
+
+// Operation rune applied to its operands, e.g. ᛵ"log.txt" content
+struct BuiltinCall : Expr {
+    static constexpr NodeKind Kind = NodeKind::Builtin;
+    BuiltinCall() : Expr(Kind) {}
+
+    char32_t rune = 0;
+    std::string_view name;   // Keyword of the rune, e.g. "writeFile"
+    NodeList<Expr> args;
+};
+
+// ---------------------------------------------------------------------------
+// Statements
+
+struct CommentStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::Comment;
+    CommentStmt() : Stmt(Kind) {}
+
+    std::string_view text;   // Everything after ᛞ up to the end of the line
+};
+
+// ᚠ arg arg ...
+struct PrintStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::Print;
+    PrintStmt() : Stmt(Kind) {}
+
+    NodeList<Expr> args;
+};
+
+// ᛜ target
+struct InputStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::Input;
+    InputStmt() : Stmt(Kind) {}
+
+    Expr* target = nullptr;
+};
+
+// Type rune followed by a name, e.g. ᛚ blockSize ᛃ 1024
+struct VarDecl : Stmt {
+    static constexpr NodeKind Kind = NodeKind::VarDecl;
+    VarDecl() : Stmt(Kind) {}
+
+    char32_t typeRune = 0;
+    std::string_view typeName;
+    std::string_view name;
+    Symbol symbol = kNoSymbol;
+    Expr* init = nullptr;
+};
+
+struct ExprStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::ExprStmt;
+    ExprStmt() : Stmt(Kind) {}
+
+    Expr* expr = nullptr;
+};
+
+struct BlockStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::Block;
+    BlockStmt() : Stmt(Kind) {}
+
+    NodeList<Stmt> body;
+};
+
+// ᚷ cond { ... } ᚨ { ... }
+struct IfStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::If;
+    IfStmt() : Stmt(Kind) {}
+
+    Expr* cond = nullptr;
+    BlockStmt* thenBlock = nullptr;
+    Stmt* elseBranch = nullptr;  // BlockStmt, chained IfStmt or null
+};
+
+// ᛉ cond { ... }
+struct WhileStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::While;
+    WhileStmt() : Stmt(Kind) {}
+
+    Expr* cond = nullptr;
+    BlockStmt* body = nullptr;
+};
+
+// ᚱ(init; cond; step) { ... }
+struct ForStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::For;
+    ForStmt() : Stmt(Kind) {}
+
+    Stmt* init = nullptr;    // VarDecl or ExprStmt, may be null
+    Expr* cond = nullptr;
+    Expr* step = nullptr;
+    BlockStmt* body = nullptr;
+};
+
+// ᛏ value
+struct ReturnStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::Return;
+    ReturnStmt() : Stmt(Kind) {}
+
+    Expr* value = nullptr;
+};
+
+struct Param {
+    char32_t typeRune;
+    std::string_view typeName;
+    std::string_view name;
+    Symbol symbol = kNoSymbol;
+};
+
+// Type rune, name, optional parameter list and a body
+struct FunctionDecl : Stmt {
+    static constexpr NodeKind Kind = NodeKind::Function;
+    FunctionDecl() : Stmt(Kind) {}
+
+    char32_t returnRune = 0;
+    std::string_view returnType;
+    std::string_view name;
+    Symbol symbol = kNoSymbol;
+    const Param* params = nullptr;
+    uint32_t paramCount = 0;
+    BlockStmt* body = nullptr;
+};
+
+// ᛥ Name { members } or ᛧ Name { members }
+struct ClassDecl : Stmt {
+    static constexpr NodeKind Kind = NodeKind::Class;
+    ClassDecl() : Stmt(Kind) {}
+
+    std::string_view keyword;  // "class" or "struct"
+    std::string_view name;
+    NodeList<Stmt> members;
+};
+
+struct Program {
+    NodeList<Stmt> body;
+    std::string_view source;  // Text the node offsets point into
+    const RuneSymbolTable* symbols = nullptr;
+};
+
+template <typename T>
+inline T* as(Node* node) {
+    return node && node->kind == T::Kind ? static_cast<T*>(node) : nullptr;
+}
+
+template <typename T>
+inline const T* as(const Node* node) {
+    return node && node->kind == T::Kind ? static_cast<const T*>(node) : nullptr;
+}
+
+} // namespace Ast
+} // namespace RuneLang
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string_view>
+#include "RuneVM.hpp"
+
+namespace RuneLang {
+
+// Host function a script can reach by name, either as a builtin rune
+// keyword ("allocateMemory") or as a prefixed name
+// ("RuneFileSystem::createDirectory"). Returns nullptr for unknown names.
+RuneNative findBuiltin(std::string_view name);
+
+} // namespace RuneLang
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "RuneAst.hpp"
+
+namespace RuneLang {
+namespace Bytecode {
+
+// Register machine instructions. Every instruction is one 32-bit word:
+//
+//   ABC   op:8 a:8 b:8 c:8
+//   ABx   op:8 a:8 bx:16     (sBx when the 16 bits are read as signed)
+//   sJ    op:8 sj:24         (signed jump offset)
+//
+// Jump offsets are relative to the instruction after the jump.
+enum class Op : uint8_t {
+    Move,         // ABC  R[a] = R[b]
+    LoadK,        // ABx  R[a] = K[bx]
+    LoadInt,      // AsBx R[a] = sbx
+    LoadNil,      // A    R[a] = nil
+    LoadBool,     // AB   R[a] = b != 0
+    GetGlobal,    // ABx  R[a] = G[bx]
+    SetGlobal,    // ABx  G[bx] = R[a]
+
+    Add,          // ABC  R[a] = R[b] + R[c]
+    Sub,
+    Mul,
+    Div,
+    Mod,
+    Shl,
+    Shr,
+    BitAnd,
+    BitOr,
+    BitXor,
+    Less,         // ABC  R[a] = R[b] < R[c]; > and >= swap their operands
+    LessEq,
+    Equal,
+    NotEqual,
+
+    Negate,       // ABC  R[a] = -R[b]
+    Not,          // ABC  R[a] = !R[b]
+    BitNot,       // ABC  R[a] = ~R[b]
+    ToBool,       // ABC  R[a] = bool(R[b])
+    ToFloat,      // ABC  R[a] = double(R[b])
+
+    GetIndex,     // ABC  R[a] = R[b][R[c]]
+    SetIndex,     // ABC  R[a][R[b]] = R[c]
+
+    Jump,         // sJ   pc += sj
+    JumpIfFalse,  // AsBx if !R[a] then pc += sbx
+    JumpIfTrue,   // AsBx if R[a] then pc += sbx
+
+    Call,         // ABC  R[a] = R[a](R[a+1] .. R[a+b])
+    CallNative,   // ABC  R[a] = natives[b](R[a] .. R[a+c-1])
+    Return,       // A    return R[a]
+    ReturnNil,    //      return nil
+
+    Print,        // A    write R[a] to stdout
+    Input,        // AB   R[a] = next stdin token read as InputKind(b)
+
+    Count
+};
+
+using Instruction = uint32_t;
+
+constexpr Instruction encodeABC(Op op, uint8_t a, uint8_t b, uint8_t c) {
+    return static_cast<Instruction>(op) | (uint32_t(a) << 8) | (uint32_t(b) << 16) | (uint32_t(c) << 24);
+}
+
+constexpr Instruction encodeABx(Op op, uint8_t a, uint16_t bx) {
+    return static_cast<Instruction>(op) | (uint32_t(a) << 8) | (uint32_t(bx) << 16);
+}
+
+constexpr Instruction encodeAsBx(Op op, uint8_t a, int16_t sbx) {
+    return encodeABx(op, a, static_cast<uint16_t>(sbx));
+}
+
+constexpr Instruction encodeSJ(Op op, int32_t sj) {
+    return static_cast<Instruction>(op) | (static_cast<uint32_t>(sj) << 8);
+}
+
+constexpr Op opOf(Instruction i) { return static_cast<Op>(i & 0xFF); }
+constexpr uint8_t argA(Instruction i) { return static_cast<uint8_t>(i >> 8); }
+constexpr uint8_t argB(Instruction i) { return static_cast<uint8_t>(i >> 16); }
+constexpr uint8_t argC(Instruction i) { return static_cast<uint8_t>(i >> 24); }
+constexpr uint16_t argBx(Instruction i) { return static_cast<uint16_t>(i >> 16); }
+constexpr int16_t argSBx(Instruction i) { return static_cast<int16_t>(i >> 16); }
+constexpr int32_t argSJ(Instruction i) { return static_cast<int32_t>(i) >> 8; }
+
+constexpr int kMaxRegisters = 256;
+constexpr int32_t kMaxJump = (1 << 23) - 1;
+
+// How Input converts the token it reads, taken from the target's type rune
+enum class InputKind : uint8_t {
+    Text,
+    Number,
+    Boolean
+};
+
+// Slice of Module::strings. Offsets rather than pointers keep the module
+// free of absolute addresses.
+struct StringRef {
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+enum class ConstantKind : uint8_t {
+    Int,
+    Float,
+    String,
+    Function
+};
+
+struct Constant {
+    ConstantKind kind = ConstantKind::Int;
+    union {
+        int64_t integer;
+        double number;
+        StringRef string;
+        uint32_t function;    // Index into Module::functions
+    };
+
+    Constant() : integer(0) {}
+};
+
+struct Function {
+    StringRef name;
+    uint32_t codeOffset = 0;  // First instruction in Module::code
+    uint32_t codeSize = 0;
+    uint8_t paramCount = 0;
+    uint16_t registerCount = 0;
+};
+
+// Maps the first instruction of a run to the source line it came from
+struct LineEntry {
+    uint32_t pc;
+    uint32_t line;
+};
+
+// Read-only run of records from a Module or a mapped .runec file
+template <typename T>
+struct Table {
+    const T* items = nullptr;
+    uint32_t count = 0;
+
+    const T* data() const { return items; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+    const T& operator[](size_t i) const { return items[i]; }
+};
+
+// The tables of a module as RuneVM reads them. An Image points either into
+// a Module or straight into a mapped .runec file (see RuneModule.hpp), so a
+// precompiled script runs without being copied or decoded.
+struct Image {
+    Table<Instruction> code;
+    Table<Constant> constants;
+    Table<Function> functions;
+    Table<StringRef> globals;
+    Table<StringRef> natives;
+    Table<LineEntry> lines;
+    std::string_view strings;
+
+    std::string_view text(StringRef ref) const {
+        return std::string_view(strings.data() + ref.offset, ref.length);
+    }
+
+    // Source line of the instruction at pc, 0 if unknown
+    uint32_t lineAt(size_t pc) const;
+};
+
+// A compiled script. functions[0] is the top-level code; it runs once and
+// defines every global, including the other functions.
+struct Module {
+    std::vector<Instruction> code;
+    std::vector<Constant> constants;
+    std::vector<Function> functions;
+    std::vector<StringRef> globals;   // Names, indexed by global slot
+    std::vector<StringRef> natives;   // Host functions named by CallNative
+    std::vector<LineEntry> lines;     // Sorted by pc
+    std::string strings;
+
+    std::string_view text(StringRef ref) const {
+        return std::string_view(strings.data() + ref.offset, ref.length);
+    }
+
+    // Source line of the instruction at pc, 0 if unknown
+    uint32_t lineAt(size_t pc) const { return image().lineAt(pc); }
+
+    // View of the tables; valid until the module is changed or destroyed
+    Image image() const;
+};
+
+const char* opName(Op op);
+
+} // namespace Bytecode
+
+// Compile a parsed program for RuneVM. Throws RuneParseError for
+// constructs the bytecode backend cannot express.
+Bytecode::Module compileBytecode(const Ast::Program& program);
+
+// Human readable listing of a module, one instruction per line
+std::string disassemble(const Bytecode::Image& module);
+
+inline std::string disassemble(const Bytecode::Module& module) {
+    return disassemble(module.image());
+}
+
+// Check that every instruction of module names an opcode the VM knows and
+// only reaches registers, constants, globals and host functions that exist,
+// and that control stays inside the function it starts in. Returns nullptr
+// if the VM can run the module without further checks, otherwise why not.
+const char* verifyBytecode(const Bytecode::Image& module);
+
+} // namespace RuneLang
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace RuneLang {
+
+// Identifies a cache entry. hash names the entry's file; check and length
+// are stored in the entry and compared on load, so two inputs whose hash
+// collides never serve each other's output.
+struct RuneCacheKey {
+    uint64_t hash;
+    uint64_t check;
+    uint64_t length;
+};
+
+// On-disk store of generated code addressed by a 64-bit key. Entries are
+// written to a temporary file and renamed into place, so concurrent
+// compilers (threads or processes) never observe a partial entry. Reading
+// an entry refreshes its modification time, and once the directory grows
+// past maxBytes the least recently used entries are evicted.
+class RuneCache {
+public:
+    explicit RuneCache(const std::string& directory, uint64_t maxBytes = 256ULL * 1024 * 1024);
+
+    RuneCache(const RuneCache&) = delete;
+    RuneCache& operator=(const RuneCache&) = delete;
+
+    // Returns false on a miss; output is left untouched in that case. An
+    // entry whose check or length differs from key counts as a miss.
+    bool load(const RuneCacheKey& key, std::string& output);
+
+    // Failures are logged and otherwise ignored, a cache must never break
+    // the compile it is serving
+    void store(const RuneCacheKey& key, std::string_view output);
+
+    // Remove least recently used entries until the cache is under lowWater
+    void evict(uint64_t lowWater);
+
+    const std::string& directory() const { return directory_; }
+    uint64_t bytesStored() const { return bytesStored_; }
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+private:
+    std::string entryPath(uint64_t key) const;
+    uint64_t scan() const;
+
+    std::string directory_;
+    uint64_t maxBytes_;
+    std::atomic<uint64_t> bytesStored_;
+    std::atomic<size_t> hits_;
+    std::atomic<size_t> misses_;
+    std::atomic<uint64_t> nextTemp_;
+    std::mutex evictMutex_;
+};
+
+} // namespace RuneLang
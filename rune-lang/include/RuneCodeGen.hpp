@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include "RuneAst.hpp"
+#include "RuneScan.hpp"
+#include "RuneSourceMap.hpp"
+
+namespace RuneLang {
+
+class RuneFileWriter;
+
+// Emit C++ for a parsed program. The output size is measured in a first
+// walk so the text is written into a single, exactly sized buffer.
+std::string generateCpp(const Ast::Program& program);
+
+// Where generated C++ came from. Given to generateCpp, it records the Rune
+// line of every statement in map and, if lineFile is set, emits #line
+// directives naming that file so compilers, debuggers and profilers report
+// Rune lines directly. One instance follows one output file across any
+// number of calls.
+struct CppSourceLines {
+    // firstLine is the output line the generated code starts on
+    explicit CppSourceLines(std::string_view source, uint32_t firstLine = 1)
+        : source(source), line(firstLine) {}
+
+    // Statements come in source order, so lines are counted on from the
+    // previous one rather than looked up in a table of the whole source
+    uint32_t runeLine(size_t offset) {
+        if (offset < scanned) {
+            scanned = 0;
+            scannedLine = 1;
+        }
+        scannedLine += static_cast<uint32_t>(scan::newlines(source.data() + scanned, offset - scanned));
+        scanned = offset;
+        return scannedLine;
+    }
+
+    RuneSourceMap map;
+    std::string lineFile;
+    std::string_view source;
+    uint32_t line;                   // Output line the next text lands on
+    uint32_t directiveLine = 0;      // Output line after the last #line, 0 before the first
+    uint32_t directiveRuneLine = 0;  // Rune line that #line gave it
+    size_t scanned = 0;              // Source offset counted up to
+    uint32_t scannedLine = 1;
+};
+
+std::string generateCpp(const Ast::Program& program, CppSourceLines& lines);
+
+// Emit a complete translation unit for a shared object. Top-level
+// statements run inside extern "C" int kRuneNativeEntry(), which returns 0.
+constexpr const char* kRuneNativeEntry = "rune_native_main";
+std::string generateNativeCpp(const Ast::Program& program);
+
+// Stream the C++ for one top-level statement straight into a file
+void generateCpp(const Ast::Stmt* stmt, RuneFileWriter& out);
+void generateCpp(const Ast::Stmt* stmt, RuneFileWriter& out, CppSourceLines& lines);
+
+} // namespace RuneLang
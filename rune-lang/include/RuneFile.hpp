@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace RuneLang {
+
+// Read-only memory mapping of a source file. Pages are faulted in as the
+// parser walks the view, so the file is never copied into the heap.
+class RuneMappedFile {
+public:
+    explicit RuneMappedFile(const std::string& path);
+    ~RuneMappedFile();
+
+    RuneMappedFile(const RuneMappedFile&) = delete;
+    RuneMappedFile& operator=(const RuneMappedFile&) = delete;
+
+    std::string_view view() const { return std::string_view(data_, size_); }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_;
+    size_t size_;
+};
+
+// Fixed-size write buffer in front of a file descriptor. Generated code is
+// streamed through it, so memory use stays at the buffer size no matter
+// how large the output grows.
+class RuneFileWriter {
+public:
+    explicit RuneFileWriter(const std::string& path, size_t bufferSize = 64 * 1024);
+    ~RuneFileWriter();
+
+    RuneFileWriter(const RuneFileWriter&) = delete;
+    RuneFileWriter& operator=(const RuneFileWriter&) = delete;
+
+    void append(std::string_view text) {
+        if (text.size() > capacity_ - used_) {
+            flushBuffer();
+            if (text.size() >= capacity_) {
+                writeAll(text.data(), text.size());
+                return;
+            }
+        }
+        std::memcpy(buffer_.get() + used_, text.data(), text.size());
+        used_ += text.size();
+    }
+
+    void append(char c) {
+        if (used_ == capacity_) flushBuffer();
+        buffer_[used_++] = c;
+    }
+
+    // Flush pending output and close the file, throwing on I/O errors
+    void close();
+
+    size_t bytesWritten() const { return written_ + used_; }
+
+private:
+    void flushBuffer();
+    void writeAll(const char* data, size_t size);
+
+    std::string path_;
+    int fd_;
+    std::unique_ptr<char[]> buffer_;
+    size_t capacity_;
+    size_t used_;
+    size_t written_;
+};
+
+} // namespace RuneLang
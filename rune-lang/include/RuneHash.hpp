@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace RuneLang {
+
+namespace detail {
+    inline uint64_t rotateLeft(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    // splitmix64 finalizer
+    inline uint64_t mix64(uint64_t value) {
+        value ^= value >> 30;
+        value *= 0xBF58476D1CE4E5B9ULL;
+        value ^= value >> 27;
+        value *= 0x94D049BB133111EBULL;
+        value ^= value >> 31;
+        return value;
+    }
+}
+
+// Fast non-cryptographic 64-bit hash. Consumes eight bytes per step, so
+// hashing a script costs far less than lexing it. Suitable for cache keys,
+// not for anything an attacker controls.
+inline uint64_t hashBytes(std::string_view data, uint64_t seed = 0) {
+    constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+
+    const char* p = data.data();
+    size_t remaining = data.size();
+    uint64_t hash = seed ^ (static_cast<uint64_t>(data.size()) * kPrime1);
+
+    while (remaining >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        hash = detail::rotateLeft(hash ^ (word * kPrime2), 31) * kPrime1;
+        p += 8;
+        remaining -= 8;
+    }
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, p, remaining);
+    hash = detail::rotateLeft(hash ^ (tail * kPrime2), 31) * kPrime1;
+
+    return detail::mix64(hash);
+}
+
+// A second 64-bit hash built unlike hashBytes (word-at-a-time FNV-1a with
+// a different prime and finalizer), so inputs that collide under one are
+// not expected to collide under the other. Used to confirm a hashBytes key.
+inline uint64_t checkBytes(std::string_view data, uint64_t seed = 0) {
+    constexpr uint64_t kOffset = 0xCBF29CE484222325ULL;
+    constexpr uint64_t kPrime = 0x00000100000001B3ULL;
+
+    const char* p = data.data();
+    size_t remaining = data.size();
+    uint64_t hash = kOffset ^ seed;
+
+    while (remaining >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        hash = (hash ^ word) * kPrime;
+        hash ^= hash >> 29;
+        p += 8;
+        remaining -= 8;
+    }
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, p, remaining);
+    hash = (hash ^ tail ^ (static_cast<uint64_t>(data.size()) << 3)) * kPrime;
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+} // namespace RuneLang
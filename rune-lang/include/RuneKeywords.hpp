@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include "RuneUtf8.hpp"
+
+namespace RuneLang {
+
+struct RuneKeyword {
+    char32_t rune;
+    std::string_view keyword;
+};
+
+// Every rune the parser knows and the C++ it stands for
+inline constexpr RuneKeyword kRuneKeywords[] = {
+    {U'ᚠ', "std::cout << "}, // Output to console
+    {U'ᚱ', "for"},           // For-loop
+    {U'ᚷ', "if"},            // If-condition
+    {U'ᛏ', "return"},        // Return from function
+    {U'ᚢ', "+"},             // Addition operator
+    {U'ᚦ', "-"},             // Subtraction operator
+    {U'ᛉ', "while"},         // While-loop
+    {U'ᚨ', "std::vector<"},  // Array declaration
+    {U'ᛜ', "std::cin >> "},  // Input from console
+    {U'ᛝ', "std::string"},   // String type
+    {U'ᛞ', "#"},             // Comment marker
+    {U'ᛟ', "\""},            // String delimiter
+    {U'ᛗ', "->"},            // Arrow operator
+    {U'ᚹ', "*"},             // Multiplication
+    {U'ᚺ', "/"},             // Division
+    {U'ᚻ', "%"},             // Modulo
+    {U'ᚼ', "<<"},            // Left shift
+    {U'ᚽ', ">>"},            // Right shift
+    {U'ᚾ', "&"},             // Bitwise AND
+    {U'ᚿ', "|"},             // Bitwise OR
+    {U'ᛀ', "^"},             // Bitwise XOR
+    {U'ᛁ', "~"},             // Bitwise NOT
+    {U'ᛃ', "="},             // Assignment
+    {U'ᛇ', "!="},            // Not equal
+    {U'ᛋ', "||"},            // Logical OR
+    {U'ᛚ', "float"},         // Float array type
+    {U'ᛦ', "double"},        // Double array type
+    {U'ᛙ', "char"},          // Char type
+    {U'ᛠ', "double"},        // Double type
+    {U'ᛡ', "bool"},          // Boolean type
+    {U'ᛤ', "void"},          // Void return type
+    {U'ᛥ', "class"},         // Class declaration
+    {U'ᛧ', "struct"},        // Struct declaration
+    {U'ᛨ', "RuneSystem::"},  // System operations prefix
+    {U'ᛩ', "RuneProcess::"}, // Process operations prefix
+    {U'ᛪ', "RuneThread::"},  // Thread operations prefix
+    {U'᛫', "RuneFileSystem::"}, // File system operations prefix
+    {U'᛬', "allocateMemory"}, // Allocate memory
+    {U'ᛮ', "freeMemory"},     // Free memory
+    {U'ᛯ', "createProcess"}, // Create new process
+    {U'ᛰ', "createThread"}, // Create new thread
+    {U'ᛱ', "terminate"},    // Terminate process/thread
+    {U'ᛲ', "createFile"},    // Create file
+    {U'ᛳ', "deleteFile"},    // Delete file
+    {U'ᛴ', "readFile"},      // Read file
+    {U'ᛵ', "writeFile"},     // Write file
+};
+
+namespace detail {
+
+constexpr bool runeKeywordsValid() {
+    constexpr size_t count = sizeof(kRuneKeywords) / sizeof(kRuneKeywords[0]);
+    for (size_t i = 0; i < count; i++) {
+        const char32_t rune = kRuneKeywords[i].rune;
+        if (rune - kRunicBlockStart >= kRunicBlockSize || kRuneKeywords[i].keyword.empty()) return false;
+        for (size_t j = i + 1; j < count; j++) {
+            if (kRuneKeywords[j].rune == rune) return false;
+        }
+    }
+    return true;
+}
+
+constexpr std::array<std::string_view, kRunicBlockSize> buildRuneTable() {
+    std::array<std::string_view, kRunicBlockSize> table{};
+    for (const RuneKeyword& entry : kRuneKeywords) {
+        table[entry.rune - kRunicBlockStart] = entry.keyword;
+    }
+    return table;
+}
+
+} // namespace detail
+
+static_assert(detail::runeKeywordsValid(),
+              "every rune must be in the Runic block, have a keyword and appear once");
+
+// Keyword text for every codepoint of the Runic block, indexed by
+// (codepoint - kRunicBlockStart). Empty entries are unknown runes.
+inline constexpr std::array<std::string_view, kRunicBlockSize> kRuneTable = detail::buildRuneTable();
+
+// Keyword for codepoint, or an empty view if it is not a known rune
+constexpr std::string_view runeKeyword(char32_t codepoint) {
+    return codepoint - kRunicBlockStart < kRunicBlockSize
+        ? kRuneTable[codepoint - kRunicBlockStart] : std::string_view();
+}
+
+} // namespace RuneLang
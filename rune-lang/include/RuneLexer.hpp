@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "RuneSymbols.hpp"
+
+namespace RuneLang {
+
+enum class TokenKind : uint8_t {
+    End,
+    Newline,
+    Rune,
+    Identifier,
+    Number,
+    String,
+    Comment,
+    Punct,
+    Error       // Text the lexer could not read; see RuneLexer::errorMessage
+};
+
+// One token as a span of the source. Tokens hold no text of their own, so
+// a token array is a flat block of 16-byte records the parser walks by index.
+struct RuneToken {
+    enum Flags : uint8_t {
+        kSpaced = 1,      // Preceded by whitespace
+        kRuneQuoted = 2   // String delimited by ᛟ rather than '"'
+    };
+
+    TokenKind kind = TokenKind::End;
+    uint8_t flags = 0;
+    uint32_t offset = 0;  // First byte, delimiters included
+    uint32_t length = 0;
+    uint32_t value = 0;   // Symbol of identifiers and strings, codepoint of runes
+
+    bool spaced() const { return flags & kSpaced; }
+    bool runeQuoted() const { return flags & kRuneQuoted; }
+    char32_t rune() const { return value; }
+    Symbol symbol() const { return value; }
+
+    // Contents of strings and comments without their delimiters, otherwise
+    // the whole token
+    std::string_view text(std::string_view source) const {
+        std::string_view span = source.substr(offset, length);
+        if (kind == TokenKind::String) {
+            const size_t quote = runeQuoted() ? 3 : 1;
+            return span.substr(quote, span.size() - 2 * quote);
+        }
+        if (kind == TokenKind::Comment) return span.substr(3);  // After ᛞ
+        return span;
+    }
+};
+
+static_assert(sizeof(RuneToken) == 16, "tokens are packed four to a cache line");
+
+// Offsets are 32-bit in tokens, line indexes and syntax trees alike, so the
+// parser refuses longer sources
+constexpr size_t kMaxRuneSourceBytes = UINT32_MAX;
+
+// Splits a source into RuneTokens. Identifiers and string contents are
+// interned into the given table as they are read. Errors do not throw:
+// unreadable text becomes an Error token and lexing carries on after it,
+// so reporting stays with the parser.
+//
+// A run of blank lines is one Newline token; whitespace inside a line only
+// sets kSpaced on the token after it.
+class RuneLexer {
+public:
+    RuneLexer() = default;
+    RuneLexer(std::string_view source, RuneSymbolTable& symbols) { reset(source, symbols); }
+
+    void reset(std::string_view source, RuneSymbolTable& symbols);
+
+    // Append up to maxTokens tokens to out. The last token of the source is
+    // End; returns false once it has been appended.
+    bool lex(std::vector<RuneToken>& out, size_t maxTokens = SIZE_MAX);
+
+    // Lex a whole source at once
+    static std::vector<RuneToken> tokenize(std::string_view source, RuneSymbolTable& symbols);
+
+    // tokenize() on up to threads threads. The source is cut into chunks at
+    // line starts, a quick scan for string delimiters moves any cut that
+    // falls inside a string to where the string ends, and the chunks are
+    // lexed side by side and joined in order. Tokens and symbol numbering
+    // are the same as tokenize() gives.
+    static std::vector<RuneToken> tokenizeParallel(std::string_view source, RuneSymbolTable& symbols,
+                                                   size_t threads);
+
+    // Sources smaller than this are not worth splitting
+    static constexpr size_t kParallelBytes = 4 * 1024 * 1024;
+
+    // What went wrong at an Error token
+    static std::string errorMessage(const RuneToken& token, std::string_view source);
+
+    size_t position() const { return cursor_; }
+
+private:
+    RuneToken next();
+    void lexString(RuneToken& token);
+    void lexQuotedString(RuneToken& token);
+    void lexComment(RuneToken& token);
+    void lexNumber(RuneToken& token);
+    void lexIdentifier(RuneToken& token);
+    void lexPunct(RuneToken& token);
+    void finish(RuneToken& token, TokenKind kind) const;
+
+    std::string_view source_;
+    size_t cursor_ = 0;
+    RuneSymbolTable* symbols_ = nullptr;
+    bool done_ = false;
+};
+
+} // namespace RuneLang
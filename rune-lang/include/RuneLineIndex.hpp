@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "RuneScan.hpp"
+
+namespace RuneLang {
+
+// Maps byte offsets in a source to 1-based line and column numbers. The
+// lexer only tracks offsets; the table of line starts is built on the first
+// lookup, so a source that never needs a position never pays for it.
+// Columns count codepoints, so a rune is one column wide.
+class RuneLineIndex {
+public:
+    struct Position {
+        uint32_t line;
+        uint32_t column;
+    };
+
+    RuneLineIndex() = default;
+    explicit RuneLineIndex(std::string_view source) : source_(source) {}
+
+    void reset(std::string_view source) {
+        source_ = source;
+        starts_.clear();
+        last_ = 0;
+    }
+
+    Position locate(size_t offset) const {
+        offset = std::min(offset, source_.size());
+        const size_t index = lineOf(offset);
+        const size_t start = starts_[index];
+        return Position{static_cast<uint32_t>(index + 1),
+                        static_cast<uint32_t>(1 + scan::codepoints(source_.data() + start, offset - start))};
+    }
+
+    uint32_t line(size_t offset) const {
+        return static_cast<uint32_t>(lineOf(std::min(offset, source_.size())) + 1);
+    }
+
+private:
+    // Lookups mostly move forward through the source, so the line found last
+    // time and the one after it are tried before searching
+    size_t lineOf(size_t offset) const {
+        if (starts_.empty()) build();
+        for (size_t index = last_; index < last_ + 2 && index < starts_.size(); index++) {
+            if (starts_[index] <= offset && (index + 1 == starts_.size() || offset < starts_[index + 1])) {
+                return last_ = index;
+            }
+        }
+        last_ = static_cast<size_t>(std::upper_bound(starts_.begin(), starts_.end(), offset) - starts_.begin()) - 1;
+        return last_;
+    }
+
+    void build() const {
+        starts_.push_back(0);
+        scan::eachNewline(source_.data(), source_.size(), [this](size_t at) {
+            starts_.push_back(static_cast<uint32_t>(at + 1));
+        });
+    }
+
+    std::string_view source_;
+    mutable std::vector<uint32_t> starts_;  // First byte of each line; offsets are 32-bit as in Ast::Node
+    mutable size_t last_ = 0;
+};
+
+} // namespace RuneLang
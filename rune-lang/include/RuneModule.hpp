@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "RuneBytecode.hpp"
+#include "RuneFile.hpp"
+
+namespace RuneLang {
+
+// Precompiled scripts (.runec). A file is a fixed header followed by the
+// tables of a Bytecode::Module, each 8-byte aligned and stored exactly as
+// Bytecode::Image reads them. Every reference inside is an index or an
+// offset, so loading only maps the file and points an Image into it:
+// nothing is parsed or copied, and pages are read as the VM touches them.
+//
+// Files use the byte order of the machine that wrote them and carry
+// kRuneModuleVersion; anything else is rejected on load rather than misread.
+constexpr uint32_t kRuneModuleVersion = 1;
+
+// Identifies the source a module was compiled from, so a stale .runec can
+// be told apart from one that is safe to run in place of the script
+uint64_t runeSourceHash(std::string_view source);
+
+// Write module to path, replacing it atomically. Throws RuneError on I/O
+// errors.
+void writeRuneModule(const Bytecode::Module& module, uint64_t sourceHash, const std::string& path);
+
+// The bytes writeRuneModule would write
+std::string encodeRuneModule(const Bytecode::Module& module, uint64_t sourceHash);
+
+// A mapped .runec file. The header and the tables the VM binds at load
+// (functions, constants, global and host function names) are checked
+// against the file size, and every instruction is checked with
+// verifyBytecode, so a damaged or hostile file is refused rather than run.
+class RuneModuleFile {
+public:
+    // Throws RuneError if path is not a module this build can run
+    explicit RuneModuleFile(const std::string& path);
+
+    RuneModuleFile(const RuneModuleFile&) = delete;
+    RuneModuleFile& operator=(const RuneModuleFile&) = delete;
+
+    const Bytecode::Image& image() const { return image_; }
+    uint64_t sourceHash() const { return sourceHash_; }
+
+private:
+    RuneMappedFile file_;
+    Bytecode::Image image_;
+    uint64_t sourceHash_;
+};
+
+} // namespace RuneLang
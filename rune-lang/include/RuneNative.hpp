@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+namespace RuneLang {
+
+// A script compiled to a shared object and loaded into this process. The
+// object is unloaded with the last reference, so code that was replaced
+// while a run was in progress stays mapped until that run returns.
+class RuneNativeLibrary {
+public:
+    // Throws RuneError if path cannot be loaded or lacks the entry point
+    explicit RuneNativeLibrary(const std::string& path);
+    ~RuneNativeLibrary();
+
+    RuneNativeLibrary(const RuneNativeLibrary&) = delete;
+    RuneNativeLibrary& operator=(const RuneNativeLibrary&) = delete;
+
+    // Run the script's top-level statements
+    int run() const { return entry_(); }
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    void* handle_;
+    int (*entry_)();
+};
+
+// Compiles scripts to native code with the host C++ compiler and loads them
+// in process. Shared objects are kept in directory under a hash of the
+// source, the compiler and the rune table version, so a script is compiled
+// once and every later compile of the same text is a dlopen. Objects are
+// written beside their final name and renamed into place, so concurrent
+// compilers never load a partial one.
+class RuneJit {
+public:
+    explicit RuneJit(const std::string& directory, const std::string& compiler = defaultCompiler());
+
+    RuneJit(const RuneJit&) = delete;
+    RuneJit& operator=(const RuneJit&) = delete;
+
+    // Throws RuneParseError for invalid scripts and RuneError when the
+    // compiler fails, with its diagnostics in the message
+    std::shared_ptr<const RuneNativeLibrary> compile(std::string_view source);
+
+    // $RUNE_CXX, then $CXX, then c++
+    static std::string defaultCompiler();
+
+    const std::string& directory() const { return directory_; }
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+private:
+    void build(const std::string& cppPath, const std::string& objectPath, const std::string& logPath);
+
+    std::string directory_;
+    std::string compiler_;
+    uint64_t seed_;  // Hash of everything besides the source that shapes an object
+    std::atomic<size_t> hits_;
+    std::atomic<size_t> misses_;
+    std::atomic<uint64_t> nextTemp_;
+};
+
+// A script file run through a RuneJit. Every run first checks whether the
+// file changed on disk and, if it did, compiles the new text and swaps it in
+// atomically. Runs already in progress finish on the version they started.
+class RuneNativeScript {
+public:
+    RuneNativeScript(RuneJit& jit, const std::string& path);
+
+    RuneNativeScript(const RuneNativeScript&) = delete;
+    RuneNativeScript& operator=(const RuneNativeScript&) = delete;
+
+    // Recompile if the file changed since it was last loaded. Returns true
+    // if a new version was swapped in. On errors the previous version stays
+    // current and the error is thrown.
+    bool reload();
+
+    // reload(), then run the current version
+    int run();
+
+    // nullptr until the first successful load
+    std::shared_ptr<const RuneNativeLibrary> current() const;
+
+    const std::string& path() const { return path_; }
+
+private:
+    struct Stamp {
+        dev_t device = 0;
+        ino_t inode = 0;
+        off_t size = -1;
+        timespec modified{};
+
+        bool operator==(const Stamp& other) const {
+            return device == other.device && inode == other.inode && size == other.size &&
+                   modified.tv_sec == other.modified.tv_sec && modified.tv_nsec == other.modified.tv_nsec;
+        }
+    };
+
+    RuneJit& jit_;
+    std::string path_;
+    std::mutex reloadMutex_;  // One compile per change, however many threads run
+    Stamp stamp_;
+    std::shared_ptr<const RuneNativeLibrary> library_;  // Only through std::atomic_load/store
+};
+
+} // namespace RuneLang
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "RuneArena.hpp"
+#include "RuneAst.hpp"
+
+namespace RuneLang {
+
+// Rewrites a parsed program before code generation. Arithmetic on literals
+// is folded, variables known to hold a constant are replaced by it, and
+// ᚷ/ᚨ branches and loops whose condition is known are dropped.
+//
+// Folding follows the C++ the code generator emits: integers are folded
+// only while they stay within int, float variables are computed in float,
+// and anything C++ would leave undefined is kept as written.
+class RuneOptimizer {
+public:
+    // Optimize a whole program. New nodes are allocated in arena, which
+    // must be the arena the program was parsed into.
+    void optimize(Ast::Program& program, RuneArena& arena);
+
+    // Streaming form for RuneParser::parseNext. Pass the top-level statements
+    // of one program in order; constants stay known from one statement to
+    // the next. Returns the statement to generate, or nullptr if it is dead.
+    Ast::Stmt* optimizeNext(Ast::Stmt* stmt, RuneArena& arena);
+
+private:
+    struct Constant {
+        enum class Kind : uint8_t {
+            Int,
+            Float,   // C++ float, held exactly in number
+            Double,
+            Bool
+        };
+
+        Kind kind = Kind::Int;
+        int64_t integer = 0;   // Int and Bool
+        double number = 0.0;   // Float and Double
+    };
+
+    struct Binding {
+        Symbol symbol;
+        std::string_view typeName;
+        bool known;
+        Constant value;
+    };
+
+    // Variables in scope and what is known about them. While a branch or
+    // loop body is visited, every change to an existing binding is logged
+    // in trail so the state before it can be restored.
+    struct Environment {
+        std::vector<Binding> bindings;
+        std::vector<size_t> scopes{0};   // Start of each open scope
+        std::vector<std::pair<size_t, Binding>> trail;
+        std::vector<size_t> liveGlobals; // Globals that may be known
+        int branches = 0;
+    };
+
+    // Statements and expressions return their replacement
+    Ast::Stmt* statement(Ast::Stmt* stmt);
+    Ast::BlockStmt* block(Ast::BlockStmt* block);
+    Ast::Stmt* ifStatement(Ast::IfStmt* stmt);
+    Ast::Stmt* whileLoop(Ast::WhileStmt* loop);
+    Ast::Stmt* forLoop(Ast::ForStmt* loop);
+    void function(Ast::FunctionDecl* function);
+    void classBody(Ast::ClassDecl* decl);
+    Ast::Expr* expr(Ast::Expr* e);
+    Ast::Expr* place(Ast::Expr* e);
+    void list(Ast::NodeList<Ast::Stmt>& items);
+    void list(Ast::NodeList<Ast::Expr>& items);
+
+    static bool constantOf(const Ast::Expr* e, Constant& value);
+    static bool truthy(const Constant& value);
+    static bool convert(std::string_view typeName, const Constant& value, Constant& converted);
+    static bool foldUnary(Ast::UnaryOp op, const Constant& operand, Constant& result);
+    static bool foldBinary(Ast::BinaryOp op, const Constant& lhs, const Constant& rhs, Constant& result);
+    Ast::Expr* literal(const Constant& value, const Ast::Node* at);
+
+    void pushScope();
+    void popScope();
+    void declare(Symbol symbol, std::string_view typeName, const Ast::Expr* init);
+    void assign(Symbol symbol, const Ast::Expr* value);
+    void update(size_t index, bool known, const Constant& value);
+    void forget(Symbol symbol);
+    void forgetGlobals();
+    bool isGlobal(size_t index) const;
+    void undo(size_t mark);
+    void endBranch();
+
+    // Names assigned anywhere below a node, and whether it calls a script
+    // function, which may assign any global
+    void writes(const Ast::Stmt* stmt, bool& calls);
+    void writes(const Ast::Expr* e, bool& calls);
+    void beforeCalls(const Ast::Expr* e);
+
+    RuneArena* arena_ = nullptr;
+    Environment env_;
+    bool inFunction_ = false;
+    std::vector<Symbol> written_;
+    std::vector<Ast::Node*> scratch_;
+};
+
+} // namespace RuneLang
@@ -1,85 +1,216 @@
 #pragma once
 
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 #include <stdexcept>
 #include "RuneSystem.hpp"
+#include "RuneUtf8.hpp"
+#include "RuneArena.hpp"
+#include "RuneAst.hpp"
+#include "RuneBytecode.hpp"
+#include "RuneLexer.hpp"
+#include "RuneLineIndex.hpp"
+#include "RuneSourceMap.hpp"
+#include "RuneSymbols.hpp"
 
 namespace RuneLang {
 
 // Forward declarations
 class RuneParser;
-class Function;
-class Class;
+class RuneCache;
+struct RuneCacheKey;
+
+// Part of every cache key. Bump it whenever the rune table or the code
+// generator changes what a script compiles to.
+constexpr uint64_t kRuneTableVersion = 2;
 
 // Custom exception for rune parsing errors
 class RuneParseError : public std::runtime_error {
 public:
     explicit RuneParseError(const std::string& message, size_t line = 0, size_t column = 0) 
         : std::runtime_error(formatError(message, line, column)),
+          message_(message),
           line_(line),
           column_(column) {}
 
+    // Message without the position prefix added by what()
+    const std::string& getMessage() const { return message_; }
     size_t getLine() const { return line_; }
     size_t getColumn() const { return column_; }
 
 private:
+    std::string message_;
     size_t line_;
     size_t column_;
     
     static std::string formatError(const std::string& message, size_t line, size_t column) {
         if (line == 0) return message;
+        if (column == 0) return "Line " + std::to_string(line) + ": " + message;
         return "Line " + std::to_string(line) + ", Column " + std::to_string(column) + ": " + message;
     }
 };
 
-// Structure to represent a function
-class Function {
-public:
-    std::string returnType;
-    std::string name;
-    std::vector<std::string> parameters;
-    std::string body;
-
-    Function(const std::string& ret, const std::string& n) 
-        : returnType(ret), name(n) {}
-};
-
-// Structure to represent a class
-class Class {
-public:
-    std::string name;
-    std::vector<Function> methods;
-    std::vector<std::string> members;
-
-    explicit Class(const std::string& n) : name(n) {}
-};
-
 // Main parser class
 class RuneParser {
 public:
     RuneParser();
     std::string parseRuneCode(const std::string& runeCode);
     std::string compileToCpp(const std::string& runeCode);
-    std::string handleCustomType(const std::string& code, size_t& pos);
+    std::string compileToCpp(const std::string& runeCode, const std::string& outputPath);
+
+    // Map the script at inputPath and stream the generated C++ to outputPath.
+    // Each top-level statement is generated and released before the next is
+    // parsed, so memory use does not grow with the size of the script.
+    void compileFile(const std::string& inputPath, const std::string& outputPath);
+
+    // Reuse generated code across runs. Sources whose hash is found in
+    // cache are written out without being parsed. Pass nullptr to disable.
+    void setCache(RuneCache* cache) { this->cache = cache; }
+
+    // Run RuneOptimizer between parsing and code generation (on by default)
+    void setOptimize(bool enabled) { optimize = enabled; }
+
+    // Write a map from the lines of every file compileToCpp and compileFile
+    // generate back to Rune lines, as "<output>.map" (see RuneSourceMap)
+    void setSourceMap(bool enabled) { sourceMap = enabled; }
+
+    // Emit #line directives into generated C++, so compiler errors,
+    // debuggers and profilers report Rune lines directly. compileFile names
+    // its input path in them; compileToCpp only sees text and names
+    // sourceName.
+    void setLineDirectives(bool enabled, const std::string& sourceName = "script.rune") {
+        lineFile = enabled ? sourceName : std::string();
+    }
+
+    // Keep going after syntax errors instead of throwing the first one. Each
+    // error is recorded in diagnostics(), the statement it occurred in is
+    // skipped and parsing resumes at the next, so one pass finds every error
+    // in a file. Code is still only generated for input without errors.
+    void setRecover(bool enabled) { recover = enabled; }
+
+    // parseProgram lexes sources of RuneLexer::kParallelBytes or more up
+    // front on this many threads (default: all cores). The incremental
+    // beginProgram/parseNext path always lexes as it goes.
+    void setLexThreads(size_t threads) { lexThreads = threads; }
+    const std::vector<RuneParseError>& diagnostics() const { return errors; }
+
+    // Parse runeCode in recovery mode without generating anything. Returns
+    // true if it has no errors; otherwise they are in diagnostics().
+    bool checkSyntax(std::string_view runeCode);
+
+    // Recording stops after this many errors
+    static constexpr size_t kMaxDiagnostics = 100;
+
+    // The whole file compileToCpp would write, returned instead. The cache
+    // is used as by compileToCpp; source maps and #line directives are not.
+    std::string compileToCppUnit(std::string_view runeCode);
+
+    // Parse runeCode and compile it for RuneVM instead of to C++
+    Bytecode::Module compileToBytecode(std::string_view runeCode);
+
+    // Parse runeCode into a translation unit for a shared object, whose
+    // statements run when kRuneNativeEntry is called (see RuneNative.hpp)
+    std::string compileToNative(std::string_view runeCode);
+
+    // Compile the script at inputPath to a precompiled .runec module at
+    // outputPath (see RuneModule.hpp)
+    void compileModule(const std::string& inputPath, const std::string& outputPath);
+
+    // Build the syntax tree for runeCode inside arena. The tree refers to
+    // runeCode directly, so both must outlive it. Its symbols belong to the
+    // parser and stay valid until the parser begins another program.
+    Ast::Program parseProgram(std::string_view runeCode, RuneArena& arena);
+
+    // Incremental form of parseProgram: call beginProgram, then parseNext
+    // until it returns nullptr
+    void beginProgram(std::string_view runeCode, RuneArena& arena);
+    Ast::Stmt* parseNext();
     
 private:
-    std::unordered_map<std::string, std::string> runeToKeyword;
-    size_t currentLine;
-    size_t currentColumn;
+    using Token = RuneToken;
+
+    // Where to resume after looking ahead
+    struct LexerState {
+        size_t index;
+        Token token;
+    };
+
+    // Tokens are lexed this many at a time, and those before the current
+    // statement are dropped once this many have been read
+    static constexpr size_t kTokenBatch = 4096;
+
+    std::string_view source;
+    RuneLexer lexer;
+    std::vector<Token> tokens;  // Window of the token stream
+    size_t current;             // Index of lookahead in tokens
+    size_t lexThreads;
+    bool streaming;             // Tokens are lexed in batches, not all up front
+    RuneLineIndex lines;  // Resolves token offsets for diagnostics
+    RuneSymbolTable symbols;  // Names and literals of the current program
+    Token lookahead;
+    RuneArena* arena;
+    RuneArena workArena;  // Trees of the compile entry points; kept so a reused parser does not reallocate
+    std::vector<Ast::Node*> scratch;  // Shared stack for building child lists
+    RuneCache* cache;
+    bool optimize;
+    bool sourceMap;
+    std::string lineFile;  // Named by #line directives, empty for none
+
+    // Error recovery; see setRecover
+    bool recover;
+    bool panicking;     // An error was recorded and its statement is being abandoned
+    bool resyncing;     // Lexing past the rest of that statement
+    size_t panicOffset;
+    std::vector<RuneParseError> errors;
     
-    void initializeRuneMap();
-    std::string handleFunction(const std::string& code, size_t& pos);
-    std::string handleClass(const std::string& code, size_t& pos);
-    std::string handleSwitch(const std::string& code, size_t& pos);
-    std::string handleString(const std::string& code, size_t& pos);
-    std::string handleComment(const std::string& code, size_t& pos);
-    std::string handleSystemCall(const std::string& code, size_t& pos);
-    std::string handleProcessManagement(const std::string& code, size_t& pos);
-    std::string handleFileOperation(const std::string& code, size_t& pos);
-    void updatePosition(const std::string& code, size_t& pos);
-    void skipWhitespace(const std::string& code, size_t& pos);
+    RuneCacheKey cacheKey(std::string_view runeCode, std::string_view directiveFile) const;
+    void storeSourceMap(const RuneCacheKey& key, const RuneSourceMap& map, const std::string& outputPath);
+    bool loadSourceMap(const RuneCacheKey& key, const std::string& outputPath);
+
+    // Lexer
+    void startProgram(std::string_view runeCode, RuneArena& arena, size_t threads);
+    void nextToken();
+    void seek(size_t index);
+    LexerState saveState() const;
+    void restoreState(const LexerState& state);
+    std::string_view text(const Token& token) const { return token.text(source); }
+
+    // Parser
+    void error(const std::string& message, const Token& at);
+    void synchronize(size_t start);
+    void failOnDiagnostics() const;
+    template <typename T> T* makeNode(const Token& at);
+    template <typename T> Ast::NodeList<T> finishList(size_t mark);
+    bool isRune(char32_t rune) const;
+    bool isPunct(std::string_view punct) const;
+    bool atStatementEnd() const;
+    bool startsExpression() const;
+    void expectPunct(std::string_view punct, const char* what);
+    void skipNewlines();
+    void expectStatementEnd();
+
+    Ast::Stmt* parseStatement();
+    Ast::BlockStmt* parseBlock();
+    Ast::Stmt* parseIf();
+    Ast::Stmt* parseWhile();
+    Ast::Stmt* parseFor();
+    Ast::Stmt* parseReturn();
+    Ast::Stmt* parsePrint();
+    Ast::Stmt* parseInput();
+    Ast::Stmt* parseDeclaration();
+    Ast::Stmt* parseFunction(const Token& typeToken, const Token& nameToken);
+    Ast::Stmt* parseClass();
+    Ast::Stmt* parseSimpleStatement();
+
+    Ast::Expr* parseExpression();
+    Ast::Expr* parseBinary(int minPrecedence);
+    Ast::Expr* parseUnary();
+    Ast::Expr* parsePostfix();
+    Ast::Expr* parsePrimary();
+    Ast::Expr* parseBuiltin();
+    Ast::Expr* parseStepExpression();
+    bool binaryOperator(Ast::BinaryOp& op, int& precedence) const;
 };
 
 } // namespace RuneLang
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RUNE_SCAN_SIMD 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define RUNE_SCAN_SIMD 1
+#endif
+
+namespace RuneLang {
+
+// Bulk byte scanning for the lexer. x86-64 always has SSE2, so it is the
+// baseline there; builds with AVX2 enabled (e.g. -march=native) scan 32
+// bytes at a time. Other targets use the scalar loops.
+namespace scan {
+
+namespace detail {
+
+inline bool isBlank(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r' && c != '\n');
+}
+
+#if defined(RUNE_SCAN_SIMD)
+
+#if defined(__AVX2__)
+struct Bytes {
+    static constexpr size_t kSize = 32;
+    __m256i v;
+
+    static Bytes load(const char* p) {
+        return {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))};
+    }
+    Bytes eq(char c) const { return {_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))}; }
+    Bytes gt(char c) const { return {_mm256_cmpgt_epi8(v, _mm256_set1_epi8(c))}; }
+    Bytes lt(char c) const { return {_mm256_cmpgt_epi8(_mm256_set1_epi8(c), v)}; }
+    Bytes operator|(Bytes o) const { return {_mm256_or_si256(v, o.v)}; }
+    Bytes operator&(Bytes o) const { return {_mm256_and_si256(v, o.v)}; }
+    Bytes operator~() const { return {_mm256_xor_si256(v, _mm256_set1_epi8(-1))}; }
+    uint32_t mask() const { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+};
+#else
+struct Bytes {
+    static constexpr size_t kSize = 16;
+    __m128i v;
+
+    static Bytes load(const char* p) {
+        return {_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))};
+    }
+    Bytes eq(char c) const { return {_mm_cmpeq_epi8(v, _mm_set1_epi8(c))}; }
+    Bytes gt(char c) const { return {_mm_cmpgt_epi8(v, _mm_set1_epi8(c))}; }
+    Bytes lt(char c) const { return {_mm_cmplt_epi8(v, _mm_set1_epi8(c))}; }
+    Bytes operator|(Bytes o) const { return {_mm_or_si128(v, o.v)}; }
+    Bytes operator&(Bytes o) const { return {_mm_and_si128(v, o.v)}; }
+    Bytes operator~() const { return {_mm_xor_si128(v, _mm_set1_epi8(-1))}; }
+    uint32_t mask() const { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+};
+#endif
+
+// Comparisons are signed, so bytes >= 0x80 are negative and never blank
+inline Bytes blank(Bytes b) {
+    return b.eq(' ') | (b.gt('\t' - 1) & b.lt('\r' + 1) & ~b.eq('\n'));
+}
+
+#else
+
+// Named by the block predicates below, which are never instantiated here
+struct Bytes;
+Bytes blank(Bytes b);
+
+#endif
+
+// Index of the first matching byte, or length. vector tests whole blocks
+// and scalar the bytes left over at the end; both must agree.
+template <typename Vector, typename Scalar>
+inline size_t findFirst(const char* text, size_t length, Vector vector, Scalar scalar) {
+    size_t i = 0;
+#if defined(RUNE_SCAN_SIMD)
+    for (; i + Bytes::kSize <= length; i += Bytes::kSize) {
+        const uint32_t mask = vector(Bytes::load(text + i)).mask();
+        if (mask != 0) return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+#else
+    (void)vector;
+#endif
+    for (; i < length; i++) {
+        if (scalar(static_cast<unsigned char>(text[i]))) return i;
+    }
+    return length;
+}
+
+// Number of matching bytes
+template <typename Vector, typename Scalar>
+inline size_t count(const char* text, size_t length, Vector vector, Scalar scalar) {
+    size_t i = 0;
+    size_t total = 0;
+#if defined(RUNE_SCAN_SIMD)
+    for (; i + Bytes::kSize <= length; i += Bytes::kSize) {
+        total += static_cast<size_t>(__builtin_popcount(vector(Bytes::load(text + i)).mask()));
+    }
+#else
+    (void)vector;
+#endif
+    for (; i < length; i++) {
+        if (scalar(static_cast<unsigned char>(text[i]))) total++;
+    }
+    return total;
+}
+
+} // namespace detail
+
+// Length of the run of spaces, tabs, \r, \v and \f at the start of text.
+// Newlines end the run.
+inline size_t spaces(const char* text, size_t length) {
+    return detail::findFirst(text, length,
+        [](auto b) { return ~detail::blank(b); },
+        [](unsigned char c) { return !detail::isBlank(c); });
+}
+
+// Length of the run of blanks and newlines at the start of text
+inline size_t blankLines(const char* text, size_t length) {
+    return detail::findFirst(text, length,
+        [](auto b) { return ~(detail::blank(b) | b.eq('\n')); },
+        [](unsigned char c) { return c != '\n' && !detail::isBlank(c); });
+}
+
+// Index of the first newline, or length
+inline size_t lineEnd(const char* text, size_t length) {
+    return detail::findFirst(text, length,
+        [](auto b) { return b.eq('\n'); },
+        [](unsigned char c) { return c == '\n'; });
+}
+
+// Index of the first '"', '\\' or newline, or length
+inline size_t quotedStop(const char* text, size_t length) {
+    return detail::findFirst(text, length,
+        [](auto b) { return b.eq('"') | b.eq('\\') | b.eq('\n'); },
+        [](unsigned char c) { return c == '"' || c == '\\' || c == '\n'; });
+}
+
+// Index of the first '"' or 0xE1 byte, or length. Every rune, the ᛟ and
+// ᛞ delimiters included, is encoded with that lead byte.
+inline size_t quoteOrRune(const char* text, size_t length) {
+    return detail::findFirst(text, length,
+        [](auto b) { return b.eq('"') | b.eq('\xE1'); },
+        [](unsigned char c) { return c == '"' || c == 0xE1; });
+}
+
+// Calls found with the index of every newline, in order
+template <typename Found>
+inline void eachNewline(const char* text, size_t length, Found found) {
+    size_t i = 0;
+#if defined(RUNE_SCAN_SIMD)
+    for (; i + detail::Bytes::kSize <= length; i += detail::Bytes::kSize) {
+        for (uint32_t mask = detail::Bytes::load(text + i).eq('\n').mask(); mask != 0; mask &= mask - 1) {
+            found(i + static_cast<size_t>(__builtin_ctz(mask)));
+        }
+    }
+#endif
+    for (; i < length; i++) {
+        if (text[i] == '\n') found(i);
+    }
+}
+
+inline size_t newlines(const char* text, size_t length) {
+    return detail::count(text, length,
+        [](auto b) { return b.eq('\n'); },
+        [](unsigned char c) { return c == '\n'; });
+}
+
+// Codepoints in valid UTF-8: every byte that is not a continuation byte
+inline size_t codepoints(const char* text, size_t length) {
+    return length - detail::count(text, length,
+        [](auto b) { return b.lt(static_cast<char>(0xC0)); },
+        [](unsigned char c) { return (c & 0xC0) == 0x80; });
+}
+
+} // namespace scan
+
+} // namespace RuneLang
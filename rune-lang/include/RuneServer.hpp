@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "RuneParser.hpp"
+#include "RuneThreadPool.hpp"
+
+namespace RuneLang {
+
+class RuneCache;
+
+// A compile request sent to runed. Messages on the socket are a 12-byte
+// header (magic, kind, flags, payload length) and the payload, in host
+// byte order since both ends are on the same machine.
+struct RuneServerRequest {
+    enum class Command : uint8_t {
+        Cpp,       // The file compileToCpp writes
+        Bytecode,  // A .runec module
+        Check      // Every syntax error, as checkSyntax finds them
+    };
+
+    Command command = Command::Cpp;
+    bool isPath = false;    // payload names a file for the server to read
+    bool optimize = true;
+    std::string payload;    // Source text, or an absolute path
+};
+
+struct RuneServerResponse {
+    enum class Status : uint8_t {
+        Ok,
+        ParseError,  // payload holds diagnostics(), one per line
+        Error        // payload is the message of the RuneError
+    };
+
+    Status status = Status::Ok;
+    std::string payload;
+
+    // The syntax errors of a ParseError response
+    std::vector<RuneParseError> diagnostics() const;
+};
+
+// Long-lived compile server on a Unix domain socket. Each worker of the
+// pool keeps its own RuneParser, and all share the compile cache, so a
+// request pays none of the startup a runec process would. Every request is
+// a program of its own: its symbols are numbered afresh, so ids mean
+// nothing across requests, and only the memory of the symbol table and
+// work arena carries over from one request to the next.
+//
+// A connection may carry any number of requests. run() watches every idle
+// connection with poll and reads requests itself; only a complete request
+// is handed to a worker, which compiles it, writes the response and gives
+// the connection back. Idle or slow clients therefore never hold a worker,
+// however many of them stay connected.
+class RuneServer {
+public:
+    // Binds socketPath, owner-only. A socket file left by a server that is
+    // no longer running is replaced; throws RuneError if one is live.
+    RuneServer(const std::string& socketPath, size_t threads, RuneCache* cache = nullptr);
+    ~RuneServer();
+
+    RuneServer(const RuneServer&) = delete;
+    RuneServer& operator=(const RuneServer&) = delete;
+
+    // Accept connections and serve their requests until stop(). Requests
+    // already being compiled then are answered; every connection is closed.
+    void run();
+
+    // Make run() return. Async-signal-safe.
+    void stop();
+
+    size_t requestsServed() const { return served_; }
+    const std::string& socketPath() const { return socketPath_; }
+
+    // $XDG_RUNTIME_DIR/runed.sock, or /tmp/runed-<uid>.sock
+    static std::string defaultSocketPath();
+
+private:
+    // Owned by the thread in run(). A busy connection has a request with a
+    // worker and is not polled until the worker gives it back.
+    struct Connection {
+        std::string buffer;  // Bytes received but not yet handed to a worker
+        bool busy = false;
+    };
+
+    void receive(int fd, std::vector<char>& chunk);
+    bool dispatch(int fd, Connection& connection);
+    void reclaim();
+    void disconnect(int fd);
+    RuneServerResponse handle(const RuneServerRequest& request, RuneParser& parser);
+
+    std::string socketPath_;
+    int listenFd_;
+    int wakeFds_[2];  // Self-pipe stop() and finished workers write to
+    std::atomic<bool> stopping_;
+    std::vector<RuneParser> parsers_;  // One per worker; the pool is joined before they go
+    RuneThreadPool pool_;
+    std::map<int, Connection> connections_;
+    std::mutex finishedMutex_;
+    std::vector<std::pair<int, bool>> finished_;  // Connections workers are done with, and whether they live on
+    std::atomic<size_t> served_;
+};
+
+// One connection to a RuneServer
+class RuneClient {
+public:
+    // Throws RuneError if no server is listening on socketPath
+    explicit RuneClient(const std::string& socketPath);
+    ~RuneClient();
+
+    RuneClient(const RuneClient&) = delete;
+    RuneClient& operator=(const RuneClient&) = delete;
+
+    // Throws RuneError if the connection fails
+    RuneServerResponse send(const RuneServerRequest& request);
+
+private:
+    int fd_;
+};
+
+} // namespace RuneLang
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace RuneLang {
+
+// Maps lines of generated C++ back to the Rune lines they came from. Each
+// entry covers the C++ lines from its own up to the next entry, which is
+// how statements spread over several lines are attributed.
+//
+// The text form is one line of base64 VLQ numbers, as in JavaScript source
+// maps: for every entry, the change in C++ line and in Rune line since the
+// previous entry. A statement per line costs about two bytes.
+class RuneSourceMap {
+public:
+    struct Entry {
+        uint32_t cppLine;
+        uint32_t runeLine;
+    };
+
+    // Entries are added in increasing C++ line order. One that repeats the
+    // Rune line of the entry before it is dropped.
+    void add(uint32_t cppLine, uint32_t runeLine);
+
+    // Rune line that cppLine came from, 0 if it precedes every entry
+    uint32_t runeLine(uint32_t cppLine) const;
+
+    const std::vector<Entry>& entries() const { return entries_; }
+    void clear() { entries_.clear(); }
+
+    std::string encode() const;
+
+    // Throws RuneError if text is not an encoded map
+    static RuneSourceMap decode(std::string_view text);
+
+    // The encoded map as a file of its own, conventionally next to the
+    // generated code as "<output>.map"
+    void write(const std::string& path) const;
+    static RuneSourceMap read(const std::string& path);
+
+private:
+    std::vector<Entry> entries_;  // Sorted by cppLine
+};
+
+} // namespace RuneLang
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include "RuneArena.hpp"
+#include "RuneHash.hpp"
+
+namespace RuneLang {
+
+// Dense id of an interned string; equal strings have equal ids
+using Symbol = uint32_t;
+constexpr Symbol kNoSymbol = UINT32_MAX;
+
+// Intern table shared by every stage that handles one program. The parser
+// interns each identifier and string literal as it is read, and later
+// stages compare or index by Symbol instead of hashing and copying text.
+//
+// intern() keeps the view it is given, which for names is the source
+// itself, so the table copies nothing; the text must outlive the table or
+// its next clear(). internCopy() is for text built on the fly.
+//
+// Symbols are numbered per program, not per process: the same name may get
+// a different id in the next program, another parser or another thread. A
+// process-wide table would have to copy every name out of sources that are
+// gone after their compile, grow for as long as the process runs, make
+// every thread that parses take a lock per identifier, and stop the
+// bytecode compiler from sizing its per-symbol tables by the program.
+// clear() keeps the slots and text storage, so a parser reused across
+// programs (each runec and runed worker) interns into memory already
+// allocated.
+class RuneSymbolTable {
+public:
+    RuneSymbolTable() : slots_(kInitialSlots), storage_(4 * 1024) {}
+
+    RuneSymbolTable(const RuneSymbolTable&) = delete;
+    RuneSymbolTable& operator=(const RuneSymbolTable&) = delete;
+
+    Symbol intern(std::string_view text) {
+        return insert(text, false);
+    }
+
+    Symbol internCopy(std::string_view text) {
+        return insert(text, true);
+    }
+
+    // kNoSymbol if text was never interned
+    Symbol find(std::string_view text) const {
+        const uint32_t hash = hashOf(text);
+        for (size_t i = hash & (slots_.size() - 1);; i = (i + 1) & (slots_.size() - 1)) {
+            const Slot& slot = slots_[i];
+            if (slot.symbol == 0) return kNoSymbol;
+            if (slot.hash == hash && names_[slot.symbol - 1] == text) return slot.symbol - 1;
+        }
+    }
+
+    std::string_view name(Symbol symbol) const { return names_[symbol]; }
+    size_t size() const { return names_.size(); }
+
+    // Forget every symbol but keep the memory for the next program
+    void clear() {
+        names_.clear();
+        std::fill(slots_.begin(), slots_.end(), Slot());
+        storage_.reset();
+    }
+
+private:
+    static constexpr size_t kInitialSlots = 1024;  // Power of two
+
+    static uint32_t hashOf(std::string_view text) {
+        return static_cast<uint32_t>(hashBytes(text));
+    }
+
+    Symbol insert(std::string_view text, bool copy) {
+        const uint32_t hash = hashOf(text);
+        size_t i = hash & (slots_.size() - 1);
+        for (;; i = (i + 1) & (slots_.size() - 1)) {
+            const Slot& slot = slots_[i];
+            if (slot.symbol == 0) break;
+            if (slot.hash == hash && names_[slot.symbol - 1] == text) return slot.symbol - 1;
+        }
+
+        if (copy && !text.empty()) {
+            char* owned = static_cast<char*>(storage_.allocate(text.size(), 1));
+            std::memcpy(owned, text.data(), text.size());
+            text = std::string_view(owned, text.size());
+        }
+        const Symbol symbol = static_cast<Symbol>(names_.size());
+        names_.push_back(text);
+        slots_[i] = Slot{hash, symbol + 1};
+
+        // Kept at most half full so probe runs stay short
+        if (names_.size() * 2 > slots_.size()) grow();
+        return symbol;
+    }
+
+    void grow() {
+        std::vector<Slot> old(slots_.size() * 2);
+        old.swap(slots_);
+        for (const Slot& slot : old) {
+            if (slot.symbol == 0) continue;
+            size_t i = slot.hash & (slots_.size() - 1);
+            while (slots_[i].symbol != 0) i = (i + 1) & (slots_.size() - 1);
+            slots_[i] = slot;
+        }
+    }
+
+    // The hash sits beside the id so most mismatches never touch the text,
+    // and growing never rehashes it
+    struct Slot {
+        uint32_t hash = 0;
+        uint32_t symbol = 0;  // Symbol + 1, or 0 when empty
+    };
+
+    std::vector<Slot> slots_;
+    std::vector<std::string_view> names_;
+    RuneArena storage_;  // Text of internCopy
+};
+
+} // namespace RuneLang
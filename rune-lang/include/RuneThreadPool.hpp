@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RuneLang {
+
+// Fixed-size pool where every worker owns a task deque. Workers take their
+// own newest task first and steal the oldest task of another worker when
+// they run dry, so uneven jobs (one huge script among many small ones)
+// do not leave threads idle.
+class RuneThreadPool {
+public:
+    // Tasks receive the index of the worker running them, which callers use
+    // to pick per-worker state such as a dedicated RuneParser
+    using Task = std::function<void(size_t worker)>;
+
+    explicit RuneThreadPool(size_t threads = std::thread::hardware_concurrency());
+    ~RuneThreadPool();
+
+    RuneThreadPool(const RuneThreadPool&) = delete;
+    RuneThreadPool& operator=(const RuneThreadPool&) = delete;
+
+    void submit(Task task);
+
+    // Block until every submitted task has finished. Rethrows the first
+    // exception that escaped a task.
+    void wait();
+
+    size_t size() const { return threads_.size(); }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(size_t index);
+    bool popLocal(size_t index, Task& task);
+    bool steal(size_t index, Task& task);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::mutex stateMutex_;
+    std::condition_variable workAvailable_;
+    std::condition_variable allDone_;
+    std::atomic<size_t> queued_;
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> nextQueue_;
+    std::exception_ptr firstError_;
+    bool stopping_;
+};
+
+} // namespace RuneLang
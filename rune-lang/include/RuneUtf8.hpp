@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace RuneLang {
+
+// Unicode Runic block (U+16A0 - U+16FF)
+constexpr char32_t kRunicBlockStart = 0x16A0;
+constexpr size_t kRunicBlockSize = 0x60;
+
+// Returned for malformed or truncated UTF-8 sequences
+constexpr char32_t kInvalidCodepoint = 0xFFFD;
+
+inline bool isRunic(char32_t codepoint) {
+    return codepoint - kRunicBlockStart < kRunicBlockSize;
+}
+
+// Decode the codepoint starting at pos and advance pos past it.
+// Malformed input yields kInvalidCodepoint and consumes a single byte.
+inline char32_t decodeUtf8(std::string_view text, size_t& pos) {
+    const unsigned char lead = static_cast<unsigned char>(text[pos]);
+    if (lead < 0x80) {
+        pos++;
+        return lead;
+    }
+
+    size_t length;
+    char32_t codepoint;
+    if ((lead & 0xE0) == 0xC0) {
+        length = 2;
+        codepoint = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 3;
+        codepoint = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 4;
+        codepoint = lead & 0x07;
+    } else {
+        pos++;
+        return kInvalidCodepoint;
+    }
+
+    if (pos + length > text.size()) {
+        pos++;
+        return kInvalidCodepoint;
+    }
+
+    for (size_t i = 1; i < length; i++) {
+        const unsigned char next = static_cast<unsigned char>(text[pos + i]);
+        if ((next & 0xC0) != 0x80) {
+            pos++;
+            return kInvalidCodepoint;
+        }
+        codepoint = (codepoint << 6) | (next & 0x3F);
+    }
+
+    pos += length;
+    return codepoint;
+}
+
+} // namespace RuneLang
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "RuneBytecode.hpp"
+#include "RuneValue.hpp"
+
+namespace RuneLang {
+
+// Error raised while a script runs, carrying the source line it stopped at
+class RuneRuntimeError : public std::runtime_error {
+public:
+    explicit RuneRuntimeError(const std::string& message, size_t line = 0)
+        : std::runtime_error(line ? "Line " + std::to_string(line) + ": " + message : message),
+          message_(message),
+          line_(line) {}
+
+    const std::string& getMessage() const { return message_; }
+    size_t getLine() const { return line_; }
+
+private:
+    std::string message_;
+    size_t line_;
+};
+
+class RuneVM;
+class RuneModuleFile;
+
+// Host function reachable from scripts through CallNative
+using RuneNative = Value (*)(RuneVM& vm, const Value* args, int count);
+
+// Register interpreter for Bytecode::Module. Dispatch is direct threaded
+// (computed goto) where the compiler supports it, with a plain switch loop
+// as the portable fallback.
+class RuneVM {
+public:
+    enum class Dispatch {
+        Threaded,
+        Switch
+    };
+
+    explicit RuneVM(std::ostream& out = std::cout, std::istream& in = std::cin);
+    ~RuneVM();
+
+    RuneVM(const RuneVM&) = delete;
+    RuneVM& operator=(const RuneVM&) = delete;
+
+    // Take ownership of module and bind its host functions. Globals and
+    // strings from a previously loaded module are released.
+    void load(Bytecode::Module module);
+
+    // Run a precompiled module straight from its mapping, which is kept
+    // alive until the next load
+    void load(std::shared_ptr<const RuneModuleFile> file);
+
+    // Execute the top-level code of the loaded module
+    void run();
+
+    static bool threadedDispatchAvailable();
+    void setDispatch(Dispatch dispatch) { dispatch_ = dispatch; }
+
+    const Bytecode::Image& module() const { return module_; }
+    Value global(std::string_view name) const;
+
+    // Services for host functions
+    Value makeString(std::string text);
+    std::string toString(Value value) const;
+    std::ostream& output() { return out_; }
+    void* allocate(size_t size);
+    bool release(void* block);
+    [[noreturn]] void error(const std::string& message) const;
+
+private:
+    struct Frame {
+        const Bytecode::Instruction* returnPc;
+        Value* base;
+    };
+
+    template <bool Threaded>
+    void execute();
+
+    // Slow paths kept out of the dispatch loop
+    Value arithmetic(Bytecode::Op op, Value a, Value b);
+    bool equals(Value a, Value b) const;
+    Value getIndex(Value base, Value index);
+    void setIndex(Value base, Value index, Value value);
+    Value input(Bytecode::InputKind kind);
+
+    void reset();
+    void bind();
+    size_t currentLine() const;
+
+    std::ostream& out_;
+    std::istream& in_;
+    Dispatch dispatch_;
+
+    Bytecode::Image module_;                      // What runs: owned_ or a mapped file
+    Bytecode::Module owned_;
+    std::shared_ptr<const RuneModuleFile> mapped_;
+    std::vector<Value> constants_;
+    std::vector<Value> globals_;
+    std::vector<RuneNative> natives_;
+    std::vector<Value> stack_;
+    std::vector<Frame> frames_;
+
+    // Strings live until the next load; scripts are short-lived rituals
+    std::deque<std::string> strings_;
+    std::unordered_map<void*, size_t> allocations_;
+
+    const Bytecode::Instruction* pc_;  // Saved for error reporting
+};
+
+} // namespace RuneLang
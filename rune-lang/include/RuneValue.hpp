@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace RuneLang {
+
+// A RuneVM value in 8 bytes. Doubles are stored as themselves; every other
+// type lives in the payload of a negative quiet NaN whose top 16 bits name
+// the type. Real NaNs are canonicalised to the positive quiet NaN, so they
+// never collide with a tag.
+//
+//   0xFFF9  nil, false, true      payload 0, 1, 2
+//   0xFFFA  integer               48-bit two's complement
+//   0xFFFB  string                const std::string* owned by the VM
+//   0xFFFC  pointer               memory handed out by allocateMemory
+//   0xFFFD  function              index into Module::functions
+class Value {
+public:
+    static constexpr int64_t kMaxInt = (int64_t(1) << 47) - 1;
+    static constexpr int64_t kMinInt = -(int64_t(1) << 47);
+
+    Value() : bits_(kNil) {}
+
+    static Value nil() { return Value(kNil); }
+    static Value boolean(bool value) { return Value(value ? kTrue : kFalse); }
+
+    // Integers outside 48 bits degrade to doubles
+    static Value integer(int64_t value) {
+        if (value < kMinInt || value > kMaxInt) return number(static_cast<double>(value));
+        return Value(kIntTag | (static_cast<uint64_t>(value) & kPayloadMask));
+    }
+
+    static Value number(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        if (value != value) bits = kCanonicalNaN;
+        return Value(bits);
+    }
+
+    static Value string(const std::string* value) {
+        return Value(kStringTag | reinterpret_cast<uint64_t>(value));
+    }
+
+    static Value pointer(void* value) {
+        return Value(kPointerTag | reinterpret_cast<uint64_t>(value));
+    }
+
+    static Value function(uint32_t index) {
+        return Value(kFunctionTag | index);
+    }
+
+    bool isNumber() const { return (bits_ >> 48) < (kNil >> 48); }
+    bool isNil() const { return bits_ == kNil; }
+    bool isBool() const { return bits_ == kTrue || bits_ == kFalse; }
+    bool isInt() const { return (bits_ & kTagMask) == kIntTag; }
+    bool isString() const { return (bits_ & kTagMask) == kStringTag; }
+    bool isPointer() const { return (bits_ & kTagMask) == kPointerTag; }
+    bool isFunction() const { return (bits_ & kTagMask) == kFunctionTag; }
+
+    // Integers, doubles and bools all take part in arithmetic, as in C++
+    bool isNumeric() const { return isNumber() || isInt() || isBool(); }
+
+    bool asBool() const { return bits_ == kTrue; }
+    int64_t asInt() const { return static_cast<int64_t>(bits_ << 16) >> 16; }
+    const std::string* asString() const { return reinterpret_cast<const std::string*>(bits_ & kPayloadMask); }
+    void* asPointer() const { return reinterpret_cast<void*>(bits_ & kPayloadMask); }
+    uint32_t asFunction() const { return static_cast<uint32_t>(bits_); }
+
+    double asNumber() const {
+        double value;
+        std::memcpy(&value, &bits_, sizeof(value));
+        return value;
+    }
+
+    // Numeric value of an int, bool or double
+    double toDouble() const {
+        if (isInt()) return static_cast<double>(asInt());
+        if (isBool()) return asBool() ? 1.0 : 0.0;
+        return asNumber();
+    }
+
+    int64_t toInt() const {
+        if (isInt()) return asInt();
+        if (isBool()) return asBool() ? 1 : 0;
+        return static_cast<int64_t>(asNumber());
+    }
+
+    bool truthy() const {
+        if (isNumber()) return asNumber() != 0.0;
+        if (isInt()) return asInt() != 0;
+        return bits_ != kNil && bits_ != kFalse;
+    }
+
+    uint64_t bits() const { return bits_; }
+    bool operator==(const Value& other) const { return bits_ == other.bits_; }
+    bool operator!=(const Value& other) const { return bits_ != other.bits_; }
+
+    const char* typeName() const {
+        if (isNumber()) return "number";
+        if (isInt()) return "integer";
+        if (isBool()) return "bool";
+        if (isString()) return "string";
+        if (isPointer()) return "pointer";
+        if (isFunction()) return "function";
+        return "nil";
+    }
+
+private:
+    explicit Value(uint64_t bits) : bits_(bits) {}
+
+    static constexpr uint64_t kTagMask = 0xFFFF000000000000ULL;
+    static constexpr uint64_t kPayloadMask = 0x0000FFFFFFFFFFFFULL;
+    static constexpr uint64_t kCanonicalNaN = 0x7FF8000000000000ULL;
+    static constexpr uint64_t kNil = 0xFFF9000000000000ULL;
+    static constexpr uint64_t kFalse = kNil | 1;
+    static constexpr uint64_t kTrue = kNil | 2;
+    static constexpr uint64_t kIntTag = 0xFFFA000000000000ULL;
+    static constexpr uint64_t kStringTag = 0xFFFB000000000000ULL;
+    static constexpr uint64_t kPointerTag = 0xFFFC000000000000ULL;
+    static constexpr uint64_t kFunctionTag = 0xFFFD000000000000ULL;
+
+    uint64_t bits_;
+};
+
+static_assert(sizeof(Value) == 8, "Value must stay one machine word");
+
+} // namespace RuneLang
@@ -1,4 +1,8 @@
 #include "GhostTerminal.hpp"
+#include "RuneError.hpp"
+#include "RuneFile.hpp"
+#include "RuneModule.hpp"
+#include "RuneVM.hpp"
 #include <iostream>
 #include <sstream>
 #include <thread>
@@ -9,6 +13,7 @@
 #include <algorithm>
 #include <unordered_map>
 #include <cmath>
+#include <filesystem>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
@@ -158,6 +163,20 @@ void GhostTerminal::registerRuneCommands() {
             }
         });
 
+    // Execution Runes
+    registerCommand("invoke", "ᛖ", "Run a rune script in place", RuneCategory::EXECUTION,
+        [this](const auto& args) {
+            if (args.empty()) {
+                std::cout << "Usage: invoke [-n] <script.rune>" << std::endl;
+                return;
+            }
+            if (args[0] == "-n" && args.size() > 1) {
+                runNativeScript(args[1]);
+            } else {
+                runRuneScript(args[0]);
+            }
+        });
+
     // System Operations
     registerCommand("process", "ᛟ", "Process manipulation ritual", RuneCategory::SYSTEM,
         [this](const auto& args) {
@@ -387,6 +406,74 @@ void GhostTerminal::openRuneEditor(const std::string& filename) {
     std::cout << "Opening editor for file: " << filename << std::endl;
 }
 
+// Scripts run on RuneVM inside the terminal process, so there is no C++
+// compiler or child process between typing the command and the output
+namespace {
+
+// Native objects are per user: loading one runs it with the terminal's rights
+std::string nativeDirectory() {
+    const char* cache = std::getenv("XDG_CACHE_HOME");
+    if (cache && *cache) return std::string(cache) + "/rune/native";
+    const char* home = std::getenv("HOME");
+    if (home && *home) return std::string(home) + "/.cache/rune/native";
+    return (std::filesystem::temp_directory_path() / ("rune-native-" + std::to_string(getuid()))).string();
+}
+
+// A .runec beside the script (see runec -b) is used when it was compiled
+// from this exact source, so the script runs without being parsed
+std::shared_ptr<const RuneModuleFile> loadPrecompiled(const std::string& path, std::string_view source) {
+    const std::string modulePath = std::filesystem::path(path).replace_extension(".runec").string();
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(modulePath, ec)) return nullptr;
+    try {
+        auto module = std::make_shared<const RuneModuleFile>(modulePath);
+        if (module->sourceHash() == runeSourceHash(source)) return module;
+    } catch (const RuneError&) {
+        // Unreadable or from another build: fall back to the source
+    }
+    return nullptr;
+}
+
+} // namespace
+
+void GhostTerminal::runRuneScript(const std::string& path) {
+    try {
+        RuneVM vm;
+        if (std::filesystem::path(path).extension() == ".runec") {
+            vm.load(std::make_shared<const RuneModuleFile>(path));
+        } else {
+            const RuneMappedFile source(path);
+            std::shared_ptr<const RuneModuleFile> compiled = loadPrecompiled(path, source.view());
+            if (compiled) {
+                vm.load(std::move(compiled));
+            } else {
+                RuneParser parser;
+                vm.load(parser.compileToBytecode(source.view()));
+            }
+        }
+        vm.run();
+        std::cout << std::flush;
+    } catch (const std::exception& e) {
+        // Parse, runtime and file errors all carry their position in what()
+        std::cout << "\033[31m" << path << ": " << e.what() << "\033[0m" << std::endl;
+    }
+}
+
+// invoke -n compiles the script to a shared object and runs it in process.
+// The script stays loaded between invokes and is recompiled only when the
+// file changes, so repeated rituals run at native speed.
+void GhostTerminal::runNativeScript(const std::string& path) {
+    try {
+        if (!jit) jit = std::make_unique<RuneJit>(nativeDirectory());
+        std::unique_ptr<RuneNativeScript>& script = nativeScripts[path];
+        if (!script) script = std::make_unique<RuneNativeScript>(*jit, path);
+        script->run();
+        std::cout << std::flush;
+    } catch (const std::exception& e) {
+        std::cout << "\033[31m" << path << ": " << e.what() << "\033[0m" << std::endl;
+    }
+}
+
 void GhostTerminal::displayRunicBorder() {
     struct winsize w;
     ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
@@ -0,0 +1,181 @@
+#include "../include/RuneBuiltins.hpp"
+#include "../include/RuneSystem.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/sysinfo.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+namespace RuneLang {
+
+namespace {
+
+const std::string& stringArg(RuneVM& vm, const Value* args, int count, int index, const char* function) {
+    if (index >= count || !args[index].isString()) {
+        vm.error(std::string(function) + " expects a string as argument " + std::to_string(index + 1));
+    }
+    return *args[index].asString();
+}
+
+int64_t intArg(RuneVM& vm, const Value* args, int count, int index, const char* function) {
+    if (index >= count || !args[index].isNumeric()) {
+        vm.error(std::string(function) + " expects a number as argument " + std::to_string(index + 1));
+    }
+    return args[index].toInt();
+}
+
+// Memory
+
+Value allocateMemory(RuneVM& vm, const Value* args, int count) {
+    const int64_t size = intArg(vm, args, count, 0, "allocateMemory");
+    if (size <= 0) vm.error("allocateMemory expects a positive size");
+    void* block = vm.allocate(static_cast<size_t>(size));
+    return block ? Value::pointer(block) : Value::nil();
+}
+
+Value freeMemory(RuneVM& vm, const Value* args, int count) {
+    if (count < 1 || !args[0].isPointer()) vm.error("freeMemory expects a block from allocateMemory");
+    return Value::boolean(vm.release(args[0].asPointer()));
+}
+
+Value memoryUsage(RuneVM&, const Value*, int) {
+    return Value::integer(static_cast<int64_t>(RuneMemory::getUsage()));
+}
+
+// Files
+
+Value createFile(RuneVM& vm, const Value* args, int count) {
+    const std::string& path = stringArg(vm, args, count, 0, "createFile");
+    const std::string content = count > 1 ? vm.toString(args[1]) : std::string();
+    return Value::boolean(RuneFileSystem::createFile(path, content));
+}
+
+Value writeFile(RuneVM& vm, const Value* args, int count) {
+    const std::string& path = stringArg(vm, args, count, 0, "writeFile");
+    if (count < 2) vm.error("writeFile expects a path and the content to write");
+    return Value::boolean(RuneFileSystem::createFile(path, vm.toString(args[1])));
+}
+
+Value readFile(RuneVM& vm, const Value* args, int count) {
+    std::ifstream file(stringArg(vm, args, count, 0, "readFile"), std::ios::binary);
+    if (!file) return Value::nil();
+    std::ostringstream content;
+    content << file.rdbuf();
+    return vm.makeString(content.str());
+}
+
+Value deleteFile(RuneVM& vm, const Value* args, int count) {
+    return Value::boolean(RuneFileSystem::deleteFile(stringArg(vm, args, count, 0, "deleteFile")));
+}
+
+Value createDirectory(RuneVM& vm, const Value* args, int count) {
+    return Value::boolean(RuneFileSystem::createDirectory(stringArg(vm, args, count, 0, "createDirectory")));
+}
+
+Value deleteDirectory(RuneVM& vm, const Value* args, int count) {
+    return Value::boolean(RuneFileSystem::deleteDirectory(stringArg(vm, args, count, 0, "deleteDirectory")));
+}
+
+Value getFileSize(RuneVM& vm, const Value* args, int count) {
+    struct stat info;
+    if (stat(stringArg(vm, args, count, 0, "getFileSize").c_str(), &info) != 0) {
+        return Value::integer(-1);
+    }
+    return Value::integer(static_cast<int64_t>(info.st_size));
+}
+
+Value getLastModified(RuneVM& vm, const Value* args, int count) {
+    struct stat info;
+    if (stat(stringArg(vm, args, count, 0, "getLastModified").c_str(), &info) != 0) {
+        return Value::integer(-1);
+    }
+    return Value::integer(static_cast<int64_t>(info.st_mtime));
+}
+
+// System information
+
+Value getHostname(RuneVM& vm, const Value*, int) {
+    char name[256] = {};
+    if (gethostname(name, sizeof(name) - 1) != 0) return Value::nil();
+    return vm.makeString(name);
+}
+
+Value getOSVersion(RuneVM& vm, const Value*, int) {
+    struct utsname info;
+    if (uname(&info) != 0) return Value::nil();
+    return vm.makeString(std::string(info.sysname) + " " + info.release);
+}
+
+Value getCPUCount(RuneVM&, const Value*, int) {
+    return Value::integer(std::max<long>(sysconf(_SC_NPROCESSORS_ONLN), 1));
+}
+
+Value getTotalMemory(RuneVM&, const Value*, int) {
+    struct sysinfo info;
+    if (sysinfo(&info) != 0) return Value::nil();
+    return Value::integer(static_cast<int64_t>(info.totalram) * info.mem_unit);
+}
+
+Value getAvailableMemory(RuneVM&, const Value*, int) {
+    struct sysinfo info;
+    if (sysinfo(&info) != 0) return Value::nil();
+    return Value::integer(static_cast<int64_t>(info.freeram) * info.mem_unit);
+}
+
+Value getUptime(RuneVM&, const Value*, int) {
+    struct sysinfo info;
+    if (sysinfo(&info) != 0) return Value::nil();
+    return Value::integer(info.uptime);
+}
+
+// Milliseconds, as in the examples
+Value sleepFor(RuneVM& vm, const Value* args, int count) {
+    const int64_t milliseconds = intArg(vm, args, count, 0, "sleep");
+    if (milliseconds > 0) usleep(static_cast<useconds_t>(milliseconds) * 1000);
+    return Value::nil();
+}
+
+struct Builtin {
+    std::string_view name;
+    RuneNative function;
+};
+
+// Sorted by name for binary search
+const Builtin kBuiltins[] = {
+    {"RuneFileSystem::createDirectory", createDirectory},
+    {"RuneFileSystem::createFile", createFile},
+    {"RuneFileSystem::deleteDirectory", deleteDirectory},
+    {"RuneFileSystem::deleteFile", deleteFile},
+    {"RuneFileSystem::getFileSize", getFileSize},
+    {"RuneFileSystem::getLastModified", getLastModified},
+    {"RuneFileSystem::readFile", readFile},
+    {"RuneFileSystem::writeFile", writeFile},
+    {"RuneSystem::getAvailableMemory", getAvailableMemory},
+    {"RuneSystem::getCPUCount", getCPUCount},
+    {"RuneSystem::getHostname", getHostname},
+    {"RuneSystem::getMemoryUsage", memoryUsage},
+    {"RuneSystem::getOSVersion", getOSVersion},
+    {"RuneSystem::getTotalMemory", getTotalMemory},
+    {"RuneSystem::getUptime", getUptime},
+    {"RuneSystem::sleep", sleepFor},
+    {"allocateMemory", allocateMemory},
+    {"createFile", createFile},
+    {"deleteFile", deleteFile},
+    {"freeMemory", freeMemory},
+    {"readFile", readFile},
+    {"writeFile", writeFile},
+};
+
+} // namespace
+
+RuneNative findBuiltin(std::string_view name) {
+    const Builtin* end = std::end(kBuiltins);
+    const Builtin* it = std::lower_bound(std::begin(kBuiltins), end, name, [](const Builtin& builtin, std::string_view key) {
+        return builtin.name < key;
+    });
+    return it != end && it->name == name ? it->function : nullptr;
+}
+
+} // namespace RuneLang
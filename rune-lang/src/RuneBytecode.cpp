@@ -0,0 +1,1082 @@
+#include "../include/RuneBytecode.hpp"
+#include "../include/RuneParser.hpp"
+#include "../include/RuneLineIndex.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace RuneLang {
+
+namespace Bytecode {
+
+uint32_t Image::lineAt(size_t pc) const {
+    auto it = std::upper_bound(lines.begin(), lines.end(), pc, [](size_t value, const LineEntry& entry) {
+        return value < entry.pc;
+    });
+    return it == lines.begin() ? 0 : (it - 1)->line;
+}
+
+namespace {
+
+template <typename T>
+Table<T> tableOf(const std::vector<T>& items) {
+    return Table<T>{items.data(), static_cast<uint32_t>(items.size())};
+}
+
+} // namespace
+
+Image Module::image() const {
+    return Image{tableOf(code), tableOf(constants), tableOf(functions), tableOf(globals),
+                 tableOf(natives), tableOf(lines), strings};
+}
+
+const char* opName(Op op) {
+    static const char* const names[] = {
+        "Move", "LoadK", "LoadInt", "LoadNil", "LoadBool", "GetGlobal", "SetGlobal",
+        "Add", "Sub", "Mul", "Div", "Mod", "Shl", "Shr", "BitAnd", "BitOr", "BitXor",
+        "Less", "LessEq", "Equal", "NotEqual",
+        "Negate", "Not", "BitNot", "ToBool", "ToFloat",
+        "GetIndex", "SetIndex",
+        "Jump", "JumpIfFalse", "JumpIfTrue",
+        "Call", "CallNative", "Return", "ReturnNil",
+        "Print", "Input",
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(Op::Count),
+                  "every opcode needs a name");
+    return op < Op::Count ? names[static_cast<size_t>(op)] : "???";
+}
+
+} // namespace Bytecode
+
+namespace {
+
+using namespace Ast;
+using namespace Bytecode;
+
+bool isFloatType(char32_t rune) {
+    return rune == U'ᛚ' || rune == U'ᛦ' || rune == U'ᛠ';
+}
+
+InputKind inputKindFor(char32_t rune) {
+    if (isFloatType(rune)) return InputKind::Number;
+    if (rune == U'ᛡ') return InputKind::Boolean;
+    return InputKind::Text;
+}
+
+// Resolve the escapes the C++ backend leaves for the C++ compiler
+std::string unescape(std::string_view text) {
+    std::string out;
+    out.reserve(text.size());
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] != '\\' || i + 1 == text.size()) {
+            out += text[i];
+            continue;
+        }
+        switch (text[++i]) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case '0': out += '\0'; break;
+            case 'a': out += '\a'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'v': out += '\v'; break;
+            default: out += text[i]; break;
+        }
+    }
+    return out;
+}
+
+class BytecodeCompiler {
+public:
+    Module compile(const Program& program) {
+        lines_.reset(program.source);
+        globals_.assign(program.symbols->size(), Global{});
+        literalConstants_.assign(program.symbols->size(), kNoConstant);
+        FunctionState script;
+        fn_ = &script;
+        module_.functions.emplace_back();
+
+        // Functions are hoisted so they can be called before (and from)
+        // each other, as with the forward declarations C++ would need
+        for (const Stmt* stmt : program.body) {
+            if (const auto* decl = as<FunctionDecl>(stmt)) {
+                const uint32_t index = static_cast<uint32_t>(module_.functions.size());
+                module_.functions.emplace_back();
+                pending_.push_back({decl, index});
+
+                Constant constant;
+                constant.kind = ConstantKind::Function;
+                constant.function = index;
+                setLine(decl);
+                emitABx(Op::LoadK, 0, addConstant(decl, constant));
+                emitABx(Op::SetGlobal, 0, globalSlot(decl, decl->symbol, decl->name, 0));
+                fn_->maxReg = std::max(fn_->maxReg, 1);
+            }
+        }
+
+        for (const Stmt* stmt : program.body) {
+            statement(stmt);
+        }
+        emit(encodeABC(Op::ReturnNil, 0, 0, 0));
+
+        finish(script, 0, "<script>", 0);
+
+        for (const auto& [decl, index] : pending_) {
+            function(decl, index);
+        }
+        return std::move(module_);
+    }
+
+private:
+    struct Local {
+        Symbol symbol;
+        uint8_t reg;
+        char32_t typeRune;
+        int depth;
+    };
+
+    struct Global {
+        bool defined = false;
+        uint16_t slot = 0;
+        char32_t typeRune = 0;
+    };
+
+    static constexpr int32_t kNoConstant = -1;
+
+    struct FunctionState {
+        std::vector<Instruction> code;
+        std::vector<LineEntry> lines;  // pc relative to this function
+        std::vector<Local> locals;
+        int depth = 0;
+        int freeReg = 0;
+        int maxReg = 0;
+        char32_t returnRune = 0;
+        bool isScript = true;
+    };
+
+    struct Target {
+        bool local;
+        uint8_t reg;
+        uint16_t slot;
+        char32_t typeRune;
+    };
+
+    Module module_;
+    RuneLineIndex lines_;
+    FunctionState* fn_ = nullptr;
+    std::vector<std::pair<const FunctionDecl*, uint32_t>> pending_;
+    // Indexed by the program's symbols
+    std::vector<Global> globals_;
+    std::vector<int32_t> literalConstants_;
+
+    // Text stored in module_.strings, and what refers to it by symbol
+    RuneSymbolTable strings_;
+    std::vector<uint32_t> stringOffsets_;
+    std::vector<int32_t> stringConstants_;
+
+    std::unordered_map<uint64_t, uint8_t> natives_;  // See nativeKey
+    std::unordered_map<int64_t, uint16_t> intConstants_;
+    std::unordered_map<uint64_t, uint16_t> floatConstants_;
+
+    [[noreturn]] void error(const Node* at, const std::string& message) const {
+        throw RuneParseError(message, at ? lines_.line(at->offset) : 0);
+    }
+
+    // -----------------------------------------------------------------------
+    // Module tables
+
+    Symbol stringSymbol(std::string_view text) {
+        const Symbol symbol = strings_.internCopy(text);
+        if (symbol == stringOffsets_.size()) {
+            stringOffsets_.push_back(static_cast<uint32_t>(module_.strings.size()));
+            stringConstants_.push_back(kNoConstant);
+            module_.strings.append(text.data(), text.size());
+        }
+        return symbol;
+    }
+
+    StringRef intern(std::string_view text) {
+        return StringRef{stringOffsets_[stringSymbol(text)], static_cast<uint32_t>(text.size())};
+    }
+
+    uint16_t addConstant(const Node* at, const Constant& constant) {
+        if (module_.constants.size() > UINT16_MAX) {
+            error(at, "Too many constants in one module");
+        }
+        module_.constants.push_back(constant);
+        return static_cast<uint16_t>(module_.constants.size() - 1);
+    }
+
+    uint16_t intConstant(const Node* at, int64_t value) {
+        auto it = intConstants_.find(value);
+        if (it != intConstants_.end()) return it->second;
+        Constant constant;
+        constant.kind = ConstantKind::Int;
+        constant.integer = value;
+        return intConstants_[value] = addConstant(at, constant);
+    }
+
+    uint16_t floatConstant(const Node* at, double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        auto it = floatConstants_.find(bits);
+        if (it != floatConstants_.end()) return it->second;
+        Constant constant;
+        constant.kind = ConstantKind::Float;
+        constant.number = value;
+        return floatConstants_[bits] = addConstant(at, constant);
+    }
+
+    uint16_t stringConstant(const Node* at, std::string_view value) {
+        const Symbol symbol = stringSymbol(value);
+        if (stringConstants_[symbol] != kNoConstant) return static_cast<uint16_t>(stringConstants_[symbol]);
+        Constant constant;
+        constant.kind = ConstantKind::String;
+        constant.string = StringRef{stringOffsets_[symbol], static_cast<uint32_t>(value.size())};
+        const uint16_t index = addConstant(at, constant);
+        stringConstants_[symbol] = index;
+        return index;
+    }
+
+    // Each distinct literal is decoded once; spellings that decode to the
+    // same text share a constant
+    uint16_t literalConstant(const StringLiteral* literal) {
+        int32_t& index = literalConstants_[literal->symbol];
+        if (index == kNoConstant) {
+            index = literal->text.find('\\') == std::string_view::npos
+                        ? stringConstant(literal, literal->text)
+                        : stringConstant(literal, unescape(literal->text));
+        }
+        return static_cast<uint16_t>(index);
+    }
+
+    uint16_t globalSlot(const Node* at, Symbol symbol, std::string_view name, char32_t typeRune) {
+        Global& global = globals_[symbol];
+        if (global.defined) {
+            if (typeRune) global.typeRune = typeRune;
+            return global.slot;
+        }
+        if (module_.globals.size() > UINT16_MAX) {
+            error(at, "Too many global variables");
+        }
+        global = Global{true, static_cast<uint16_t>(module_.globals.size()), typeRune};
+        module_.globals.push_back(intern(name));
+        return global.slot;
+    }
+
+    // Builtins are told apart by their rune, scoped calls by their prefix
+    // rune and the symbol of their name
+    static uint64_t nativeKey(char32_t rune, Symbol symbol) {
+        return static_cast<uint64_t>(rune) << 32 | symbol;
+    }
+
+    uint8_t nativeIndex(const Node* at, uint64_t key, std::string_view scope, std::string_view name) {
+        auto it = natives_.find(key);
+        if (it != natives_.end()) return it->second;
+        if (module_.natives.size() > UINT8_MAX) {
+            error(at, "Too many distinct host functions in one module");
+        }
+        std::string fullName(scope);
+        fullName += name;
+        module_.natives.push_back(intern(fullName));
+        return natives_[key] = static_cast<uint8_t>(module_.natives.size() - 1);
+    }
+
+    // -----------------------------------------------------------------------
+    // Emission
+
+    size_t pc() const { return fn_->code.size(); }
+
+    size_t emit(Instruction instruction) {
+        fn_->code.push_back(instruction);
+        return fn_->code.size() - 1;
+    }
+
+    void emitABC(Op op, int a, int b, int c) {
+        emit(encodeABC(op, static_cast<uint8_t>(a), static_cast<uint8_t>(b), static_cast<uint8_t>(c)));
+    }
+
+    void emitABx(Op op, int a, uint16_t bx) {
+        emit(encodeABx(op, static_cast<uint8_t>(a), bx));
+    }
+
+    void emitMove(int to, int from) {
+        if (to != from) emitABC(Op::Move, to, from, 0);
+    }
+
+    void setLine(const Node* node) {
+        std::vector<LineEntry>& lines = fn_->lines;
+        const uint32_t at = static_cast<uint32_t>(pc());
+        const uint32_t line = lines_.line(node->offset);
+        if (!lines.empty() && lines.back().line == line) return;
+        if (!lines.empty() && lines.back().pc == at) {
+            lines.back().line = line;
+        } else {
+            lines.push_back({at, line});
+        }
+    }
+
+    size_t emitJump() {
+        return emit(encodeSJ(Op::Jump, 0));
+    }
+
+    size_t emitBranch(Op op, int reg) {
+        return emit(encodeAsBx(op, static_cast<uint8_t>(reg), 0));
+    }
+
+    void jumpTo(const Node* at, size_t target) {
+        const int64_t offset = static_cast<int64_t>(target) - static_cast<int64_t>(pc() + 1);
+        if (offset < -kMaxJump) error(at, "Loop body too large for the bytecode backend");
+        emit(encodeSJ(Op::Jump, static_cast<int32_t>(offset)));
+    }
+
+    // Point a forward jump or branch at the current end of the code
+    void patch(const Node* at, size_t from) {
+        const int64_t offset = static_cast<int64_t>(pc()) - static_cast<int64_t>(from + 1);
+        Instruction& instruction = fn_->code[from];
+        if (opOf(instruction) == Op::Jump) {
+            if (offset > kMaxJump) error(at, "Block too large for the bytecode backend");
+            instruction = encodeSJ(Op::Jump, static_cast<int32_t>(offset));
+        } else {
+            if (offset > INT16_MAX) error(at, "Block too large for the bytecode backend");
+            instruction = encodeAsBx(opOf(instruction), argA(instruction), static_cast<int16_t>(offset));
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // Registers and scopes
+
+    int allocReg(const Node* at) {
+        if (fn_->freeReg >= kMaxRegisters) {
+            error(at, "Expression needs more than 256 registers");
+        }
+        const int reg = fn_->freeReg++;
+        fn_->maxReg = std::max(fn_->maxReg, fn_->freeReg);
+        return reg;
+    }
+
+    void beginScope() {
+        fn_->depth++;
+    }
+
+    void endScope() {
+        fn_->depth--;
+        while (!fn_->locals.empty() && fn_->locals.back().depth > fn_->depth) {
+            fn_->locals.pop_back();
+        }
+        fn_->freeReg = static_cast<int>(fn_->locals.size());
+    }
+
+    bool atGlobalScope() const {
+        return fn_->isScript && fn_->depth == 0;
+    }
+
+    const Local* findLocal(Symbol symbol) const {
+        for (auto it = fn_->locals.rbegin(); it != fn_->locals.rend(); ++it) {
+            if (it->symbol == symbol) return &*it;
+        }
+        return nullptr;
+    }
+
+    Target resolve(const Identifier* id) const {
+        if (const Local* local = findLocal(id->symbol)) {
+            return Target{true, local->reg, 0, local->typeRune};
+        }
+        const Global& global = globals_[id->symbol];
+        if (!global.defined) {
+            error(id, "Unknown variable '" + std::string(id->name) + "'");
+        }
+        return Target{false, 0, global.slot, global.typeRune};
+    }
+
+    // -----------------------------------------------------------------------
+    // Functions
+
+    void function(const FunctionDecl* decl, uint32_t index) {
+        FunctionState state;
+        state.isScript = false;
+        state.returnRune = decl->returnRune;
+        fn_ = &state;
+
+        if (decl->paramCount > UINT8_MAX) {
+            error(decl, "Too many parameters");
+        }
+        setLine(decl);
+        for (uint32_t i = 0; i < decl->paramCount; i++) {
+            const Param& param = decl->params[i];
+            const int reg = allocReg(decl);
+            fn_->locals.push_back(Local{param.symbol, static_cast<uint8_t>(reg), param.typeRune, 0});
+            if (isFloatType(param.typeRune)) {
+                emitABC(Op::ToFloat, reg, reg, 0);
+            }
+        }
+
+        for (const Stmt* stmt : decl->body->body) {
+            statement(stmt);
+        }
+        emit(encodeABC(Op::ReturnNil, 0, 0, 0));
+
+        finish(state, index, decl->name, static_cast<uint8_t>(decl->paramCount));
+    }
+
+    void finish(FunctionState& state, uint32_t index, std::string_view name, uint8_t paramCount) {
+        Function& function = module_.functions[index];
+        function.name = intern(name);
+        function.codeOffset = static_cast<uint32_t>(module_.code.size());
+        function.codeSize = static_cast<uint32_t>(state.code.size());
+        function.paramCount = paramCount;
+        function.registerCount = static_cast<uint16_t>(std::max(state.maxReg, 1));
+
+        for (const LineEntry& entry : state.lines) {
+            module_.lines.push_back({entry.pc + function.codeOffset, entry.line});
+        }
+        module_.code.insert(module_.code.end(), state.code.begin(), state.code.end());
+    }
+
+    // -----------------------------------------------------------------------
+    // Statements
+
+    void statement(const Stmt* stmt) {
+        if (stmt->kind != NodeKind::Comment) setLine(stmt);
+
+        switch (stmt->kind) {
+            case NodeKind::Comment:
+                break;
+
+            case NodeKind::Print: {
+                for (const Expr* arg : static_cast<const PrintStmt*>(stmt)->args) {
+                    const int mark = fn_->freeReg;
+                    emitABC(Op::Print, operand(arg), 0, 0);
+                    fn_->freeReg = mark;
+                }
+                break;
+            }
+
+            case NodeKind::Input: {
+                const auto* id = as<Identifier>(static_cast<const InputStmt*>(stmt)->target);
+                if (!id) error(stmt, "ᛜ can only read into a variable");
+                const Target target = resolve(id);
+                const int kind = static_cast<int>(inputKindFor(target.typeRune));
+                if (target.local) {
+                    emitABC(Op::Input, target.reg, kind, 0);
+                } else {
+                    const int reg = allocReg(stmt);
+                    emitABC(Op::Input, reg, kind, 0);
+                    emitABx(Op::SetGlobal, reg, target.slot);
+                    fn_->freeReg = reg;
+                }
+                break;
+            }
+
+            case NodeKind::VarDecl:
+                declaration(static_cast<const VarDecl*>(stmt));
+                break;
+
+            case NodeKind::ExprStmt:
+                discard(static_cast<const ExprStmt*>(stmt)->expr);
+                break;
+
+            case NodeKind::Block:
+                beginScope();
+                for (const Stmt* child : static_cast<const BlockStmt*>(stmt)->body) {
+                    statement(child);
+                }
+                endScope();
+                break;
+
+            case NodeKind::If: {
+                const auto* ifStmt = static_cast<const IfStmt*>(stmt);
+                const size_t skipThen = branch(ifStmt->cond, Op::JumpIfFalse);
+                statement(ifStmt->thenBlock);
+                if (ifStmt->elseBranch) {
+                    const size_t skipElse = emitJump();
+                    patch(stmt, skipThen);
+                    statement(ifStmt->elseBranch);
+                    patch(stmt, skipElse);
+                } else {
+                    patch(stmt, skipThen);
+                }
+                break;
+            }
+
+            case NodeKind::While: {
+                const auto* loop = static_cast<const WhileStmt*>(stmt);
+                const size_t start = pc();
+                const size_t exit = branch(loop->cond, Op::JumpIfFalse);
+                statement(loop->body);
+                jumpTo(stmt, start);
+                patch(stmt, exit);
+                break;
+            }
+
+            case NodeKind::For: {
+                const auto* loop = static_cast<const ForStmt*>(stmt);
+                beginScope();
+                if (loop->init) statement(loop->init);
+                const size_t start = pc();
+                const bool bounded = loop->cond != nullptr;
+                const size_t exit = bounded ? branch(loop->cond, Op::JumpIfFalse) : 0;
+                statement(loop->body);
+                if (loop->step) discard(loop->step);
+                jumpTo(stmt, start);
+                if (bounded) patch(stmt, exit);
+                endScope();
+                break;
+            }
+
+            case NodeKind::Return: {
+                const Expr* value = static_cast<const ReturnStmt*>(stmt)->value;
+                if (!value) {
+                    emit(encodeABC(Op::ReturnNil, 0, 0, 0));
+                    break;
+                }
+                const int mark = fn_->freeReg;
+                int reg = operand(value);
+                if (needsFloat(fn_->returnRune, value)) {
+                    const int converted = allocReg(stmt);
+                    emitABC(Op::ToFloat, converted, reg, 0);
+                    reg = converted;
+                }
+                emitABC(Op::Return, reg, 0, 0);
+                fn_->freeReg = mark;
+                break;
+            }
+
+            case NodeKind::Function:
+                // Top-level functions were hoisted and are compiled separately
+                if (!atGlobalScope()) {
+                    error(stmt, "Functions must be declared at the top level");
+                }
+                break;
+
+            case NodeKind::Class:
+                error(stmt, "Classes are not supported by the bytecode backend");
+
+            default:
+                error(stmt, "Unexpected node in statement position");
+        }
+    }
+
+    bool needsFloat(char32_t typeRune, const Expr* value) const {
+        return isFloatType(typeRune) && value->kind != NodeKind::FloatLiteral;
+    }
+
+    void defaultValue(const VarDecl* decl, int reg) {
+        if (isFloatType(decl->typeRune)) {
+            emitABx(Op::LoadK, reg, floatConstant(decl, 0.0));
+        } else if (decl->typeRune == U'ᛡ') {
+            emitABC(Op::LoadBool, reg, 0, 0);
+        } else if (decl->typeRune == U'ᛝ') {
+            emitABx(Op::LoadK, reg, stringConstant(decl, std::string_view()));
+        } else if (decl->typeRune == U'ᛙ') {
+            emit(encodeAsBx(Op::LoadInt, static_cast<uint8_t>(reg), 0));
+        } else {
+            emitABC(Op::LoadNil, reg, 0, 0);
+        }
+    }
+
+    void declaration(const VarDecl* decl) {
+        const int reg = allocReg(decl);
+        if (decl->init) {
+            expr(decl->init, reg);
+            if (needsFloat(decl->typeRune, decl->init)) {
+                emitABC(Op::ToFloat, reg, reg, 0);
+            }
+        } else {
+            defaultValue(decl, reg);
+        }
+
+        if (atGlobalScope()) {
+            emitABx(Op::SetGlobal, reg, globalSlot(decl, decl->symbol, decl->name, decl->typeRune));
+            fn_->freeReg = reg;
+        } else {
+            // Registered after the initializer, which must not see the new name
+            fn_->locals.push_back(Local{decl->symbol, static_cast<uint8_t>(reg), decl->typeRune, fn_->depth});
+        }
+    }
+
+    // Evaluate cond and emit a branch on it, returning the branch to patch
+    size_t branch(const Expr* cond, Op op) {
+        const int mark = fn_->freeReg;
+        const size_t at = emitBranch(op, operand(cond));
+        fn_->freeReg = mark;
+        return at;
+    }
+
+    // Expression evaluated only for its side effects
+    void discard(const Expr* e) {
+        const int mark = fn_->freeReg;
+        switch (e->kind) {
+            case NodeKind::Assign:
+                assign(static_cast<const AssignExpr*>(e), -1);
+                break;
+            case NodeKind::Call:
+                call(static_cast<const CallExpr*>(e), -1);
+                break;
+            case NodeKind::Builtin:
+                builtin(static_cast<const BuiltinCall*>(e), -1);
+                break;
+            default:
+                expr(e, allocReg(e));
+                break;
+        }
+        fn_->freeReg = mark;
+    }
+
+    // -----------------------------------------------------------------------
+    // Expressions
+
+    // Register holding the value of e: locals are used in place, anything
+    // else is evaluated into a new temporary
+    int operand(const Expr* e) {
+        if (const auto* id = as<Identifier>(e)) {
+            if (const Local* local = findLocal(id->symbol)) return local->reg;
+        }
+        const int reg = allocReg(e);
+        expr(e, reg);
+        return reg;
+    }
+
+    // Evaluate e into target. Temporaries are released before returning.
+    void expr(const Expr* e, int target) {
+        const int mark = fn_->freeReg;
+
+        switch (e->kind) {
+            case NodeKind::IntLiteral: {
+                const int64_t value = static_cast<const IntLiteral*>(e)->value;
+                loadInt(e, target, value);
+                break;
+            }
+
+            case NodeKind::FloatLiteral:
+                emitABx(Op::LoadK, target, floatConstant(e, static_cast<const FloatLiteral*>(e)->value));
+                break;
+
+            case NodeKind::StringLiteral:
+                emitABx(Op::LoadK, target, literalConstant(static_cast<const StringLiteral*>(e)));
+                break;
+
+            case NodeKind::BoolLiteral:
+                emitABC(Op::LoadBool, target, static_cast<const BoolLiteral*>(e)->value ? 1 : 0, 0);
+                break;
+
+            case NodeKind::Identifier: {
+                const Target source = resolve(static_cast<const Identifier*>(e));
+                if (source.local) {
+                    emitMove(target, source.reg);
+                } else {
+                    emitABx(Op::GetGlobal, target, source.slot);
+                }
+                break;
+            }
+
+            case NodeKind::Unary: {
+                const auto* unary = static_cast<const UnaryExpr*>(e);
+                const auto* literal = as<IntLiteral>(unary->operand);
+                if (unary->op == UnaryOp::Negate && literal) {
+                    loadInt(e, target, -literal->value);
+                    break;
+                }
+                const Op op = unary->op == UnaryOp::Negate ? Op::Negate
+                            : unary->op == UnaryOp::Not ? Op::Not
+                            : Op::BitNot;
+                emitABC(op, target, operand(unary->operand), 0);
+                break;
+            }
+
+            case NodeKind::Binary:
+                binary(static_cast<const BinaryExpr*>(e), target);
+                break;
+
+            case NodeKind::Assign:
+                assign(static_cast<const AssignExpr*>(e), target);
+                break;
+
+            case NodeKind::Call:
+                call(static_cast<const CallExpr*>(e), target);
+                break;
+
+            case NodeKind::Builtin:
+                builtin(static_cast<const BuiltinCall*>(e), target);
+                break;
+
+            case NodeKind::Index: {
+                const auto* index = static_cast<const IndexExpr*>(e);
+                const int base = operand(index->base);
+                emitABC(Op::GetIndex, target, base, operand(index->index));
+                break;
+            }
+
+            case NodeKind::Scoped: {
+                const auto* scoped = static_cast<const ScopedExpr*>(e);
+                error(e, std::string(scoped->scope) + std::string(scoped->name) + " must be called");
+            }
+
+            case NodeKind::Member:
+                error(e, "Member access is not supported by the bytecode backend");
+
+            default:
+                error(e, "Unexpected node in expression position");
+        }
+
+        fn_->freeReg = mark;
+    }
+
+    void loadInt(const Expr* e, int target, int64_t value) {
+        if (value >= INT16_MIN && value <= INT16_MAX) {
+            emit(encodeAsBx(Op::LoadInt, static_cast<uint8_t>(target), static_cast<int16_t>(value)));
+        } else {
+            emitABx(Op::LoadK, target, intConstant(e, value));
+        }
+    }
+
+    void binary(const BinaryExpr* e, int target) {
+        if (e->op == BinaryOp::LogicalAnd || e->op == BinaryOp::LogicalOr) {
+            // Built in a temporary so a local named in the right operand is
+            // not overwritten before it is read
+            const int reg = allocReg(e);
+            expr(e->lhs, reg);
+            emitABC(Op::ToBool, reg, reg, 0);
+            const size_t shortCircuit = emitBranch(e->op == BinaryOp::LogicalAnd ? Op::JumpIfFalse : Op::JumpIfTrue, reg);
+            expr(e->rhs, reg);
+            emitABC(Op::ToBool, reg, reg, 0);
+            patch(e, shortCircuit);
+            emitMove(target, reg);
+            return;
+        }
+
+        int lhs = operand(e->lhs);
+        int rhs = operand(e->rhs);
+        Op op;
+        switch (e->op) {
+            case BinaryOp::Add: op = Op::Add; break;
+            case BinaryOp::Sub: op = Op::Sub; break;
+            case BinaryOp::Mul: op = Op::Mul; break;
+            case BinaryOp::Div: op = Op::Div; break;
+            case BinaryOp::Mod: op = Op::Mod; break;
+            case BinaryOp::Shl: op = Op::Shl; break;
+            case BinaryOp::Shr: op = Op::Shr; break;
+            case BinaryOp::BitAnd: op = Op::BitAnd; break;
+            case BinaryOp::BitOr: op = Op::BitOr; break;
+            case BinaryOp::BitXor: op = Op::BitXor; break;
+            case BinaryOp::Less: op = Op::Less; break;
+            case BinaryOp::LessEq: op = Op::LessEq; break;
+            case BinaryOp::Greater: op = Op::Less; std::swap(lhs, rhs); break;
+            case BinaryOp::GreaterEq: op = Op::LessEq; std::swap(lhs, rhs); break;
+            case BinaryOp::Equal: op = Op::Equal; break;
+            case BinaryOp::NotEqual: op = Op::NotEqual; break;
+            default: error(e, "Unexpected binary operator");
+        }
+        emitABC(op, target, lhs, rhs);
+    }
+
+    // target < 0 when the value of the assignment is unused
+    void assign(const AssignExpr* e, int target) {
+        if (const auto* index = as<IndexExpr>(e->target)) {
+            const int base = operand(index->base);
+            const int key = operand(index->index);
+            const int value = operand(e->value);
+            emitABC(Op::SetIndex, base, key, value);
+            if (target >= 0) emitMove(target, value);
+            return;
+        }
+
+        const auto* id = as<Identifier>(e->target);
+        if (!id) error(e, "Only variables and indexed elements can be assigned");
+
+        const Target dest = resolve(id);
+        if (dest.local) {
+            expr(e->value, dest.reg);
+            if (needsFloat(dest.typeRune, e->value)) {
+                emitABC(Op::ToFloat, dest.reg, dest.reg, 0);
+            }
+            if (target >= 0) emitMove(target, dest.reg);
+            return;
+        }
+
+        const int reg = target >= 0 ? target : allocReg(e);
+        expr(e->value, reg);
+        if (needsFloat(dest.typeRune, e->value)) {
+            emitABC(Op::ToFloat, reg, reg, 0);
+        }
+        emitABx(Op::SetGlobal, reg, dest.slot);
+    }
+
+    // Register a call frame starts at. A target that is the newest
+    // temporary is reused so the result needs no extra move.
+    int callBase(const Node* at, int target) {
+        if (target >= static_cast<int>(fn_->locals.size()) && target == fn_->freeReg - 1) {
+            return target;
+        }
+        return allocReg(at);
+    }
+
+    // Arguments go into the registers directly after the ones in use
+    uint8_t arguments(const Node* at, const NodeList<Expr>& args) {
+        if (args.count > UINT8_MAX) error(at, "Too many arguments");
+        for (const Expr* arg : args) {
+            expr(arg, allocReg(arg));
+        }
+        return static_cast<uint8_t>(args.count);
+    }
+
+    void call(const CallExpr* e, int target) {
+        if (const auto* scoped = as<ScopedExpr>(e->callee)) {
+            native(e, nativeKey(scoped->prefix, scoped->symbol), scoped->scope, scoped->name, e->args, target);
+            return;
+        }
+        if (e->callee->kind == NodeKind::Member) {
+            error(e, "Method calls are not supported by the bytecode backend");
+        }
+
+        const int base = callBase(e, target);
+        expr(e->callee, base);
+        const uint8_t count = arguments(e, e->args);
+        emitABC(Op::Call, base, count, 0);
+        if (target >= 0) emitMove(target, base);
+    }
+
+    void builtin(const BuiltinCall* e, int target) {
+        native(e, nativeKey(e->rune, kNoSymbol), std::string_view(), e->name, e->args, target);
+    }
+
+    void native(const Node* at, uint64_t key, std::string_view scope, std::string_view name,
+                const NodeList<Expr>& args, int target) {
+        const uint8_t index = nativeIndex(at, key, scope, name);
+        if (args.count > UINT8_MAX) error(at, "Too many arguments");
+
+        // The first argument shares its register with the result
+        const int base = callBase(at, target);
+        for (uint32_t i = 0; i < args.count; i++) {
+            expr(args[i], i == 0 ? base : allocReg(args[i]));
+        }
+        emitABC(Op::CallNative, base, index, static_cast<int>(args.count));
+        if (target >= 0) emitMove(target, base);
+    }
+};
+
+void appendf(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+void appendf(std::string& out, const char* format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    const int length = std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length > 0) out.append(buffer, std::min<size_t>(length, sizeof(buffer) - 1));
+}
+
+void appendConstant(std::string& out, const Image& module, const Constant& constant) {
+    switch (constant.kind) {
+        case ConstantKind::Int:
+            appendf(out, "%" PRId64, constant.integer);
+            break;
+        case ConstantKind::Float:
+            appendf(out, "%g", constant.number);
+            break;
+        case ConstantKind::String: {
+            out += '"';
+            for (char c : module.text(constant.string)) {
+                if (c == '\n') out += "\\n";
+                else if (c == '\t') out += "\\t";
+                else if (c == '"') out += "\\\"";
+                else out += c;
+            }
+            out += '"';
+            break;
+        }
+        case ConstantKind::Function:
+            appendf(out, "<function %.*s>",
+                    static_cast<int>(module.functions[constant.function].name.length),
+                    module.text(module.functions[constant.function].name).data());
+            break;
+    }
+}
+
+} // namespace
+
+Bytecode::Module compileBytecode(const Ast::Program& program) {
+    return BytecodeCompiler().compile(program);
+}
+
+const char* verifyBytecode(const Bytecode::Image& module) {
+    if (module.functions.empty()) return "module has no top-level code";
+
+    for (const Function& function : module.functions) {
+        if (function.codeSize == 0 || function.codeOffset > module.code.size() ||
+            function.codeSize > module.code.size() - function.codeOffset) {
+            return "function code out of range";
+        }
+        if (function.registerCount == 0 || function.registerCount > kMaxRegisters ||
+            function.paramCount > function.registerCount) {
+            return "bad function register count";
+        }
+
+        const uint32_t registers = function.registerCount;
+        const int64_t size = function.codeSize;
+        auto reg = [registers](uint32_t r) { return r < registers; };
+        auto lands = [size](uint32_t at, int32_t offset) {
+            const int64_t target = int64_t(at) + 1 + offset;
+            return target >= 0 && target < size;
+        };
+
+        for (uint32_t i = 0; i < function.codeSize; i++) {
+            const Instruction instruction = module.code[function.codeOffset + i];
+            const uint32_t a = argA(instruction);
+            const uint32_t b = argB(instruction);
+            const uint32_t c = argC(instruction);
+            bool valid;
+            switch (opOf(instruction)) {
+                case Op::Move:
+                case Op::Negate:
+                case Op::Not:
+                case Op::BitNot:
+                case Op::ToBool:
+                case Op::ToFloat:
+                    valid = reg(a) && reg(b);
+                    break;
+                case Op::LoadK:
+                    valid = reg(a) && argBx(instruction) < module.constants.size();
+                    break;
+                case Op::LoadInt:
+                case Op::LoadNil:
+                case Op::LoadBool:
+                case Op::Return:
+                case Op::Print:
+                    valid = reg(a);
+                    break;
+                case Op::GetGlobal:
+                case Op::SetGlobal:
+                    valid = reg(a) && argBx(instruction) < module.globals.size();
+                    break;
+                case Op::Add:
+                case Op::Sub:
+                case Op::Mul:
+                case Op::Div:
+                case Op::Mod:
+                case Op::Shl:
+                case Op::Shr:
+                case Op::BitAnd:
+                case Op::BitOr:
+                case Op::BitXor:
+                case Op::Less:
+                case Op::LessEq:
+                case Op::Equal:
+                case Op::NotEqual:
+                case Op::GetIndex:
+                case Op::SetIndex:
+                    valid = reg(a) && reg(b) && reg(c);
+                    break;
+                case Op::Jump:
+                    valid = lands(i, argSJ(instruction));
+                    break;
+                case Op::JumpIfFalse:
+                case Op::JumpIfTrue:
+                    valid = reg(a) && lands(i, argSBx(instruction));
+                    break;
+                case Op::Call:
+                    // The callee and its arguments, R[a] .. R[a+b]
+                    valid = reg(a + b);
+                    break;
+                case Op::CallNative:
+                    valid = b < module.natives.size() && reg(a) && a + c <= registers;
+                    break;
+                case Op::ReturnNil:
+                    valid = true;
+                    break;
+                case Op::Input:
+                    valid = reg(a) && b <= static_cast<uint32_t>(InputKind::Boolean);
+                    break;
+                default:
+                    return "unknown instruction";
+            }
+            if (!valid) return "instruction operand out of range";
+        }
+
+        // Execution must never run past the last instruction into whatever
+        // follows the function
+        const Op last = opOf(module.code[function.codeOffset + function.codeSize - 1]);
+        if (last != Op::Jump && last != Op::Return && last != Op::ReturnNil) {
+            return "function does not end in a return or jump";
+        }
+    }
+    return nullptr;
+}
+
+std::string disassemble(const Bytecode::Image& module) {
+    std::string out;
+    for (const Function& function : module.functions) {
+        const std::string_view name = module.text(function.name);
+        appendf(out, "function %.*s params=%u registers=%u\n",
+                static_cast<int>(name.size()), name.data(), function.paramCount, function.registerCount);
+
+        for (uint32_t i = 0; i < function.codeSize; i++) {
+            const size_t pc = function.codeOffset + i;
+            const Instruction instruction = module.code[pc];
+            const Op op = opOf(instruction);
+            appendf(out, "%6u [%u] %-11s", i, module.lineAt(pc), opName(op));
+
+            switch (op) {
+                case Op::LoadK:
+                    appendf(out, " r%u ", argA(instruction));
+                    appendConstant(out, module, module.constants[argBx(instruction)]);
+                    break;
+                case Op::LoadInt:
+                    appendf(out, " r%u %d", argA(instruction), argSBx(instruction));
+                    break;
+                case Op::LoadNil:
+                case Op::Return:
+                case Op::Print:
+                    appendf(out, " r%u", argA(instruction));
+                    break;
+                case Op::LoadBool:
+                case Op::Input:
+                    appendf(out, " r%u %u", argA(instruction), argB(instruction));
+                    break;
+                case Op::GetGlobal:
+                case Op::SetGlobal: {
+                    const std::string_view global = module.text(module.globals[argBx(instruction)]);
+                    appendf(out, " r%u %.*s", argA(instruction), static_cast<int>(global.size()), global.data());
+                    break;
+                }
+                case Op::Jump:
+                    appendf(out, " -> %d", static_cast<int>(i) + 1 + argSJ(instruction));
+                    break;
+                case Op::JumpIfFalse:
+                case Op::JumpIfTrue:
+                    appendf(out, " r%u -> %d", argA(instruction), static_cast<int>(i) + 1 + argSBx(instruction));
+                    break;
+                case Op::Call:
+                    appendf(out, " r%u %u", argA(instruction), argB(instruction));
+                    break;
+                case Op::CallNative: {
+                    const std::string_view native = module.text(module.natives[argB(instruction)]);
+                    appendf(out, " r%u %.*s %u", argA(instruction),
+                            static_cast<int>(native.size()), native.data(), argC(instruction));
+                    break;
+                }
+                case Op::ReturnNil:
+                    break;
+                case Op::Move:
+                case Op::Negate:
+                case Op::Not:
+                case Op::BitNot:
+                case Op::ToBool:
+                case Op::ToFloat:
+                    appendf(out, " r%u r%u", argA(instruction), argB(instruction));
+                    break;
+                default:
+                    appendf(out, " r%u r%u r%u", argA(instruction), argB(instruction), argC(instruction));
+                    break;
+            }
+            out += '\n';
+        }
+    }
+    return out;
+}
+
+} // namespace RuneLang
@@ -0,0 +1,184 @@
+#include "../include/RuneCache.hpp"
+#include "../include/RuneError.hpp"
+#include "../include/RuneFile.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace RuneLang {
+
+namespace {
+    constexpr std::string_view kTempPrefix = ".tmp-";
+
+    // Every entry starts with the check hash and length of the key it was
+    // stored under, in host byte order
+    constexpr size_t kHeaderSize = 2 * sizeof(uint64_t);
+
+    // Entries of other processes may vanish mid-scan, so nothing here throws
+    bool isEntry(const fs::directory_entry& entry) {
+        std::error_code ec;
+        return entry.is_regular_file(ec) && entry.path().filename().string().rfind(kTempPrefix, 0) != 0;
+    }
+}
+
+RuneCache::RuneCache(const std::string& directory, uint64_t maxBytes)
+    : directory_(directory), maxBytes_(maxBytes), bytesStored_(0), hits_(0), misses_(0), nextTemp_(0) {
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if (ec) {
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot create cache directory " + directory_ + ": " + ec.message());
+    }
+    bytesStored_ = scan();
+}
+
+std::string RuneCache::entryPath(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016" PRIx64 ".cpp", key);
+    return directory_ + name;
+}
+
+uint64_t RuneCache::scan() const {
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(directory_, ec)) {
+        if (isEntry(entry)) {
+            total += entry.file_size(ec);
+        }
+    }
+    return total;
+}
+
+bool RuneCache::load(const RuneCacheKey& key, std::string& output) {
+    const std::string path = entryPath(key.hash);
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        misses_++;
+        return false;
+    }
+
+    struct stat info;
+    bool ok = fstat(fd, &info) == 0;
+    std::string contents;
+    if (ok) {
+        contents.resize(static_cast<size_t>(info.st_size));
+        size_t done = 0;
+        while (done < contents.size()) {
+            const ssize_t result = read(fd, &contents[done], contents.size() - done);
+            if (result < 0 && errno == EINTR) continue;
+            if (result <= 0) {
+                ok = false;
+                break;
+            }
+            done += static_cast<size_t>(result);
+        }
+    }
+
+    if (!ok || contents.size() < kHeaderSize) {
+        close(fd);
+        LOG_WARNING("Ignoring unreadable cache entry ", path);
+        misses_++;
+        return false;
+    }
+
+    // A different input that happens to share the hash
+    uint64_t header[2];
+    std::memcpy(header, contents.data(), kHeaderSize);
+    if (header[0] != key.check || header[1] != key.length) {
+        close(fd);
+        misses_++;
+        return false;
+    }
+
+    // Bump the modification time, it is the recency used for eviction
+    futimens(fd, nullptr);
+    close(fd);
+
+    contents.erase(0, kHeaderSize);
+    output = std::move(contents);
+    hits_++;
+    return true;
+}
+
+void RuneCache::store(const RuneCacheKey& key, std::string_view output) {
+    const std::string temp = directory_ + "/" + std::string(kTempPrefix) +
+                             std::to_string(getpid()) + "-" + std::to_string(nextTemp_++);
+    try {
+        const uint64_t header[2] = {key.check, key.length};
+        RuneFileWriter writer(temp);
+        writer.append(std::string_view(reinterpret_cast<const char*>(header), kHeaderSize));
+        writer.append(output);
+        writer.close();
+    } catch (const RuneError&) {
+        unlink(temp.c_str());
+        return;
+    }
+
+    // An entry being replaced no longer counts towards the total
+    const std::string path = entryPath(key.hash);
+    struct stat replaced;
+    const uint64_t replacedSize = stat(path.c_str(), &replaced) == 0 ? static_cast<uint64_t>(replaced.st_size) : 0;
+    if (rename(temp.c_str(), path.c_str()) != 0) {
+        LOG_WARNING("Cannot store cache entry ", path, ": ", std::strerror(errno));
+        unlink(temp.c_str());
+        return;
+    }
+
+    // Trim to three quarters of the limit so stores right after an
+    // eviction do not rescan the directory every time
+    const uint64_t stored = kHeaderSize + output.size();
+    uint64_t total = bytesStored_.load();
+    uint64_t updated;
+    do {
+        updated = total + stored - std::min(total + stored, replacedSize);
+    } while (!bytesStored_.compare_exchange_weak(total, updated));
+    if (updated > maxBytes_) {
+        evict(maxBytes_ / 4 * 3);
+    }
+}
+
+void RuneCache::evict(uint64_t lowWater) {
+    std::lock_guard<std::mutex> lock(evictMutex_);
+
+    struct Entry {
+        fs::path path;
+        uint64_t size;
+        fs::file_time_type used;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(directory_, ec)) {
+        if (!isEntry(entry)) continue;
+        const uint64_t size = entry.file_size(ec);
+        if (ec) continue;
+        const fs::file_time_type used = entry.last_write_time(ec);
+        if (ec) continue;
+        entries.push_back({entry.path(), size, used});
+        total += size;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.used < b.used;
+    });
+
+    for (const Entry& entry : entries) {
+        if (total <= lowWater) break;
+        if (fs::remove(entry.path, ec)) {
+            total -= entry.size;
+        }
+    }
+
+    bytesStored_ = total;
+}
+
+} // namespace RuneLang
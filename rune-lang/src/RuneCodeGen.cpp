@@ -0,0 +1,538 @@
+#include "../include/RuneCodeGen.hpp"
+#include "../include/RuneFile.hpp"
+#include "../include/RuneParser.hpp"
+#include <algorithm>
+#include <string_view>
+
+namespace RuneLang {
+
+namespace {
+
+using namespace Ast;
+
+// Precedence levels above the binary operators
+constexpr int kUnaryPrecedence = 11;
+constexpr int kPostfixPrecedence = 12;
+
+// Output that only measures how much would be written
+class SizeCounter {
+public:
+    void append(std::string_view text) { size += text.size(); }
+    void append(char) { size++; }
+
+    size_t size = 0;
+};
+
+// Output that writes into a buffer reserved by the caller
+class StringOutput {
+public:
+    explicit StringOutput(std::string& out) : out_(out) {}
+
+    void append(std::string_view text) { out_.append(text.data(), text.size()); }
+    void append(char c) { out_ += c; }
+
+private:
+    std::string& out_;
+};
+
+// Output that forwards to another and counts the lines written to it
+template <typename Output>
+class LineCounter {
+public:
+    LineCounter(Output& out, CppSourceLines& lines) : out_(out), lines_(lines) {}
+
+    void append(std::string_view text) {
+        out_.append(text);
+        lines_.line += static_cast<uint32_t>(std::count(text.begin(), text.end(), '\n'));
+    }
+    void append(char c) {
+        out_.append(c);
+        if (c == '\n') lines_.line++;
+    }
+
+private:
+    Output& out_;
+    CppSourceLines& lines_;
+};
+
+template <typename Output>
+class CppWriter {
+public:
+    explicit CppWriter(Output& out) : out_(out), lines_(nullptr), native_(nullptr), depth_(0) {}
+
+    // out must count its lines into lines
+    CppWriter(Output& out, CppSourceLines& lines) : out_(out), lines_(&lines), native_(nullptr), depth_(0) {}
+
+    void program(const Program& program) {
+        for (const Stmt* stmt : program.body) {
+            statement(stmt);
+        }
+    }
+
+    void topLevel(const Stmt* stmt) {
+        statement(stmt);
+    }
+
+    // Declarations stay at namespace scope, in source order, so functions
+    // see the globals declared before them as in the plain output. Every
+    // other statement runs inside the entry point, and globals get their
+    // initial value there, so each call starts the script afresh.
+    void native(const Program& program) {
+        native_ = &program;
+        out_.append(kNativePrologue);
+        out_.append("namespace {\n\n");
+        for (const Stmt* stmt : program.body) {
+            if (const auto* decl = as<VarDecl>(stmt)) {
+                globalDecl(decl);
+            } else if (isDeclaration(stmt)) {
+                statement(stmt);
+            }
+        }
+        out_.append("\n} // namespace\n\nextern \"C\" int ");
+        out_.append(kRuneNativeEntry);
+        out_.append("() {\n");
+        depth_++;
+        for (const Stmt* stmt : program.body) {
+            if (const auto* decl = as<VarDecl>(stmt)) {
+                indent();
+                out_.append(decl->name);
+                out_.append(" = ");
+                if (decl->init) {
+                    expr(decl->init);
+                } else {
+                    out_.append("{}");
+                }
+                out_.append(";\n");
+            } else if (!isDeclaration(stmt)) {
+                statement(stmt);
+            }
+        }
+        indent();
+        out_.append("return 0;\n");
+        depth_--;
+        out_.append("}\n");
+    }
+
+private:
+    static constexpr std::string_view kNativePrologue =
+        "#include <iostream>\n#include <string>\n\n";
+
+    static bool isDeclaration(const Stmt* stmt) {
+        return stmt->kind == NodeKind::Function || stmt->kind == NodeKind::Class;
+    }
+
+    void globalDecl(const VarDecl* decl) {
+        nativeType(decl);
+        out_.append(decl->typeName);
+        out_.append(' ');
+        out_.append(decl->name);
+        out_.append("{};\n");
+    }
+
+    // The shared object is built from the standard library alone, and the
+    // runtime behind the operation runes is only reachable from RuneVM, so
+    // a script using them is rejected rather than left to fail in the
+    // compiler
+    [[noreturn]] void unsupported(const Node* at, const std::string& what) const {
+        const std::string_view source = native_->source;
+        const size_t line = 1 + scan::newlines(source.data(), std::min<size_t>(at->offset, source.size()));
+        throw RuneParseError(what + " is not supported by the native backend", line);
+    }
+
+    void nativeType(const VarDecl* decl) const {
+        if (native_ && (decl->typeRune == U'ᛩ' || decl->typeRune == U'ᛪ')) {
+            unsupported(decl, std::string(decl->typeName));
+        }
+    }
+
+    void indent() {
+        for (int i = 0; i < depth_; i++) out_.append("    ");
+    }
+
+    // Called at the start of the line a statement begins on. A #line is
+    // only needed where the line the compiler would assume is wrong.
+    void mark(const Stmt* stmt) {
+        if (!lines_) return;
+        CppSourceLines& lines = *lines_;
+        const uint32_t runeLine = lines.runeLine(stmt->offset);
+        if (!lines.lineFile.empty() &&
+            (lines.directiveLine == 0 || lines.directiveRuneLine + (lines.line - lines.directiveLine) != runeLine)) {
+            out_.append("#line ");
+            out_.append(std::to_string(runeLine));
+            out_.append(" \"");
+            for (char c : lines.lineFile) {
+                if (c == '"' || c == '\\') out_.append('\\');
+                out_.append(c);
+            }
+            out_.append("\"\n");
+            lines.directiveLine = lines.line;
+            lines.directiveRuneLine = runeLine;
+        }
+        lines.map.add(lines.line, runeLine);
+    }
+
+    void statement(const Stmt* stmt) {
+        mark(stmt);
+        indent();
+        switch (stmt->kind) {
+            case NodeKind::Comment:
+                out_.append("//");
+                out_.append(static_cast<const CommentStmt*>(stmt)->text);
+                out_.append('\n');
+                break;
+
+            case NodeKind::Print: {
+                const auto* print = static_cast<const PrintStmt*>(stmt);
+                out_.append("std::cout");
+                for (const Expr* arg : print->args) {
+                    out_.append(" << ");
+                    // Operands that do not bind tighter than << need parentheses
+                    operand(arg, precedence(BinaryOp::Add));
+                }
+                out_.append(";\n");
+                break;
+            }
+
+            case NodeKind::Input:
+                out_.append("std::cin >> ");
+                expr(static_cast<const InputStmt*>(stmt)->target);
+                out_.append(";\n");
+                break;
+
+            case NodeKind::VarDecl:
+            case NodeKind::ExprStmt:
+                simple(stmt);
+                out_.append(";\n");
+                break;
+
+            case NodeKind::Block:
+                block(static_cast<const BlockStmt*>(stmt));
+                out_.append('\n');
+                break;
+
+            case NodeKind::If:
+                ifChain(static_cast<const IfStmt*>(stmt));
+                out_.append('\n');
+                break;
+
+            case NodeKind::While: {
+                const auto* loop = static_cast<const WhileStmt*>(stmt);
+                out_.append("while (");
+                expr(loop->cond);
+                out_.append(") ");
+                block(loop->body);
+                out_.append('\n');
+                break;
+            }
+
+            case NodeKind::For: {
+                const auto* loop = static_cast<const ForStmt*>(stmt);
+                out_.append("for (");
+                if (loop->init) simple(loop->init);
+                out_.append(';');
+                if (loop->cond) {
+                    out_.append(' ');
+                    expr(loop->cond);
+                }
+                out_.append(';');
+                if (loop->step) {
+                    out_.append(' ');
+                    expr(loop->step);
+                }
+                out_.append(") ");
+                block(loop->body);
+                out_.append('\n');
+                break;
+            }
+
+            case NodeKind::Return: {
+                const auto* ret = static_cast<const ReturnStmt*>(stmt);
+                out_.append("return");
+                if (ret->value) {
+                    out_.append(' ');
+                    expr(ret->value);
+                }
+                out_.append(";\n");
+                break;
+            }
+
+            case NodeKind::Function: {
+                const auto* function = static_cast<const FunctionDecl*>(stmt);
+                out_.append(function->returnType);
+                out_.append(' ');
+                out_.append(function->name);
+                out_.append('(');
+                for (uint32_t i = 0; i < function->paramCount; i++) {
+                    if (i > 0) out_.append(", ");
+                    out_.append(function->params[i].typeName);
+                    out_.append(' ');
+                    out_.append(function->params[i].name);
+                }
+                out_.append(") ");
+                block(function->body);
+                out_.append('\n');
+                break;
+            }
+
+            case NodeKind::Class: {
+                const auto* decl = static_cast<const ClassDecl*>(stmt);
+                out_.append(decl->keyword);
+                out_.append(' ');
+                out_.append(decl->name);
+                out_.append(" {\n");
+                indent();
+                out_.append("public:\n");
+                depth_++;
+                for (const Stmt* member : decl->members) {
+                    statement(member);
+                }
+                depth_--;
+                indent();
+                out_.append("};\n");
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    // Declarations and expressions without their terminator, as used in
+    // statement position and in loop headers
+    void simple(const Stmt* stmt) {
+        if (const auto* decl = as<VarDecl>(stmt)) {
+            nativeType(decl);
+            // Handle runes name a type, but their initialisers may not yield it
+            const bool handle = decl->typeRune == U'ᛩ' || decl->typeRune == U'ᛪ';
+            out_.append(handle && decl->init ? std::string_view("auto") : decl->typeName);
+            out_.append(' ');
+            out_.append(decl->name);
+            if (decl->init) {
+                out_.append(" = ");
+                expr(decl->init);
+            }
+        } else if (const auto* exprStmt = as<ExprStmt>(stmt)) {
+            expr(exprStmt->expr);
+        }
+    }
+
+    void block(const BlockStmt* block) {
+        out_.append("{\n");
+        depth_++;
+        for (const Stmt* stmt : block->body) {
+            statement(stmt);
+        }
+        depth_--;
+        indent();
+        out_.append('}');
+    }
+
+    void ifChain(const IfStmt* stmt) {
+        out_.append("if (");
+        expr(stmt->cond);
+        out_.append(") ");
+        block(stmt->thenBlock);
+        if (const auto* elseIf = as<IfStmt>(stmt->elseBranch)) {
+            out_.append(" else ");
+            ifChain(elseIf);
+        } else if (const auto* elseBlock = as<BlockStmt>(stmt->elseBranch)) {
+            out_.append(" else ");
+            block(elseBlock);
+        }
+    }
+
+    static int exprPrecedence(const Expr* e) {
+        switch (e->kind) {
+            case NodeKind::Assign: return 0;
+            case NodeKind::Binary: return precedence(static_cast<const BinaryExpr*>(e)->op);
+            case NodeKind::Unary: return kUnaryPrecedence;
+            default: return kPostfixPrecedence + 1;
+        }
+    }
+
+    void operand(const Expr* e, int minPrecedence) {
+        if (exprPrecedence(e) < minPrecedence) {
+            out_.append('(');
+            expr(e);
+            out_.append(')');
+        } else {
+            expr(e);
+        }
+    }
+
+    void arguments(const NodeList<Expr>& args) {
+        out_.append('(');
+        for (uint32_t i = 0; i < args.count; i++) {
+            if (i > 0) out_.append(", ");
+            expr(args[i]);
+        }
+        out_.append(')');
+    }
+
+    void expr(const Expr* e) {
+        switch (e->kind) {
+            case NodeKind::IntLiteral:
+                out_.append(static_cast<const IntLiteral*>(e)->text);
+                break;
+
+            case NodeKind::FloatLiteral:
+                out_.append(static_cast<const FloatLiteral*>(e)->text);
+                break;
+
+            case NodeKind::StringLiteral: {
+                const auto* literal = static_cast<const StringLiteral*>(e);
+                out_.append('"');
+                if (literal->runeQuoted) {
+                    // ᛟ strings may contain bare quotes
+                    size_t start = 0;
+                    size_t quote;
+                    while ((quote = literal->text.find('"', start)) != std::string_view::npos) {
+                        out_.append(literal->text.substr(start, quote - start));
+                        out_.append("\\\"");
+                        start = quote + 1;
+                    }
+                    out_.append(literal->text.substr(start));
+                } else {
+                    out_.append(literal->text);
+                }
+                out_.append('"');
+                break;
+            }
+
+            case NodeKind::BoolLiteral:
+                out_.append(static_cast<const BoolLiteral*>(e)->value ? "true" : "false");
+                break;
+
+            case NodeKind::Identifier:
+                out_.append(static_cast<const Identifier*>(e)->name);
+                break;
+
+            case NodeKind::Unary: {
+                const auto* unary = static_cast<const UnaryExpr*>(e);
+                switch (unary->op) {
+                    case UnaryOp::Negate: out_.append('-'); break;
+                    case UnaryOp::Not: out_.append('!'); break;
+                    case UnaryOp::BitNot: out_.append('~'); break;
+                }
+                operand(unary->operand, kUnaryPrecedence);
+                break;
+            }
+
+            case NodeKind::Binary: {
+                const auto* binary = static_cast<const BinaryExpr*>(e);
+                const int level = precedence(binary->op);
+                operand(binary->lhs, level);
+                out_.append(' ');
+                out_.append(spelling(binary->op));
+                out_.append(' ');
+                operand(binary->rhs, level + 1);
+                break;
+            }
+
+            case NodeKind::Assign: {
+                const auto* assign = static_cast<const AssignExpr*>(e);
+                expr(assign->target);
+                out_.append(" = ");
+                expr(assign->value);
+                break;
+            }
+
+            case NodeKind::Call: {
+                const auto* call = static_cast<const CallExpr*>(e);
+                operand(call->callee, kPostfixPrecedence);
+                arguments(call->args);
+                break;
+            }
+
+            case NodeKind::Index: {
+                const auto* index = static_cast<const IndexExpr*>(e);
+                operand(index->base, kPostfixPrecedence);
+                out_.append('[');
+                expr(index->index);
+                out_.append(']');
+                break;
+            }
+
+            case NodeKind::Member: {
+                const auto* member = static_cast<const MemberExpr*>(e);
+                operand(member->base, kPostfixPrecedence);
+                out_.append(member->arrow ? "->" : ".");
+                out_.append(member->member);
+                break;
+            }
+
+            case NodeKind::Scoped: {
+                const auto* scoped = static_cast<const ScopedExpr*>(e);
+                if (native_) unsupported(e, std::string(scoped->scope) + std::string(scoped->name));
+                out_.append(scoped->scope);
+                out_.append(scoped->name);
+                break;
+            }
+
+            case NodeKind::Builtin: {
+                const auto* call = static_cast<const BuiltinCall*>(e);
+                if (native_) unsupported(e, std::string(call->name));
+                out_.append(call->name);
+                arguments(call->args);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    Output& out_;
+    CppSourceLines* lines_;  // nullptr when not tracked
+    const Program* native_;  // Set while writing a shared object's source
+    int depth_;
+};
+
+} // namespace
+
+std::string generateCpp(const Program& program) {
+    SizeCounter counter;
+    CppWriter<SizeCounter>(counter).program(program);
+
+    std::string code;
+    code.reserve(counter.size);
+    StringOutput output(code);
+    CppWriter<StringOutput>(output).program(program);
+    return code;
+}
+
+std::string generateCpp(const Program& program, CppSourceLines& lines) {
+    // The measured size leaves out #line directives, so here it only sets
+    // the starting reservation
+    SizeCounter counter;
+    CppWriter<SizeCounter>(counter).program(program);
+
+    std::string code;
+    code.reserve(counter.size);
+    StringOutput output(code);
+    LineCounter<StringOutput> counted(output, lines);
+    CppWriter<LineCounter<StringOutput>>(counted, lines).program(program);
+    return code;
+}
+
+std::string generateNativeCpp(const Program& program) {
+    SizeCounter counter;
+    CppWriter<SizeCounter>(counter).native(program);
+
+    std::string code;
+    code.reserve(counter.size);
+    StringOutput output(code);
+    CppWriter<StringOutput>(output).native(program);
+    return code;
+}
+
+void generateCpp(const Stmt* stmt, RuneFileWriter& out) {
+    CppWriter<RuneFileWriter>(out).topLevel(stmt);
+}
+
+void generateCpp(const Stmt* stmt, RuneFileWriter& out, CppSourceLines& lines) {
+    LineCounter<RuneFileWriter> counted(out, lines);
+    CppWriter<LineCounter<RuneFileWriter>>(counted, lines).topLevel(stmt);
+}
+
+} // namespace RuneLang
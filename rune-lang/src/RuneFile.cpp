@@ -0,0 +1,106 @@
+#include "../include/RuneFile.hpp"
+#include "../include/RuneError.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace RuneLang {
+
+// RuneMappedFile implementation
+RuneMappedFile::RuneMappedFile(const std::string& path) : data_(nullptr), size_(0) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot open " + path + ": " + std::strerror(errno));
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        const int err = errno;
+        close(fd);
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot stat " + path + ": " + std::strerror(err));
+    }
+
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ > 0) {
+        void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            const int err = errno;
+            close(fd);
+            RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot map " + path + ": " + std::strerror(err));
+        }
+        madvise(mapping, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(mapping);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+RuneMappedFile::~RuneMappedFile() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+// RuneFileWriter implementation
+RuneFileWriter::RuneFileWriter(const std::string& path, size_t bufferSize)
+    : path_(path),
+      fd_(-1),
+      buffer_(new char[bufferSize]),
+      capacity_(bufferSize),
+      used_(0),
+      written_(0) {
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot create " + path + ": " + std::strerror(errno));
+    }
+}
+
+RuneFileWriter::~RuneFileWriter() {
+    if (fd_ >= 0) {
+        try {
+            close();
+        } catch (const std::exception&) {
+            // Already logged by RuneError; destructors must not throw
+        }
+    }
+}
+
+void RuneFileWriter::close() {
+    if (fd_ < 0) return;
+    try {
+        flushBuffer();
+    } catch (const RuneError&) {
+        ::close(fd_);
+        fd_ = -1;
+        throw;
+    }
+    const int result = ::close(fd_);
+    fd_ = -1;
+    if (result != 0) {
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot close " + path_ + ": " + std::strerror(errno));
+    }
+}
+
+void RuneFileWriter::flushBuffer() {
+    if (used_ == 0) return;
+    writeAll(buffer_.get(), used_);
+    used_ = 0;
+}
+
+void RuneFileWriter::writeAll(const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t result = write(fd_, data, size);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot write " + path_ + ": " + std::strerror(errno));
+        }
+        data += result;
+        size -= static_cast<size_t>(result);
+        written_ += static_cast<size_t>(result);
+    }
+}
+
+} // namespace RuneLang
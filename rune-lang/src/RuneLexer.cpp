@@ -0,0 +1,402 @@
+#include "../include/RuneLexer.hpp"
+#include "../include/RuneKeywords.hpp"
+#include "../include/RuneScan.hpp"
+#include "../include/RuneThreadPool.hpp"
+#include "../include/RuneUtf8.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace RuneLang {
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool isAscii(char c) {
+    return static_cast<unsigned char>(c) < 0x80;
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool isHexDigit(char c) {
+    return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+bool isIdentifierStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool isIdentifierChar(char c) {
+    return isIdentifierStart(c) || isDigit(c);
+}
+
+// Chunks smaller than this cost more to hand out than they save
+constexpr size_t kMinChunkBytes = 1024 * 1024;
+
+// What a line start can be inside. Comments end at the newline, so they
+// never reach one.
+enum class Quote : uint8_t { None, Rune, Ascii };
+constexpr size_t kQuotes = 3;
+
+// Where a scan of a chunk that began inside a quote ends up
+struct QuoteScan {
+    size_t codeAt = SIZE_MAX;  // After the quote open at the start closes, if it does
+    Quote exit = Quote::None;  // What the end of the chunk is inside
+};
+
+// Follows only what decides whether a byte is inside a string: quote
+// delimiters, escapes in '"' strings and comments, which can hide either.
+// This is several times cheaper than lexing.
+QuoteScan scanQuotes(std::string_view source, size_t begin, size_t end, Quote quote) {
+    QuoteScan result;
+    if (quote == Quote::None) result.codeAt = begin;
+
+    size_t i = begin;
+    while (i < end) {
+        if (quote == Quote::None) {
+            i += scan::quoteOrRune(source.data() + i, end - i);
+            if (i >= end) break;
+            if (source[i] == '"') {
+                quote = Quote::Ascii;
+                i++;
+            } else if (source.compare(i, 3, "ᛟ") == 0) {
+                quote = Quote::Rune;
+                i += 3;
+            } else if (source.compare(i, 3, "ᛞ") == 0) {
+                i += 3 + scan::lineEnd(source.data() + i + 3, source.size() - i - 3);
+            } else {
+                i++;
+            }
+            continue;
+        }
+
+        if (quote == Quote::Ascii) {
+            i += scan::quotedStop(source.data() + i, end - i);
+            if (i >= end) break;
+            if (source[i] != '"') {
+                i += source[i] == '\\' ? 2 : 1;
+                continue;
+            }
+            i++;
+        } else {
+            const void* lead = std::memchr(source.data() + i, '\xE1', end - i);
+            if (!lead) break;
+            i = static_cast<size_t>(static_cast<const char*>(lead) - source.data());
+            if (source.compare(i, 3, "ᛟ") != 0) {
+                i++;
+                continue;
+            }
+            i += 3;
+        }
+        quote = Quote::None;
+        if (result.codeAt == SIZE_MAX) result.codeAt = i;
+    }
+    result.exit = quote;
+    return result;
+}
+
+// A source range lexed on its own, into its own symbol table
+struct Chunk {
+    size_t start = 0;
+    size_t stop = SIZE_MAX;  // Lexing ends at the first token that reaches it
+    QuoteScan scans[kQuotes];  // By the quote the chunk starts inside
+    RuneSymbolTable symbols;
+    std::vector<RuneToken> tokens;
+};
+
+// The first line start at or after from that has something on it. The
+// Newline token before it then ends exactly there, as no run of blank
+// lines continues past it.
+size_t lineStartAfter(std::string_view source, size_t from) {
+    while (from < source.size()) {
+        const void* newline = std::memchr(source.data() + from, '\n', source.size() - from);
+        if (!newline) break;
+        from = static_cast<size_t>(static_cast<const char*>(newline) - source.data()) + 1;
+        if (from < source.size() && source[from] != '\n' && !isSpace(source[from])) return from;
+    }
+    return source.size();
+}
+
+size_t tokenEnd(const RuneToken& token) {
+    return token.offset + token.length;
+}
+
+} // namespace
+
+void RuneLexer::reset(std::string_view source, RuneSymbolTable& symbols) {
+    source_ = source;
+    cursor_ = 0;
+    symbols_ = &symbols;
+    done_ = false;
+}
+
+bool RuneLexer::lex(std::vector<RuneToken>& out, size_t maxTokens) {
+    for (size_t i = 0; i < maxTokens && !done_; i++) {
+        out.push_back(next());
+        done_ = out.back().kind == TokenKind::End;
+    }
+    return !done_;
+}
+
+std::vector<RuneToken> RuneLexer::tokenize(std::string_view source, RuneSymbolTable& symbols) {
+    std::vector<RuneToken> tokens;
+    tokens.reserve(source.size() / 4 + 1);
+    RuneLexer(source, symbols).lex(tokens);
+    return tokens;
+}
+
+std::vector<RuneToken> RuneLexer::tokenizeParallel(std::string_view source, RuneSymbolTable& symbols,
+                                                   size_t threads) {
+    const size_t chunkBytes = std::max(source.size() / std::max<size_t>(threads, 1), kMinChunkBytes);
+    if (threads <= 1 || source.size() < kParallelBytes || chunkBytes >= source.size()) {
+        return tokenize(source, symbols);
+    }
+
+    std::vector<size_t> cuts{0};
+    while (true) {
+        const size_t cut = lineStartAfter(source, cuts.back() + chunkBytes);
+        if (cut >= source.size()) break;
+        cuts.push_back(cut);
+    }
+
+    // First find out which cuts are inside strings. Each chunk is scanned
+    // for every quote it could start inside; the real one is then known
+    // from the chunk before it, and a chunk starts lexing where that quote
+    // closes.
+    std::vector<Chunk> chunks(cuts.size());
+    RuneThreadPool pool(std::min(threads, chunks.size()));
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const size_t end = i + 1 < cuts.size() ? cuts[i + 1] : source.size();
+        pool.submit([&source, &chunk = chunks[i], begin = cuts[i], end, first = i == 0](size_t) {
+            for (size_t quote = 0; quote < (first ? 1 : kQuotes); quote++) {
+                chunk.scans[quote] = scanQuotes(source, begin, end, static_cast<Quote>(quote));
+            }
+        });
+    }
+    pool.wait();
+
+    // Chunks that are all one string are left to the chunk before them
+    std::vector<Chunk*> live;
+    Quote quote = Quote::None;
+    for (Chunk& chunk : chunks) {
+        const QuoteScan& scan = chunk.scans[static_cast<size_t>(quote)];
+        quote = scan.exit;
+        if (scan.codeAt == SIZE_MAX) continue;
+        chunk.start = scan.codeAt;
+        if (!live.empty()) live.back()->stop = chunk.start;
+        live.push_back(&chunk);
+    }
+
+    for (Chunk* chunk : live) {
+        pool.submit([&source, chunk](size_t) {
+            RuneLexer lexer(source, chunk->symbols);
+            lexer.cursor_ = chunk->start;
+            chunk->tokens.reserve((std::min(chunk->stop, source.size()) - chunk->start) / 4 + 1);
+            while (!lexer.done_ && lexer.cursor_ < chunk->stop) {
+                chunk->tokens.push_back(lexer.next());
+                lexer.done_ = chunk->tokens.back().kind == TokenKind::End;
+            }
+        });
+    }
+    pool.wait();
+
+    size_t total = 0;
+    for (const Chunk* chunk : live) total += chunk->tokens.size();
+    std::vector<RuneToken> tokens;
+    tokens.reserve(total);
+
+    // Joined in source order, so symbols are numbered as tokenize() would
+    RuneLexer lexer(source, symbols);
+    std::vector<Symbol> remap;
+    for (const Chunk* chunk : live) {
+        const std::vector<RuneToken>& local = chunk->tokens;
+        size_t first = 0;
+
+        // The scan follows the lexer's rules, so the chunk before should
+        // end exactly where this one starts. Should the two ever disagree,
+        // relex until the cursor is at the end of one of this chunk's
+        // tokens, after which they agree again.
+        while (lexer.cursor_ != chunk->start) {
+            const auto synced = std::lower_bound(local.begin(), local.end(), lexer.cursor_,
+                [](const RuneToken& token, size_t end) { return tokenEnd(token) < end; });
+            if (synced == local.end()) {
+                first = local.size();
+                break;
+            }
+            if (tokenEnd(*synced) == lexer.cursor_) {
+                first = static_cast<size_t>(synced - local.begin()) + 1;
+                break;
+            }
+            tokens.push_back(lexer.next());
+            if (tokens.back().kind == TokenKind::End) return tokens;
+        }
+        if (first == local.size()) continue;
+
+        remap.assign(chunk->symbols.size(), kNoSymbol);
+        for (size_t i = first; i < local.size(); i++) {
+            RuneToken token = local[i];
+            if (token.kind == TokenKind::Identifier || token.kind == TokenKind::String) {
+                Symbol& symbol = remap[token.value];
+                if (symbol == kNoSymbol) symbol = symbols.intern(chunk->symbols.name(token.value));
+                token.value = symbol;
+            }
+            tokens.push_back(token);
+        }
+        lexer.cursor_ = tokenEnd(local.back());
+    }
+
+    // Chunks skipped whole can take the End token with them
+    while (tokens.empty() || tokens.back().kind != TokenKind::End) {
+        tokens.push_back(lexer.next());
+    }
+    return tokens;
+}
+
+std::string RuneLexer::errorMessage(const RuneToken& token, std::string_view source) {
+    const std::string_view text = source.substr(token.offset, token.length);
+    if (text.empty()) return "Unexpected end of input";
+    if (text[0] == '"' || text.substr(0, 3) == "ᛟ") return "Unterminated string";
+    if (isAscii(text[0])) return "Unexpected character: " + std::string(1, text[0]);
+    return "Unknown rune symbol: " + std::string(text);
+}
+
+// The token's span runs from its offset to the cursor
+void RuneLexer::finish(RuneToken& token, TokenKind kind) const {
+    token.kind = kind;
+    token.length = static_cast<uint32_t>(cursor_ - token.offset);
+}
+
+RuneToken RuneLexer::next() {
+    RuneToken token;
+
+    // Newlines end statements, so only spaces within a line are skipped
+    if (cursor_ < source_.size() && isSpace(source_[cursor_])) {
+        cursor_ += scan::spaces(source_.data() + cursor_, source_.size() - cursor_);
+        token.flags |= RuneToken::kSpaced;
+    }
+    token.offset = static_cast<uint32_t>(cursor_);
+
+    if (cursor_ >= source_.size()) {
+        return token;
+    }
+
+    const char c = source_[cursor_];
+    if (c == '\n') {
+        // Indentation after the last newline is left for the next token
+        const char* text = source_.data() + cursor_;
+        size_t end = scan::blankLines(text, source_.size() - cursor_);
+        while (text[end - 1] != '\n') end--;
+        cursor_ += end;
+        finish(token, TokenKind::Newline);
+    } else if (isAscii(c)) {
+        if (c == '"') {
+            lexQuotedString(token);
+        } else if (isDigit(c)) {
+            lexNumber(token);
+        } else if (isIdentifierStart(c)) {
+            lexIdentifier(token);
+        } else {
+            lexPunct(token);
+        }
+    } else {
+        size_t next = cursor_;
+        const char32_t rune = decodeUtf8(source_, next);
+
+        if (rune == U'ᛟ') { // String
+            lexString(token);
+        } else if (rune == U'ᛞ') { // Comment
+            lexComment(token);
+        } else {
+            cursor_ = next;
+            token.value = rune;
+            finish(token, runeKeyword(rune).empty() ? TokenKind::Error : TokenKind::Rune);
+        }
+    }
+    return token;
+}
+
+void RuneLexer::lexString(RuneToken& token) {
+    decodeUtf8(source_, cursor_); // Skip opening quote rune
+
+    while (cursor_ < source_.size()) {
+        if (decodeUtf8(source_, cursor_) == U'ᛟ') { // Check for closing quote
+            token.flags |= RuneToken::kRuneQuoted;
+            finish(token, TokenKind::String);
+            token.value = symbols_->intern(token.text(source_));
+            return;
+        }
+    }
+    finish(token, TokenKind::Error);
+}
+
+void RuneLexer::lexQuotedString(RuneToken& token) {
+    cursor_++; // Skip opening quote
+
+    while (cursor_ < source_.size()) {
+        cursor_ += scan::quotedStop(source_.data() + cursor_, source_.size() - cursor_);
+        if (cursor_ >= source_.size()) break;
+
+        if (source_[cursor_] == '"') {
+            cursor_++;
+            finish(token, TokenKind::String);
+            token.value = symbols_->intern(token.text(source_));
+            return;
+        }
+        // A backslash also skips the byte it escapes
+        cursor_ += source_[cursor_] == '\\' && cursor_ + 1 < source_.size() ? 2 : 1;
+    }
+    finish(token, TokenKind::Error);
+}
+
+void RuneLexer::lexComment(RuneToken& token) {
+    cursor_ += 3; // ᛞ
+    cursor_ += scan::lineEnd(source_.data() + cursor_, source_.size() - cursor_);
+    finish(token, TokenKind::Comment);
+}
+
+void RuneLexer::lexNumber(RuneToken& token) {
+    if (source_[cursor_] == '0' && cursor_ + 1 < source_.size() &&
+        (source_[cursor_ + 1] == 'x' || source_[cursor_ + 1] == 'X')) {
+        cursor_ += 2;
+        while (cursor_ < source_.size() && isHexDigit(source_[cursor_])) cursor_++;
+    } else {
+        while (cursor_ < source_.size() && isDigit(source_[cursor_])) cursor_++;
+        if (cursor_ + 1 < source_.size() && source_[cursor_] == '.' && isDigit(source_[cursor_ + 1])) {
+            cursor_++;
+            while (cursor_ < source_.size() && isDigit(source_[cursor_])) cursor_++;
+        }
+    }
+    finish(token, TokenKind::Number);
+}
+
+void RuneLexer::lexIdentifier(RuneToken& token) {
+    while (cursor_ < source_.size() && isIdentifierChar(source_[cursor_])) cursor_++;
+    finish(token, TokenKind::Identifier);
+    token.value = symbols_->intern(token.text(source_));
+}
+
+void RuneLexer::lexPunct(RuneToken& token) {
+    static const std::string_view twoCharOperators[] = {
+        "==", "!=", "<=", ">=", "&&", "||", "<<", ">>", "->"
+    };
+    static const std::string_view singleCharOperators = "(){}[],;.+-*/%<>=!&|^~:";
+
+    const std::string_view rest = source_.substr(cursor_, 2);
+    for (std::string_view op : twoCharOperators) {
+        if (rest == op) {
+            cursor_ += 2;
+            finish(token, TokenKind::Punct);
+            return;
+        }
+    }
+
+    const bool known = singleCharOperators.find(source_[cursor_]) != std::string_view::npos;
+    cursor_++;
+    finish(token, known ? TokenKind::Punct : TokenKind::Error);
+}
+
+} // namespace RuneLang
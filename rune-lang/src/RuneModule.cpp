@@ -0,0 +1,253 @@
+#include "../include/RuneModule.hpp"
+#include "../include/RuneError.hpp"
+#include "../include/RuneHash.hpp"
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <unistd.h>
+
+namespace RuneLang {
+
+using namespace Bytecode;
+
+namespace {
+
+constexpr char kMagic[8] = {'R', 'U', 'N', 'E', 'C', '\0', '\r', '\n'};
+constexpr uint32_t kByteOrderMark = 0x01020304;
+
+enum Section : uint32_t {
+    kCode,
+    kConstants,
+    kFunctions,
+    kGlobals,
+    kNatives,
+    kLines,
+    kStrings,
+    kSectionCount
+};
+
+constexpr size_t kRecordSize[kSectionCount] = {
+    sizeof(Instruction), sizeof(Constant), sizeof(Function),
+    sizeof(StringRef), sizeof(StringRef), sizeof(LineEntry), 1
+};
+
+struct SectionEntry {
+    uint64_t offset;
+    uint64_t count;   // Records, or bytes for the string table
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t sourceHash;
+    SectionEntry sections[kSectionCount];
+};
+
+static_assert(sizeof(Header) % 8 == 0, "tables after the header must stay aligned");
+static_assert(std::is_trivially_copyable<Constant>::value && std::is_trivially_copyable<Function>::value,
+              "module records are used in place");
+static_assert(alignof(Constant) <= 8 && alignof(Function) <= 8 && alignof(LineEntry) <= 8,
+              "tables are 8-byte aligned");
+
+size_t align8(size_t size) {
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+// Constant and Function contain padding. Their fields are copied into
+// zeroed records so the same module always produces the same file.
+template <typename T>
+using Record = std::array<char, sizeof(T)>;
+
+template <typename T, typename Field>
+void put(Record<T>& record, size_t offset, const Field& field) {
+    std::memcpy(record.data() + offset, &field, sizeof(Field));
+}
+
+Record<Constant> recordOf(const Constant& constant) {
+    Record<Constant> record{};
+    put<Constant>(record, offsetof(Constant, kind), constant.kind);
+    put<Constant>(record, offsetof(Constant, integer), constant.integer);  // Whole union
+    return record;
+}
+
+Record<Function> recordOf(const Function& function) {
+    Record<Function> record{};
+    put<Function>(record, offsetof(Function, name), function.name);
+    put<Function>(record, offsetof(Function, codeOffset), function.codeOffset);
+    put<Function>(record, offsetof(Function, codeSize), function.codeSize);
+    put<Function>(record, offsetof(Function, paramCount), function.paramCount);
+    put<Function>(record, offsetof(Function, registerCount), function.registerCount);
+    return record;
+}
+
+// Lays a module out into any output with append(std::string_view)
+template <typename Output>
+class ModuleWriter {
+public:
+    explicit ModuleWriter(Output& out) : out_(out), written_(0) {}
+
+    void module(const Module& module, uint64_t sourceHash) {
+        Header header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kRuneModuleVersion;
+        header.byteOrder = kByteOrderMark;
+        header.sourceHash = sourceHash;
+
+        const size_t counts[kSectionCount] = {
+            module.code.size(), module.constants.size(), module.functions.size(),
+            module.globals.size(), module.natives.size(), module.lines.size(), module.strings.size()
+        };
+        size_t offset = sizeof(Header);
+        for (uint32_t i = 0; i < kSectionCount; i++) {
+            offset = align8(offset);
+            header.sections[i] = SectionEntry{offset, counts[i]};
+            offset += counts[i] * kRecordSize[i];
+        }
+
+        bytes(&header, sizeof(header));
+        table(module.code);
+        records(module.constants);
+        records(module.functions);
+        table(module.globals);
+        table(module.natives);
+        table(module.lines);
+        align();
+        bytes(module.strings.data(), module.strings.size());
+    }
+
+private:
+    void bytes(const void* data, size_t size) {
+        out_.append(std::string_view(static_cast<const char*>(data), size));
+        written_ += size;
+    }
+
+    template <typename T>
+    void table(const std::vector<T>& items) {
+        align();
+        bytes(items.data(), items.size() * sizeof(T));
+    }
+
+    template <typename T>
+    void records(const std::vector<T>& items) {
+        align();
+        for (const T& item : items) {
+            const Record<T> record = recordOf(item);
+            bytes(record.data(), record.size());
+        }
+    }
+
+    void align() {
+        static constexpr char kZeros[8] = {};
+        bytes(kZeros, align8(written_) - written_);
+    }
+
+    Output& out_;
+    size_t written_;
+};
+
+// Numbers writeRuneModule's temporaries, so two threads writing one path
+// never share one
+std::atomic<uint64_t> nextTemp{0};
+
+} // namespace
+
+uint64_t runeSourceHash(std::string_view source) {
+    return hashBytes(source, kRuneModuleVersion);
+}
+
+void writeRuneModule(const Module& module, uint64_t sourceHash, const std::string& path) {
+    // Written beside the target and renamed over it, so a script being
+    // loaded never sees a half-written module
+    const std::string temp = path + ".tmp" + std::to_string(getpid()) + "-" + std::to_string(nextTemp++);
+    try {
+        RuneFileWriter output(temp);
+        ModuleWriter<RuneFileWriter>(output).module(module, sourceHash);
+        output.close();
+    } catch (const RuneError&) {
+        unlink(temp.c_str());
+        throw;
+    }
+
+    if (rename(temp.c_str(), path.c_str()) != 0) {
+        const int err = errno;
+        unlink(temp.c_str());
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot write " + path + ": " + std::strerror(err));
+    }
+}
+
+std::string encodeRuneModule(const Module& module, uint64_t sourceHash) {
+    std::string bytes;
+    ModuleWriter<std::string>(bytes).module(module, sourceHash);
+    return bytes;
+}
+
+RuneModuleFile::RuneModuleFile(const std::string& path) : file_(path), sourceHash_(0) {
+    const std::string_view bytes = file_.view();
+    auto reject = [&path](const char* reason) {
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, path + ": " + reason);
+    };
+
+    Header header;
+    if (bytes.size() < sizeof(header)) reject("not a Rune module");
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) reject("not a Rune module");
+    if (header.version != kRuneModuleVersion || header.byteOrder != kByteOrderMark) {
+        reject("module was written by an incompatible build");
+    }
+
+    for (uint32_t i = 0; i < kSectionCount; i++) {
+        const SectionEntry& section = header.sections[i];
+        if (section.offset % 8 != 0 || section.offset > bytes.size() ||
+            section.count > (bytes.size() - section.offset) / kRecordSize[i] ||
+            section.count > UINT32_MAX) {
+            reject("truncated or corrupt module");
+        }
+    }
+
+    auto table = [&](Section section, auto& target) {
+        using T = std::remove_const_t<std::remove_pointer_t<decltype(target.items)>>;
+        target.items = reinterpret_cast<const T*>(bytes.data() + header.sections[section].offset);
+        target.count = static_cast<uint32_t>(header.sections[section].count);
+    };
+    table(kCode, image_.code);
+    table(kConstants, image_.constants);
+    table(kFunctions, image_.functions);
+    table(kGlobals, image_.globals);
+    table(kNatives, image_.natives);
+    table(kLines, image_.lines);
+    image_.strings = bytes.substr(header.sections[kStrings].offset, header.sections[kStrings].count);
+    sourceHash_ = header.sourceHash;
+
+    // References the VM follows while binding, calling or executing are
+    // checked once here, so a damaged file fails to load instead of reading
+    // stray memory
+    const size_t stringBytes = image_.strings.size();
+    auto validString = [stringBytes](StringRef ref) {
+        return ref.offset <= stringBytes && ref.length <= stringBytes - ref.offset;
+    };
+    for (const Function& function : image_.functions) {
+        if (!validString(function.name) || function.codeOffset > image_.code.size() ||
+            function.codeSize > image_.code.size() - function.codeOffset) {
+            reject("corrupt function table");
+        }
+    }
+    for (const Constant& constant : image_.constants) {
+        const bool valid =
+            constant.kind == ConstantKind::Int || constant.kind == ConstantKind::Float ||
+            (constant.kind == ConstantKind::String && validString(constant.string)) ||
+            (constant.kind == ConstantKind::Function && constant.function < image_.functions.size());
+        if (!valid) reject("corrupt constant table");
+    }
+    for (const Table<StringRef>* names : {&image_.globals, &image_.natives}) {
+        for (StringRef name : *names) {
+            if (!validString(name)) reject("corrupt name table");
+        }
+    }
+    if (const char* reason = verifyBytecode(image_)) reject(reason);
+}
+
+} // namespace RuneLang
@@ -0,0 +1,190 @@
+#include "../include/RuneNative.hpp"
+#include "../include/RuneCodeGen.hpp"
+#include "../include/RuneError.hpp"
+#include "../include/RuneFile.hpp"
+#include "../include/RuneHash.hpp"
+#include "../include/RuneParser.hpp"
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char** environ;
+
+namespace RuneLang {
+
+namespace {
+    constexpr std::string_view kTempPrefix = ".tmp-";
+    constexpr const char* kCompileFlags[] = {"-std=c++17", "-O2", "-fPIC", "-shared"};
+
+    // Compiler output beyond this is left out of the error message
+    constexpr size_t kMaxLogBytes = 4096;
+
+    std::string readLog(const std::string& path) {
+        std::string log;
+        FILE* file = std::fopen(path.c_str(), "r");
+        if (!file) return log;
+        log.resize(kMaxLogBytes);
+        log.resize(std::fread(&log[0], 1, log.size(), file));
+        std::fclose(file);
+        while (!log.empty() && log.back() == '\n') log.pop_back();
+        return log;
+    }
+}
+
+RuneNativeLibrary::RuneNativeLibrary(const std::string& path) : path_(path), handle_(nullptr), entry_(nullptr) {
+    // RTLD_LOCAL keeps the script's symbols away from every other script
+    handle_ = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle_) {
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot load " + path + ": " + dlerror());
+    }
+    entry_ = reinterpret_cast<int (*)()>(dlsym(handle_, kRuneNativeEntry));
+    if (!entry_) {
+        dlclose(handle_);
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, path + ": missing " + kRuneNativeEntry);
+    }
+}
+
+RuneNativeLibrary::~RuneNativeLibrary() {
+    dlclose(handle_);
+}
+
+RuneJit::RuneJit(const std::string& directory, const std::string& compiler)
+    : directory_(directory), compiler_(compiler), hits_(0), misses_(0), nextTemp_(0) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) {
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot create JIT directory " + directory_ + ": " + ec.message());
+    }
+
+    std::string toolchain = compiler_;
+    for (const char* flag : kCompileFlags) {
+        toolchain += ' ';
+        toolchain += flag;
+    }
+    seed_ = hashBytes(toolchain, kRuneTableVersion);
+}
+
+std::string RuneJit::defaultCompiler() {
+    for (const char* name : {"RUNE_CXX", "CXX"}) {
+        const char* value = std::getenv(name);
+        if (value && *value) return value;
+    }
+    return "c++";
+}
+
+std::shared_ptr<const RuneNativeLibrary> RuneJit::compile(std::string_view source) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016" PRIx64 ".so", hashBytes(source, seed_));
+    const std::string objectPath = directory_ + name;
+
+    if (access(objectPath.c_str(), R_OK) == 0) {
+        hits_++;
+        return std::make_shared<const RuneNativeLibrary>(objectPath);
+    }
+    misses_++;
+
+    RuneParser parser;
+    const std::string cpp = parser.compileToNative(source);
+
+    const std::string temp = directory_ + "/" + std::string(kTempPrefix) +
+                             std::to_string(getpid()) + "-" + std::to_string(nextTemp_++);
+    const std::string cppPath = temp + ".cpp";
+    const std::string tempObject = temp + ".so";
+    const std::string logPath = temp + ".log";
+    try {
+        RuneFileWriter output(cppPath);
+        output.append(cpp);
+        output.close();
+        build(cppPath, tempObject, logPath);
+    } catch (const RuneError&) {
+        for (const std::string& path : {cppPath, tempObject, logPath}) unlink(path.c_str());
+        throw;
+    }
+    unlink(cppPath.c_str());
+    unlink(logPath.c_str());
+
+    if (rename(tempObject.c_str(), objectPath.c_str()) != 0) {
+        const int err = errno;
+        unlink(tempObject.c_str());
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot store " + objectPath + ": " + std::strerror(err));
+    }
+    return std::make_shared<const RuneNativeLibrary>(objectPath);
+}
+
+void RuneJit::build(const std::string& cppPath, const std::string& objectPath, const std::string& logPath) {
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(compiler_.c_str()));
+    for (const char* flag : kCompileFlags) argv.push_back(const_cast<char*>(flag));
+    argv.push_back(const_cast<char*>("-o"));
+    argv.push_back(const_cast<char*>(objectPath.c_str()));
+    argv.push_back(const_cast<char*>(cppPath.c_str()));
+    argv.push_back(nullptr);
+
+    // The compiler's diagnostics go to a log that is reported on failure
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+
+    pid_t pid;
+    const int spawned = posix_spawnp(&pid, compiler_.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (spawned != 0) {
+        RUNE_THROW(RuneError::ErrorCode::PROCESS_ERROR, "Cannot run " + compiler_ + ": " + std::strerror(spawned));
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            RUNE_THROW(RuneError::ErrorCode::PROCESS_ERROR, "Lost " + compiler_ + ": " + std::strerror(errno));
+        }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        RUNE_THROW(RuneError::ErrorCode::PROCESS_ERROR, compiler_ + " failed:\n" + readLog(logPath));
+    }
+}
+
+RuneNativeScript::RuneNativeScript(RuneJit& jit, const std::string& path) : jit_(jit), path_(path) {}
+
+bool RuneNativeScript::reload() {
+    std::lock_guard<std::mutex> lock(reloadMutex_);
+
+    struct stat info;
+    if (stat(path_.c_str(), &info) != 0) {
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot stat " + path_ + ": " + std::strerror(errno));
+    }
+    Stamp stamp;
+    stamp.device = info.st_dev;
+    stamp.inode = info.st_ino;
+    stamp.size = info.st_size;
+    stamp.modified = info.st_mtim;
+    if (stamp == stamp_ && std::atomic_load(&library_)) return false;
+
+    // Stamped before reading, so a write that lands in between is picked
+    // up by the next reload rather than missed
+    const RuneMappedFile source(path_);
+    std::atomic_store(&library_, jit_.compile(source.view()));
+    stamp_ = stamp;
+    return true;
+}
+
+int RuneNativeScript::run() {
+    reload();
+    return std::atomic_load(&library_)->run();
+}
+
+std::shared_ptr<const RuneNativeLibrary> RuneNativeScript::current() const {
+    return std::atomic_load(&library_);
+}
+
+} // namespace RuneLang
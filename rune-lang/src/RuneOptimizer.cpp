@@ -0,0 +1,860 @@
+#include "../include/RuneOptimizer.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <unordered_set>
+
+namespace RuneLang {
+
+namespace {
+
+using namespace Ast;
+
+// Plain integer literals are C++ ints; anything wider is left to the C++
+// compiler. The minimum is excluded because "-2147483648" is not an int.
+constexpr int64_t kIntMax = std::numeric_limits<int32_t>::max();
+
+bool fitsInt(int64_t value) {
+    return value >= -kIntMax && value <= kIntMax;
+}
+
+} // namespace
+
+void RuneOptimizer::optimize(Program& program, RuneArena& arena) {
+    arena_ = &arena;
+    env_ = Environment();
+    inFunction_ = false;
+    list(program.body);
+}
+
+Stmt* RuneOptimizer::optimizeNext(Stmt* stmt, RuneArena& arena) {
+    arena_ = &arena;
+    return statement(stmt);
+}
+
+// ---------------------------------------------------------------------------
+// Statements
+
+Stmt* RuneOptimizer::statement(Stmt* stmt) {
+    switch (stmt->kind) {
+        case NodeKind::Print: {
+            auto* print = static_cast<PrintStmt*>(stmt);
+            for (const Expr* arg : print->args) beforeCalls(arg);
+            list(print->args);
+            return stmt;
+        }
+
+        case NodeKind::Input: {
+            auto* input = static_cast<InputStmt*>(stmt);
+            if (const auto* id = as<Identifier>(input->target)) {
+                forget(id->symbol);
+            } else {
+                beforeCalls(input->target);
+                input->target = place(input->target);
+            }
+            return stmt;
+        }
+
+        case NodeKind::VarDecl: {
+            auto* decl = static_cast<VarDecl*>(stmt);
+            if (decl->init) {
+                beforeCalls(decl->init);
+                decl->init = expr(decl->init);
+            }
+            // Declared after the initializer, which must not see the new name
+            declare(decl->symbol, decl->typeName, decl->init);
+            return stmt;
+        }
+
+        case NodeKind::ExprStmt: {
+            auto* exprStmt = static_cast<ExprStmt*>(stmt);
+            beforeCalls(exprStmt->expr);
+            auto* assignment = as<AssignExpr>(exprStmt->expr);
+            if (assignment && assignment->target->kind == NodeKind::Identifier) {
+                // Only a whole-statement assignment is certain to run, so only
+                // it may give the variable a new known value
+                assignment->value = expr(assignment->value);
+                assign(static_cast<Identifier*>(assignment->target)->symbol, assignment->value);
+            } else {
+                exprStmt->expr = expr(exprStmt->expr);
+            }
+            return stmt;
+        }
+
+        case NodeKind::Block:
+            return block(static_cast<BlockStmt*>(stmt));
+
+        case NodeKind::If:
+            return ifStatement(static_cast<IfStmt*>(stmt));
+
+        case NodeKind::While:
+            return whileLoop(static_cast<WhileStmt*>(stmt));
+
+        case NodeKind::For:
+            return forLoop(static_cast<ForStmt*>(stmt));
+
+        case NodeKind::Return: {
+            auto* ret = static_cast<ReturnStmt*>(stmt);
+            if (ret->value) {
+                beforeCalls(ret->value);
+                ret->value = expr(ret->value);
+            }
+            return stmt;
+        }
+
+        case NodeKind::Function:
+            function(static_cast<FunctionDecl*>(stmt));
+            return stmt;
+
+        case NodeKind::Class:
+            classBody(static_cast<ClassDecl*>(stmt));
+            return stmt;
+
+        default:
+            return stmt;
+    }
+}
+
+BlockStmt* RuneOptimizer::block(BlockStmt* block) {
+    pushScope();
+    list(block->body);
+    popScope();
+    return block;
+}
+
+Stmt* RuneOptimizer::ifStatement(IfStmt* stmt) {
+    beforeCalls(stmt->cond);
+    stmt->cond = expr(stmt->cond);
+
+    Constant cond;
+    if (constantOf(stmt->cond, cond)) {
+        Stmt* taken = truthy(cond) ? stmt->thenBlock : stmt->elseBranch;
+        return taken ? statement(taken) : nullptr;
+    }
+
+    env_.branches++;
+    const size_t mark = env_.trail.size();
+    block(stmt->thenBlock);
+
+    // What the then branch left behind, before going back for the else branch
+    std::vector<std::pair<size_t, Binding>> afterThen;
+    for (size_t i = mark; i < env_.trail.size(); i++) {
+        const size_t index = env_.trail[i].first;
+        if (index < env_.bindings.size()) afterThen.emplace_back(index, env_.bindings[index]);
+    }
+    undo(mark);
+
+    if (stmt->elseBranch) {
+        stmt->elseBranch = statement(stmt->elseBranch);
+    }
+
+    // Keep only what both branches agree on
+    auto same = [](const Binding& a, const Binding& b) {
+        if (a.known != b.known) return false;
+        if (!a.known) return true;
+        return a.value.kind == b.value.kind && a.value.integer == b.value.integer &&
+               std::memcmp(&a.value.number, &b.value.number, sizeof(double)) == 0;
+    };
+
+    const size_t elseEnd = env_.trail.size();
+    std::unordered_set<size_t> seen;
+    for (const auto& entry : afterThen) {
+        seen.insert(entry.first);
+        if (!same(entry.second, env_.bindings[entry.first])) update(entry.first, false, Constant());
+    }
+    for (size_t i = mark; i < elseEnd; i++) {
+        const size_t index = env_.trail[i].first;
+        if (index >= env_.bindings.size() || !seen.insert(index).second) continue;
+        // The oldest entry holds the value from before the branches
+        if (!same(env_.trail[i].second, env_.bindings[index])) update(index, false, Constant());
+    }
+
+    endBranch();
+    return stmt;
+}
+
+Stmt* RuneOptimizer::whileLoop(WhileStmt* loop) {
+    // Anything the loop assigns is unknown from its first test on
+    bool calls = false;
+    written_.clear();
+    writes(loop->cond, calls);
+    writes(loop->body, calls);
+    for (Symbol symbol : written_) forget(symbol);
+    if (calls) forgetGlobals();
+
+    loop->cond = expr(loop->cond);
+    Constant cond;
+    if (constantOf(loop->cond, cond) && !truthy(cond)) {
+        return nullptr;
+    }
+
+    env_.branches++;
+    const size_t mark = env_.trail.size();
+    block(loop->body);
+    undo(mark);
+    endBranch();
+    return loop;
+}
+
+Stmt* RuneOptimizer::forLoop(ForStmt* loop) {
+    pushScope();
+    if (loop->init) loop->init = statement(loop->init);
+
+    bool calls = false;
+    written_.clear();
+    if (loop->cond) writes(loop->cond, calls);
+    if (loop->step) writes(loop->step, calls);
+    writes(loop->body, calls);
+    for (Symbol symbol : written_) forget(symbol);
+    if (calls) forgetGlobals();
+
+    if (loop->cond) {
+        loop->cond = expr(loop->cond);
+        Constant cond;
+        if (constantOf(loop->cond, cond) && !truthy(cond)) {
+            popScope();
+            if (!loop->init) return nullptr;
+            // The initializer still runs once, in a scope of its own
+            auto* init = arena_->make<BlockStmt>();
+            init->offset = loop->offset;
+            init->body.items = arena_->copyArray(&loop->init, 1);
+            init->body.count = 1;
+            return init;
+        }
+    }
+
+    env_.branches++;
+    const size_t mark = env_.trail.size();
+    block(loop->body);
+    if (loop->step) loop->step = expr(loop->step);
+    undo(mark);
+    endBranch();
+    popScope();
+    return loop;
+}
+
+void RuneOptimizer::function(FunctionDecl* function) {
+    // Functions run whenever they are called, so nothing outside them is known
+    Environment outer;
+    std::swap(outer, env_);
+    const bool wasInFunction = inFunction_;
+    inFunction_ = true;
+
+    for (uint32_t i = 0; i < function->paramCount; i++) {
+        env_.bindings.push_back(Binding{function->params[i].symbol, function->params[i].typeName, false, Constant()});
+    }
+    block(function->body);
+
+    inFunction_ = wasInFunction;
+    std::swap(outer, env_);
+}
+
+void RuneOptimizer::classBody(ClassDecl* decl) {
+    Environment outer;
+    std::swap(outer, env_);
+    const bool wasInFunction = inFunction_;
+    inFunction_ = true;
+
+    for (Stmt* member : decl->members) {
+        if (auto* field = as<VarDecl>(member)) {
+            // Fields may be set by any constructor, so only their initializers fold
+            if (field->init) field->init = expr(field->init);
+        } else if (auto* method = as<FunctionDecl>(member)) {
+            function(method);
+        }
+    }
+
+    inFunction_ = wasInFunction;
+    std::swap(outer, env_);
+}
+
+// ---------------------------------------------------------------------------
+// Expressions
+
+Expr* RuneOptimizer::expr(Expr* e) {
+    switch (e->kind) {
+        case NodeKind::Identifier: {
+            const Symbol symbol = static_cast<Identifier*>(e)->symbol;
+            for (size_t i = env_.bindings.size(); i-- > 0;) {
+                const Binding& binding = env_.bindings[i];
+                if (binding.symbol == symbol) {
+                    return binding.known ? literal(binding.value, e) : e;
+                }
+            }
+            return e;
+        }
+
+        case NodeKind::Unary: {
+            auto* unary = static_cast<UnaryExpr*>(e);
+            unary->operand = expr(unary->operand);
+            Constant operand;
+            Constant result;
+            if (constantOf(unary->operand, operand) && foldUnary(unary->op, operand, result)) {
+                return literal(result, e);
+            }
+            return e;
+        }
+
+        case NodeKind::Binary: {
+            auto* binary = static_cast<BinaryExpr*>(e);
+            binary->lhs = expr(binary->lhs);
+
+            Constant lhs;
+            const bool lhsKnown = constantOf(binary->lhs, lhs);
+            if (lhsKnown && (binary->op == BinaryOp::LogicalAnd || binary->op == BinaryOp::LogicalOr) &&
+                truthy(lhs) == (binary->op == BinaryOp::LogicalOr)) {
+                // Short-circuited: the right operand is never evaluated
+                Constant result;
+                result.kind = Constant::Kind::Bool;
+                result.integer = truthy(lhs);
+                return literal(result, e);
+            }
+
+            binary->rhs = expr(binary->rhs);
+            Constant rhs;
+            Constant result;
+            if (lhsKnown && constantOf(binary->rhs, rhs) && foldBinary(binary->op, lhs, rhs, result)) {
+                return literal(result, e);
+            }
+            return e;
+        }
+
+        case NodeKind::Assign: {
+            auto* assignment = static_cast<AssignExpr*>(e);
+            assignment->target = place(assignment->target);
+            assignment->value = expr(assignment->value);
+            if (const auto* id = as<Identifier>(assignment->target)) forget(id->symbol);
+            return e;
+        }
+
+        case NodeKind::Call: {
+            auto* call = static_cast<CallExpr*>(e);
+            call->callee = place(call->callee);
+            list(call->args);
+            return e;
+        }
+
+        case NodeKind::Index:
+        case NodeKind::Member:
+            return place(e);
+
+        case NodeKind::Builtin:
+            list(static_cast<BuiltinCall*>(e)->args);
+            return e;
+
+        default:
+            return e;
+    }
+}
+
+// Expression naming a variable or callee rather than reading a value
+Expr* RuneOptimizer::place(Expr* e) {
+    switch (e->kind) {
+        case NodeKind::Identifier:
+            return e;
+
+        case NodeKind::Index: {
+            auto* index = static_cast<IndexExpr*>(e);
+            index->base = place(index->base);
+            index->index = expr(index->index);
+            return e;
+        }
+
+        case NodeKind::Member: {
+            auto* member = static_cast<MemberExpr*>(e);
+            member->base = place(member->base);
+            return e;
+        }
+
+        default:
+            return expr(e);
+    }
+}
+
+void RuneOptimizer::list(NodeList<Stmt>& items) {
+    const size_t mark = scratch_.size();
+    bool changed = false;
+    for (Stmt* item : items) {
+        Stmt* rewritten = statement(item);
+        changed |= rewritten != item;
+        if (rewritten) scratch_.push_back(rewritten);
+    }
+
+    if (changed) {
+        const size_t count = scratch_.size() - mark;
+        auto** copy = static_cast<Stmt**>(arena_->allocate(sizeof(Stmt*) * (count ? count : 1), alignof(Stmt*)));
+        for (size_t i = 0; i < count; i++) copy[i] = static_cast<Stmt*>(scratch_[mark + i]);
+        items.items = copy;
+        items.count = static_cast<uint32_t>(count);
+    }
+    scratch_.resize(mark);
+}
+
+void RuneOptimizer::list(NodeList<Expr>& items) {
+    const size_t mark = scratch_.size();
+    bool changed = false;
+    for (Expr* item : items) {
+        Expr* rewritten = expr(item);
+        changed |= rewritten != item;
+        scratch_.push_back(rewritten);
+    }
+
+    if (changed) {
+        auto** copy = static_cast<Expr**>(arena_->allocate(sizeof(Expr*) * items.count, alignof(Expr*)));
+        for (uint32_t i = 0; i < items.count; i++) copy[i] = static_cast<Expr*>(scratch_[mark + i]);
+        items.items = copy;
+    }
+    scratch_.resize(mark);
+}
+
+// ---------------------------------------------------------------------------
+// Constants
+
+bool RuneOptimizer::constantOf(const Expr* e, Constant& value) {
+    switch (e->kind) {
+        case NodeKind::IntLiteral:
+            value.kind = Constant::Kind::Int;
+            value.integer = static_cast<const IntLiteral*>(e)->value;
+            return true;
+
+        case NodeKind::FloatLiteral: {
+            const auto* literal = static_cast<const FloatLiteral*>(e);
+            value.kind = !literal->text.empty() && literal->text.back() == 'f'
+                ? Constant::Kind::Float : Constant::Kind::Double;
+            value.number = literal->value;
+            return true;
+        }
+
+        case NodeKind::BoolLiteral:
+            value.kind = Constant::Kind::Bool;
+            value.integer = static_cast<const BoolLiteral*>(e)->value;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool RuneOptimizer::truthy(const Constant& value) {
+    return value.kind == Constant::Kind::Int || value.kind == Constant::Kind::Bool
+        ? value.integer != 0 : value.number != 0.0;
+}
+
+// Value a variable of the given C++ type holds once value is stored in it.
+// Only types whose value a literal can stand in for are tracked.
+bool RuneOptimizer::convert(std::string_view typeName, const Constant& value, Constant& converted) {
+    const bool integral = value.kind == Constant::Kind::Int || value.kind == Constant::Kind::Bool;
+    const double number = integral ? static_cast<double>(value.integer) : value.number;
+
+    if (typeName == "float") {
+        const float narrowed = integral ? static_cast<float>(value.integer) : static_cast<float>(value.number);
+        if (!std::isfinite(narrowed)) return false;
+        converted.kind = Constant::Kind::Float;
+        converted.number = narrowed;
+        return true;
+    }
+    if (typeName == "double") {
+        converted.kind = Constant::Kind::Double;
+        converted.number = number;
+        return true;
+    }
+    if (typeName == "bool") {
+        converted.kind = Constant::Kind::Bool;
+        converted.integer = truthy(value);
+        return true;
+    }
+    return false;
+}
+
+bool RuneOptimizer::foldUnary(UnaryOp op, const Constant& operand, Constant& result) {
+    const bool integral = operand.kind == Constant::Kind::Int || operand.kind == Constant::Kind::Bool;
+    switch (op) {
+        case UnaryOp::Negate:
+            if (integral) {
+                if (!fitsInt(operand.integer)) return false;
+                result.kind = Constant::Kind::Int;
+                result.integer = -operand.integer;
+            } else {
+                result.kind = operand.kind;
+                result.number = -operand.number;
+            }
+            return true;
+
+        case UnaryOp::Not:
+            result.kind = Constant::Kind::Bool;
+            result.integer = !truthy(operand);
+            return true;
+
+        case UnaryOp::BitNot:
+            if (!integral || !fitsInt(operand.integer)) return false;
+            result.kind = Constant::Kind::Int;
+            result.integer = ~operand.integer;
+            return fitsInt(result.integer);
+    }
+    return false;
+}
+
+bool RuneOptimizer::foldBinary(BinaryOp op, const Constant& lhs, const Constant& rhs, Constant& result) {
+    using Kind = Constant::Kind;
+    const bool lhsIntegral = lhs.kind == Kind::Int || lhs.kind == Kind::Bool;
+    const bool rhsIntegral = rhs.kind == Kind::Int || rhs.kind == Kind::Bool;
+
+    if (op == BinaryOp::LogicalAnd || op == BinaryOp::LogicalOr) {
+        result.kind = Kind::Bool;
+        result.integer = op == BinaryOp::LogicalAnd ? truthy(lhs) && truthy(rhs) : truthy(lhs) || truthy(rhs);
+        return true;
+    }
+
+    auto compare = [&](auto a, auto b) {
+        result.kind = Kind::Bool;
+        switch (op) {
+            case BinaryOp::Less: result.integer = a < b; return true;
+            case BinaryOp::Greater: result.integer = a > b; return true;
+            case BinaryOp::LessEq: result.integer = a <= b; return true;
+            case BinaryOp::GreaterEq: result.integer = a >= b; return true;
+            case BinaryOp::Equal: result.integer = a == b; return true;
+            case BinaryOp::NotEqual: result.integer = a != b; return true;
+            default: return false;
+        }
+    };
+
+    if (lhsIntegral && rhsIntegral) {
+        const int64_t a = lhs.integer;
+        const int64_t b = rhs.integer;
+        if (!fitsInt(a) || !fitsInt(b)) return false;
+        if (compare(a, b)) return true;
+
+        int64_t value;
+        switch (op) {
+            case BinaryOp::Add: value = a + b; break;
+            case BinaryOp::Sub: value = a - b; break;
+            case BinaryOp::Mul: value = a * b; break;
+            case BinaryOp::Div:
+                if (b == 0) return false;
+                value = a / b;
+                break;
+            case BinaryOp::Mod:
+                if (b == 0) return false;
+                value = a % b;
+                break;
+            case BinaryOp::Shl:
+                if (a < 0 || b < 0 || b > 31) return false;
+                value = a << b;
+                break;
+            case BinaryOp::Shr:
+                if (a < 0 || b < 0 || b > 31) return false;
+                value = a >> b;
+                break;
+            case BinaryOp::BitAnd: value = a & b; break;
+            case BinaryOp::BitOr: value = a | b; break;
+            case BinaryOp::BitXor: value = a ^ b; break;
+            default: return false;
+        }
+        if (!fitsInt(value)) return false;
+        result.kind = Kind::Int;
+        result.integer = value;
+        return true;
+    }
+
+    // Usual arithmetic conversions: double wins over float, float over int
+    const bool useDouble = lhs.kind == Kind::Double || rhs.kind == Kind::Double;
+    double value;
+    if (useDouble) {
+        const double a = lhsIntegral ? static_cast<double>(lhs.integer) : lhs.number;
+        const double b = rhsIntegral ? static_cast<double>(rhs.integer) : rhs.number;
+        if (compare(a, b)) return true;
+        switch (op) {
+            case BinaryOp::Add: value = a + b; break;
+            case BinaryOp::Sub: value = a - b; break;
+            case BinaryOp::Mul: value = a * b; break;
+            case BinaryOp::Div: value = a / b; break;
+            default: return false;
+        }
+    } else {
+        const float a = lhsIntegral ? static_cast<float>(lhs.integer) : static_cast<float>(lhs.number);
+        const float b = rhsIntegral ? static_cast<float>(rhs.integer) : static_cast<float>(rhs.number);
+        if (compare(a, b)) return true;
+        float narrowed;
+        switch (op) {
+            case BinaryOp::Add: narrowed = a + b; break;
+            case BinaryOp::Sub: narrowed = a - b; break;
+            case BinaryOp::Mul: narrowed = a * b; break;
+            case BinaryOp::Div: narrowed = a / b; break;
+            default: return false;
+        }
+        value = narrowed;
+    }
+
+    if (!std::isfinite(value)) return false;
+    result.kind = useDouble ? Kind::Double : Kind::Float;
+    result.number = value;
+    return true;
+}
+
+Expr* RuneOptimizer::literal(const Constant& value, const Node* at) {
+    Expr* node;
+    if (value.kind == Constant::Kind::Bool) {
+        auto* literal = arena_->make<BoolLiteral>();
+        literal->value = value.integer != 0;
+        node = literal;
+    } else {
+        // Shortest text that reads back as the same value
+        char text[40];
+        std::to_chars_result written;
+        if (value.kind == Constant::Kind::Int) {
+            written = std::to_chars(text, text + sizeof(text), value.integer);
+        } else if (value.kind == Constant::Kind::Float) {
+            written = std::to_chars(text, text + sizeof(text) - 3, static_cast<float>(value.number));
+        } else {
+            written = std::to_chars(text, text + sizeof(text) - 3, value.number);
+        }
+        char* end = written.ptr;
+        if (value.kind != Constant::Kind::Int) {
+            if (std::find_if(text, end, [](char c) { return c == '.' || c == 'e'; }) == end) {
+                *end++ = '.';
+                *end++ = '0';
+            }
+            if (value.kind == Constant::Kind::Float) *end++ = 'f';
+        }
+
+        const size_t length = static_cast<size_t>(end - text);
+        char* stored = static_cast<char*>(arena_->allocate(length, 1));
+        std::memcpy(stored, text, length);
+
+        if (value.kind == Constant::Kind::Int) {
+            auto* literal = arena_->make<IntLiteral>();
+            literal->value = value.integer;
+            literal->text = std::string_view(stored, length);
+            node = literal;
+        } else {
+            auto* literal = arena_->make<FloatLiteral>();
+            literal->value = value.number;
+            literal->text = std::string_view(stored, length);
+            node = literal;
+        }
+    }
+    node->offset = at->offset;
+    return node;
+}
+
+// ---------------------------------------------------------------------------
+// Known values
+
+void RuneOptimizer::pushScope() {
+    env_.scopes.push_back(env_.bindings.size());
+}
+
+void RuneOptimizer::popScope() {
+    env_.bindings.resize(env_.scopes.back());
+    env_.scopes.pop_back();
+}
+
+void RuneOptimizer::declare(Symbol symbol, std::string_view typeName, const Expr* init) {
+    Binding binding{symbol, typeName, false, Constant()};
+    Constant value;
+    if (init && constantOf(init, value)) {
+        binding.known = convert(typeName, value, binding.value);
+    }
+
+    // A name declared again in the same scope (a global, in practice) keeps
+    // its binding, so long scripts do not grow the list lookups walk
+    for (size_t i = env_.bindings.size(); i-- > env_.scopes.back();) {
+        if (env_.bindings[i].symbol != symbol) continue;
+        if (env_.branches > 0) env_.trail.emplace_back(i, env_.bindings[i]);
+        env_.bindings[i] = binding;
+        if (binding.known && isGlobal(i)) env_.liveGlobals.push_back(i);
+        return;
+    }
+
+    env_.bindings.push_back(binding);
+    if (binding.known && isGlobal(env_.bindings.size() - 1)) {
+        env_.liveGlobals.push_back(env_.bindings.size() - 1);
+    }
+}
+
+void RuneOptimizer::assign(Symbol symbol, const Expr* value) {
+    for (size_t i = env_.bindings.size(); i-- > 0;) {
+        if (env_.bindings[i].symbol != symbol) continue;
+        Constant constant;
+        Constant converted;
+        const bool known = constantOf(value, constant) && convert(env_.bindings[i].typeName, constant, converted);
+        update(i, known, converted);
+        return;
+    }
+}
+
+void RuneOptimizer::update(size_t index, bool known, const Constant& value) {
+    Binding& binding = env_.bindings[index];
+    if (env_.branches > 0) env_.trail.emplace_back(index, binding);
+    binding.known = known;
+    binding.value = value;
+    if (known && isGlobal(index)) env_.liveGlobals.push_back(index);
+}
+
+void RuneOptimizer::forget(Symbol symbol) {
+    for (size_t i = env_.bindings.size(); i-- > 0;) {
+        if (env_.bindings[i].symbol != symbol) continue;
+        if (env_.bindings[i].known) update(i, false, Constant());
+        return;
+    }
+}
+
+// A call may run any function, and functions may assign any global
+void RuneOptimizer::forgetGlobals() {
+    for (size_t index : env_.liveGlobals) {
+        if (isGlobal(index) && env_.bindings[index].known) {
+            Binding& binding = env_.bindings[index];
+            if (env_.branches > 0) env_.trail.emplace_back(index, binding);
+            binding.known = false;
+        }
+    }
+    env_.liveGlobals.clear();
+}
+
+bool RuneOptimizer::isGlobal(size_t index) const {
+    if (inFunction_) return false;
+    const size_t end = env_.scopes.size() > 1 ? env_.scopes[1] : env_.bindings.size();
+    return index < end;
+}
+
+void RuneOptimizer::undo(size_t mark) {
+    while (env_.trail.size() > mark) {
+        const auto [index, old] = env_.trail.back();
+        env_.trail.pop_back();
+        if (index >= env_.bindings.size()) continue;
+        env_.bindings[index] = old;
+        if (old.known && isGlobal(index)) env_.liveGlobals.push_back(index);
+    }
+}
+
+void RuneOptimizer::endBranch() {
+    // Outside every branch there is nothing left to restore
+    if (--env_.branches == 0) env_.trail.clear();
+}
+
+void RuneOptimizer::beforeCalls(const Expr* e) {
+    if (inFunction_) return;
+    bool calls = false;
+    written_.clear();
+    writes(e, calls);
+    if (calls) forgetGlobals();
+}
+
+void RuneOptimizer::writes(const Stmt* stmt, bool& calls) {
+    switch (stmt->kind) {
+        case NodeKind::Print:
+            for (const Expr* arg : static_cast<const PrintStmt*>(stmt)->args) writes(arg, calls);
+            break;
+
+        case NodeKind::Input: {
+            const Expr* target = static_cast<const InputStmt*>(stmt)->target;
+            if (const auto* id = as<Identifier>(target)) {
+                written_.push_back(id->symbol);
+            } else {
+                writes(target, calls);
+            }
+            break;
+        }
+
+        case NodeKind::VarDecl:
+            if (const Expr* init = static_cast<const VarDecl*>(stmt)->init) writes(init, calls);
+            break;
+
+        case NodeKind::ExprStmt:
+            writes(static_cast<const ExprStmt*>(stmt)->expr, calls);
+            break;
+
+        case NodeKind::Block:
+            for (const Stmt* child : static_cast<const BlockStmt*>(stmt)->body) writes(child, calls);
+            break;
+
+        case NodeKind::If: {
+            const auto* branch = static_cast<const IfStmt*>(stmt);
+            writes(branch->cond, calls);
+            writes(branch->thenBlock, calls);
+            if (branch->elseBranch) writes(branch->elseBranch, calls);
+            break;
+        }
+
+        case NodeKind::While: {
+            const auto* loop = static_cast<const WhileStmt*>(stmt);
+            writes(loop->cond, calls);
+            writes(loop->body, calls);
+            break;
+        }
+
+        case NodeKind::For: {
+            const auto* loop = static_cast<const ForStmt*>(stmt);
+            if (loop->init) writes(loop->init, calls);
+            if (loop->cond) writes(loop->cond, calls);
+            if (loop->step) writes(loop->step, calls);
+            writes(loop->body, calls);
+            break;
+        }
+
+        case NodeKind::Return:
+            if (const Expr* value = static_cast<const ReturnStmt*>(stmt)->value) writes(value, calls);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void RuneOptimizer::writes(const Expr* e, bool& calls) {
+    switch (e->kind) {
+        case NodeKind::Unary:
+            writes(static_cast<const UnaryExpr*>(e)->operand, calls);
+            break;
+
+        case NodeKind::Binary: {
+            const auto* binary = static_cast<const BinaryExpr*>(e);
+            writes(binary->lhs, calls);
+            writes(binary->rhs, calls);
+            break;
+        }
+
+        case NodeKind::Assign: {
+            const auto* assignment = static_cast<const AssignExpr*>(e);
+            if (const auto* id = as<Identifier>(assignment->target)) {
+                written_.push_back(id->symbol);
+            } else {
+                writes(assignment->target, calls);
+            }
+            writes(assignment->value, calls);
+            break;
+        }
+
+        case NodeKind::Call: {
+            const auto* call = static_cast<const CallExpr*>(e);
+            // Host functions behind a prefix rune cannot reach script variables
+            if (call->callee->kind != NodeKind::Scoped) calls = true;
+            writes(call->callee, calls);
+            for (const Expr* arg : call->args) writes(arg, calls);
+            break;
+        }
+
+        case NodeKind::Index: {
+            const auto* index = static_cast<const IndexExpr*>(e);
+            writes(index->base, calls);
+            writes(index->index, calls);
+            break;
+        }
+
+        case NodeKind::Member:
+            writes(static_cast<const MemberExpr*>(e)->base, calls);
+            break;
+
+        case NodeKind::Builtin:
+            for (const Expr* arg : static_cast<const BuiltinCall*>(e)->args) writes(arg, calls);
+            break;
+
+        default:
+            break;
+    }
+}
+
+} // namespace RuneLang
@@ -1,275 +1,1097 @@
 #include "../include/RuneParser.hpp"
-#include <sstream>
-#include <fstream>
+#include "../include/RuneCodeGen.hpp"
+#include "../include/RuneFile.hpp"
+#include "../include/RuneCache.hpp"
+#include "../include/RuneError.hpp"
+#include "../include/RuneHash.hpp"
+#include "../include/RuneKeywords.hpp"
+#include "../include/RuneModule.hpp"
+#include "../include/RuneOptimizer.hpp"
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <thread>
+#include <unistd.h>
 
 namespace RuneLang {
 
-RuneParser::RuneParser() : currentLine(1), currentColumn(1) {
-    initializeRuneMap();
-}
-
-void RuneParser::initializeRuneMap() {
-    runeToKeyword = {
-        {"ᚠ", "std::cout << "}, // Output to console
-        {"ᚱ", "for"},           // For-loop
-        {"ᚷ", "if"},            // If-condition
-        {"ᛏ", "return"},        // Return from function
-        {"ᚢ", "+"},             // Addition operator
-        {"ᚦ", "-"},             // Subtraction operator
-        {"ᛉ", "while"},         // While-loop
-        {"ᚨ", "std::vector<"},  // Array declaration
-        {"ᛜ", "std::cin >> "},  // Input from console
-        {"ᛝ", "std::string"},   // String type
-        {"ᛞ", "#"},             // Comment marker
-        {"ᛟ", "\""},            // String delimiter
-        {"ᛗ", "->"},            // Arrow operator
-        {"ᚹ", "*"},             // Multiplication
-        {"ᚺ", "/"},             // Division
-        {"ᚻ", "%"},             // Modulo
-        {"ᚼ", "<<"},            // Left shift
-        {"ᚽ", ">>"},            // Right shift
-        {"ᚾ", "&"},             // Bitwise AND
-        {"ᚿ", "|"},             // Bitwise OR
-        {"ᛀ", "^"},             // Bitwise XOR
-        {"ᛁ", "~"},             // Bitwise NOT
-        {"ᛚ", "float"},         // Float array type
-        {"ᛦ", "double"},        // Double array type
-        {"ᛙ", "char"},          // Char type
-        {"ᛠ", "double"},        // Double type
-        {"ᛡ", "bool"},          // Boolean type
-        {"ᛤ", "void"},          // Void return type
-        {"ᛥ", "class"},         // Class declaration
-        {"ᛦ", "namespace"},     // Namespace declaration
-        {"ᛧ", "struct"},        // Struct declaration
-        {"ᛨ", "RuneSystem::"},  // System operations prefix
-        {"ᛩ", "RuneProcess::"}, // Process operations prefix
-        {"ᛪ", "RuneThread::"},  // Thread operations prefix
-        {"᛫", "RuneFileSystem::"}, // File system operations prefix
-        {"᛬", "allocateMemory"}, // Allocate memory
-        {"ᛮ", "freeMemory"},     // Free memory
-        {"ᛯ", "createProcess"}, // Create new process
-        {"ᛰ", "createThread"}, // Create new thread
-        {"ᛱ", "terminate"},    // Terminate process/thread
-        {"ᛲ", "createFile"},    // Create file
-        {"ᛳ", "deleteFile"},    // Delete file
-        {"ᛴ", "readFile"},      // Read file
-        {"ᛵ", "writeFile"},     // Write file
-    };
-}
-
-void RuneParser::updatePosition(const std::string& code, size_t& pos) {
-    if (code[pos] == '\n') {
-        currentLine++;
-        currentColumn = 1;
-    } else {
-        currentColumn++;
+namespace {
+
+// Runes that introduce a typed declaration
+bool isTypeRune(char32_t rune) {
+    switch (rune) {
+        case U'ᛚ': case U'ᛦ': case U'ᛙ': case U'ᛠ':
+        case U'ᛡ': case U'ᛤ': case U'ᛝ':
+        case U'ᛩ': case U'ᛪ':
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Runes that scope the name written directly after them
+bool isPrefixRune(char32_t rune) {
+    return rune == U'ᛨ' || rune == U'ᛩ' || rune == U'ᛪ' || rune == U'᛫';
+}
+
+// Operation runes that take their operands without parentheses
+bool isBuiltinRune(char32_t rune) {
+    switch (rune) {
+        case U'᛬': case U'ᛮ': case U'ᛯ': case U'ᛰ': case U'ᛱ':
+        case U'ᛲ': case U'ᛳ': case U'ᛴ': case U'ᛵ':
+            return true;
+        default:
+            return false;
     }
-    pos++;
 }
 
-void RuneParser::skipWhitespace(const std::string& code, size_t& pos) {
-    while (pos < code.length() && std::isspace(code[pos])) {
-        updatePosition(code, pos);
+// Wrapped around the generated statements of every translation unit
+constexpr std::string_view kCppPrologue = "#include <iostream>\n\n";
+constexpr std::string_view kCppEpilogue = "\nint main() {\n\treturn 0;\n}";
+constexpr uint32_t kCppFirstLine = 3;  // Where generated code starts, after kCppPrologue
+
+// Source maps are cached beside the code, under its key with these bits flipped
+constexpr uint64_t kSourceMapKey = 0x9e3779b97f4a7c15ULL;
+
+RuneCacheKey sourceMapKey(const RuneCacheKey& key) {
+    return {key.hash ^ kSourceMapKey, key.check ^ kSourceMapKey, key.length};
+}
+
+void writeFile(const std::string& path, std::string_view contents) {
+    RuneFileWriter output(path);
+    output.append(contents);
+    output.close();
+}
+
+void checkSourceSize(std::string_view runeCode) {
+    if (runeCode.size() > kMaxRuneSourceBytes) {
+        throw RuneParseError("Source is " + std::to_string(runeCode.size()) +
+                             " bytes; sources of 4 GiB or more are not supported");
     }
 }
 
-std::string RuneParser::handleString(const std::string& code, size_t& pos) {
-    std::string result = "\"";
-    pos++; // Skip opening quote rune
-    
-    while (pos < code.length()) {
-        if (std::string(1, code[pos]) == "ᛟ") { // Check for closing quote
-            pos++;
+size_t builtinArity(char32_t rune) {
+    return rune == U'ᛵ' ? 2 : 1;
+}
+
+bool isArithmetic(Ast::BinaryOp op) {
+    switch (op) {
+        case Ast::BinaryOp::Add: case Ast::BinaryOp::Sub: case Ast::BinaryOp::Mul:
+        case Ast::BinaryOp::Div: case Ast::BinaryOp::Mod: case Ast::BinaryOp::Shl:
+        case Ast::BinaryOp::Shr: case Ast::BinaryOp::BitAnd: case Ast::BinaryOp::BitOr:
+        case Ast::BinaryOp::BitXor:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool isAssignable(const Ast::Expr* expr) {
+    return expr->kind == Ast::NodeKind::Identifier ||
+           expr->kind == Ast::NodeKind::Index ||
+           expr->kind == Ast::NodeKind::Member;
+}
+
+bool isCallable(const Ast::Expr* expr) {
+    return expr->kind == Ast::NodeKind::Identifier ||
+           expr->kind == Ast::NodeKind::Member ||
+           expr->kind == Ast::NodeKind::Scoped;
+}
+
+// Numbers compileFile's temporaries, so two threads writing one output
+// path never share one
+std::atomic<uint64_t> nextTemp{0};
+
+} // namespace
+
+RuneParser::RuneParser()
+    : current(0), lexThreads(std::thread::hardware_concurrency()), streaming(true), arena(nullptr), cache(nullptr), optimize(true),
+      sourceMap(false),
+      recover(false), panicking(false), resyncing(false), panicOffset(0) {
+}
+
+// ---------------------------------------------------------------------------
+// Lexer
+
+// The parser walks a window of the token array. Lexer errors arrive as
+// Error tokens and are reported when they become the lookahead.
+void RuneParser::nextToken() {
+    if (panicking) {
+        lookahead = Token();
+        lookahead.offset = static_cast<uint32_t>(panicOffset);
+        return;
+    }
+    seek(tokens[current].kind == TokenKind::End ? current : current + 1);
+}
+
+void RuneParser::seek(size_t index) {
+    if (index == tokens.size()) lexer.lex(tokens, kTokenBatch);
+    current = index;
+    lookahead = tokens[current];
+    if (lookahead.kind == TokenKind::Error) {
+        error(RuneLexer::errorMessage(lookahead, source), lookahead);
+    }
+}
+
+RuneParser::LexerState RuneParser::saveState() const {
+    return LexerState{current, lookahead};
+}
+
+void RuneParser::restoreState(const LexerState& state) {
+    current = state.index;
+    lookahead = state.token;
+}
+
+// ---------------------------------------------------------------------------
+// Parser helpers
+
+void RuneParser::error(const std::string& message, const Token& at) {
+    if (!recover) {
+        const RuneLineIndex::Position position = lines.locate(at.offset);
+        throw RuneParseError(message, position.line, position.column);
+    }
+
+    // Only the first error of a statement is recorded. The lexer then
+    // reports End, so the parse functions return without another error
+    // until the statement is skipped by synchronize.
+    if (panicking || resyncing) return;
+    if (errors.size() < kMaxDiagnostics) {
+        const RuneLineIndex::Position position = lines.locate(at.offset);
+        errors.emplace_back(message, position.line, position.column);
+    }
+    panicking = true;
+    panicOffset = at.offset;
+    lookahead = Token();
+    lookahead.offset = at.offset;
+}
+
+// Skip the rest of the statement starting at start that failed to parse.
+// It is lexed again from the start and skipped up to the first line end or
+// ';' after the error that is not inside braces, or up to the '}' closing
+// the enclosing block.
+void RuneParser::synchronize(size_t start) {
+    panicking = false;
+    resyncing = true;
+    seek(start);
+
+    int depth = 0;
+    while (lookahead.kind != TokenKind::End) {
+        if (isPunct("{")) {
+            depth++;
+        } else if (isPunct("}")) {
+            if (depth == 0) break;
+            depth--;
+        } else if ((lookahead.kind == TokenKind::Newline || isPunct(";")) &&
+                   depth == 0 && lookahead.offset >= panicOffset) {
             break;
         }
-        result += code[pos];
-        updatePosition(code, pos);
+        nextToken();
+    }
+    resyncing = false;
+}
+
+void RuneParser::failOnDiagnostics() const {
+    if (!errors.empty()) throw errors.front();
+}
+
+template <typename T>
+T* RuneParser::makeNode(const Token& at) {
+    T* node = arena->make<T>();
+    node->offset = static_cast<uint32_t>(at.offset);
+    return node;
+}
+
+// Move the children pushed since mark into an arena array
+template <typename T>
+Ast::NodeList<T> RuneParser::finishList(size_t mark) {
+    Ast::NodeList<T> list;
+    list.count = static_cast<uint32_t>(scratch.size() - mark);
+    if (list.count > 0) {
+        T** items = static_cast<T**>(arena->allocate(sizeof(T*) * list.count, alignof(T*)));
+        for (uint32_t i = 0; i < list.count; i++) {
+            items[i] = static_cast<T*>(scratch[mark + i]);
+        }
+        list.items = items;
     }
-    
-    return result + "\"";
+    scratch.resize(mark);
+    return list;
+}
+
+bool RuneParser::isRune(char32_t rune) const {
+    return lookahead.kind == TokenKind::Rune && lookahead.rune() == rune;
 }
 
-std::string RuneParser::handleComment(const std::string& code, size_t& pos) {
-    std::string result = "//";
-    pos++; // Skip comment rune
-    
-    while (pos < code.length() && code[pos] != '\n') {
-        result += code[pos];
-        pos++;
+bool RuneParser::isPunct(std::string_view punct) const {
+    return lookahead.kind == TokenKind::Punct && lookahead.length == punct.size() &&
+           std::memcmp(source.data() + lookahead.offset, punct.data(), punct.size()) == 0;
+}
+
+bool RuneParser::atStatementEnd() const {
+    return lookahead.kind == TokenKind::End ||
+           lookahead.kind == TokenKind::Newline ||
+           lookahead.kind == TokenKind::Comment ||
+           isPunct(";") || isPunct("}");
+}
+
+bool RuneParser::startsExpression() const {
+    switch (lookahead.kind) {
+        case TokenKind::Number:
+        case TokenKind::String:
+        case TokenKind::Identifier:
+            return true;
+        case TokenKind::Punct:
+            return isPunct("(") || isPunct("-") || isPunct("!") || isPunct("~");
+        case TokenKind::Rune:
+            return isPrefixRune(lookahead.rune()) || isBuiltinRune(lookahead.rune()) ||
+                   lookahead.rune() == U'ᛁ';
+        default:
+            return false;
     }
-    
-    return result + "\n";
 }
 
-std::string RuneParser::handleSystemCall(const std::string& code, size_t& pos) {
-    std::string result = "RuneSystem::";
-    pos++; // Skip the system operation rune
-    
-    // Parse system call parameters
-    while (pos < code.length() && !std::isspace(code[pos])) {
-        result += code[pos];
-        updatePosition(code, pos);
+void RuneParser::expectPunct(std::string_view punct, const char* what) {
+    if (!isPunct(punct)) {
+        error(std::string("Expected ") + what, lookahead);
     }
-    
-    return result;
+    nextToken();
 }
 
-std::string RuneParser::handleProcessManagement(const std::string& code, size_t& pos) {
-    std::string result = "RuneProcess::";
-    pos++; // Skip the process operation rune
-    
-    // Parse process management parameters
-    while (pos < code.length() && !std::isspace(code[pos])) {
-        result += code[pos];
-        updatePosition(code, pos);
+void RuneParser::skipNewlines() {
+    while (lookahead.kind == TokenKind::Newline) {
+        nextToken();
     }
-    
-    return result;
 }
 
-std::string RuneParser::handleFileOperation(const std::string& code, size_t& pos) {
-    std::string result = "RuneFileSystem::";
-    pos++; // Skip the file operation rune
-    
-    // Parse file operation parameters
-    while (pos < code.length() && !std::isspace(code[pos])) {
-        result += code[pos];
-        updatePosition(code, pos);
+void RuneParser::expectStatementEnd() {
+    if (isPunct(";")) {
+        nextToken();
+    } else if (!atStatementEnd()) {
+        error("Expected end of statement", lookahead);
     }
-    
-    return result;
 }
 
-std::string RuneParser::parseRuneCode(const std::string& runeCode) {
-    std::string parsedCode;
-    size_t pos = 0;
-    
-    try {
-        while (pos < runeCode.length()) {
-            skipWhitespace(runeCode, pos);
-            if (pos >= runeCode.length()) break;
-            
-            std::string runeStr(1, runeCode[pos]);
-            
-            if (runeStr == "ᛟ") { // String
-                parsedCode += handleString(runeCode, pos);
-            } else if (runeStr == "ᛞ") { // Comment
-                parsedCode += handleComment(runeCode, pos);
-            } else if (runeStr == "ᛨ") { // System call
-                parsedCode += handleSystemCall(runeCode, pos);
-            } else if (runeStr == "ᛩ") { // Process management
-                parsedCode += handleProcessManagement(runeCode, pos);
-            } else if (runeStr == "᛫") { // File operation
-                parsedCode += handleFileOperation(runeCode, pos);
-            } else if (runeToKeyword.find(runeStr) != runeToKeyword.end()) {
-                parsedCode += runeToKeyword[runeStr];
-                updatePosition(runeCode, pos);
-            } else {
-                throw RuneParseError("Unknown rune symbol: " + runeStr, currentLine, currentColumn);
+// ---------------------------------------------------------------------------
+// Statements
+
+void RuneParser::beginProgram(std::string_view runeCode, RuneArena& programArena) {
+    startProgram(runeCode, programArena, 1);
+}
+
+void RuneParser::startProgram(std::string_view runeCode, RuneArena& programArena, size_t threads) {
+    checkSourceSize(runeCode);
+    source = runeCode;
+    lines.reset(runeCode);
+    symbols.clear();
+    lexer.reset(runeCode, symbols);
+    tokens.clear();
+    streaming = threads <= 1 || runeCode.size() < RuneLexer::kParallelBytes;
+    if (!streaming) tokens = RuneLexer::tokenizeParallel(runeCode, symbols, threads);
+    arena = &programArena;
+    scratch.clear();
+    errors.clear();
+    if (recover) errors.reserve(kMaxDiagnostics);
+    panicking = false;
+    resyncing = false;
+    seek(0);
+}
+
+Ast::Stmt* RuneParser::parseNext() {
+    // Statements never look back past their start
+    if (streaming && current >= kTokenBatch) {
+        tokens.erase(tokens.begin(), tokens.begin() + static_cast<std::ptrdiff_t>(current));
+        current = 0;
+    }
+
+    while (true) {
+        while (lookahead.kind == TokenKind::Newline || isPunct(";")) {
+            nextToken();
+        }
+        if (panicking) { // The lexer failed between statements
+            synchronize(current);
+            continue;
+        }
+        if (lookahead.kind == TokenKind::End || errors.size() >= kMaxDiagnostics) {
+            return nullptr;
+        }
+
+        const size_t start = current;
+        if (isPunct("}")) {
+            error("Unexpected '}'", lookahead);
+            synchronize(start + 1);
+            continue;
+        }
+        Ast::Stmt* stmt = parseStatement();
+        if (!panicking) return stmt;
+        synchronize(start);
+    }
+}
+
+Ast::Program RuneParser::parseProgram(std::string_view runeCode, RuneArena& programArena) {
+    startProgram(runeCode, programArena, lexThreads);
+
+    const size_t mark = scratch.size();
+    while (Ast::Stmt* stmt = parseNext()) {
+        scratch.push_back(stmt);
+    }
+
+    Ast::Program program;
+    program.body = finishList<Ast::Stmt>(mark);
+    program.source = runeCode;
+    program.symbols = &symbols;
+    return program;
+}
+
+Ast::Stmt* RuneParser::parseStatement() {
+    const Token start = lookahead;
+
+    if (start.kind == TokenKind::Comment) {
+        auto* comment = makeNode<Ast::CommentStmt>(start);
+        comment->text = text(start);
+        nextToken();
+        return comment;
+    }
+
+    if (isPunct("{")) {
+        return parseBlock();
+    }
+
+    if (start.kind == TokenKind::Rune) {
+        switch (start.rune()) {
+            case U'ᚷ': return parseIf();
+            case U'ᛉ': return parseWhile();
+            case U'ᚱ': return parseFor();
+            case U'ᛥ':
+            case U'ᛧ': return parseClass();
+            case U'ᚨ': error("ᚨ without a preceding ᚷ", start); break;
+            case U'ᛏ': {
+                Ast::Stmt* stmt = parseReturn();
+                expectStatementEnd();
+                return stmt;
             }
+            case U'ᚠ': {
+                Ast::Stmt* stmt = parsePrint();
+                expectStatementEnd();
+                return stmt;
+            }
+            case U'ᛜ': {
+                Ast::Stmt* stmt = parseInput();
+                expectStatementEnd();
+                return stmt;
+            }
+            default:
+                break;
         }
-    } catch (const std::exception& e) {
-        throw RuneParseError(e.what(), currentLine, currentColumn);
+
+        if (isTypeRune(start.rune())) {
+            bool declaration = true;
+            if (isPrefixRune(start.rune())) {
+                // ᛩname is a scoped call, ᛩ name declares a handle
+                const LexerState state = saveState();
+                nextToken();
+                declaration = lookahead.kind == TokenKind::Identifier && lookahead.spaced();
+                restoreState(state);
+            }
+            if (declaration) {
+                Ast::Stmt* stmt = parseDeclaration();
+                if (stmt->kind == Ast::NodeKind::VarDecl) {
+                    expectStatementEnd();
+                }
+                return stmt;
+            }
+        }
+    }
+
+    Ast::Stmt* stmt = parseSimpleStatement();
+    expectStatementEnd();
+    return stmt;
+}
+
+Ast::BlockStmt* RuneParser::parseBlock() {
+    skipNewlines();
+    const Token start = lookahead;
+    expectPunct("{", "'{'");
+
+    const size_t mark = scratch.size();
+    while (true) {
+        while (lookahead.kind == TokenKind::Newline || isPunct(";")) {
+            nextToken();
+        }
+        if (isPunct("}")) break;
+        if (lookahead.kind == TokenKind::End) {
+            error("Expected '}' to close block", start);
+            break;
+        }
+        const size_t statementStart = current;
+        Ast::Stmt* stmt = parseStatement();
+        if (panicking) {
+            synchronize(statementStart);
+            continue;
+        }
+        scratch.push_back(stmt);
+    }
+    nextToken();
+
+    auto* block = makeNode<Ast::BlockStmt>(start);
+    block->body = finishList<Ast::Stmt>(mark);
+    return block;
+}
+
+Ast::Stmt* RuneParser::parseIf() {
+    auto* stmt = makeNode<Ast::IfStmt>(lookahead);
+    nextToken();
+    stmt->cond = parseExpression();
+    stmt->thenBlock = parseBlock();
+
+    const LexerState state = saveState();
+    skipNewlines();
+    if (isRune(U'ᚨ')) {
+        nextToken();
+        if (isRune(U'ᚷ')) {
+            stmt->elseBranch = parseIf();
+        } else {
+            stmt->elseBranch = parseBlock();
+        }
+    } else {
+        restoreState(state);
+    }
+    return stmt;
+}
+
+Ast::Stmt* RuneParser::parseWhile() {
+    auto* stmt = makeNode<Ast::WhileStmt>(lookahead);
+    nextToken();
+    stmt->cond = parseExpression();
+    stmt->body = parseBlock();
+    return stmt;
+}
+
+Ast::Stmt* RuneParser::parseFor() {
+    auto* stmt = makeNode<Ast::ForStmt>(lookahead);
+    nextToken();
+    expectPunct("(", "'(' after ᚱ");
+
+    if (!isPunct(";")) {
+        if (lookahead.kind == TokenKind::Rune && isTypeRune(lookahead.rune())) {
+            stmt->init = parseDeclaration();
+            if (stmt->init->kind != Ast::NodeKind::VarDecl) {
+                error("Expected a variable declaration in ᚱ", lookahead);
+            }
+        } else {
+            stmt->init = parseSimpleStatement();
+        }
+    }
+    expectPunct(";", "';' after loop initialiser");
+
+    if (!isPunct(";")) {
+        stmt->cond = parseExpression();
+    }
+    expectPunct(";", "';' after loop condition");
+
+    if (!isPunct(")")) {
+        stmt->step = parseStepExpression();
+    }
+    expectPunct(")", "')' to close ᚱ");
+
+    stmt->body = parseBlock();
+    return stmt;
+}
+
+Ast::Stmt* RuneParser::parseReturn() {
+    auto* stmt = makeNode<Ast::ReturnStmt>(lookahead);
+    nextToken();
+    if (!atStatementEnd()) {
+        stmt->value = parseExpression();
+    }
+    return stmt;
+}
+
+Ast::Stmt* RuneParser::parsePrint() {
+    auto* stmt = makeNode<Ast::PrintStmt>(lookahead);
+    nextToken();
+    if (!startsExpression()) {
+        error("Expected a value after ᚠ", lookahead);
+    }
+
+    // Juxtaposed values are all written out, e.g. ᚠ"Total: " total "\n"
+    const size_t mark = scratch.size();
+    while (startsExpression()) {
+        scratch.push_back(parseExpression());
     }
-    
-    return parsedCode;
+    stmt->args = finishList<Ast::Expr>(mark);
+    return stmt;
 }
 
-std::string RuneParser::handleFunction(const std::string& code, size_t& pos) {
-    std::string returnType = runeToKeyword[std::string(1, code[pos])];
-    pos++;
+Ast::Stmt* RuneParser::parseInput() {
+    auto* stmt = makeNode<Ast::InputStmt>(lookahead);
+    nextToken();
+    const Token at = lookahead;
+    stmt->target = parsePostfix();
+    if (!isAssignable(stmt->target)) {
+        error("Expected a variable after ᛜ", at);
+    }
+    return stmt;
+}
 
-    // Skip whitespace
-    while (pos < code.length() && std::isspace(code[pos])) pos++;
+Ast::Stmt* RuneParser::parseDeclaration() {
+    const Token typeToken = lookahead;
+    nextToken();
+    if (lookahead.kind != TokenKind::Identifier) {
+        error("Expected a name after " + std::string(text(typeToken)), lookahead);
+    }
+    const Token nameToken = lookahead;
+    nextToken();
 
-    // Get function name
-    std::string functionName;
-    while (pos < code.length() && !std::isspace(code[pos]) && code[pos] != '(') {
-        functionName += code[pos++];
+    if (isPunct("(") || isPunct("{")) {
+        return parseFunction(typeToken, nameToken);
     }
 
-    if (functionName.empty()) {
-        throw RuneParseError("Expected function name");
+    auto* decl = makeNode<Ast::VarDecl>(typeToken);
+    decl->typeRune = typeToken.rune();
+    decl->typeName = runeKeyword(typeToken.rune());
+    if (isPrefixRune(typeToken.rune())) {
+        decl->typeName.remove_suffix(2); // "RuneProcess::" names the RuneProcess type
     }
+    decl->name = text(nameToken);
+    decl->symbol = nameToken.symbol();
 
-    return returnType + " " + functionName + "() {\n";
+    if (isRune(U'ᛃ') || isPunct("=")) {
+        nextToken();
+        decl->init = parseExpression();
+    }
+    return decl;
 }
 
-std::string RuneParser::handleClass(const std::string& code, size_t& pos) {
-    pos++; // Skip class rune
+Ast::Stmt* RuneParser::parseFunction(const Token& typeToken, const Token& nameToken) {
+    auto* function = makeNode<Ast::FunctionDecl>(typeToken);
+    function->returnRune = typeToken.rune();
+    function->returnType = runeKeyword(typeToken.rune());
+    function->name = text(nameToken);
+    function->symbol = nameToken.symbol();
 
-    // Skip whitespace
-    while (pos < code.length() && std::isspace(code[pos])) pos++;
+    if (isPunct("(")) {
+        nextToken();
+        std::vector<Ast::Param> params;
+        while (!isPunct(")")) {
+            if (lookahead.kind != TokenKind::Rune || !isTypeRune(lookahead.rune())) {
+                error("Expected a parameter type rune", lookahead);
+            }
+            Ast::Param param{lookahead.rune(), runeKeyword(lookahead.rune()), std::string_view()};
+            nextToken();
+            if (lookahead.kind != TokenKind::Identifier) {
+                error("Expected a parameter name", lookahead);
+            }
+            param.name = text(lookahead);
+            param.symbol = lookahead.symbol();
+            params.push_back(param);
+            nextToken();
+            if (!isPunct(",")) break;
+            nextToken();
+        }
+        expectPunct(")", "')' after parameters");
+        function->params = arena->copyArray(params.data(), params.size());
+        function->paramCount = static_cast<uint32_t>(params.size());
+    }
 
-    // Get class name
-    std::string className;
-    while (pos < code.length() && !std::isspace(code[pos]) && code[pos] != '{') {
-        className += code[pos++];
+    function->body = parseBlock();
+    return function;
+}
+
+Ast::Stmt* RuneParser::parseClass() {
+    const Token keywordToken = lookahead;
+    nextToken();
+    if (lookahead.kind != TokenKind::Identifier) {
+        error("Expected a name after " + std::string(text(keywordToken)), lookahead);
     }
 
-    if (className.empty()) {
-        throw RuneParseError("Expected class name");
+    auto* decl = makeNode<Ast::ClassDecl>(keywordToken);
+    decl->keyword = runeKeyword(keywordToken.rune());
+    decl->name = text(lookahead);
+    nextToken();
+    decl->members = parseBlock()->body;
+    return decl;
+}
+
+Ast::Stmt* RuneParser::parseSimpleStatement() {
+    auto* stmt = makeNode<Ast::ExprStmt>(lookahead);
+    stmt->expr = parseExpression();
+    return stmt;
+}
+
+// ---------------------------------------------------------------------------
+// Expressions
+
+Ast::Expr* RuneParser::parseExpression() {
+    const Token start = lookahead;
+    Ast::Expr* lhs = parseBinary(1);
+
+    if (isRune(U'ᛃ') || isPunct("=")) {
+        if (!isAssignable(lhs)) {
+            error("Invalid assignment target", start);
+        }
+        auto* assign = makeNode<Ast::AssignExpr>(lookahead);
+        nextToken();
+        assign->target = lhs;
+        assign->value = parseExpression();
+        return assign;
     }
+    return lhs;
+}
 
-    return "class " + className + " {\n";
+bool RuneParser::binaryOperator(Ast::BinaryOp& op, int& precedence) const {
+    using Ast::BinaryOp;
+
+    if (lookahead.kind == TokenKind::Rune) {
+        switch (lookahead.rune()) {
+            case U'ᚢ': op = BinaryOp::Add; break;
+            case U'ᚦ': op = BinaryOp::Sub; break;
+            case U'ᚹ': op = BinaryOp::Mul; break;
+            case U'ᚺ': op = BinaryOp::Div; break;
+            case U'ᚻ': op = BinaryOp::Mod; break;
+            case U'ᚼ': op = BinaryOp::Shl; break;
+            case U'ᚽ': op = BinaryOp::Shr; break;
+            case U'ᚾ': op = BinaryOp::BitAnd; break;
+            case U'ᚿ': op = BinaryOp::BitOr; break;
+            case U'ᛀ': op = BinaryOp::BitXor; break;
+            case U'ᛇ': op = BinaryOp::NotEqual; break;
+            case U'ᛋ': op = BinaryOp::LogicalOr; break;
+            default: return false;
+        }
+    } else if (lookahead.kind == TokenKind::Punct) {
+        static const std::pair<std::string_view, BinaryOp> punctOperators[] = {
+            {"+", BinaryOp::Add}, {"-", BinaryOp::Sub}, {"*", BinaryOp::Mul},
+            {"/", BinaryOp::Div}, {"%", BinaryOp::Mod}, {"<<", BinaryOp::Shl},
+            {">>", BinaryOp::Shr}, {"&", BinaryOp::BitAnd}, {"|", BinaryOp::BitOr},
+            {"^", BinaryOp::BitXor}, {"<", BinaryOp::Less}, {">", BinaryOp::Greater},
+            {"<=", BinaryOp::LessEq}, {">=", BinaryOp::GreaterEq}, {"==", BinaryOp::Equal},
+            {"!=", BinaryOp::NotEqual}, {"&&", BinaryOp::LogicalAnd}, {"||", BinaryOp::LogicalOr},
+        };
+        bool found = false;
+        const std::string_view punct = text(lookahead);
+        for (const auto& [spelling, binaryOp] : punctOperators) {
+            if (punct == spelling) {
+                op = binaryOp;
+                found = true;
+                break;
+            }
+        }
+        if (!found) return false;
+    } else {
+        return false;
+    }
+
+    precedence = Ast::precedence(op);
+    return true;
 }
 
-std::string RuneParser::handleCustomType(const std::string& code, size_t& pos) {
-    // Logic to handle custom type definitions
-    // Example: ᛚ MyType
-    std::string typeName;
-    while (pos < code.length() && !std::isspace(code[pos]) && code[pos] != '{') {
-        typeName += code[pos++];
+Ast::Expr* RuneParser::parseBinary(int minPrecedence) {
+    Ast::Expr* lhs = parseUnary();
+
+    Ast::BinaryOp op;
+    int precedence;
+    while (binaryOperator(op, precedence) && precedence >= minPrecedence) {
+        auto* binary = makeNode<Ast::BinaryExpr>(lookahead);
+        nextToken();
+        binary->op = op;
+        binary->lhs = lhs;
+        binary->rhs = parseBinary(precedence + 1);
+        lhs = binary;
     }
-    return "typedef int " + typeName + ";";
+    return lhs;
 }
 
-std::string RuneParser::handleSwitch(const std::string& code, size_t& pos) {
-    std::string switchCode;
-    pos++; // Move past the switch rune
+Ast::Expr* RuneParser::parseUnary() {
+    Ast::UnaryOp op;
+    if (isRune(U'ᛁ') || isPunct("~")) {
+        op = Ast::UnaryOp::BitNot;
+    } else if (isPunct("-")) {
+        op = Ast::UnaryOp::Negate;
+    } else if (isPunct("!")) {
+        op = Ast::UnaryOp::Not;
+    } else {
+        return parsePostfix();
+    }
+
+    auto* unary = makeNode<Ast::UnaryExpr>(lookahead);
+    nextToken();
+    unary->op = op;
+    unary->operand = parseUnary();
+    return unary;
+}
 
-    // Skip whitespace
-    while (pos < code.length() && std::isspace(code[pos])) pos++;
+Ast::Expr* RuneParser::parsePostfix() {
+    Ast::Expr* expr = parsePrimary();
 
-    // Get the switch variable
-    std::string switchVariable;
-    while (pos < code.length() && !std::isspace(code[pos]) && code[pos] != '{') {
-        switchVariable += code[pos++];
+    while (true) {
+        if (isPunct("(") && isCallable(expr)) {
+            auto* call = makeNode<Ast::CallExpr>(lookahead);
+            nextToken();
+            skipNewlines();
+            const size_t mark = scratch.size();
+            while (!isPunct(")")) {
+                scratch.push_back(parseExpression());
+                skipNewlines();
+                if (!isPunct(",")) break;
+                nextToken();
+                skipNewlines();
+            }
+            expectPunct(")", "')' after arguments");
+            call->callee = expr;
+            call->args = finishList<Ast::Expr>(mark);
+            expr = call;
+        } else if (isPunct("[")) {
+            auto* index = makeNode<Ast::IndexExpr>(lookahead);
+            nextToken();
+            index->base = expr;
+            index->index = parseExpression();
+            expectPunct("]", "']'");
+            expr = index;
+        } else if (isPunct(".") || isPunct("->") || isRune(U'ᛗ')) {
+            auto* member = makeNode<Ast::MemberExpr>(lookahead);
+            member->arrow = !isPunct(".");
+            nextToken();
+            if (lookahead.kind != TokenKind::Identifier) {
+                error("Expected a member name", lookahead);
+            }
+            member->base = expr;
+            member->member = text(lookahead);
+            nextToken();
+            expr = member;
+        } else {
+            return expr;
+        }
     }
+}
+
+Ast::Expr* RuneParser::parsePrimary() {
+    const Token token = lookahead;
+
+    switch (token.kind) {
+        case TokenKind::Number: {
+            nextToken();
+            const char* first = text(token).data();
+            const char* last = first + text(token).size();
+            if (text(token).find('.') != std::string_view::npos) {
+                auto* literal = makeNode<Ast::FloatLiteral>(token);
+                literal->text = text(token);
+                if (std::from_chars(first, last, literal->value).ec != std::errc()) {
+                    error("Invalid number: " + std::string(text(token)), token);
+                }
+                return literal;
+            }
+            auto* literal = makeNode<Ast::IntLiteral>(token);
+            literal->text = text(token);
+            int base = 10;
+            if (text(token).size() > 2 && (text(token)[1] == 'x' || text(token)[1] == 'X')) {
+                first += 2;
+                base = 16;
+            }
+            if (std::from_chars(first, last, literal->value, base).ec != std::errc()) {
+                error("Integer literal out of range: " + std::string(text(token)), token);
+            }
+            return literal;
+        }
+
+        case TokenKind::String: {
+            nextToken();
+            auto* literal = makeNode<Ast::StringLiteral>(token);
+            literal->text = text(token);
+            literal->symbol = token.symbol();
+            literal->runeQuoted = token.runeQuoted();
+            return literal;
+        }
 
-    switchCode += "switch (" + switchVariable + ") {\n";
+        case TokenKind::Identifier: {
+            nextToken();
+            if (text(token) == "true" || text(token) == "false") {
+                auto* literal = makeNode<Ast::BoolLiteral>(token);
+                literal->value = text(token) == "true";
+                return literal;
+            }
+            auto* identifier = makeNode<Ast::Identifier>(token);
+            identifier->name = text(token);
+            identifier->symbol = token.symbol();
+            return identifier;
+        }
 
-    // Process cases
-    while (pos < code.length()) {
-        std::string caseRune(1, code[pos]);
-        if (caseRune == "ᚲ") { // If it's a case rune
-            pos++; // Move past the case rune
-            std::string caseValue;
-            while (pos < code.length() && !std::isspace(code[pos]) && code[pos] != '}') {
-                caseValue += code[pos++];
+        case TokenKind::Punct:
+            if (isPunct("(")) {
+                nextToken();
+                skipNewlines();
+                Ast::Expr* inner = parseExpression();
+                skipNewlines();
+                expectPunct(")", "')'");
+                return inner;
             }
-            switchCode += "case " + caseValue + ": \n";
-        } else if (caseRune == "ᛞ") { // If it's a default case
-            pos++; // Move past the default rune
-            switchCode += "default: \n";
-        } else if (caseRune == "}") { // End of switch
-            switchCode += "}\n";
             break;
-        } else {
-            // Handle unexpected characters
-            throw RuneParseError("Unexpected character in switch statement");
+
+        case TokenKind::Rune:
+            if (isPrefixRune(token.rune())) {
+                nextToken();
+                if (lookahead.kind != TokenKind::Identifier || lookahead.spaced()) {
+                    error("Expected a name directly after " + std::string(text(token)), lookahead);
+                }
+                auto* scoped = makeNode<Ast::ScopedExpr>(token);
+                scoped->prefix = token.rune();
+                scoped->scope = runeKeyword(token.rune());
+                scoped->name = text(lookahead);
+                scoped->symbol = lookahead.symbol();
+                nextToken();
+                return scoped;
+            }
+            if (isBuiltinRune(token.rune())) {
+                return parseBuiltin();
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (token.kind == TokenKind::End || token.kind == TokenKind::Newline) {
+        error("Expected an expression", token);
+    }
+    error("Unexpected " + std::string(text(token)) + " in expression", token);
+
+    // Only reached in recovery mode, where the statement is discarded
+    return makeNode<Ast::Identifier>(token);
+}
+
+// Operation runes take a fixed number of operands, e.g. ᛵ"log.txt" content,
+// or an explicit argument list such as ᛵ("log.txt", content)
+Ast::Expr* RuneParser::parseBuiltin() {
+    auto* call = makeNode<Ast::BuiltinCall>(lookahead);
+    call->rune = lookahead.rune();
+    call->name = runeKeyword(lookahead.rune());
+    const Token runeToken = lookahead;
+    nextToken();
+
+    const size_t mark = scratch.size();
+    if (isPunct("(") && !lookahead.spaced()) {
+        nextToken();
+        while (!isPunct(")")) {
+            scratch.push_back(parseExpression());
+            if (!isPunct(",")) break;
+            nextToken();
+        }
+        expectPunct(")", "')' after arguments");
+    } else {
+        for (size_t i = 0; i < builtinArity(runeToken.rune()); i++) {
+            if (!startsExpression()) {
+                error("Expected an operand for " + std::string(text(runeToken)), lookahead);
+            }
+            scratch.push_back(parsePostfix());
         }
     }
+    call->args = finishList<Ast::Expr>(mark);
+    return call;
+}
+
+// Loop steps written as "i ᚢ 1" update the counter in place
+Ast::Expr* RuneParser::parseStepExpression() {
+    Ast::Expr* step = parseExpression();
+    auto* binary = Ast::as<Ast::BinaryExpr>(step);
+    if (binary && isArithmetic(binary->op) && binary->lhs->kind == Ast::NodeKind::Identifier) {
+        auto* assign = arena->make<Ast::AssignExpr>();
+        assign->offset = binary->lhs->offset;
+        assign->target = binary->lhs;
+        assign->value = binary;
+        return assign;
+    }
+    return step;
+}
+
+// ---------------------------------------------------------------------------
+
+std::string RuneParser::parseRuneCode(const std::string& runeCode) {
+    RuneArena& programArena = workArena;
+    programArena.reset();
+    Ast::Program program = parseProgram(runeCode, programArena);
+    failOnDiagnostics();
+    if (optimize) RuneOptimizer().optimize(program, programArena);
+    return generateCpp(program);
+}
+
+Bytecode::Module RuneParser::compileToBytecode(std::string_view runeCode) {
+    RuneArena& programArena = workArena;
+    programArena.reset();
+    Ast::Program program = parseProgram(runeCode, programArena);
+    failOnDiagnostics();
+    if (optimize) RuneOptimizer().optimize(program, programArena);
+    return compileBytecode(program);
+}
+
+std::string RuneParser::compileToNative(std::string_view runeCode) {
+    RuneArena& programArena = workArena;
+    programArena.reset();
+    Ast::Program program = parseProgram(runeCode, programArena);
+    failOnDiagnostics();
+    if (optimize) RuneOptimizer().optimize(program, programArena);
+    return generateNativeCpp(program);
+}
+
+void RuneParser::compileModule(const std::string& inputPath, const std::string& outputPath) {
+    const RuneMappedFile input(inputPath);
+    writeRuneModule(compileToBytecode(input.view()), runeSourceHash(input.view()), outputPath);
+}
+
+bool RuneParser::checkSyntax(std::string_view runeCode) {
+    const bool wasRecovering = recover;
+    recover = true;
+
+    RuneArena& statementArena = workArena;
+    statementArena.reset();
+    beginProgram(runeCode, statementArena);
+    while (parseNext()) {
+        statementArena.reset();
+    }
+
+    recover = wasRecovering;
+    return errors.empty();
+}
+
+// Optimized and unoptimized output must not share cache entries, nor may
+// output whose #line directives name different files
+RuneCacheKey RuneParser::cacheKey(std::string_view runeCode, std::string_view directiveFile) const {
+    checkSourceSize(runeCode);  // Refused before, not after, hashing all of it
+    uint64_t seed = optimize ? kRuneTableVersion : ~kRuneTableVersion;
+    uint64_t checkSeed = seed;
+    if (!directiveFile.empty()) {
+        seed = hashBytes(directiveFile, seed);
+        checkSeed = checkBytes(directiveFile, checkSeed);
+    }
+    return {hashBytes(runeCode, seed), checkBytes(runeCode, checkSeed), runeCode.size()};
+}
 
-    return switchCode;
+void RuneParser::storeSourceMap(const RuneCacheKey& key, const RuneSourceMap& map, const std::string& outputPath) {
+    map.write(outputPath + ".map");
+    if (cache) cache->store(sourceMapKey(key), map.encode());
+}
+
+bool RuneParser::loadSourceMap(const RuneCacheKey& key, const std::string& outputPath) {
+    std::string encoded;
+    if (!cache->load(sourceMapKey(key), encoded)) return false;
+    RuneSourceMap::decode(encoded).write(outputPath + ".map");
+    return true;
 }
 
 std::string RuneParser::compileToCpp(const std::string& runeCode) {
-    std::string cppCode = parseRuneCode(runeCode);
-    std::ofstream outputFile("output.cpp");
-    outputFile << "#include <iostream>\n\n" << cppCode << "\nint main() {\n\treturn 0;\n}";
-    outputFile.close();
+    return compileToCpp(runeCode, "output.cpp");
+}
+
+std::string RuneParser::compileToCpp(const std::string& runeCode, const std::string& outputPath) {
+    const RuneCacheKey key = cacheKey(runeCode, lineFile);
+    std::string cached;
+    if (cache && cache->load(key, cached) &&
+        cached.size() >= kCppPrologue.size() + kCppEpilogue.size() &&
+        (!sourceMap || loadSourceMap(key, outputPath))) {
+        writeFile(outputPath, cached);
+        return cached.substr(kCppPrologue.size(), cached.size() - kCppPrologue.size() - kCppEpilogue.size());
+    }
+
+    std::string cppCode;
+    if (sourceMap || !lineFile.empty()) {
+        RuneArena& programArena = workArena;
+        programArena.reset();
+        Ast::Program program = parseProgram(runeCode, programArena);
+        failOnDiagnostics();
+        if (optimize) RuneOptimizer().optimize(program, programArena);
+        CppSourceLines lines(runeCode, kCppFirstLine);
+        lines.lineFile = lineFile;
+        cppCode = generateCpp(program, lines);
+        if (sourceMap) storeSourceMap(key, lines.map, outputPath);
+    } else {
+        cppCode = parseRuneCode(runeCode);
+    }
+
+    RuneFileWriter output(outputPath);
+    output.append(kCppPrologue);
+    output.append(cppCode);
+    output.append(kCppEpilogue);
+    output.close();
+
+    if (cache) {
+        cache->store(key, std::string(kCppPrologue) + cppCode + std::string(kCppEpilogue));
+    }
     return cppCode;
 }
 
+std::string RuneParser::compileToCppUnit(std::string_view runeCode) {
+    const RuneCacheKey key = cacheKey(runeCode, {});
+    std::string unit;
+    if (cache && cache->load(key, unit) && unit.size() >= kCppPrologue.size() + kCppEpilogue.size()) {
+        return unit;
+    }
+
+    RuneArena& programArena = workArena;
+    programArena.reset();
+    Ast::Program program = parseProgram(runeCode, programArena);
+    failOnDiagnostics();
+    if (optimize) RuneOptimizer().optimize(program, programArena);
+    unit = std::string(kCppPrologue) + generateCpp(program) + std::string(kCppEpilogue);
+
+    if (cache) cache->store(key, unit);
+    return unit;
+}
+
+void RuneParser::compileFile(const std::string& inputPath, const std::string& outputPath) {
+    const RuneMappedFile input(inputPath);
+    const std::string directiveFile = lineFile.empty() ? std::string() : inputPath;
+    const RuneCacheKey key = cacheKey(input.view(), directiveFile);
+    std::string cached;
+    if (cache && cache->load(key, cached) && (!sourceMap || loadSourceMap(key, outputPath))) {
+        writeFile(outputPath, cached);
+        return;
+    }
+
+    RuneArena& statementArena = workArena;
+    statementArena.reset();
+    RuneOptimizer optimizer;
+    std::optional<CppSourceLines> lines;
+    if (sourceMap || !directiveFile.empty()) {
+        lines.emplace(input.view(), kCppFirstLine);
+        lines->lineFile = directiveFile;
+    }
+
+    // Streamed beside the target and renamed over it, so a syntax error
+    // found halfway through never leaves a truncated .cpp behind
+    const std::string temp = outputPath + ".tmp" + std::to_string(getpid()) + "-" + std::to_string(nextTemp++);
+    try {
+        RuneFileWriter output(temp);
+        output.append(kCppPrologue);
+        beginProgram(input.view(), statementArena);
+        while (Ast::Stmt* stmt = parseNext()) {
+            if (optimize) stmt = optimizer.optimizeNext(stmt, statementArena);
+            if (stmt && lines) {
+                generateCpp(stmt, output, *lines);
+            } else if (stmt) {
+                generateCpp(stmt, output);
+            }
+            statementArena.reset();
+        }
+        failOnDiagnostics();
+        output.append(kCppEpilogue);
+        output.close();
+    } catch (...) {
+        unlink(temp.c_str());
+        throw;
+    }
+
+    if (rename(temp.c_str(), outputPath.c_str()) != 0) {
+        const int err = errno;
+        unlink(temp.c_str());
+        RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Cannot write " + outputPath + ": " + std::strerror(err));
+    }
+    if (sourceMap) storeSourceMap(key, lines->map, outputPath);
+
+    // The output was streamed, so read it back rather than keeping it all
+    // in memory while generating
+    if (cache) {
+        const RuneMappedFile generated(outputPath);
+        cache->store(key, generated.view());
+    }
+}
+
 } // namespace RuneLang
@@ -0,0 +1,402 @@
+#include "../include/RuneServer.hpp"
+#include "../include/RuneError.hpp"
+#include "../include/RuneFile.hpp"
+#include "../include/RuneModule.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <new>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace RuneLang {
+
+namespace {
+
+constexpr uint32_t kRequestMagic = 0x51524E52;   // "RNRQ"
+constexpr uint32_t kResponseMagic = 0x53524E52;  // "RNRS"
+
+// Larger messages are refused rather than allocated
+constexpr uint32_t kMaxPayload = 256u * 1024 * 1024;
+
+// A worker gives up on a client that has read nothing of its response for
+// this long, so one that stops reading cannot keep the worker
+constexpr timeval kSendTimeout = {10, 0};
+
+// Bytes run() reads from a connection per wakeup
+constexpr size_t kReceiveChunk = 64 * 1024;
+
+enum RequestFlags : uint8_t {
+    kIsPath = 1,
+    kNoOptimize = 2
+};
+
+struct MessageHeader {
+    uint32_t magic;
+    uint8_t kind;     // Command of a request, Status of a response
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t length;  // Payload bytes that follow
+};
+
+static_assert(sizeof(MessageHeader) == 12, "the header is part of the wire format");
+
+sockaddr_un addressOf(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        RUNE_THROW(RuneError::ErrorCode::NETWORK_ERROR, "Invalid socket path: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+bool connectTo(int fd, const std::string& path) {
+    const sockaddr_un address = addressOf(path);
+    int result;
+    do {
+        result = connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    } while (result != 0 && errno == EINTR);
+    return result == 0;
+}
+
+// False on end of file or error. A peer that is gone must never raise
+// SIGPIPE, so everything is written with MSG_NOSIGNAL.
+bool readAll(int fd, void* data, size_t size) {
+    char* at = static_cast<char*>(data);
+    while (size > 0) {
+        const ssize_t got = recv(fd, at, size, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        at += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* at = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t sent = send(fd, at, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        at += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool writeMessage(int fd, uint32_t magic, uint8_t kind, uint8_t flags, const std::string& payload) {
+    const MessageHeader header{magic, kind, flags, 0, static_cast<uint32_t>(payload.size())};
+    return writeAll(fd, &header, sizeof(header)) && writeAll(fd, payload.data(), payload.size());
+}
+
+// False on a clean end of file or a message that breaks the protocol
+bool readMessage(int fd, uint32_t magic, MessageHeader& header, std::string& payload) {
+    if (!readAll(fd, &header, sizeof(header))) return false;
+    if (header.magic != magic || header.length > kMaxPayload) return false;
+    payload.resize(header.length);
+    return readAll(fd, &payload[0], payload.size());
+}
+
+void appendDiagnostic(std::string& out, const RuneParseError& e) {
+    out += std::to_string(e.getLine());
+    out += ':';
+    out += std::to_string(e.getColumn());
+    out += ':';
+    out += e.getMessage();
+    out += '\n';
+}
+
+} // namespace
+
+std::vector<RuneParseError> RuneServerResponse::diagnostics() const {
+    std::vector<RuneParseError> errors;
+    if (status != Status::ParseError) return errors;
+
+    size_t start = 0;
+    while (start < payload.size()) {
+        size_t end = payload.find('\n', start);
+        if (end == std::string::npos) end = payload.size();
+        const std::string line = payload.substr(start, end - start);
+        start = end + 1;
+
+        const size_t lineEnd = line.find(':');
+        const size_t columnEnd = lineEnd == std::string::npos ? lineEnd : line.find(':', lineEnd + 1);
+        if (columnEnd == std::string::npos) {
+            errors.emplace_back(line);
+            continue;
+        }
+        errors.emplace_back(line.substr(columnEnd + 1),
+                            std::strtoul(line.c_str(), nullptr, 10),
+                            std::strtoul(line.c_str() + lineEnd + 1, nullptr, 10));
+    }
+    return errors;
+}
+
+RuneServer::RuneServer(const std::string& socketPath, size_t threads, RuneCache* cache)
+    : socketPath_(socketPath), listenFd_(-1), wakeFds_{-1, -1}, stopping_(false),
+      parsers_(threads == 0 ? 1 : threads), pool_(parsers_.size()), served_(0) {
+    for (RuneParser& parser : parsers_) {
+        parser.setCache(cache);
+        // Requests already keep every worker busy
+        parser.setLexThreads(1);
+    }
+
+    auto fail = [this](const std::string& message) {
+        for (int fd : {listenFd_, wakeFds_[0], wakeFds_[1]}) {
+            if (fd >= 0) close(fd);
+        }
+        RUNE_THROW(RuneError::ErrorCode::NETWORK_ERROR, message);
+    };
+
+    const sockaddr_un address = addressOf(socketPath_);
+    if (pipe2(wakeFds_, O_CLOEXEC | O_NONBLOCK) != 0) {
+        fail(std::string("Cannot create wake pipe: ") + std::strerror(errno));
+    }
+    listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) fail(std::string("Cannot create socket: ") + std::strerror(errno));
+
+    // Only a socket nobody answers on is taken over; anything else at the
+    // path is left alone
+    struct stat info;
+    if (lstat(socketPath_.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) fail(socketPath_ + " exists and is not a socket");
+        if (connectTo(listenFd_, socketPath_)) fail("A server is already listening on " + socketPath_);
+        unlink(socketPath_.c_str());
+    }
+
+    // Connecting needs write permission on the socket file, so owner-only
+    // mode keeps other users out. Nobody can connect before listen().
+    if (bind(listenFd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        fail("Cannot bind " + socketPath_ + ": " + std::strerror(errno));
+    }
+    if (chmod(socketPath_.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(listenFd_, SOMAXCONN) != 0) {
+        const int err = errno;
+        unlink(socketPath_.c_str());
+        fail("Cannot listen on " + socketPath_ + ": " + std::strerror(err));
+    }
+}
+
+RuneServer::~RuneServer() {
+    for (const auto& entry : connections_) close(entry.first);
+    close(listenFd_);
+    unlink(socketPath_.c_str());
+    close(wakeFds_[0]);
+    close(wakeFds_[1]);
+}
+
+std::string RuneServer::defaultSocketPath() {
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) return std::string(runtime) + "/runed.sock";
+    return "/tmp/runed-" + std::to_string(getuid()) + ".sock";
+}
+
+void RuneServer::run() {
+    std::vector<pollfd> fds;
+    std::vector<char> chunk(kReceiveChunk);
+    while (!stopping_) {
+        fds.clear();
+        fds.push_back({listenFd_, POLLIN, 0});
+        fds.push_back({wakeFds_[0], POLLIN, 0});
+        for (const auto& [fd, connection] : connections_) {
+            if (!connection.busy) fds.push_back({fd, POLLIN, 0});
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            RUNE_THROW(RuneError::ErrorCode::NETWORK_ERROR, std::string("poll failed: ") + std::strerror(errno));
+        }
+        if (fds[1].revents) {
+            char drained[64];
+            while (read(wakeFds_[0], drained, sizeof(drained)) > 0) {}
+            reclaim();
+            if (stopping_) break;
+        }
+
+        // Readiness of the connections is acted on before new ones are
+        // accepted, which may reuse the number of one closed meanwhile
+        for (size_t i = 2; i < fds.size(); i++) {
+            if (fds[i].revents) receive(fds[i].fd, chunk);
+        }
+
+        if (fds[0].revents & POLLIN) {
+            const int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) continue;  // The client gave up, or try again on the next wakeup
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &kSendTimeout, sizeof(kSendTimeout));
+            connections_[fd];
+        }
+    }
+
+    // Requests with a worker are answered before their connections go
+    pool_.wait();
+    reclaim();
+    for (const auto& entry : connections_) close(entry.first);
+    connections_.clear();
+}
+
+void RuneServer::stop() {
+    stopping_ = true;
+    const char wake = 1;
+    const ssize_t ignored = write(wakeFds_[1], &wake, 1);
+    (void)ignored;
+}
+
+void RuneServer::receive(int fd, std::vector<char>& chunk) {
+    // Reads never block run(): the socket stays blocking for the worker
+    // writing the response, so each read asks not to wait instead
+    const ssize_t got = recv(fd, chunk.data(), chunk.size(), MSG_DONTWAIT);
+    if (got < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (got <= 0) {
+        disconnect(fd);
+        return;
+    }
+
+    // A request too large to hold only costs its connection
+    Connection& connection = connections_[fd];
+    try {
+        connection.buffer.append(chunk.data(), static_cast<size_t>(got));
+        if (dispatch(fd, connection)) return;
+    } catch (const std::bad_alloc&) {
+    }
+    disconnect(fd);
+}
+
+// Hands the next request in the connection's buffer to a worker once all
+// of it has arrived. False if the client broke the protocol.
+bool RuneServer::dispatch(int fd, Connection& connection) {
+    MessageHeader header;
+    if (connection.buffer.size() < sizeof(header)) return true;
+    std::memcpy(&header, connection.buffer.data(), sizeof(header));
+    if (header.magic != kRequestMagic || header.length > kMaxPayload) return false;
+
+    const size_t size = sizeof(header) + header.length;
+    if (connection.buffer.size() < size) {
+        connection.buffer.reserve(size);
+        return true;
+    }
+
+    RuneServerRequest request;
+    request.command = static_cast<RuneServerRequest::Command>(header.kind);
+    request.isPath = header.flags & kIsPath;
+    request.optimize = !(header.flags & kNoOptimize);
+    request.payload.assign(connection.buffer, sizeof(header), header.length);
+    connection.buffer.erase(0, size);
+    connection.busy = true;
+
+    pool_.submit([this, fd, request = std::move(request)](size_t worker) {
+        const RuneServerResponse response = handle(request, parsers_[worker]);
+        served_++;
+        const bool sent = writeMessage(fd, kResponseMagic, static_cast<uint8_t>(response.status), 0, response.payload);
+        {
+            std::lock_guard<std::mutex> lock(finishedMutex_);
+            finished_.emplace_back(fd, sent);
+        }
+        const char wake = 0;
+        const ssize_t ignored = write(wakeFds_[1], &wake, 1);
+        (void)ignored;
+    });
+    return true;
+}
+
+// Take back the connections workers have answered on, and dispatch any
+// request a client sent ahead of its previous response
+void RuneServer::reclaim() {
+    std::vector<std::pair<int, bool>> finished;
+    {
+        std::lock_guard<std::mutex> lock(finishedMutex_);
+        finished.swap(finished_);
+    }
+    for (const auto& [fd, alive] : finished) {
+        auto it = connections_.find(fd);
+        if (it == connections_.end()) continue;
+        it->second.busy = false;
+        if (!alive || !dispatch(fd, it->second)) disconnect(fd);
+    }
+}
+
+void RuneServer::disconnect(int fd) {
+    close(fd);
+    connections_.erase(fd);
+}
+
+RuneServerResponse RuneServer::handle(const RuneServerRequest& request, RuneParser& parser) {
+    RuneServerResponse response;
+    try {
+        std::unique_ptr<RuneMappedFile> file;
+        std::string_view source = request.payload;
+        if (request.isPath) {
+            file = std::make_unique<RuneMappedFile>(request.payload);
+            source = file->view();
+        }
+        parser.setOptimize(request.optimize);
+
+        switch (request.command) {
+            case RuneServerRequest::Command::Cpp:
+                response.payload = parser.compileToCppUnit(source);
+                break;
+            case RuneServerRequest::Command::Bytecode:
+                response.payload = encodeRuneModule(parser.compileToBytecode(source), runeSourceHash(source));
+                break;
+            case RuneServerRequest::Command::Check:
+                if (!parser.checkSyntax(source)) {
+                    response.status = RuneServerResponse::Status::ParseError;
+                    for (const RuneParseError& e : parser.diagnostics()) appendDiagnostic(response.payload, e);
+                }
+                break;
+            default:
+                response.status = RuneServerResponse::Status::Error;
+                response.payload = "Unknown command " + std::to_string(static_cast<int>(request.command));
+                break;
+        }
+    } catch (const RuneParseError& e) {
+        response.status = RuneServerResponse::Status::ParseError;
+        response.payload.clear();
+        appendDiagnostic(response.payload, e);
+    } catch (const std::exception& e) {
+        response.status = RuneServerResponse::Status::Error;
+        response.payload = e.what();
+    }
+    return response;
+}
+
+RuneClient::RuneClient(const std::string& socketPath) : fd_(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) {
+    if (fd_ < 0) {
+        RUNE_THROW(RuneError::ErrorCode::NETWORK_ERROR, std::string("Cannot create socket: ") + std::strerror(errno));
+    }
+    if (!connectTo(fd_, socketPath)) {
+        const int err = errno;
+        close(fd_);
+        RUNE_THROW(RuneError::ErrorCode::NETWORK_ERROR, "Cannot connect to " + socketPath + ": " + std::strerror(err));
+    }
+}
+
+RuneClient::~RuneClient() {
+    close(fd_);
+}
+
+RuneServerResponse RuneClient::send(const RuneServerRequest& request) {
+    if (request.payload.size() > kMaxPayload) {
+        RUNE_THROW(RuneError::ErrorCode::NETWORK_ERROR, "Request too large for runed");
+    }
+    const uint8_t flags = (request.isPath ? kIsPath : 0) | (request.optimize ? 0 : kNoOptimize);
+    if (!writeMessage(fd_, kRequestMagic, static_cast<uint8_t>(request.command), flags, request.payload)) {
+        RUNE_THROW(RuneError::ErrorCode::NETWORK_ERROR, std::string("Lost runed: ") + std::strerror(errno));
+    }
+
+    MessageHeader header;
+    RuneServerResponse response;
+    if (!readMessage(fd_, kResponseMagic, header, response.payload)) {
+        RUNE_THROW(RuneError::ErrorCode::NETWORK_ERROR, "runed closed the connection");
+    }
+    response.status = static_cast<RuneServerResponse::Status>(header.kind);
+    return response;
+}
+
+} // namespace RuneLang
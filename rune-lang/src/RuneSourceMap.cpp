@@ -0,0 +1,103 @@
+#include "../include/RuneSourceMap.hpp"
+#include "../include/RuneError.hpp"
+#include "../include/RuneFile.hpp"
+#include <algorithm>
+
+namespace RuneLang {
+
+namespace {
+
+constexpr std::string_view kBase64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Five bits per digit, low bits first; bit 5 marks that more digits follow.
+// The sign is kept in the lowest bit of the first digit.
+void appendVlq(std::string& out, int64_t value) {
+    uint64_t bits = value < 0 ? (static_cast<uint64_t>(-value) << 1) | 1 : static_cast<uint64_t>(value) << 1;
+    do {
+        uint64_t digit = bits & 31;
+        bits >>= 5;
+        if (bits) digit |= 32;
+        out += kBase64[digit];
+    } while (bits);
+}
+
+bool readVlq(std::string_view text, size_t& pos, int64_t& value) {
+    uint64_t bits = 0;
+    for (unsigned shift = 0; pos < text.size() && shift < 64; shift += 5) {
+        const size_t digit = kBase64.find(text[pos++]);
+        if (digit == std::string_view::npos) return false;
+        bits |= static_cast<uint64_t>(digit & 31) << shift;
+        if (!(digit & 32)) {
+            value = bits & 1 ? -static_cast<int64_t>(bits >> 1) : static_cast<int64_t>(bits >> 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+void RuneSourceMap::add(uint32_t cppLine, uint32_t runeLine) {
+    if (!entries_.empty() && entries_.back().runeLine == runeLine) return;
+    if (!entries_.empty() && entries_.back().cppLine == cppLine) {
+        entries_.back().runeLine = runeLine;
+    } else {
+        entries_.push_back({cppLine, runeLine});
+    }
+}
+
+uint32_t RuneSourceMap::runeLine(uint32_t cppLine) const {
+    auto it = std::upper_bound(entries_.begin(), entries_.end(), cppLine, [](uint32_t line, const Entry& entry) {
+        return line < entry.cppLine;
+    });
+    return it == entries_.begin() ? 0 : (it - 1)->runeLine;
+}
+
+std::string RuneSourceMap::encode() const {
+    std::string out;
+    out.reserve(entries_.size() * 2);
+    Entry previous{0, 0};
+    for (const Entry& entry : entries_) {
+        appendVlq(out, static_cast<int64_t>(entry.cppLine) - previous.cppLine);
+        appendVlq(out, static_cast<int64_t>(entry.runeLine) - previous.runeLine);
+        previous = entry;
+    }
+    return out;
+}
+
+RuneSourceMap RuneSourceMap::decode(std::string_view text) {
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) text.remove_suffix(1);
+
+    RuneSourceMap map;
+    int64_t cppLine = 0;
+    int64_t runeLine = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        int64_t cppDelta;
+        int64_t runeDelta;
+        if (!readVlq(text, pos, cppDelta) || !readVlq(text, pos, runeDelta)) {
+            RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Malformed source map at byte " + std::to_string(pos));
+        }
+        cppLine += cppDelta;
+        runeLine += runeDelta;
+        if (cppDelta <= 0 || cppLine > UINT32_MAX || runeLine < 0 || runeLine > UINT32_MAX) {
+            RUNE_THROW(RuneError::ErrorCode::FILE_ERROR, "Source map lines out of order at byte " + std::to_string(pos));
+        }
+        map.entries_.push_back({static_cast<uint32_t>(cppLine), static_cast<uint32_t>(runeLine)});
+    }
+    return map;
+}
+
+void RuneSourceMap::write(const std::string& path) const {
+    RuneFileWriter output(path);
+    output.append(encode());
+    output.append('\n');
+    output.close();
+}
+
+RuneSourceMap RuneSourceMap::read(const std::string& path) {
+    const RuneMappedFile input(path);
+    return decode(input.view());
+}
+
+} // namespace RuneLang
@@ -0,0 +1,102 @@
+#include "../include/RuneThreadPool.hpp"
+
+namespace RuneLang {
+
+RuneThreadPool::RuneThreadPool(size_t threads)
+    : queued_(0), pending_(0), nextQueue_(0), stopping_(false) {
+    if (threads == 0) threads = 1;
+
+    for (size_t i = 0; i < threads; i++) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        threads_.emplace_back(&RuneThreadPool::run, this, i);
+    }
+}
+
+RuneThreadPool::~RuneThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        stopping_ = true;
+    }
+    workAvailable_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void RuneThreadPool::submit(Task task) {
+    pending_++;
+    {
+        // Counted before it becomes visible so a worker never sees more
+        // tasks than queued_ reports
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        queued_++;
+    }
+
+    WorkQueue& queue = *queues_[nextQueue_++ % queues_.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    workAvailable_.notify_one();
+}
+
+void RuneThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(stateMutex_);
+    allDone_.wait(lock, [this] { return pending_ == 0; });
+
+    if (firstError_) {
+        std::exception_ptr error = firstError_;
+        firstError_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+bool RuneThreadPool::popLocal(size_t index, Task& task) {
+    WorkQueue& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool RuneThreadPool::steal(size_t index, Task& task) {
+    for (size_t offset = 1; offset < queues_.size(); offset++) {
+        WorkQueue& victim = *queues_[(index + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty()) continue;
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void RuneThreadPool::run(size_t index) {
+    while (true) {
+        Task task;
+        if (popLocal(index, task) || steal(index, task)) {
+            queued_--;
+            try {
+                task(index);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(stateMutex_);
+                if (!firstError_) firstError_ = std::current_exception();
+            }
+
+            if (--pending_ == 0) {
+                std::lock_guard<std::mutex> lock(stateMutex_);
+                allDone_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(stateMutex_);
+        workAvailable_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+        if (stopping_ && queued_ == 0) return;
+    }
+}
+
+} // namespace RuneLang
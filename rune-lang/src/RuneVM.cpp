@@ -0,0 +1,658 @@
+#include "../include/RuneVM.hpp"
+#include "../include/RuneBuiltins.hpp"
+#include "../include/RuneModule.hpp"
+#include "../include/RuneSystem.hpp"
+#include <cmath>
+#include <sstream>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RUNE_VM_COMPUTED_GOTO 1
+#else
+#define RUNE_VM_COMPUTED_GOTO 0
+#endif
+
+namespace RuneLang {
+
+using namespace Bytecode;
+
+namespace {
+
+constexpr size_t kStackSize = 64 * 1024;  // Registers shared by all frames
+constexpr size_t kMaxFrames = 4096;
+
+void format(std::ostream& out, const Image& module, Value value) {
+    if (value.isString()) {
+        out << *value.asString();
+    } else if (value.isInt()) {
+        out << value.asInt();
+    } else if (value.isNumber()) {
+        out << value.asNumber();
+    } else if (value.isBool()) {
+        // std::cout prints bools as digits, and so does the generated C++
+        out << (value.asBool() ? '1' : '0');
+    } else if (value.isPointer()) {
+        out << value.asPointer();
+    } else if (value.isFunction()) {
+        out << "<function " << module.text(module.functions[value.asFunction()].name) << '>';
+    } else {
+        out << "nil";
+    }
+}
+
+bool bothInts(Value a, Value b) {
+    return a.isInt() && b.isInt();
+}
+
+bool multiply(int64_t x, int64_t y, int64_t& product) {
+#if defined(__GNUC__) || defined(__clang__)
+    return !__builtin_mul_overflow(x, y, &product);
+#else
+    constexpr int64_t kHalf = int64_t(1) << 31;
+    if (x <= -kHalf || x >= kHalf || y <= -kHalf || y >= kHalf) return false;
+    product = x * y;
+    return true;
+#endif
+}
+
+const char* opSymbol(Op op) {
+    switch (op) {
+        case Op::Add: return "+";
+        case Op::Sub: return "-";
+        case Op::Mul: return "*";
+        case Op::Div: return "/";
+        case Op::Mod: return "%";
+        case Op::Shl: return "<<";
+        case Op::Shr: return ">>";
+        case Op::BitAnd: return "&";
+        case Op::BitOr: return "|";
+        case Op::BitXor: return "^";
+        case Op::Less: return "<";
+        case Op::LessEq: return "<=";
+        default: return opName(op);
+    }
+}
+
+} // namespace
+
+RuneVM::RuneVM(std::ostream& out, std::istream& in)
+    : out_(out),
+      in_(in),
+      dispatch_(threadedDispatchAvailable() ? Dispatch::Threaded : Dispatch::Switch),
+      pc_(nullptr) {
+    stack_.resize(kStackSize);
+    frames_.reserve(64);
+}
+
+RuneVM::~RuneVM() {
+    reset();
+}
+
+bool RuneVM::threadedDispatchAvailable() {
+    return RUNE_VM_COMPUTED_GOTO;
+}
+
+void RuneVM::reset() {
+    for (const auto& [block, size] : allocations_) {
+        RuneMemory::deallocate(block);
+    }
+    allocations_.clear();
+    constants_.clear();
+    globals_.clear();
+    natives_.clear();
+    strings_.clear();
+    frames_.clear();
+}
+
+void RuneVM::load(Module module) {
+    reset();
+    mapped_.reset();
+    owned_ = std::move(module);
+    module_ = owned_.image();
+    bind();
+}
+
+void RuneVM::load(std::shared_ptr<const RuneModuleFile> file) {
+    reset();
+    owned_ = Module();
+    mapped_ = std::move(file);
+    module_ = mapped_->image();
+    bind();
+}
+
+void RuneVM::bind() {
+    constants_.reserve(module_.constants.size());
+    for (const Constant& constant : module_.constants) {
+        switch (constant.kind) {
+            case ConstantKind::Int:
+                constants_.push_back(Value::integer(constant.integer));
+                break;
+            case ConstantKind::Float:
+                constants_.push_back(Value::number(constant.number));
+                break;
+            case ConstantKind::String:
+                constants_.push_back(makeString(std::string(module_.text(constant.string))));
+                break;
+            case ConstantKind::Function:
+                constants_.push_back(Value::function(constant.function));
+                break;
+        }
+    }
+
+    globals_.assign(module_.globals.size(), Value::nil());
+
+    // Unknown names stay unbound and fail when the call is reached, so a
+    // script can still run branches that do not need them
+    natives_.reserve(module_.natives.size());
+    for (const StringRef& name : module_.natives) {
+        natives_.push_back(findBuiltin(module_.text(name)));
+    }
+}
+
+void RuneVM::run() {
+    if (module_.functions.empty()) return;
+    frames_.clear();
+    if (dispatch_ == Dispatch::Threaded && threadedDispatchAvailable()) {
+        execute<true>();
+    } else {
+        execute<false>();
+    }
+}
+
+Value RuneVM::global(std::string_view name) const {
+    for (size_t i = 0; i < module_.globals.size(); i++) {
+        if (module_.text(module_.globals[i]) == name) return globals_[i];
+    }
+    return Value::nil();
+}
+
+Value RuneVM::makeString(std::string text) {
+    strings_.push_back(std::move(text));
+    return Value::string(&strings_.back());
+}
+
+std::string RuneVM::toString(Value value) const {
+    if (value.isString()) return *value.asString();
+    std::ostringstream out;
+    format(out, module_, value);
+    return out.str();
+}
+
+void* RuneVM::allocate(size_t size) {
+    void* block = RuneMemory::allocate(size);
+    if (block) allocations_[block] = size;
+    return block;
+}
+
+bool RuneVM::release(void* block) {
+    auto it = allocations_.find(block);
+    if (it == allocations_.end()) return false;
+    RuneMemory::deallocate(block);
+    allocations_.erase(it);
+    return true;
+}
+
+size_t RuneVM::currentLine() const {
+    if (!pc_) return 0;
+    return module_.lineAt(static_cast<size_t>(pc_ - module_.code.data()) - 1);
+}
+
+void RuneVM::error(const std::string& message) const {
+    throw RuneRuntimeError(message, currentLine());
+}
+
+template <bool Threaded>
+void RuneVM::execute() {
+    const Instruction* const code = module_.code.data();
+    const Value* const constants = constants_.data();
+    Value* const globals = globals_.data();
+    Value* const stackEnd = stack_.data() + stack_.size();
+
+    const Function& script = module_.functions[0];
+    if (script.registerCount > stack_.size()) error("Script needs too many registers");
+
+    const Instruction* pc = code + script.codeOffset;
+    Value* R = stack_.data();
+    Instruction instruction;
+
+#if RUNE_VM_COMPUTED_GOTO
+    static void* const kLabels[] = {
+        &&op_Move, &&op_LoadK, &&op_LoadInt, &&op_LoadNil, &&op_LoadBool, &&op_GetGlobal, &&op_SetGlobal,
+        &&op_Add, &&op_Sub, &&op_Mul, &&op_Div, &&op_Mod, &&op_Shl, &&op_Shr,
+        &&op_BitAnd, &&op_BitOr, &&op_BitXor,
+        &&op_Less, &&op_LessEq, &&op_Equal, &&op_NotEqual,
+        &&op_Negate, &&op_Not, &&op_BitNot, &&op_ToBool, &&op_ToFloat,
+        &&op_GetIndex, &&op_SetIndex,
+        &&op_Jump, &&op_JumpIfFalse, &&op_JumpIfTrue,
+        &&op_Call, &&op_CallNative, &&op_Return, &&op_ReturnNil,
+        &&op_Print, &&op_Input,
+    };
+    static_assert(sizeof(kLabels) / sizeof(kLabels[0]) == static_cast<size_t>(Op::Count),
+                  "every opcode needs a handler");
+
+// The threaded build jumps straight from one handler to the next; the
+// switch build returns to the top of the loop
+#define VM_NEXT()                                                          \
+    do {                                                                   \
+        if constexpr (Threaded) {                                          \
+            instruction = *pc++;                                           \
+            goto *kLabels[static_cast<size_t>(opOf(instruction))];         \
+        } else {                                                           \
+            goto dispatch;                                                 \
+        }                                                                  \
+    } while (0)
+#define VM_CASE(name) case Op::name: op_##name:
+#else
+#define VM_NEXT() goto dispatch
+#define VM_CASE(name) case Op::name:
+#endif
+
+#define VM_ERROR(message) \
+    do {                  \
+        pc_ = pc;         \
+        error(message);   \
+    } while (0)
+
+#define RA R[argA(instruction)]
+#define RB R[argB(instruction)]
+#define RC R[argC(instruction)]
+
+// Integer fast path inline, everything else through arithmetic()
+#define VM_ARITH(name, expr)                                               \
+    VM_CASE(name) {                                                        \
+        const Value b = RB;                                                \
+        const Value c = RC;                                                \
+        if (bothInts(b, c)) {                                              \
+            const int64_t x = b.asInt();                                   \
+            const int64_t y = c.asInt();                                   \
+            RA = Value::integer(expr);                                     \
+        } else {                                                           \
+            pc_ = pc;                                                      \
+            RA = arithmetic(Op::name, b, c);                               \
+        }                                                                  \
+        VM_NEXT();                                                         \
+    }
+
+#define VM_COMPARE(name, op)                                               \
+    VM_CASE(name) {                                                        \
+        const Value b = RB;                                                \
+        const Value c = RC;                                                \
+        if (bothInts(b, c)) {                                              \
+            RA = Value::boolean(b.asInt() op c.asInt());                   \
+        } else {                                                           \
+            pc_ = pc;                                                      \
+            RA = arithmetic(Op::name, b, c);                               \
+        }                                                                  \
+        VM_NEXT();                                                         \
+    }
+
+#if RUNE_VM_COMPUTED_GOTO
+dispatch: __attribute__((unused));  // Only the switch build loops back here
+#else
+dispatch:
+#endif
+    instruction = *pc++;
+    switch (opOf(instruction)) {
+        VM_CASE(Move) {
+            RA = RB;
+            VM_NEXT();
+        }
+
+        VM_CASE(LoadK) {
+            RA = constants[argBx(instruction)];
+            VM_NEXT();
+        }
+
+        VM_CASE(LoadInt) {
+            RA = Value::integer(argSBx(instruction));
+            VM_NEXT();
+        }
+
+        VM_CASE(LoadNil) {
+            RA = Value::nil();
+            VM_NEXT();
+        }
+
+        VM_CASE(LoadBool) {
+            RA = Value::boolean(argB(instruction) != 0);
+            VM_NEXT();
+        }
+
+        VM_CASE(GetGlobal) {
+            RA = globals[argBx(instruction)];
+            VM_NEXT();
+        }
+
+        VM_CASE(SetGlobal) {
+            globals[argBx(instruction)] = RA;
+            VM_NEXT();
+        }
+
+        VM_ARITH(Add, x + y)
+        VM_ARITH(Sub, x - y)
+
+        VM_CASE(Mul) {
+            const Value b = RB;
+            const Value c = RC;
+            int64_t product;
+            if (bothInts(b, c) && multiply(b.asInt(), c.asInt(), product)) {
+                RA = Value::integer(product);
+            } else {
+                pc_ = pc;
+                RA = arithmetic(Op::Mul, b, c);
+            }
+            VM_NEXT();
+        }
+
+        VM_CASE(Div) {
+            const Value b = RB;
+            const Value c = RC;
+            if (bothInts(b, c) && c.asInt() != 0) {
+                RA = Value::integer(b.asInt() / c.asInt());
+            } else {
+                pc_ = pc;
+                RA = arithmetic(Op::Div, b, c);
+            }
+            VM_NEXT();
+        }
+
+        VM_CASE(Mod) {
+            const Value b = RB;
+            const Value c = RC;
+            if (bothInts(b, c) && c.asInt() != 0) {
+                RA = Value::integer(b.asInt() % c.asInt());
+            } else {
+                pc_ = pc;
+                RA = arithmetic(Op::Mod, b, c);
+            }
+            VM_NEXT();
+        }
+
+        VM_CASE(Shl) { pc_ = pc; RA = arithmetic(Op::Shl, RB, RC); VM_NEXT(); }
+        VM_CASE(Shr) { pc_ = pc; RA = arithmetic(Op::Shr, RB, RC); VM_NEXT(); }
+
+        VM_ARITH(BitAnd, x & y)
+        VM_ARITH(BitOr, x | y)
+        VM_ARITH(BitXor, x ^ y)
+
+        VM_COMPARE(Less, <)
+        VM_COMPARE(LessEq, <=)
+
+        VM_CASE(Equal) {
+            RA = Value::boolean(equals(RB, RC));
+            VM_NEXT();
+        }
+
+        VM_CASE(NotEqual) {
+            RA = Value::boolean(!equals(RB, RC));
+            VM_NEXT();
+        }
+
+        VM_CASE(Negate) {
+            const Value b = RB;
+            if (b.isInt()) {
+                RA = Value::integer(-b.asInt());
+            } else if (b.isNumeric()) {
+                RA = Value::number(-b.toDouble());
+            } else {
+                VM_ERROR(std::string("Cannot negate a ") + b.typeName());
+            }
+            VM_NEXT();
+        }
+
+        VM_CASE(Not) {
+            RA = Value::boolean(!RB.truthy());
+            VM_NEXT();
+        }
+
+        VM_CASE(BitNot) {
+            const Value b = RB;
+            if (!b.isInt() && !b.isBool()) VM_ERROR(std::string("Cannot apply ~ to a ") + b.typeName());
+            RA = Value::integer(~b.toInt());
+            VM_NEXT();
+        }
+
+        VM_CASE(ToBool) {
+            RA = Value::boolean(RB.truthy());
+            VM_NEXT();
+        }
+
+        VM_CASE(ToFloat) {
+            const Value b = RB;
+            if (b.isNumber()) {
+                RA = b;
+            } else if (b.isNumeric()) {
+                RA = Value::number(b.toDouble());
+            } else if (b.isNil()) {
+                RA = Value::number(0.0);
+            } else {
+                VM_ERROR(std::string("Cannot convert a ") + b.typeName() + " to a number");
+            }
+            VM_NEXT();
+        }
+
+        VM_CASE(GetIndex) {
+            pc_ = pc;
+            RA = getIndex(RB, RC);
+            VM_NEXT();
+        }
+
+        VM_CASE(SetIndex) {
+            pc_ = pc;
+            setIndex(RA, RB, RC);
+            VM_NEXT();
+        }
+
+        VM_CASE(Jump) {
+            pc += argSJ(instruction);
+            VM_NEXT();
+        }
+
+        VM_CASE(JumpIfFalse) {
+            if (!RA.truthy()) pc += argSBx(instruction);
+            VM_NEXT();
+        }
+
+        VM_CASE(JumpIfTrue) {
+            if (RA.truthy()) pc += argSBx(instruction);
+            VM_NEXT();
+        }
+
+        VM_CASE(Call) {
+            const Value callee = RA;
+            if (!callee.isFunction()) VM_ERROR(std::string("Cannot call a ") + callee.typeName());
+
+            const Function& function = module_.functions[callee.asFunction()];
+            Value* base = &RA + 1;
+            if (base + function.registerCount > stackEnd || frames_.size() >= kMaxFrames) {
+                VM_ERROR("Stack overflow");
+            }
+            for (int i = argB(instruction); i < function.paramCount; i++) {
+                base[i] = Value::nil();
+            }
+
+            frames_.push_back(Frame{pc, R});
+            R = base;
+            pc = code + function.codeOffset;
+            VM_NEXT();
+        }
+
+        VM_CASE(CallNative) {
+            const RuneNative native = natives_[argB(instruction)];
+            pc_ = pc;
+            if (!native) {
+                error("Unknown host function '" + std::string(module_.text(module_.natives[argB(instruction)])) + "'");
+            }
+            RA = native(*this, &RA, argC(instruction));
+            VM_NEXT();
+        }
+
+        VM_CASE(Return) {
+            const Value result = RA;
+            if (frames_.empty()) return;
+            R[-1] = result;
+            pc = frames_.back().returnPc;
+            R = frames_.back().base;
+            frames_.pop_back();
+            VM_NEXT();
+        }
+
+        VM_CASE(ReturnNil) {
+            if (frames_.empty()) return;
+            R[-1] = Value::nil();
+            pc = frames_.back().returnPc;
+            R = frames_.back().base;
+            frames_.pop_back();
+            VM_NEXT();
+        }
+
+        VM_CASE(Print) {
+            format(out_, module_, RA);
+            VM_NEXT();
+        }
+
+        VM_CASE(Input) {
+            pc_ = pc;
+            RA = input(static_cast<InputKind>(argB(instruction)));
+            VM_NEXT();
+        }
+
+        case Op::Count:
+            break;
+    }
+
+    pc_ = pc;
+    error("Invalid instruction");
+
+#undef VM_NEXT
+#undef VM_CASE
+#undef VM_ERROR
+#undef VM_ARITH
+#undef VM_COMPARE
+#undef RA
+#undef RB
+#undef RC
+}
+
+template void RuneVM::execute<true>();
+template void RuneVM::execute<false>();
+
+Value RuneVM::arithmetic(Op op, Value a, Value b) {
+    if (op == Op::Add && (a.isString() || b.isString())) {
+        return makeString(toString(a) + toString(b));
+    }
+
+    if ((op == Op::Less || op == Op::LessEq) && a.isString() && b.isString()) {
+        const int order = a.asString()->compare(*b.asString());
+        return Value::boolean(op == Op::Less ? order < 0 : order <= 0);
+    }
+
+    if (!a.isNumeric() || !b.isNumeric()) {
+        error(std::string("Cannot apply ") + opSymbol(op) + " to a " + a.typeName() + " and a " + b.typeName());
+    }
+
+    const bool integral = !a.isNumber() && !b.isNumber();
+    switch (op) {
+        case Op::Shl:
+        case Op::Shr:
+        case Op::BitAnd:
+        case Op::BitOr:
+        case Op::BitXor: {
+            if (!integral) error(std::string("Operands of ") + opSymbol(op) + " must be integers");
+            const int64_t x = a.toInt();
+            const int64_t y = b.toInt();
+            if (op == Op::BitAnd) return Value::integer(x & y);
+            if (op == Op::BitOr) return Value::integer(x | y);
+            if (op == Op::BitXor) return Value::integer(x ^ y);
+            if (y < 0 || y > 63) error("Shift count out of range");
+            return Value::integer(op == Op::Shl ? static_cast<int64_t>(static_cast<uint64_t>(x) << y) : x >> y);
+        }
+
+        case Op::Div:
+        case Op::Mod:
+            if (integral) {
+                if (b.toInt() == 0) error("Division by zero");
+                return Value::integer(op == Op::Div ? a.toInt() / b.toInt() : a.toInt() % b.toInt());
+            }
+            return Value::number(op == Op::Div ? a.toDouble() / b.toDouble() : std::fmod(a.toDouble(), b.toDouble()));
+
+        case Op::Less:
+            return Value::boolean(integral ? a.toInt() < b.toInt() : a.toDouble() < b.toDouble());
+        case Op::LessEq:
+            return Value::boolean(integral ? a.toInt() <= b.toInt() : a.toDouble() <= b.toDouble());
+
+        default:
+            break;
+    }
+
+    // Integer sums that overflowed the fast path end up here as doubles
+    const double x = a.toDouble();
+    const double y = b.toDouble();
+    switch (op) {
+        case Op::Add: return Value::number(x + y);
+        case Op::Sub: return Value::number(x - y);
+        case Op::Mul: return Value::number(x * y);
+        default: error(std::string("Invalid arithmetic operator ") + opName(op));
+    }
+}
+
+bool RuneVM::equals(Value a, Value b) const {
+    if (a == b) return !(a.isNumber() && a.asNumber() != a.asNumber());
+    if (a.isNumeric() && b.isNumeric()) {
+        if (!a.isNumber() && !b.isNumber()) return a.toInt() == b.toInt();
+        return a.toDouble() == b.toDouble();
+    }
+    if (a.isString() && b.isString()) return *a.asString() == *b.asString();
+    return false;
+}
+
+Value RuneVM::getIndex(Value base, Value index) {
+    if (!index.isNumeric()) error(std::string("Cannot index with a ") + index.typeName());
+    const int64_t i = index.toInt();
+
+    if (base.isString()) {
+        const std::string& text = *base.asString();
+        if (i < 0 || static_cast<uint64_t>(i) >= text.size()) error("String index out of range");
+        return makeString(std::string(1, text[static_cast<size_t>(i)]));
+    }
+    if (base.isPointer()) {
+        auto it = allocations_.find(base.asPointer());
+        if (it == allocations_.end()) error("Memory block was already freed");
+        if (i < 0 || static_cast<uint64_t>(i) >= it->second) error("Memory index out of range");
+        return Value::integer(static_cast<unsigned char*>(it->first)[i]);
+    }
+    error(std::string("Cannot index a ") + base.typeName());
+}
+
+void RuneVM::setIndex(Value base, Value index, Value value) {
+    if (base.isString()) error("Strings cannot be modified in place");
+    if (!base.isPointer()) error(std::string("Cannot index a ") + base.typeName());
+    if (!index.isNumeric() || !value.isNumeric()) error("Memory blocks hold numbers");
+
+    auto it = allocations_.find(base.asPointer());
+    if (it == allocations_.end()) error("Memory block was already freed");
+    const int64_t i = index.toInt();
+    if (i < 0 || static_cast<uint64_t>(i) >= it->second) error("Memory index out of range");
+    static_cast<unsigned char*>(it->first)[i] = static_cast<unsigned char>(value.toInt());
+}
+
+Value RuneVM::input(InputKind kind) {
+    switch (kind) {
+        case InputKind::Number: {
+            double value = 0.0;
+            if (!(in_ >> value)) in_.clear();
+            return Value::number(value);
+        }
+        case InputKind::Boolean: {
+            bool value = false;
+            if (!(in_ >> value)) in_.clear();
+            return Value::boolean(value);
+        }
+        case InputKind::Text:
+            break;
+    }
+    std::string token;
+    in_ >> token;
+    return makeString(std::move(token));
+}
+
+} // namespace RuneLang
@@ -11,13 +11,13 @@ int main() {
     std::cout << "C++ code: " << parser.compileToCpp(runeCode1) << "\n\n";
 
     // Example 2: Nested function
-    std::string runeCode2 = "ᛤ myFunction ᛒ ᚠ \"Hello from myFunction!\\n\" ᛏ 0 ᛘ";
+    std::string runeCode2 = "ᛤ myFunction() { ᚠ \"Hello from myFunction!\\n\" }";
     std::cout << "Example 2 - Nested Function Definition:\n";
     std::cout << "Rune code: " << runeCode2 << "\n";
     std::cout << "C++ code: " << parser.compileToCpp(runeCode2) << "\n\n";
 
     // Example 3: For loop
-    std::string runeCode3 = "ᚱ i 0 i < 5 ᚦ ᚢ 1 ᚠ i";
+    std::string runeCode3 = "ᚱ(ᛚ i ᛃ 0; i < 5; i ᚢ 1) { ᚠ i }";
     std::cout << "Example 3 - For Loop:\n";
     std::cout << "Rune code: " << runeCode3 << "\n";
     std::cout << "C++ code: " << parser.compileToCpp(runeCode3) << "\n\n";
@@ -29,7 +29,7 @@ int main() {
     std::cout << "C++ code: " << parser.parseRuneCode(runeCode4) << "\n\n";
 
     // Example 5: Function definition
-    std::string runeCode5 = "ᛤ main ᛒ ᚠ \"Hello from function!\\n\" ᛏ 0 ᛘ";
+    std::string runeCode5 = "ᛤ greet() { ᚠ \"Hello from function!\\n\"; ᛏ }";
     std::cout << "Example 5 - Function definition:\n";
     std::cout << "Rune code: " << runeCode5 << "\n";
     std::cout << "C++ code: " << parser.parseRuneCode(runeCode5) << "\n\n";
@@ -0,0 +1,265 @@
+#include "RuneParser.hpp"
+#include "RuneThreadPool.hpp"
+#include "RuneCache.hpp"
+#include "RuneFile.hpp"
+#include "RuneLogger.hpp"
+#include "RuneServer.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace RuneLang;
+
+namespace {
+    struct Job {
+        fs::path input;
+        fs::path output;
+    };
+
+    struct Result {
+        bool ok = false;
+        std::string diagnostic;
+    };
+
+    void printUsage() {
+        std::cout << "\nUsage: runec [options] <file.rune | directory>...\n"
+                  << "------------------------\n"
+                  << "Transpiles Rune sources to C++ in parallel.\n\n"
+                  << "Options:\n"
+                  << "  -o <dir>   Write generated files below <dir> instead of next to each source\n"
+                  << "  -j <n>     Number of worker threads (default: all cores)\n"
+                  << "  -c <dir>   Reuse generated code cached in <dir> for unchanged sources\n"
+                  << "  -O0        Generate code without folding constants or removing dead branches\n"
+                  << "  -s         Only check syntax, reporting every error in each file\n"
+                  << "  -b         Write precompiled .runec bytecode modules instead of C++\n"
+                  << "  -m         Write a source map next to each generated file as <file>.cpp.map\n"
+                  << "  -g         Emit #line directives pointing back at the Rune sources\n"
+                  << "  -S <sock>  Compile on the runed server listening on <sock>\n"
+                  << "  -h         Show this help message\n"
+                  << std::endl;
+    }
+
+    std::string formatDiagnostic(const fs::path& input, const RuneParseError& e) {
+        return input.string() + ":" + std::to_string(e.getLine()) + ":" +
+               std::to_string(e.getColumn()) + ": error: " + e.getMessage();
+    }
+
+    // The server reads the file itself, so only its absolute path is sent
+    bool compileOnServer(RuneClient& client, const Job& job, RuneServerRequest::Command command,
+                         bool optimize, std::string& diagnostic) {
+        RuneServerRequest request;
+        request.command = command;
+        request.isPath = true;
+        request.optimize = optimize;
+        request.payload = fs::absolute(job.input).string();
+
+        const RuneServerResponse response = client.send(request);
+        switch (response.status) {
+            case RuneServerResponse::Status::Ok:
+                if (command != RuneServerRequest::Command::Check) {
+                    RuneFileWriter output(job.output.string());
+                    output.append(response.payload);
+                    output.close();
+                }
+                return true;
+            case RuneServerResponse::Status::ParseError:
+                for (const RuneParseError& e : response.diagnostics()) {
+                    if (!diagnostic.empty()) diagnostic += '\n';
+                    diagnostic += formatDiagnostic(job.input, e);
+                }
+                return false;
+            default:
+                diagnostic = job.input.string() + ": error: " + response.payload;
+                return false;
+        }
+    }
+
+    fs::path outputFor(const fs::path& source, const fs::path& relative, const fs::path& outputDir,
+                       const char* extension) {
+        fs::path output = outputDir.empty() ? source : outputDir / relative;
+        output.replace_extension(extension);
+        return output;
+    }
+
+    // Directories are expanded in sorted order so runs are reproducible
+    void collectJobs(const fs::path& input, const fs::path& outputDir, const char* extension,
+                     std::vector<Job>& jobs) {
+        if (!fs::is_directory(input)) {
+            jobs.push_back({input, outputFor(input, input.filename(), outputDir, extension)});
+            return;
+        }
+
+        std::vector<fs::path> sources;
+        for (const auto& entry : fs::recursive_directory_iterator(input)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".rune") {
+                sources.push_back(entry.path());
+            }
+        }
+        std::sort(sources.begin(), sources.end());
+
+        for (const fs::path& source : sources) {
+            jobs.push_back({source, outputFor(source, source.lexically_relative(input), outputDir, extension)});
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    fs::path outputDir;
+    std::string cacheDir;
+    std::string serverSocket;
+    bool optimize = true;
+    bool syntaxOnly = false;
+    bool bytecode = false;
+    bool sourceMap = false;
+    bool lineDirectives = false;
+    size_t threads = std::thread::hardware_concurrency();
+    std::vector<fs::path> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        } else if (arg == "-o" && i + 1 < argc) {
+            outputDir = argv[++i];
+        } else if (arg == "-j" && i + 1 < argc) {
+            threads = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "-c" && i + 1 < argc) {
+            cacheDir = argv[++i];
+        } else if (arg == "-O0") {
+            optimize = false;
+        } else if (arg == "-s") {
+            syntaxOnly = true;
+        } else if (arg == "-b") {
+            bytecode = true;
+        } else if (arg == "-m") {
+            sourceMap = true;
+        } else if (arg == "-g") {
+            lineDirectives = true;
+        } else if (arg == "-S" && i + 1 < argc) {
+            serverSocket = argv[++i];
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "runec: unknown option " << arg << std::endl;
+            printUsage();
+            return 2;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (inputs.empty()) {
+        printUsage();
+        return 2;
+    }
+    if (!serverSocket.empty() && (sourceMap || lineDirectives || !cacheDir.empty())) {
+        std::cerr << "runec: -m, -g and -c cannot be combined with -S" << std::endl;
+        return 2;
+    }
+
+    std::vector<Job> jobs;
+    std::unique_ptr<RuneCache> cache;
+    try {
+        if (!cacheDir.empty()) {
+            cache = std::make_unique<RuneCache>(cacheDir);
+        }
+        for (const fs::path& input : inputs) {
+            collectJobs(input, outputDir, bytecode ? ".runec" : ".cpp", jobs);
+        }
+        for (const Job& job : jobs) {
+            if (!syntaxOnly && job.output.has_parent_path()) {
+                fs::create_directories(job.output.parent_path());
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "runec: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // Failures are reported below in input order rather than logged as
+    // they happen on whichever worker hit them
+    LogLevelUtils::setLevel(LogLevel::CRITICAL);
+
+    RuneThreadPool pool(std::min(threads == 0 ? 1 : threads, std::max<size_t>(jobs.size(), 1)));
+    std::vector<RuneParser> parsers(pool.size());
+    for (RuneParser& parser : parsers) {
+        parser.setCache(cache.get());
+        parser.setOptimize(optimize);
+        parser.setSourceMap(sourceMap);
+        parser.setLineDirectives(lineDirectives);
+        // Files are spread over the workers; a lone file lexes on all of them
+        parser.setLexThreads(jobs.size() == 1 ? threads : 1);
+    }
+    std::vector<Result> results(jobs.size());
+
+    // One connection per worker, each served by a worker of the server
+    std::vector<std::unique_ptr<RuneClient>> clients;
+    const RuneServerRequest::Command command = syntaxOnly ? RuneServerRequest::Command::Check
+                                               : bytecode ? RuneServerRequest::Command::Bytecode
+                                                          : RuneServerRequest::Command::Cpp;
+    try {
+        if (!serverSocket.empty()) {
+            for (size_t i = 0; i < pool.size(); i++) {
+                clients.push_back(std::make_unique<RuneClient>(serverSocket));
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "runec: " << e.what() << std::endl;
+        return 1;
+    }
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        pool.submit([&, i](size_t worker) {
+            const Job& job = jobs[i];
+            Result& result = results[i];
+            try {
+                if (!clients.empty()) {
+                    result.ok = compileOnServer(*clients[worker], job, command, optimize, result.diagnostic);
+                    if (syntaxOnly) return;
+                } else if (syntaxOnly) {
+                    const RuneMappedFile input(job.input.string());
+                    result.ok = parsers[worker].checkSyntax(input.view());
+                    for (const RuneParseError& e : parsers[worker].diagnostics()) {
+                        if (!result.diagnostic.empty()) result.diagnostic += '\n';
+                        result.diagnostic += formatDiagnostic(job.input, e);
+                    }
+                    return;
+                } else if (bytecode) {
+                    parsers[worker].compileModule(job.input.string(), job.output.string());
+                    result.ok = true;
+                } else {
+                    parsers[worker].compileFile(job.input.string(), job.output.string());
+                    result.ok = true;
+                }
+            } catch (const RuneParseError& e) {
+                result.diagnostic = formatDiagnostic(job.input, e);
+            } catch (const std::exception& e) {
+                result.diagnostic = job.input.string() + ": error: " + e.what();
+            }
+
+            if (!result.ok) {
+                std::error_code ignored;
+                fs::remove(job.output, ignored);
+            }
+        });
+    }
+    pool.wait();
+
+    size_t failed = 0;
+    for (const Result& result : results) {
+        if (!result.ok) {
+            std::cerr << result.diagnostic << std::endl;
+            failed++;
+        }
+    }
+
+    if (failed > 0) {
+        std::cerr << "runec: " << failed << " of " << jobs.size() << " files failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "RuneServer.hpp"
+#include "RuneCache.hpp"
+#include "RuneLogger.hpp"
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace RuneLang;
+
+namespace {
+    RuneServer* server = nullptr;
+
+    void signalHandler(int) {
+        if (server) server->stop();
+    }
+
+    void printUsage() {
+        std::cout << "\nUsage: runed [options] [socket]\n"
+                  << "------------------------\n"
+                  << "Serves Rune compile requests from runec -S on a Unix socket,\n"
+                  << "by default " << RuneServer::defaultSocketPath() << ".\n\n"
+                  << "Options:\n"
+                  << "  -j <n>     Number of requests compiled at once (default: all cores)\n"
+                  << "  -c <dir>   Cache generated code in <dir> across requests and restarts\n"
+                  << "  -h         Show this help message\n"
+                  << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string socketPath = RuneServer::defaultSocketPath();
+    std::string cacheDir;
+    size_t threads = std::thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        } else if (arg == "-j" && i + 1 < argc) {
+            threads = static_cast<size_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "-c" && i + 1 < argc) {
+            cacheDir = argv[++i];
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "runed: unknown option " << arg << std::endl;
+            printUsage();
+            return 2;
+        } else {
+            socketPath = arg;
+        }
+    }
+
+    // Clients that hang up mid-response must not take the server down
+    signal(SIGPIPE, SIG_IGN);
+
+    // Bad requests are answered to their client, not logged here
+    LogLevelUtils::setLevel(LogLevel::CRITICAL);
+
+    try {
+        std::unique_ptr<RuneCache> cache;
+        if (!cacheDir.empty()) {
+            cache = std::make_unique<RuneCache>(cacheDir);
+        }
+        RuneServer instance(socketPath, threads, cache.get());
+        server = &instance;
+        signal(SIGINT, signalHandler);
+        signal(SIGTERM, signalHandler);
+
+        std::cout << "runed: listening on " << instance.socketPath() << std::endl;
+        instance.run();
+        server = nullptr;
+        std::cout << "runed: served " << instance.requestsServed() << " requests" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "runed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
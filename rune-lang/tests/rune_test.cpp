@@ -3,9 +3,25 @@
 #include "RuneMonitor.hpp"
 #include "RuneLogger.hpp"
 #include "GhostSystem.hpp"
+#include "RuneParser.hpp"
+#include "RuneKeywords.hpp"
+#include "RuneLexer.hpp"
+#include "RuneCache.hpp"
+#include "RuneVM.hpp"
+#include "RuneModule.hpp"
+#include "RuneNative.hpp"
+#include "RuneSourceMap.hpp"
+#include "RuneServer.hpp"
+#include "RuneFile.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <chrono>
+#include <unistd.h>
 
 using namespace RuneLang;
 
@@ -92,6 +108,972 @@ void testLogging() {
     LOG_CRITICAL("Critical message");
 }
 
+void testRuneLexer() {
+    const std::string source = "ᛝ name ᛃ ᛟhi \"thereᛟ\n\n\n  ᚠ name \"\\n\" 0x1F>=2 ᛞ done\n";
+    RuneSymbolTable symbols;
+    const std::vector<RuneToken> tokens = RuneLexer::tokenize(source, symbols);
+
+    [[maybe_unused]] const TokenKind kinds[] = {
+        TokenKind::Rune, TokenKind::Identifier, TokenKind::Rune, TokenKind::String, TokenKind::Newline,
+        TokenKind::Rune, TokenKind::Identifier, TokenKind::String, TokenKind::Number, TokenKind::Punct,
+        TokenKind::Number, TokenKind::Comment, TokenKind::Newline, TokenKind::End
+    };
+    assert(tokens.size() == sizeof(kinds) / sizeof(kinds[0]));
+    for (size_t i = 0; i < tokens.size(); i++) assert(tokens[i].kind == kinds[i]);
+
+    // Tokens are spans of the source; names and strings carry their symbol
+    assert(tokens[0].rune() == U'ᛝ' && tokens[0].offset == 0 && tokens[0].length == 3);
+    assert(tokens[1].text(source) == "name" && tokens[1].spaced());
+    assert(tokens[6].symbol() == tokens[1].symbol() && symbols.name(tokens[1].symbol()) == "name");
+    assert(tokens[3].text(source) == "hi \"there" && tokens[3].runeQuoted());
+    assert(tokens[7].text(source) == "\\n" && !tokens[7].runeQuoted());
+    assert(tokens[9].text(source) == ">=" && !tokens[9].spaced() && !tokens[10].spaced());
+    assert(tokens[11].text(source) == " done");
+    assert(tokens[5].spaced() && source.compare(tokens[5].offset, 3, "ᚠ") == 0);
+
+    // Lexing in batches gives the same stream
+    RuneSymbolTable batchSymbols;
+    RuneLexer lexer(source, batchSymbols);
+    std::vector<RuneToken> batched;
+    while (lexer.lex(batched, 3)) {}
+    assert(batched.size() == tokens.size());
+    for (size_t i = 0; i < tokens.size(); i++) {
+        assert(batched[i].kind == tokens[i].kind && batched[i].offset == tokens[i].offset &&
+               batched[i].length == tokens[i].length && batched[i].value == tokens[i].value);
+    }
+
+    // Unreadable text becomes an Error token and lexing carries on
+    const std::string bad = "a ᛘ $ \"open";
+    const std::vector<RuneToken> errors = RuneLexer::tokenize(bad, symbols);
+    assert(errors.size() == 5 && errors[1].kind == TokenKind::Error && errors[2].kind == TokenKind::Error);
+    assert(RuneLexer::errorMessage(errors[2], bad) == "Unexpected character: $");
+    assert(RuneLexer::errorMessage(errors[3], bad) == "Unterminated string");
+    assert(errors[3].kind == TokenKind::Error && errors[4].kind == TokenKind::End);
+}
+
+void testRuneParallelLexer() {
+    // Strings that span lines put many of the cuts inside a literal, where
+    // the chunk after the cut starts out lexing string text as code
+    std::string source;
+    for (size_t i = 0; source.size() < RuneLexer::kParallelBytes + 512 * 1024; i++) {
+        const std::string name = "name" + std::to_string(i % 997);
+        source += "ᛝ " + name + " ᛃ ᛟfirst\nᛝ inside " + std::to_string(i) + "\n\nᛟ\n";
+        source += "\"quoted\nᛟ still quoted\" ᛞ note " + name + "\n";
+        source += "  ᚠ " + name + " 0x1F>=2\n\n   \n";
+    }
+
+    auto check = [](const std::string& text) {
+        RuneSymbolTable serialSymbols;
+        RuneSymbolTable parallelSymbols;
+        const std::vector<RuneToken> serial = RuneLexer::tokenize(text, serialSymbols);
+        const std::vector<RuneToken> parallel = RuneLexer::tokenizeParallel(text, parallelSymbols, 4);
+        assert(parallel.size() == serial.size());
+        for (size_t i = 0; i < serial.size(); i++) {
+            assert(parallel[i].kind == serial[i].kind && parallel[i].flags == serial[i].flags &&
+                   parallel[i].offset == serial[i].offset && parallel[i].length == serial[i].length &&
+                   parallel[i].value == serial[i].value);
+        }
+        assert(parallelSymbols.size() == serialSymbols.size());
+    };
+    check(source);
+
+    // A stray quote turns every string after it inside out
+    std::string stray = source;
+    stray.insert(stray.size() / 3, "\nᛟ stray\n");
+    check(stray);
+
+    // An unterminated string swallows every chunk after it
+    std::string unterminated = source.substr(0, source.size() / 3) + "\nᛟ never closed\n";
+    while (unterminated.size() < source.size()) unterminated += "ᚠ name 1\n";
+    check(unterminated);
+
+    // parseProgram takes the parallel path for sources this large
+    std::string script;
+    size_t statements = 0;
+    for (size_t i = 0; script.size() < RuneLexer::kParallelBytes + 1024; i++) {
+        script += "ᛝ name" + std::to_string(i) + " ᛃ ᛟtwo\nlinesᛟ\nᚠ name" + std::to_string(i) + "\n";
+        statements += 2;
+    }
+    RuneParser parser;
+    parser.setLexThreads(4);
+    RuneArena arena;
+    [[maybe_unused]] const Ast::Program program = parser.parseProgram(script, arena);
+    assert(program.body.count == statements && program.symbols->find("name1000") != kNoSymbol);
+}
+
+void testRuneParser() {
+    RuneParser parser;
+
+    // Multi-byte runes decode as whole codepoints
+    assert(parser.parseRuneCode("ᚠ\"Hello\"") == "std::cout << \"Hello\";\n");
+    assert(parser.parseRuneCode("ᛨgetHostname()") == "RuneSystem::getHostname();\n");
+    assert(parser.parseRuneCode("ᚠᛟrunic textᛟ") == "std::cout << \"runic text\";\n");
+    assert(parser.parseRuneCode("ᛞ note\nx ᛃ 1") == "// note\nx = 1;\n");
+
+    // The rune table is built at compile time and shared by every parser
+    static_assert(runeKeyword(U'ᚷ') == "if", "rune table is constexpr");
+    assert(runeKeyword(U'ᛦ') == "double");
+    assert(runeKeyword(U'ᛒ').empty());
+    assert(runeKeyword(U'a').empty());
+
+    try {
+        parser.parseRuneCode("ᚠ 1\n  ᛒ");
+        assert(false && "Should not reach here");
+    } catch (const RuneParseError& e) {
+        assert(e.getLine() == 2);
+        assert(e.getColumn() == 3);
+    }
+
+    // Long comments, blank lines and quoted strings are scanned in bulk;
+    // positions still count lines and codepoints
+    try {
+        parser.parseRuneCode(
+            "ᛞ ᚠᚱᚷᛏ runes in a comment long enough to span several blocks ᛉᛉᛉ\n"
+            "\n   \t\n\n"
+            "ᚠ\"a quoted string with \\\" escapes\nand a line break ᛟ\"   \t   \t  ᛒ");
+        assert(false && "Should not reach here");
+    } catch (const RuneParseError& e) {
+        assert(e.getLine() == 6);
+        assert(e.getColumn() == 30);
+    }
+
+    // Positions are resolved from byte offsets on demand
+    const RuneLineIndex lines("ᚠ 1\n\nx ᛃ ᛟᚱᛟ\n");
+    assert(lines.locate(0).line == 1 && lines.locate(0).column == 1);
+    assert(lines.locate(4).line == 1 && lines.locate(4).column == 3);
+    assert(lines.locate(6).line == 2 && lines.locate(6).column == 1);
+    assert(lines.locate(13).line == 3 && lines.locate(13).column == 5);
+    assert(lines.line(100) == 4);
+}
+
+void testRuneDiagnostics() {
+    RuneParser parser;
+    const std::string source =
+        "ᚠ \"ok\"\n"
+        "x ᛃ ᛒ\n"
+        "ᚷ(x) {\n"
+        "    y ᛃ (1\n"
+        "    ᚠ y\n"
+        "    z ᛃ 2\n"
+        "}\n"
+        "}\n"
+        "ᛚ ᛃ 3\n"
+        "ᚠ \"done\"\n";
+
+    // Every error is found in one pass; the statements around them parse
+    assert(!parser.checkSyntax(source));
+    [[maybe_unused]] const std::vector<RuneParseError>& diagnostics = parser.diagnostics();
+    assert(diagnostics.size() == 4);
+    assert(diagnostics[0].getLine() == 2 && diagnostics[0].getColumn() == 5);
+    assert(diagnostics[1].getLine() == 5 && diagnostics[1].getMessage() == "Expected ')'");
+    assert(diagnostics[2].getLine() == 8 && diagnostics[2].getMessage() == "Unexpected '}'");
+    assert(diagnostics[3].getLine() == 9);
+    assert(parser.checkSyntax("ᚠ 1\nᚠ 2") && parser.diagnostics().empty());
+
+    // Without recovery the first error is thrown as before
+    try {
+        parser.parseRuneCode(source);
+        assert(false && "Should not reach here");
+    } catch (const RuneParseError& e) {
+        assert(e.getLine() == 2);
+    }
+
+    // With it, nothing is generated for a file with errors
+    parser.setRecover(true);
+    try {
+        parser.parseRuneCode(source);
+        assert(false && "Should not reach here");
+    } catch (const RuneParseError& e) {
+        assert(e.getLine() == 2 && parser.diagnostics().size() == 4);
+    }
+    assert(parser.parseRuneCode("x ᛃ 1") == "x = 1;\n");
+}
+
+void testRuneSyntaxTree() {
+    RuneParser parser;
+    RuneArena arena;
+
+    const std::string source =
+        "ᛚ size ᛃ 1024 ᚹ 1024  ᛞ 1MB\n"
+        "ᚷ(size > 0) {\n"
+        "    ᚠ\"Size: \" size \"\\n\"\n"
+        "} ᚨ {\n"
+        "    ᛮsize\n"
+        "}\n";
+    const Ast::Program program = parser.parseProgram(source, arena);
+    assert(program.body.count == 3);
+
+    const auto* decl = Ast::as<Ast::VarDecl>(program.body[0]);
+    assert(decl && decl->name == "size" && decl->typeName == "float");
+    [[maybe_unused]] const auto* product = Ast::as<Ast::BinaryExpr>(decl->init);
+    assert(product && product->op == Ast::BinaryOp::Mul);
+    assert(Ast::as<Ast::CommentStmt>(program.body[1]));
+
+    const auto* branch = Ast::as<Ast::IfStmt>(program.body[2]);
+    assert(branch && branch->thenBlock->body.count == 1);
+    assert(Ast::as<Ast::PrintStmt>(branch->thenBlock->body[0])->args.count == 3);
+    assert(Ast::as<Ast::BlockStmt>(branch->elseBranch));
+
+    // Every mention of a name shares one symbol
+    const auto* print = Ast::as<Ast::PrintStmt>(branch->thenBlock->body[0]);
+    [[maybe_unused]] const auto* mention = Ast::as<Ast::Identifier>(print->args[1]);
+    assert(mention && mention->symbol == decl->symbol);
+    assert(program.symbols->name(decl->symbol) == "size");
+    assert(program.symbols->find("size") == decl->symbol);
+    assert(program.symbols->find("Size: ") != kNoSymbol && program.symbols->find("missing") == kNoSymbol);
+
+    // Symbols stay dense and stable while the table grows
+    RuneSymbolTable symbols;
+    std::vector<std::string> names;
+    for (int i = 0; i < 5000; i++) names.push_back("name" + std::to_string(i));
+    for (int i = 0; i < 5000; i++) assert(symbols.intern(names[i]) == static_cast<Symbol>(i));
+    for (int i = 0; i < 5000; i++) assert(symbols.internCopy(names[i]) == static_cast<Symbol>(i));
+    assert(symbols.size() == 5000 && symbols.name(4321) == "name4321");
+    symbols.clear();
+    assert(symbols.find("name1") == kNoSymbol && symbols.internCopy(std::string("x")) == 0 && symbols.name(0) == "x");
+
+    // Generated as written; testRuneOptimizer covers the rewritten form
+    parser.setOptimize(false);
+    assert(parser.parseRuneCode(source) ==
+           "float size = 1024 * 1024;\n"
+           "// 1MB\n"
+           "if (size > 0) {\n"
+           "    std::cout << \"Size: \" << size << \"\\n\";\n"
+           "} else {\n"
+           "    freeMemory(size);\n"
+           "}\n");
+
+    // Loop steps written as a bare operation update the counter
+    assert(parser.parseRuneCode("ᚱ(ᛚ i ᛃ 0; i < 3; i ᚢ 1) {\n}") ==
+           "for (float i = 0; i < 3; i = i + 1) {\n}\n");
+}
+
+// Whether a temporary written beside path is still in its directory
+bool hasTemporary(const std::string& path) {
+    const std::filesystem::path target(path);
+    const std::string prefix = target.filename().string() + ".tmp";
+    const std::filesystem::path directory = target.has_parent_path() ? target.parent_path() : ".";
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.path().filename().string().compare(0, prefix.size(), prefix) == 0) return true;
+    }
+    return false;
+}
+
+void testRuneFileCompile() {
+    const std::string inputPath = "rune_test_input.rune";
+    const std::string outputPath = "rune_test_output.cpp";
+    {
+        std::ofstream input(inputPath);
+        input << "ᛝ name ᛃ \"Odin\"\n"
+                 "ᚠ\"Hail \" name\n";
+    }
+
+    RuneParser parser;
+    parser.compileFile(inputPath, outputPath);
+
+    std::ifstream output(outputPath);
+    std::stringstream generated;
+    generated << output.rdbuf();
+    assert(generated.str() ==
+           "#include <iostream>\n\n"
+           "std::string name = \"Odin\";\n"
+           "std::cout << \"Hail \" << name;\n"
+           "\nint main() {\n\treturn 0;\n}");
+
+    // A syntax error after some output was streamed leaves the last good
+    // file in place rather than a truncated one
+    {
+        std::ofstream input(inputPath);
+        input << "ᚠ\"Hail\"\n"
+                 "}\n";
+    }
+    [[maybe_unused]] bool threw = false;
+    try {
+        parser.compileFile(inputPath, outputPath);
+    } catch (const RuneParseError&) {
+        threw = true;
+    }
+    assert(threw);
+    std::ifstream kept(outputPath);
+    std::stringstream previous;
+    previous << kept.rdbuf();
+    assert(previous.str() == generated.str());
+    assert(!hasTemporary(outputPath));
+
+    // Threads writing the same output path each stream to a temporary of
+    // their own, so the file that wins is always whole
+    {
+        std::ofstream input(inputPath);
+        input << "ᛝ name ᛃ \"Odin\"\n"
+                 "ᚠ\"Hail \" name\n";
+    }
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 4; i++) {
+        writers.emplace_back([&inputPath, &outputPath] {
+            RuneParser writer;
+            for (int j = 0; j < 25; j++) writer.compileFile(inputPath, outputPath);
+        });
+    }
+    for (std::thread& writer : writers) writer.join();
+    std::ifstream raced(outputPath);
+    std::stringstream written;
+    written << raced.rdbuf();
+    assert(written.str() == generated.str());
+    assert(!hasTemporary(outputPath));
+
+    // Offsets are 32-bit, so a source of 4 GiB is refused before it is read.
+    // The file is sparse and only mapped, never touched.
+    std::filesystem::resize_file(inputPath, uint64_t(kMaxRuneSourceBytes) + 1);
+    for (int entry = 0; entry < 2; entry++) {
+        try {
+            if (entry == 0) {
+                parser.compileFile(inputPath, outputPath);
+            } else {
+                const RuneMappedFile huge(inputPath);
+                parser.checkSyntax(huge.view());
+            }
+            assert(false && "Expected exception was not thrown");
+        } catch (const RuneParseError& e) {
+            assert(e.getMessage().find("4 GiB") != std::string::npos);
+        }
+    }
+    assert(!hasTemporary(outputPath));
+
+    std::remove(inputPath.c_str());
+    std::remove(outputPath.c_str());
+}
+
+void testRuneSourceMap() {
+    RuneSourceMap map;
+    map.add(3, 1);
+    map.add(4, 1);  // Same Rune line, dropped
+    map.add(5, 4);
+    map.add(9, 2);
+    map.add(100000, 70000);
+    assert(map.entries().size() == 4);
+    assert(map.runeLine(2) == 0 && map.runeLine(4) == 1 && map.runeLine(8) == 4 && map.runeLine(9) == 2);
+    assert(map.runeLine(200000) == 70000);
+
+    const std::string encoded = map.encode();
+    const RuneSourceMap decoded = RuneSourceMap::decode(encoded);
+    assert(decoded.entries().size() == map.entries().size());
+    for (size_t i = 0; i < map.entries().size(); i++) {
+        assert(decoded.entries()[i].cppLine == map.entries()[i].cppLine &&
+               decoded.entries()[i].runeLine == map.entries()[i].runeLine);
+    }
+    [[maybe_unused]] bool threw = false;
+    try {
+        RuneSourceMap::decode(encoded + "!");
+    } catch (const RuneError& e) {
+        threw = e.getCode() == RuneError::ErrorCode::FILE_ERROR;
+    }
+    assert(threw);
+
+    const std::string inputPath = "rune_test_map.rune";
+    const std::string outputPath = "rune_test_map.cpp";
+    {
+        std::ofstream input(inputPath);
+        input << "ᛞ note\n"
+                 "ᛚ x ᛃ 1\n"
+                 "\n"
+                 "ᚷ x > 0 {\n"
+                 "    ᚠ x\n"
+                 "}\n"
+                 "ᚠ x\n";
+    }
+
+    RuneParser parser;
+    parser.setOptimize(false);
+    parser.setSourceMap(true);
+    parser.setLineDirectives(true);
+    parser.compileFile(inputPath, outputPath);
+
+    std::ifstream output(outputPath);
+    std::stringstream generated;
+    generated << output.rdbuf();
+    // A directive is only written where the compiler's own count goes wrong
+    assert(generated.str() ==
+           "#include <iostream>\n\n"
+           "#line 1 \"rune_test_map.rune\"\n"
+           "// note\n"
+           "float x = 1;\n"
+           "#line 4 \"rune_test_map.rune\"\n"
+           "if (x > 0) {\n"
+           "    std::cout << x;\n"
+           "}\n"
+           "std::cout << x;\n"
+           "\nint main() {\n\treturn 0;\n}");
+
+    const RuneSourceMap written = RuneSourceMap::read(outputPath + ".map");
+    assert(written.runeLine(4) == 1 && written.runeLine(5) == 2 && written.runeLine(7) == 4);
+    assert(written.runeLine(8) == 5 && written.runeLine(9) == 5 && written.runeLine(10) == 7);
+
+    // A cached compile restores the map along with the code
+    const std::string cacheDir = "rune_test_map_cache";
+    {
+        RuneCache cache(cacheDir);
+        RuneParser cached;
+        cached.setCache(&cache);
+        cached.setSourceMap(true);
+        cached.compileToCpp("ᚠ 1\n\nᚠ 2\n", outputPath);
+        std::remove((outputPath + ".map").c_str());
+        cached.compileToCpp("ᚠ 1\n\nᚠ 2\n", outputPath);
+        assert(cache.hits() == 2);
+        assert(RuneSourceMap::read(outputPath + ".map").runeLine(4) == 3);
+    }
+    std::filesystem::remove_all(cacheDir);
+
+    std::remove(inputPath.c_str());
+    std::remove(outputPath.c_str());
+    std::remove((outputPath + ".map").c_str());
+}
+
+void testRuneCache() {
+    namespace fs = std::filesystem;
+    const fs::path cacheDir = "rune_test_cache";
+    const std::string outputPath = "rune_test_cached.cpp";
+    fs::remove_all(cacheDir);
+
+    const std::string code = "ᛚ x ᛃ 1\nᚠ x\n";
+    {
+        RuneCache cache(cacheDir.string());
+        RuneParser parser;
+        parser.setCache(&cache);
+
+        const std::string first = parser.compileToCpp(code, outputPath);
+        assert(cache.hits() == 0 && cache.misses() == 1);
+        const std::string second = parser.compileToCpp(code, outputPath);
+        assert(cache.hits() == 1);
+        assert(first == second);
+
+        std::ifstream output(outputPath);
+        std::stringstream generated;
+        generated << output.rdbuf();
+        assert(generated.str() == "#include <iostream>\n\n" + first + "\nint main() {\n\treturn 0;\n}");
+
+        // A changed script must not be served from the cache
+        parser.compileToCpp(code + "ᚠ x\n", outputPath);
+        assert(cache.hits() == 1 && cache.misses() == 2);
+    }
+
+    // Least recently used entries go first once the size limit is hit
+    fs::remove_all(cacheDir);
+    {
+        RuneCache cache(cacheDir.string(), 1000);
+        const std::string entry(300, 'x');
+        for (uint64_t key = 1; key <= 3; key++) {
+            cache.store({key, key, 300}, entry);
+        }
+
+        const auto now = fs::file_time_type::clock::now();
+        for (int key = 1; key <= 3; key++) {
+            const fs::path path = cacheDir / ("000000000000000" + std::to_string(key) + ".cpp");
+            fs::last_write_time(path, now - std::chrono::hours(4 - key));
+        }
+
+        std::string loaded;
+        assert(cache.load({1, 1, 300}, loaded) && loaded == entry);
+        cache.store({4, 4, 300}, entry);
+
+        assert(cache.bytesStored() <= 750);
+        assert(cache.load({1, 1, 300}, loaded) && cache.load({4, 4, 300}, loaded));
+        assert(!cache.load({2, 2, 300}, loaded) && !cache.load({3, 3, 300}, loaded));
+    }
+
+    // A key whose hash collides with a stored entry's is a miss, not a hit
+    // on the other input's output
+    fs::remove_all(cacheDir);
+    {
+        RuneCache cache(cacheDir.string());
+        cache.store({7, 1, 10}, "first");
+        std::string loaded = "untouched";
+        assert(!cache.load({7, 2, 10}, loaded) && !cache.load({7, 1, 11}, loaded));
+        assert(loaded == "untouched" && cache.misses() == 2);
+        assert(cache.load({7, 1, 10}, loaded) && loaded == "first");
+
+        // Replacing an entry counts only its new size
+        [[maybe_unused]] const uint64_t once = cache.bytesStored();
+        cache.store({7, 1, 10}, "first");
+        assert(cache.bytesStored() == once);
+    }
+
+    fs::remove_all(cacheDir);
+    std::remove(outputPath.c_str());
+}
+
+void testRuneBytecode() {
+    RuneParser parser;
+    parser.setOptimize(false);
+
+    const Bytecode::Module module = parser.compileToBytecode(
+        "ᛚ size ᛃ 4 ᚹ 2\n"
+        "ᚠ \"size \" size\n");
+    assert(module.functions.size() == 1);
+    assert(module.globals.size() == 1 && module.text(module.globals[0]) == "size");
+    assert(disassemble(module) ==
+           "function <script> params=0 registers=3\n"
+           "     0 [1] LoadInt     r1 4\n"
+           "     1 [1] LoadInt     r2 2\n"
+           "     2 [1] Mul         r0 r1 r2\n"
+           "     3 [1] ToFloat     r0 r0\n"
+           "     4 [1] SetGlobal   r0 size\n"
+           "     5 [2] LoadK       r0 \"size \"\n"
+           "     6 [2] Print       r0\n"
+           "     7 [2] GetGlobal   r0 size\n"
+           "     8 [2] Print       r0\n"
+           "     9 [2] ReturnNil  \n");
+
+    // Functions are hoisted and host calls are named for the VM to bind
+    const Bytecode::Module calls = parser.compileToBytecode(
+        "ᚠ twice(3)\n"
+        "ᛠ twice(ᛠ n) { ᛏ n ᚹ 2 }\n"
+        "ᚠ ᛨgetHostname() ᛲ\"log.txt\"\n");
+    assert(calls.functions.size() == 2);
+    assert(calls.text(calls.functions[1].name) == "twice");
+    assert(calls.functions[1].paramCount == 1);
+    assert(calls.natives.size() == 2);
+    assert(calls.text(calls.natives[0]) == "RuneSystem::getHostname");
+    assert(calls.text(calls.natives[1]) == "createFile");
+    assert(calls.lineAt(calls.functions[1].codeOffset) == 2);
+
+    try {
+        parser.compileToBytecode("ᚠ missing\n");
+        assert(false && "Expected exception was not thrown");
+    } catch (const RuneParseError& e) {
+        assert(e.getLine() == 1);
+        assert(e.getMessage() == "Unknown variable 'missing'");
+    }
+}
+
+void testRuneVM() {
+    RuneParser parser;
+    const std::string script =
+        "ᛠ fib(ᛠ n) {\n"
+        "    ᚷ n < 2 { ᛏ n }\n"
+        "    ᛏ fib(n ᚦ 1) ᚢ fib(n ᚦ 2)\n"
+        "}\n"
+        "ᛝ name ᛃ \"Odin\"\n"
+        "ᛙ total ᛃ 0\n"
+        "ᚱ(ᛙ i ᛃ 1; i <= 10; i ᚢ 1) {\n"
+        "    ᚷ i ᚻ 2 == 0 { total ᛃ total ᚢ i } ᚨ { total ᛃ total ᚦ 1 }\n"
+        "}\n"
+        "ᛝ block ᛃ ᛬16\n"
+        "block[3] ᛃ 200\n"
+        "ᚠ name \" \" fib(10) \" \" total \" \" 7 ᚺ 2 \" \" block[3] \"\\n\"\n"
+        "ᛮblock\n";
+
+    for (RuneVM::Dispatch dispatch : {RuneVM::Dispatch::Threaded, RuneVM::Dispatch::Switch}) {
+        std::ostringstream out;
+        RuneVM vm(out);
+        vm.setDispatch(dispatch);
+        vm.load(parser.compileToBytecode(script));
+        vm.run();
+        assert(out.str() == "Odin 55 25 3 200\n");
+        assert(vm.global("total").asInt() == 25);
+    }
+
+    // Float declarations behave like the generated C++
+    {
+        std::ostringstream out;
+        RuneVM vm(out);
+        vm.load(parser.compileToBytecode("ᛚ half ᛃ 7\nhalf ᛃ half ᚺ 2\nᚠ half\n"));
+        vm.run();
+        assert(out.str() == "3.5");
+    }
+
+    // Runtime errors report the line they happened on
+    try {
+        std::ostringstream out;
+        RuneVM vm(out);
+        vm.load(parser.compileToBytecode("ᛙ zero ᛃ 0\n\nᚠ 1 ᚺ zero\n"));
+        vm.run();
+        assert(false && "Expected exception was not thrown");
+    } catch (const RuneRuntimeError& e) {
+        assert(e.getLine() == 3);
+        assert(e.getMessage() == "Division by zero");
+    }
+}
+
+void testRuneModule() {
+    const std::string sourcePath = "rune_test_module.rune";
+    const std::string modulePath = "rune_test_module.runec";
+    const std::string script =
+        "ᛠ twice(ᛠ n) {\n"
+        "    ᛏ n ᚹ 2\n"
+        "}\n"
+        "ᛝ name ᛃ \"Odin\"\n"
+        "ᚠ name \" \" twice(21) \"\\n\"\n"
+        "ᛙ zero ᛃ 0\n"
+        "ᚠ 1 ᚺ zero\n";
+    std::ofstream(sourcePath) << script;
+
+    RuneParser parser;
+    parser.compileModule(sourcePath, modulePath);
+
+    // The mapped module runs as compiled, line table included
+    {
+        auto module = std::make_shared<const RuneModuleFile>(modulePath);
+        assert(module->sourceHash() == runeSourceHash(script));
+        assert(disassemble(module->image()) == disassemble(parser.compileToBytecode(script)));
+
+        std::ostringstream out;
+        RuneVM vm(out);
+        vm.load(module);
+        try {
+            vm.run();
+            assert(false && "Expected exception was not thrown");
+        } catch (const RuneRuntimeError& e) {
+            assert(e.getLine() == 7);
+        }
+        assert(out.str() == "Odin 42\n");
+    }
+
+    // Writing is deterministic, and damaged files are refused
+    std::stringstream first;
+    first << std::ifstream(modulePath, std::ios::binary).rdbuf();
+    parser.compileModule(sourcePath, modulePath);
+    std::stringstream second;
+    second << std::ifstream(modulePath, std::ios::binary).rdbuf();
+    assert(first.str() == second.str());
+
+    std::filesystem::resize_file(modulePath, first.str().size() / 2);
+    try {
+        RuneModuleFile truncated(modulePath);
+        assert(false && "Expected exception was not thrown");
+    } catch (const RuneError& e) {
+        assert(e.getCode() == RuneError::ErrorCode::FILE_ERROR);
+    }
+
+    // Instructions that would leave their tables, registers or function
+    // are refused at load as well
+    using namespace Bytecode;
+    Module valid;
+    valid.functions.push_back(Function{StringRef{}, 0, 3, 0, 2});
+    valid.constants.emplace_back();
+    valid.globals.push_back(StringRef{});
+    valid.natives.push_back(StringRef{});
+    valid.code = {encodeABx(Op::LoadK, 1, 0), encodeABx(Op::SetGlobal, 1, 0), encodeABC(Op::ReturnNil, 0, 0, 0)};
+    assert(verifyBytecode(valid.image()) == nullptr);
+
+    const Instruction damaged[] = {
+        encodeABx(Op::LoadK, 0, 1),              // Constant past the table
+        encodeABx(Op::GetGlobal, 0, 1),          // Global past the table
+        encodeABC(Op::CallNative, 0, 1, 0),      // Unknown host function
+        encodeABC(Op::CallNative, 1, 0, 2),      // Arguments past the frame
+        encodeABC(Op::Call, 1, 1, 0),            // Arguments past the frame
+        encodeSJ(Op::Jump, 1),                   // Past the end of the function
+        encodeAsBx(Op::JumpIfTrue, 0, -3),       // Before its start
+        encodeABC(Op::Add, 0, 1, 2),             // Register past registerCount
+        encodeABC(Op::Input, 0, 3, 0),           // No such InputKind
+        static_cast<Instruction>(Op::Count),     // No such opcode
+    };
+    for (Instruction instruction : damaged) {
+        Module module = valid;
+        module.code[1] = instruction;
+        assert(verifyBytecode(module.image()) != nullptr);
+    }
+
+    Module fallsOff = valid;
+    fallsOff.code[2] = encodeABC(Op::Print, 0, 0, 0);
+    Module outside = valid;
+    outside.functions[0].codeSize = 4;
+    Module noScript = valid;
+    noScript.functions.clear();
+    for ([[maybe_unused]] const Module* module : {&fallsOff, &outside, &noScript}) {
+        assert(verifyBytecode(module->image()) != nullptr);
+    }
+
+    Module badJump = valid;
+    badJump.code[1] = encodeSJ(Op::Jump, 5);
+    std::ofstream(modulePath, std::ios::binary | std::ios::trunc) << encodeRuneModule(badJump, 0);
+    try {
+        RuneModuleFile hostile(modulePath);
+        assert(false && "Expected exception was not thrown");
+    } catch (const RuneError& e) {
+        assert(e.getCode() == RuneError::ErrorCode::FILE_ERROR);
+    }
+    std::ofstream(modulePath, std::ios::binary | std::ios::trunc) << encodeRuneModule(valid, 0);
+    assert(RuneModuleFile(modulePath).image().code.size() == 3);
+
+    // Threads writing one path each write a temporary of their own
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 4; i++) {
+        writers.emplace_back([&valid, &modulePath] {
+            for (int j = 0; j < 25; j++) writeRuneModule(valid, 0, modulePath);
+        });
+    }
+    for (std::thread& writer : writers) writer.join();
+    assert(RuneModuleFile(modulePath).image().code.size() == 3);
+    assert(!hasTemporary(modulePath));
+
+    std::remove(sourcePath.c_str());
+    std::remove(modulePath.c_str());
+}
+
+void testRuneNative() {
+    const std::string jitDir = "rune_test_jit";
+    const std::string scriptPath = "rune_test_native.rune";
+    std::filesystem::remove_all(jitDir);
+    RuneJit jit(jitDir);
+
+    const std::string script =
+        "ᛠ fib(ᛠ n) {\n"
+        "    ᚷ n < 2 { ᛏ n }\n"
+        "    ᛏ fib(n ᚦ 1) ᚢ fib(n ᚦ 2)\n"
+        "}\n"
+        "ᛠ total ᛃ 0\n"
+        "ᛝ name ᛃ \"Odin\"\n"
+        "ᚱ(ᛙ i ᛃ 1; i <= 10; i ᚢ 1) { total ᛃ total ᚢ i }\n"
+        "ᚠ name \" \" fib(10) \" \" total \"\\n\"\n";
+
+    // The entry point runs in process; globals start afresh on every run
+    std::ostringstream out;
+    std::streambuf* console = std::cout.rdbuf(out.rdbuf());
+    auto library = jit.compile(script);
+    library->run();
+    library->run();
+    std::cout.rdbuf(console);
+    assert(out.str() == "Odin 55 55\nOdin 55 55\n");
+    assert(jit.misses() == 1);
+
+    // The same text is loaded from the object directory without compiling
+    jit.compile(script);
+    assert(jit.hits() == 1 && jit.misses() == 1);
+
+    // Scripts that change on disk are swapped in on the next run
+    std::ofstream(scriptPath) << "ᚠ 1\n";
+    RuneNativeScript native(jit, scriptPath);
+    out.str("");
+    console = std::cout.rdbuf(out.rdbuf());
+    native.run();
+    assert(!native.reload());
+    std::ofstream(scriptPath) << "ᚠ 22\n";
+    assert(native.reload());
+    native.run();
+    std::cout.rdbuf(console);
+    assert(out.str() == "122");
+
+    // A version that fails to compile leaves the previous one current
+    auto previous = native.current();
+    std::ofstream(scriptPath) << "ᚠ (1\n";
+    try {
+        native.reload();
+        assert(false && "Expected exception was not thrown");
+    } catch (const RuneParseError&) {
+    }
+    assert(native.current() == previous);
+
+    // Operation runes need the runtime, which only RuneVM reaches, so
+    // scripts calling them are refused before the compiler runs
+    const std::pair<const char*, size_t> runtimeScripts[] = {
+        {"ᚠ ᛨgetHostname()\n", 1},
+        {"ᚠ 1\nᛩ worker\n", 2},
+        {"ᛠ f() {\n    ᛵ\"log.txt\" \"x\"\n}\n", 2},
+    };
+    for (const auto& [runtime, line] : runtimeScripts) {
+        try {
+            jit.compile(runtime);
+            assert(false && "Expected exception was not thrown");
+        } catch (const RuneParseError& e) {
+            assert(e.getMessage().find("not supported by the native backend") != std::string::npos);
+            assert(e.getLine() == line);
+        }
+    }
+
+    std::remove(scriptPath.c_str());
+    std::filesystem::remove_all(jitDir);
+}
+
+void testRuneOptimizer() {
+    RuneParser parser;
+
+    // Literal arithmetic folds, and known variables are replaced by values
+    // of their declared type
+    assert(parser.parseRuneCode(
+               "ᛚ size ᛃ 1024 ᚹ 1024\n"
+               "ᚠ size \" \" 7 ᚺ 2 \" \" (1 ᚢ 2) ᚹ 0.5\n") ==
+           "float size = 1048576;\n"
+           "std::cout << 1048576.0f << \" \" << 3 << \" \" << 1.5;\n");
+
+    // Dead branches disappear and the taken one keeps its scope
+    assert(parser.parseRuneCode(
+               "ᛡ verbose ᛃ 0\n"
+               "ᚷ verbose { ᚠ \"loud\" } ᚨ { ᚠ \"quiet\" }\n"
+               "ᛉ verbose { ᚠ \"never\" }\n") ==
+           "bool verbose = 0;\n"
+           "{\n"
+           "    std::cout << \"quiet\";\n"
+           "}\n");
+
+    // Assignments carry constants forward until the branches disagree
+    assert(parser.parseRuneCode(
+               "ᛠ x ᛃ 2\n"
+               "x ᛃ x ᚢ 1\n"
+               "ᚠ x\n"
+               "ᚷ flag { x ᛃ 4 }\n"
+               "ᚠ x\n") ==
+           "double x = 2;\n"
+           "x = 3.0;\n"
+           "std::cout << 3.0;\n"
+           "if (flag) {\n"
+           "    x = 4;\n"
+           "}\n"
+           "std::cout << x;\n");
+
+    // Loop counters, script calls and undefined arithmetic are left alone
+    assert(parser.parseRuneCode(
+               "ᛠ g ᛃ 1\n"
+               "ᚱ(ᛠ i ᛃ 0; i < 3; i ᚢ 1) { ᚠ i }\n"
+               "bump()\n"
+               "ᚠ g \" \" 7 ᚻ 0 \" \" 2147483647 ᚢ 1\n") ==
+           "double g = 1;\n"
+           "for (double i = 0; i < 3; i = i + 1) {\n"
+           "    std::cout << i;\n"
+           "}\n"
+           "bump();\n"
+           "std::cout << g << \" \" << 7 % 0 << \" \" << 2147483647 + 1;\n");
+
+    // A name declared again in its scope takes the new type and value, and
+    // forgets the old one when the new initializer is not constant
+    assert(parser.parseRuneCode(
+               "ᛚ a ᛃ 1\n"
+               "ᛠ a ᛃ 2\n"
+               "ᚠ a ᚹ 0.5\n"
+               "ᛠ a ᛃ g\n"
+               "ᚠ a\n") ==
+           "float a = 1;\n"
+           "double a = 2;\n"
+           "std::cout << 1.0;\n"
+           "double a = g;\n"
+           "std::cout << a;\n");
+
+    // Redeclaring inside a branch does not leak past it, and a global
+    // redeclared many times is still forgotten across a script call
+    assert(parser.parseRuneCode(
+               "ᛚ b ᛃ 1\n"
+               "ᚷ flag { ᛚ b ᛃ 2\n ᛚ b ᛃ 3\n ᚠ b }\n"
+               "ᚠ b\n"
+               "ᛚ b ᛃ 4\n"
+               "ᛚ b ᛃ 5\n"
+               "bump()\n"
+               "ᚠ b\n") ==
+           "float b = 1;\n"
+           "if (flag) {\n"
+           "    float b = 2;\n"
+           "    float b = 3;\n"
+           "    std::cout << 3.0f;\n"
+           "}\n"
+           "std::cout << 1.0f;\n"
+           "float b = 4;\n"
+           "float b = 5;\n"
+           "bump();\n"
+           "std::cout << b;\n");
+
+    // The VM sees the same program
+    std::ostringstream out;
+    RuneVM vm(out);
+    vm.load(parser.compileToBytecode("ᛚ half ᛃ 7\nhalf ᛃ half ᚺ 2\nᚷ half > 3 { ᚠ half }\n"));
+    vm.run();
+    assert(out.str() == "3.5");
+    assert(disassemble(vm.module()).find("Jump") == std::string::npos);
+}
+
+void testRuneServer() {
+    const std::string socketPath = "rune_test_runed.sock";
+    const std::string sourcePath = std::filesystem::absolute("rune_test_server.rune").string();
+    const std::string script = "ᛝ name ᛃ \"Odin\"\nᚠ name \"\\n\"\n";
+    std::ofstream(sourcePath) << script;
+
+    RuneServer server(socketPath, 2);
+    std::thread serving([&server] { server.run(); });
+    RuneParser parser;
+
+    // Answers match what the parser produces in process, request after
+    // request on one connection
+    {
+        RuneClient client(socketPath);
+        RuneServerRequest request;
+        request.payload = script;
+        RuneServerResponse response = client.send(request);
+        assert(response.status == RuneServerResponse::Status::Ok);
+        assert(response.payload == parser.compileToCppUnit(script));
+
+        request.command = RuneServerRequest::Command::Bytecode;
+        request.isPath = true;
+        request.payload = sourcePath;
+        response = client.send(request);
+        assert(response.status == RuneServerResponse::Status::Ok);
+        assert(response.payload == encodeRuneModule(parser.compileToBytecode(script), runeSourceHash(script)));
+
+        request.command = RuneServerRequest::Command::Check;
+        request.isPath = false;
+        request.payload = "ᚠ \"ok\"\nx ᛃ ᛒ\nᚠ 1\n}\n";
+        response = client.send(request);
+        const std::vector<RuneParseError> diagnostics = response.diagnostics();
+        assert(response.status == RuneServerResponse::Status::ParseError);
+        assert(diagnostics.size() == 2);
+        assert(diagnostics[0].getLine() == 2 && diagnostics[0].getColumn() == 5);
+        assert(diagnostics[1].getLine() == 4 && diagnostics[1].getMessage() == "Unexpected '}'");
+
+        request.command = RuneServerRequest::Command::Cpp;
+        request.payload = "x ᛃ ᛒ\n";
+        response = client.send(request);
+        assert(response.status == RuneServerResponse::Status::ParseError);
+        assert(response.diagnostics().size() == 1 && response.diagnostics()[0].getLine() == 1);
+
+        request.isPath = true;
+        request.payload = sourcePath + ".missing";
+        response = client.send(request);
+        assert(response.status == RuneServerResponse::Status::Error);
+    }
+
+    // Connections are served side by side
+    const std::string expected = parser.compileToCppUnit(script);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < 2; i++) {
+        clients.emplace_back([&] {
+            RuneClient client(socketPath);
+            RuneServerRequest request;
+            request.payload = script;
+            for (int j = 0; j < 20; j++) {
+                assert(client.send(request).payload == expected);
+            }
+        });
+    }
+    for (std::thread& client : clients) client.join();
+
+    // Clients that stay connected between requests do not hold a worker,
+    // so more of them than there are workers still leave room for others
+    {
+        std::vector<std::unique_ptr<RuneClient>> idle;
+        RuneServerRequest request;
+        request.payload = script;
+        for (int i = 0; i < 4; i++) {
+            idle.push_back(std::make_unique<RuneClient>(socketPath));
+            assert(idle.back()->send(request).payload == expected);
+        }
+        RuneClient late(socketPath);
+        assert(late.send(request).payload == expected);
+        assert(idle.front()->send(request).payload == expected);
+    }
+
+    // A live server is not replaced
+    try {
+        RuneServer second(socketPath, 1);
+        assert(false && "Expected exception was not thrown");
+    } catch (const RuneError& e) {
+        assert(e.getCode() == RuneError::ErrorCode::NETWORK_ERROR);
+    }
+
+    // Stopping does not wait for idle clients to hang up
+    RuneClient idle(socketPath);
+    server.stop();
+    serving.join();
+    assert(server.requestsServed() == 51);
+
+    std::remove(sourcePath.c_str());
+}
+
 int main() {
     std::cout << "Running Rune tests..." << std::endl;
 
@@ -118,6 +1100,48 @@ int main() {
         testLogging();
         std::cout << "Logging test passed" << std::endl;
 
+        testRuneLexer();
+        std::cout << "Rune lexer test passed" << std::endl;
+
+        testRuneParallelLexer();
+        std::cout << "Rune parallel lexer test passed" << std::endl;
+
+        testRuneParser();
+        std::cout << "Rune parser test passed" << std::endl;
+
+        testRuneDiagnostics();
+        std::cout << "Rune diagnostics test passed" << std::endl;
+
+        testRuneSyntaxTree();
+        std::cout << "Rune syntax tree test passed" << std::endl;
+
+        testRuneFileCompile();
+        std::cout << "Rune file compile test passed" << std::endl;
+
+        testRuneSourceMap();
+        std::cout << "Rune source map test passed" << std::endl;
+
+        testRuneCache();
+        std::cout << "Rune cache test passed" << std::endl;
+
+        testRuneBytecode();
+        std::cout << "Rune bytecode test passed" << std::endl;
+
+        testRuneVM();
+        std::cout << "Rune VM test passed" << std::endl;
+
+        testRuneModule();
+        std::cout << "Rune module test passed" << std::endl;
+
+        testRuneNative();
+        std::cout << "Rune native test passed" << std::endl;
+
+        testRuneOptimizer();
+        std::cout << "Rune optimizer test passed" << std::endl;
+
+        testRuneServer();
+        std::cout << "Rune server test passed" << std::endl;
+
         std::cout << "\nAll tests passed successfully!" << std::endl;
         return 0;
     } catch (const std::exception& e) {